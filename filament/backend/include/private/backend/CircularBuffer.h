@@ -29,6 +29,10 @@ public:
     //      to set it to 3*requiredSize to avoid blocking the render thread (usually the UI thread).
     explicit CircularBuffer(size_t bufferSize);
 
+    // Uses the given memory, which is not owned, as a linear buffer of 'bufferSize' bytes. Such a
+    // buffer must not be circularized. This is used by CommandStreamSegment.
+    CircularBuffer(void* data, size_t bufferSize) noexcept;
+
     // can't be moved or copy-constructed
     CircularBuffer(CircularBuffer const& rhs) = delete;
     CircularBuffer(CircularBuffer&& rhs) noexcept = delete;
@@ -55,6 +59,15 @@ public:
 
     void* getTail() const noexcept { return mTail; }
 
+    // Allocations must not go past this address, or they would overwrite commands that were not
+    // executed yet. This is maintained by the owner of the buffer, see CommandBufferQueue.
+    void* getLimit() const noexcept { return mLimit; }
+
+    void setLimit(void* limit) noexcept { mLimit = limit; }
+
+    // exchanges the memory and state of two buffers
+    void swap(CircularBuffer& rhs) noexcept;
+
     // call at least once every getRequiredSize() bytes allocated from the buffer
     void circularize() noexcept;
 
@@ -67,6 +80,7 @@ private:
     // pointer to the beginning of the circular buffer (constant)
     void* mData = nullptr;
     int mUsesAshmem = -1;
+    bool mOwnsData = true;
 
     // size of the circular buffer (constant)
     size_t mSize = 0;
@@ -77,6 +91,9 @@ private:
     // pointer to the next available command
     void* mHead = nullptr;
 
+    // end of the space available for commands
+    void* mLimit = nullptr;
+
     // system page size
     static size_t sPageSize;
 };
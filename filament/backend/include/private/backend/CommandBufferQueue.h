@@ -19,9 +19,13 @@
 
 #include "private/backend/CircularBuffer.h"
 
+#include <utils/architecture.h>
 #include <utils/Condition.h>
 #include <utils/Mutex.h>
 
+#include <array>
+#include <atomic>
+#include <memory>
 #include <vector>
 
 #include <stddef.h>
@@ -30,38 +34,122 @@
 namespace filament::backend {
 
 /*
- * A producer-consumer command queue that uses a CircularBuffer as main storage
+ * A producer-consumer command queue that uses a CircularBuffer as main storage.
+ *
+ * Slices are handed off from the producer (main) thread to the consumer (driver) thread through a
+ * lock-free single-producer / single-consumer queue. A thread that must wait, for commands or for
+ * free space, spins for a bounded time before parking on a condition variable.
+ *
+ * A slice that outgrows the space guaranteed by the previous flush() waits for older slices to
+ * be executed, see reserve(). When allowed, the circular buffer then grows at the next flush(),
+ * and shrinks back after it has been mostly unused for a while. A slice that doesn't fit in the
+ * whole circular buffer continues in a larger one, linked to by a NoopCommand.
  */
 class CommandBufferQueue {
     struct Slice {
         void* begin;
         void* end;
+        // space used in the circular buffer, this excludes the part of a slice recorded in
+        // storage that was retired since, so it's not always end - begin.
+        size_t size;
     };
 
-    const size_t mRequiredSize;
+    // maximum number of slices waiting to be executed, must be a power of two.
+    static constexpr uint32_t SLICE_QUEUE_SIZE = 256;
+    static_assert((SLICE_QUEUE_SIZE & (SLICE_QUEUE_SIZE - 1)) == 0);
+
+    // number of times a thread yields and polls before parking
+    static constexpr uint32_t SPIN_COUNT = 128;
+
+    // number of flushes the circular buffer must be mostly unused for, before it's shrunk
+    static constexpr uint32_t SHRINK_COOLDOWN_FLUSH_COUNT = 600;
+
+    // guaranteed available space after flush(), this scales with the circular buffer's size
+    size_t mRequiredSize;
+    const size_t mMinBufferSize;
+    const size_t mMaxBufferSize;
 
     CircularBuffer mCircularBuffer;
 
-    // space available in the circular buffer
+    // storage of the circular buffer before it was last resized, and the number of slices that
+    // must be released before it can be freed.
+    std::vector<std::unique_ptr<CircularBuffer>> mRetiredBuffers;
+    uint32_t mRetiredBufferReleaseCount = 0;
+
+    // beginning of the slice being recorded, if it started in retired storage
+    void* mChainedSliceBegin = nullptr;
 
+    // largest space used since the last resize, and number of flushes since then
+    size_t mPeakUsedSinceResize = 0;
+    uint32_t mFlushCountSinceResize = 0;
+    uint32_t mResizeCount = 0;
+
+    // slices ready to be executed, from mSliceTail (consumer) to mSliceHead (producer)
+    std::array<Slice, SLICE_QUEUE_SIZE> mSlices;
+    alignas(utils::CACHELINE_SIZE) std::atomic<uint32_t> mSliceHead{ 0 };
+    alignas(utils::CACHELINE_SIZE) mutable std::atomic<uint32_t> mSliceTail{ 0 };
+
+    // space available in the circular buffer, and number of slices released by the consumer
+    alignas(utils::CACHELINE_SIZE) std::atomic<size_t> mFreeSpace;
+    std::atomic<uint32_t> mReleasedCount{ 0 };
+    size_t mHighWatermark = 0;
+    std::atomic<uint32_t> mExitRequested{ 0 };
+
+    // only used for parking
     mutable utils::Mutex mLock;
     mutable utils::Condition mCondition;
-    mutable std::vector<Slice> mCommandBuffersToExecute;
-    size_t mFreeSpace = 0;
-    size_t mHighWatermark = 0;
-    uint32_t mExitRequested = 0;
+    mutable std::atomic<uint32_t> mParkedCount{ 0 };
+
+    // time spent blocked by each side, in nanoseconds
+    std::atomic<uint64_t> mProducerBlockedTime{ 0 };
+    mutable std::atomic<uint64_t> mConsumerBlockedTime{ 0 };
 
     static constexpr uint32_t EXIT_REQUESTED = 0x31415926;
 
+    // waits until pred() is true, returns the time spent waiting in nanoseconds
+    template<typename PREDICATE>
+    uint64_t wait(PREDICATE pred) const noexcept;
+
+    // wakes up the other thread if it's parked
+    void notify() const noexcept;
+
+    // replaces the circular buffer by one of the given size, once all slices are released
+    uint64_t resize(size_t size) noexcept;
+
+    // continues the slice being recorded in a circular buffer of the given size, once all the
+    // slices already flushed are released.
+    uint64_t chain(size_t size) noexcept;
+
+    // keeps the circular buffer's previous storage until releaseCount slices have been released
+    void retire(std::unique_ptr<CircularBuffer> buffer, uint32_t releaseCount) noexcept;
+
 public:
     // requiredSize: guaranteed available space after flush()
-    CommandBufferQueue(size_t requiredSize, size_t bufferSize);
+    // maxBufferSize: the circular buffer can grow up to this size, 0 disables growing.
+    CommandBufferQueue(size_t requiredSize, size_t bufferSize, size_t maxBufferSize = 0);
     ~CommandBufferQueue();
 
     CircularBuffer& getCircularBuffer() { return mCircularBuffer; }
 
+    // largest space used in the circular buffer at a time
     size_t getHighWatermark() const noexcept { return mHighWatermark; }
 
+    // current size of the circular buffer
+    size_t getSize() const noexcept { return mCircularBuffer.size(); }
+
+    // number of times the circular buffer was grown or shrunk
+    uint32_t getResizeCount() const noexcept { return mResizeCount; }
+
+    // total time flush() spent waiting for space in the circular buffer, in nanoseconds
+    uint64_t getProducerBlockedTime() const noexcept {
+        return mProducerBlockedTime.load(std::memory_order_relaxed);
+    }
+
+    // total time waitForCommands() spent waiting for commands, in nanoseconds
+    uint64_t getConsumerBlockedTime() const noexcept {
+        return mConsumerBlockedTime.load(std::memory_order_relaxed);
+    }
+
     // wait for commands to be available and returns an array containing these commands
     std::vector<Slice> waitForCommands() const;
 
@@ -72,8 +160,15 @@ public:
 
     // all commands buffers (Slices) written to this point are returned by waitForCommand(). This
     // call blocks until the CircularBuffer has at least mRequiredSize bytes available.
+    // The circular buffer is only resized here.
     void flush() noexcept;
 
+    // Blocks until the commands being recorded can grow by 'size' bytes, and moves the circular
+    // buffer's limit accordingly. Unlike flush(), this doesn't hand off these commands, so the
+    // memory allocated with them stays valid. When they can't fit in the circular buffer, they
+    // continue in a larger one if allowed. This is CommandStream's overflow handler.
+    void reserve(size_t size) noexcept;
+
     // returns from waitForCommands() immediately.
     void requestExit();
 
@@ -33,6 +33,7 @@
 
 #include <utils/compiler.h>
 #include <utils/debug.h>
+#include <utils/Invocable.h>
 #include <utils/ThreadUtils.h>
 
 #include <cstddef>
@@ -148,6 +149,9 @@ struct CommandType<void (Driver::*)(ARGS...)> {
         // A command can be moved
         inline Command(Command&& rhs) noexcept = default;
 
+        // the arguments this command was recorded with, see CommandStreamCapture
+        SavedParameters const& getArguments() const noexcept { return mArgs; }
+
         template<typename... A>
         inline explicit constexpr Command(Execute execute, A&& ... args)
                 : CommandBase(execute), mArgs(std::forward<A>(args)...) {
@@ -164,6 +168,18 @@ struct CommandType<void (Driver::*)(ARGS...)> {
 // convert a method of "class Driver" into a Command<> type
 #define COMMAND_TYPE(method) CommandType<decltype(&Driver::method)>::Command<&Driver::method>
 
+// Identifies the asynchronous driver commands, e.g. in a capture file
+enum class CommandId : uint16_t {
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                     methodName,
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)     methodName,
+#include "DriverAPI.inc"
+    COUNT
+};
+
+// Returns the name of the driver method corresponding to a command
+const char* getCommandName(CommandId id) noexcept;
+
 // ------------------------------------------------------------------------------------------------
 
 class CustomCommand : public CommandBase {
@@ -189,6 +205,12 @@ public:
 
 // ------------------------------------------------------------------------------------------------
 
+class CommandStreamCapture;
+class CommandStreamProfiler;
+class CommandStreamSegment;
+
+// ------------------------------------------------------------------------------------------------
+
 #if !defined(NDEBUG) || (FILAMENT_DEBUG_COMMANDS >= FILAMENT_DEBUG_COMMANDS_ENABLE)
     // For now, simply pass the method name down as a string and throw away the parameters.
     // This is good enough for certain debugging needs and we can improve this later.
@@ -257,12 +279,74 @@ public:
 
     void execute(void* buffer);
 
+    /*
+     * Sets the function called when the buffer doesn't have enough space left for an allocation
+     * of the given size. It must move the buffer's limit so the allocation fits, otherwise the
+     * program is terminated. By default there is no handler.
+     *
+     * The handler must not hand off the commands recorded so far: memory returned by allocate()
+     * must remain valid until the commands referring to it are executed, and these may not be
+     * recorded yet.
+     */
+    void setOverflowHandler(utils::Invocable<void(size_t)>&& handler) noexcept {
+        mOverflowHandler = std::move(handler);
+    }
+
     /*
      * queueCommand() allows to queue a lambda function as a command.
      * This is much less efficient than using the Driver* API.
      */
     void queueCommand(std::function<void()> command);
 
+    /*
+     * Segments allow recording commands concurrently from several threads.
+     *
+     * createSegment() returns a segment which can hold up to 'capacity' bytes of commands. Its
+     * stream can then be used from any one thread (which must call debugThreading() first),
+     * and insertSegment() inserts the recorded commands at the current position of this
+     * stream. Segments are therefore executed in the order they're inserted, regardless of when
+     * they were recorded. The segment is destroyed once its commands have been executed.
+     *
+     * Only asynchronous commands that don't return a value can be recorded in a segment, and
+     * createSegment() / insertSegment() must be called from the thread owning this stream.
+     * Segments can't be used when FILAMENT_DEBUG_COMMANDS is enabled, see hasSegments().
+     */
+    CommandStreamSegment* createSegment(size_t capacity);
+
+    void insertSegment(CommandStreamSegment* segment) noexcept;
+
+    static constexpr bool hasSegments() noexcept {
+        // debug commands add their own, unaccounted for, commands to the stream
+        return FILAMENT_DEBUG_COMMANDS == FILAMENT_DEBUG_COMMANDS_NONE;
+    }
+
+    /*
+     * Starts writing the commands recorded from now on to the file at 'path', as they are
+     * executed. See CommandStreamCapture. Returns false if the file can't be created or a
+     * capture is already in progress.
+     *
+     * stopCommandCapture() stops the capture, the file is closed once the captured commands are
+     * executed. Neither can be called while segments are being recorded.
+     */
+    bool startCommandCapture(const char* path);
+
+    void stopCommandCapture();
+
+    /*
+     * Starts accounting for the commands executed from now on, per type of command and per frame.
+     * See CommandStreamProfiler. Returns false if profiling is already in progress.
+     *
+     * stopCommandProfiling() stops it. Neither can be called while segments are being recorded.
+     * Capture and profiling can be used together, but must then be stopped in the reverse order
+     * they were started.
+     */
+    bool startCommandProfiling();
+
+    void stopCommandProfiling();
+
+    // Returns the profiler started by startCommandProfiling(), or nullptr.
+    CommandStreamProfiler const* getCommandProfiler() const noexcept { return mProfiler; }
+
     /*
      * Allocates memory associated to the current CommandStreamBuffer.
      * This memory will be automatically freed after this command buffer is processed.
@@ -281,14 +365,23 @@ public:
 private:
     inline void* allocateCommand(size_t size) {
         assert_invariant(utils::ThreadUtils::isThisThread(mThreadId));
+        if (UTILS_UNLIKELY(uintptr_t(mCurrentBuffer.getHead()) + size >
+                uintptr_t(mCurrentBuffer.getLimit()))) {
+            overflow(size);
+        }
         return mCurrentBuffer.allocate(size);
     }
 
+    void overflow(size_t size);
+
     // We use a copy of Dispatcher (instead of a pointer) because this removes one dereference
     // when executing driver commands.
     Driver& UTILS_RESTRICT mDriver;
     CircularBuffer& UTILS_RESTRICT mCurrentBuffer;
     Dispatcher mDispatcher;
+    utils::Invocable<void(size_t)> mOverflowHandler;
+    CommandStreamCapture* mCapture = nullptr;
+    CommandStreamProfiler* mProfiler = nullptr;
 
 #ifndef NDEBUG
     // just for debugging...
@@ -320,6 +413,29 @@ PodType* CommandStream::allocatePod(size_t count, size_t alignment) noexcept {
     return static_cast<PodType*>(allocate(count * sizeof(PodType), alignment));
 }
 
+// ------------------------------------------------------------------------------------------------
+
+/*
+ * A CommandStream recording into its own heap buffer, see CommandStream::createSegment().
+ */
+class CommandStreamSegment {
+public:
+    CommandStreamSegment(Driver& driver, size_t capacity);
+    ~CommandStreamSegment() noexcept;
+
+    CommandStreamSegment(CommandStreamSegment const& rhs) = delete;
+    CommandStreamSegment& operator=(CommandStreamSegment const& rhs) = delete;
+
+    CommandStream& getStream() noexcept { return mStream; }
+
+private:
+    friend class CommandStream;
+    void* mData;
+    size_t mCapacity;
+    CircularBuffer mBuffer;
+    CommandStream mStream;
+};
+
 } // namespace filament::backend
 
 #endif // TNT_FILAMENT_BACKEND_PRIVATE_COMMANDSTREAM_H
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_BACKEND_PRIVATE_COMMANDSTREAMCAPTURE_H
+#define TNT_FILAMENT_BACKEND_PRIVATE_COMMANDSTREAMCAPTURE_H
+
+#include "private/backend/CircularBuffer.h"
+#include "private/backend/CommandStream.h"
+#include "private/backend/Dispatcher.h"
+
+#include <backend/Handle.h>
+
+#include <tsl/robin_map.h>
+
+#include <tuple>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+namespace filament::backend {
+
+class Driver;
+
+/*
+ * CommandStreamCapture serializes the commands executed by a CommandStream, along with their
+ * arguments, to a file. See CommandStream::startCommandCapture().
+ *
+ * The capture works by substituting the CommandStream's Dispatcher with one which serializes each
+ * command before executing it with the driver's Dispatcher, so it happens on the driver thread
+ * and adds no cost when not capturing. The arguments are written as follows:
+ * - buffer descriptors are written with their content
+ * - pixel buffer descriptors are written with their layout and a digest of their content
+ * - pointers (native windows, callbacks, user data) are not meaningful outside of this process,
+ *   they're written as null
+ * - everything else is written as is
+ *
+ * Synchronous driver methods and commands queued with CommandStream::queueCommand() are not
+ * captured.
+ *
+ * A capture file is replayed with CommandStreamReplay.
+ */
+class CommandStreamCapture {
+public:
+    static constexpr uint32_t MAGIC = 0x43534346;   // 'FCSC'
+    static constexpr uint32_t VERSION = 1;
+
+    // Returns nullptr if the file can't be created
+    static CommandStreamCapture* create(const char* path, Dispatcher const& dispatcher) noexcept;
+
+    ~CommandStreamCapture() noexcept;
+
+    CommandStreamCapture(CommandStreamCapture const& rhs) = delete;
+    CommandStreamCapture& operator=(CommandStreamCapture const& rhs) = delete;
+
+    // Dispatcher to use to record the commands to capture
+    Dispatcher const& getDispatcher() const noexcept { return mCaptureDispatcher; }
+
+    // Dispatcher the capture was created with, which executes the commands
+    Dispatcher const& getDriverDispatcher() const noexcept { return mDriverDispatcher; }
+
+    // Starts / stops receiving the commands executed on the calling thread. These must be called
+    // on the driver thread, before the first and after the last captured command executes.
+    void activate() noexcept;
+    void deactivate() noexcept;
+
+private:
+    friend class CaptureDispatcher;
+
+    CommandStreamCapture(FILE* file, Dispatcher const& dispatcher) noexcept;
+
+    template<typename ... ARGS>
+    void write(CommandId id, std::tuple<ARGS...> const& args) noexcept;
+
+    FILE* mFile;
+    Dispatcher mDriverDispatcher;
+    Dispatcher mCaptureDispatcher;
+    std::vector<uint8_t> mData;     // serialized arguments of the current command
+    bool mFailed = false;
+};
+
+/*
+ * CommandStreamReplay executes the commands of a capture file with a Driver.
+ *
+ * The commands are decoded and recorded in a CommandStream, which is executed at the end of each
+ * frame (and when it's full), all on the calling thread. Handles are translated to the ones
+ * created during the replay. The arguments that couldn't be captured are replaced as follows:
+ * - the content of pixel buffer descriptors is zero-filled
+ * - pointers (native windows, callbacks, user data) are null
+ *
+ * This makes replays deterministic and suitable to benchmark the driver thread, in particular
+ * with NoopDriver. Drivers for a GPU backend might not be able to replay a capture faithfully,
+ * e.g. swap chains can't be created without a native window.
+ */
+class CommandStreamReplay {
+public:
+    struct CommandStatistics {
+        uint64_t count = 0;         // number of commands executed
+        uint64_t captureSize = 0;   // size of their arguments in the capture file
+        uint64_t streamSize = 0;    // size they used in the CommandStream
+    };
+
+    struct Statistics {
+        CommandStatistics commands[size_t(CommandId::COUNT)] = {};
+        uint64_t frameCount = 0;
+        uint64_t skippedCount = 0;      // commands unknown to this version of the driver API
+        uint64_t executionTime = 0;     // time spent executing commands, in nanoseconds
+    };
+
+    // bufferSize is the size of the CommandStream's buffer. Commands are executed at the end of
+    // each frame, or earlier when the buffer is full.
+    CommandStreamReplay(Driver& driver, size_t bufferSize);
+    ~CommandStreamReplay() noexcept;
+
+    CommandStreamReplay(CommandStreamReplay const& rhs) = delete;
+    CommandStreamReplay& operator=(CommandStreamReplay const& rhs) = delete;
+
+    // Replays the capture file at 'path'. Returns false if the file can't be read or is
+    // corrupted, in which case the commands up to the error have been executed.
+    bool replay(const char* path);
+
+    Statistics const& getStatistics() const noexcept { return mStatistics; }
+
+private:
+    class Reader;
+    friend class Reader;
+
+    // returns the size of the command in the CommandStream, 0 if its arguments are invalid
+    size_t execute(CommandId id, Reader& reader);
+    void flush();
+
+    // replaces the handles of the capture in a command's arguments by ours
+    template<typename ... ARGS>
+    void remapArguments(CommandId id, std::tuple<ARGS...>& args) const noexcept;
+    void remapSamplers(BufferDescriptor& data) const noexcept;
+
+    template<typename T>
+    void remap(Handle<T>& handle) const noexcept;
+    void remap(TargetBufferInfo& info) const noexcept;
+    void remap(MRT& mrt) const noexcept;
+    void remap(PipelineState& state) const noexcept;
+    template<typename T>
+    void remap(T const&) const noexcept { }
+
+    Driver& mDriver;
+    CircularBuffer mBuffer;
+    CommandStream mStream;
+    // handles of the capture to the handles created during the replay
+    tsl::robin_map<HandleBase::HandleId, HandleBase::HandleId> mHandles;
+    Statistics mStatistics;
+};
+
+} // namespace filament::backend
+
+#endif // TNT_FILAMENT_BACKEND_PRIVATE_COMMANDSTREAMCAPTURE_H
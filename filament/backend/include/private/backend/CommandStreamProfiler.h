@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_BACKEND_PRIVATE_COMMANDSTREAMPROFILER_H
+#define TNT_FILAMENT_BACKEND_PRIVATE_COMMANDSTREAMPROFILER_H
+
+#include "private/backend/CommandStream.h"
+#include "private/backend/Dispatcher.h"
+
+#include <utils/Mutex.h>
+
+#include <array>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace utils::io {
+class ostream;
+} // namespace utils::io
+
+namespace filament::backend {
+
+/*
+ * CommandStreamProfiler accounts for the commands executed by the driver thread, per type of
+ * command and per frame. See CommandStream::startCommandProfiling().
+ *
+ * Like CommandStreamCapture, it substitutes the CommandStream's Dispatcher with one which times
+ * each command, so it adds no cost when not in use. The time of a command includes decoding its
+ * arguments and executing it.
+ */
+class CommandStreamProfiler {
+public:
+    struct CommandStatistics {
+        uint32_t count = 0;     // number of commands executed
+        uint32_t size = 0;      // size of these commands in the CommandStream, in bytes
+        uint64_t time = 0;      // time spent executing them, in nanoseconds
+    };
+
+    struct FrameStatistics {
+        std::array<CommandStatistics, size_t(CommandId::COUNT)> commands{};
+        uint32_t frameId = 0;   // id passed to the endFrame command closing this frame
+    };
+
+    explicit CommandStreamProfiler(Dispatcher const& dispatcher) noexcept;
+
+    CommandStreamProfiler(CommandStreamProfiler const& rhs) = delete;
+    CommandStreamProfiler& operator=(CommandStreamProfiler const& rhs) = delete;
+
+    // Dispatcher to use to record the commands to account for
+    Dispatcher const& getDispatcher() const noexcept { return mProfilerDispatcher; }
+
+    // Dispatcher the profiler was created with, which executes the commands
+    Dispatcher const& getDriverDispatcher() const noexcept { return mDriverDispatcher; }
+
+    // Starts / stops receiving the commands executed on the calling thread. These must be called
+    // on the driver thread, before the first and after the last profiled command executes.
+    void activate() noexcept;
+    void deactivate() noexcept;
+
+    // Returns the statistics of the last frame whose endFrame command was executed. This can be
+    // called from any thread.
+    FrameStatistics getFrameStatistics() const noexcept;
+
+    // Writes getFrameStatistics() as JSON
+    static void writeJson(utils::io::ostream& out, FrameStatistics const& statistics) noexcept;
+
+private:
+    friend class ProfilerDispatcher;
+
+    void record(CommandId id, intptr_t size, uint64_t time) noexcept {
+        CommandStatistics& command = mCurrentFrame.commands[size_t(id)];
+        command.count++;
+        command.size += uint32_t(size);
+        command.time += time;
+    }
+
+    void endFrame(uint32_t frameId) noexcept;
+
+    Dispatcher mDriverDispatcher;
+    Dispatcher mProfilerDispatcher;
+    FrameStatistics mCurrentFrame;          // only accessed by the driver thread
+    mutable utils::Mutex mLock;
+    FrameStatistics mLastFrame;             // protected by mLock
+};
+
+} // namespace filament::backend
+
+#endif // TNT_FILAMENT_BACKEND_PRIVATE_COMMANDSTREAMPROFILER_H
@@ -21,12 +21,12 @@
 
 #include <utils/Allocator.h>
 #include <utils/Log.h>
+#include <utils/Mutex.h>
 #include <utils/compiler.h>
 #include <utils/debug.h>
 #include <utils/ostream.h>
 
-#include <tsl/robin_map.h>
-
+#include <atomic>
 #include <exception>
 #include <type_traits>
 #include <unordered_map>
@@ -48,6 +48,10 @@ namespace filament::backend {
 
 /*
  * A utility class to efficiently allocate and manage Handle<>
+ *
+ * Handles can be allocated and freed from any thread without locking: each pool is a lock-free
+ * free list. When the HandleArena is full, handles are allocated from overflow arenas, which are
+ * created as needed, each twice as large as the previous one.
  */
 template <size_t P0, size_t P1, size_t P2>
 class HandleAllocator {
@@ -222,9 +226,9 @@ private:
     // template <int P0, int P1, int P2>
     class Allocator {
         friend class HandleAllocator;
-        utils::PoolAllocator<P0, 16>   mPool0;
-        utils::PoolAllocator<P1, 16>   mPool1;
-        utils::PoolAllocator<P2, 16>   mPool2;
+        utils::PoolAllocator<P0, 16, 0, utils::AtomicFreeList>   mPool0;
+        utils::PoolAllocator<P1, 16, 0, utils::AtomicFreeList>   mPool1;
+        utils::PoolAllocator<P2, 16, 0, utils::AtomicFreeList>   mPool2;
         UTILS_UNUSED_IN_RELEASE const utils::AreaPolicy::HeapArea& mArea;
     public:
         static constexpr size_t MIN_ALIGNMENT_SHIFT = 4;
@@ -248,18 +252,22 @@ private:
         }
     };
 
-// FIXME: We should be using a Spinlock here, at least on platforms where mutexes are not
-//        efficient (i.e. non-Linux). However, we've seen some hangs on that spinlock, which
-//        we don't understand well (b/308029108).
+    // The pools are thread-safe, the lock is only needed for the tracking policy, which isn't.
 #ifndef NDEBUG
     using HandleArena = utils::Arena<Allocator,
             utils::LockingPolicy::Mutex,
             utils::TrackingPolicy::DebugAndHighWatermark>;
 #else
     using HandleArena = utils::Arena<Allocator,
-            utils::LockingPolicy::Mutex>;
+            utils::LockingPolicy::NoLock>;
 #endif
 
+    struct OverflowArena {
+        explicit OverflowArena(size_t size) : area(size), allocator(area) { }
+        utils::AreaPolicy::HeapArea area;
+        Allocator allocator;
+    };
+
     // allocateHandle()/deallocateHandle() selects the pool to use at compile-time based on the
     // allocation size this is always inlined, because all these do is to call
     // allocateHandleInPool()/deallocateHandleFromPool() with the right pool size.
@@ -284,8 +292,7 @@ private:
     }
 
     // allocateHandleInPool()/deallocateHandleFromPool() is NOT inlined, which will cause three
-    // versions to be generated, one for each pool. Because the arena is synchronized,
-    // the code generated is not trivial (even if it's not insane either).
+    // versions to be generated, one for each pool.
     template<size_t SIZE>
     UTILS_NOINLINE
     HandleBase::HandleId allocateHandleInPool() noexcept {
@@ -308,10 +315,19 @@ private:
         }
     }
 
-    static constexpr uint32_t HEAP_HANDLE_FLAG = 0x80000000u;
+    // Handles allocated from an overflow arena have OVERFLOW_HANDLE_FLAG set, followed by the
+    // index of the arena and the offset of the handle within it.
+    static constexpr uint32_t OVERFLOW_HANDLE_FLAG = 0x80000000u;
+    static constexpr uint32_t OVERFLOW_ARENA_SHIFT = 27u;
+    static constexpr uint32_t OVERFLOW_OFFSET_MASK = (1u << OVERFLOW_ARENA_SHIFT) - 1u;
+    static constexpr size_t MAX_OVERFLOW_ARENA_SIZE =
+            size_t(OVERFLOW_OFFSET_MASK + 1u) << Allocator::MIN_ALIGNMENT_SHIFT;
+    // the last index is never used, so that the null handle doesn't map to an arena
+    static constexpr uint32_t MAX_OVERFLOW_ARENA_COUNT =
+            (~OVERFLOW_HANDLE_FLAG >> OVERFLOW_ARENA_SHIFT);
 
     static bool isPoolHandle(HandleBase::HandleId id) noexcept {
-        return (id & HEAP_HANDLE_FLAG) == 0u;
+        return (id & OVERFLOW_HANDLE_FLAG) == 0u;
     }
 
     HandleBase::HandleId allocateHandleSlow(size_t size) noexcept;
@@ -336,16 +352,21 @@ private:
         char* const base = (char*)mHandleArena.getArea().begin();
         size_t offset = (char*)p - base;
         auto id = HandleBase::HandleId(offset >> Allocator::MIN_ALIGNMENT_SHIFT);
-        assert_invariant((id & HEAP_HANDLE_FLAG) == 0);
+        assert_invariant((id & OVERFLOW_HANDLE_FLAG) == 0);
         return id;
     }
 
     HandleArena mHandleArena;
 
-    // Below is only used when running out of space in the HandleArena
+    // Below is only used when running out of space in the HandleArena. The overflow arenas are
+    // published by mOverflowArenaCount, and only created with mLock held.
+    OverflowArena* mOverflowArenas[MAX_OVERFLOW_ARENA_COUNT] = {};
+    std::atomic<uint32_t> mOverflowArenaCount = 0;
     mutable utils::Mutex mLock;
-    tsl::robin_map<HandleBase::HandleId, void*> mOverflowMap;
-    HandleBase::HandleId mId = 0;
+#ifndef NDEBUG
+    // number of handles allocated from the overflow arenas and not freed yet
+    std::atomic<uint32_t> mOverflowHandleCount = 0;
+#endif
 #if HANDLE_TYPE_SAFETY
     mutable std::unordered_map<const void*, const char*> mHandleTypeId;
 #endif
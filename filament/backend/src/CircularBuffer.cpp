@@ -24,6 +24,8 @@
 #    define HAS_MMAP 0
 #endif
 
+#include <utility>
+
 #include <stdio.h>
 
 #include <utils/architecture.h>
@@ -43,10 +45,31 @@ CircularBuffer::CircularBuffer(size_t size) {
     mSize = size;
     mTail = mData;
     mHead = mData;
+    mLimit = (char*)mData + size;
+}
+
+CircularBuffer::CircularBuffer(void* data, size_t size) noexcept
+        : mOwnsData(false),
+          mSize(size),
+          mTail(data),
+          mHead(data),
+          mLimit((char*)data + size) {
 }
 
 CircularBuffer::~CircularBuffer() noexcept {
-    dealloc();
+    if (mOwnsData) {
+        dealloc();
+    }
+}
+
+void CircularBuffer::swap(CircularBuffer& rhs) noexcept {
+    std::swap(mData, rhs.mData);
+    std::swap(mUsesAshmem, rhs.mUsesAshmem);
+    std::swap(mOwnsData, rhs.mOwnsData);
+    std::swap(mSize, rhs.mSize);
+    std::swap(mTail, rhs.mTail);
+    std::swap(mHead, rhs.mHead);
+    std::swap(mLimit, rhs.mLimit);
 }
 
 // If the system support mmap(), use it for creating a "hard circular buffer" where two virtual
@@ -150,6 +173,7 @@ void CircularBuffer::dealloc() noexcept {
 
 
 void CircularBuffer::circularize() noexcept {
+    assert_invariant(mOwnsData);
     if (mUsesAshmem > 0) {
         intptr_t const overflow = intptr_t(mHead) - (intptr_t(mData) + ssize_t(mSize));
         if (overflow >= 0) {
@@ -24,37 +24,88 @@
 #include "private/backend/BackendUtils.h"
 #include "private/backend/CommandStream.h"
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
 using namespace utils;
 
 namespace filament::backend {
 
-CommandBufferQueue::CommandBufferQueue(size_t requiredSize, size_t bufferSize)
+CommandBufferQueue::CommandBufferQueue(size_t requiredSize, size_t bufferSize,
+        size_t maxBufferSize)
         : mRequiredSize((requiredSize + (CircularBuffer::getBlockSize() - 1u)) & ~(CircularBuffer::getBlockSize() -1u)),
+          mMinBufferSize(bufferSize),
+          mMaxBufferSize(std::max(bufferSize, maxBufferSize)),
           mCircularBuffer(bufferSize),
           mFreeSpace(mCircularBuffer.size()) {
     SYSTRACE_CALL();
     assert_invariant(mCircularBuffer.size() > requiredSize);
+    // leave room for the terminating NoopCommand, see flush()
+    mCircularBuffer.setLimit(static_cast<char*>(mCircularBuffer.getTail()) +
+            mCircularBuffer.size() - CommandBase::align(sizeof(NoopCommand)));
 }
 
 CommandBufferQueue::~CommandBufferQueue() {
     SYSTRACE_CALL();
-    assert_invariant(mCommandBuffersToExecute.empty());
+    assert_invariant(mSliceHead.load() == mSliceTail.load());
+}
+
+template<typename PREDICATE>
+uint64_t CommandBufferQueue::wait(PREDICATE pred) const noexcept {
+    if (UTILS_LIKELY(pred())) {
+        return 0;
+    }
+
+    auto const start = std::chrono::steady_clock::now();
+
+    // The other thread is usually about to make progress, spinning a little avoids the latency
+    // of parking and waking up.
+    bool ready = false;
+    for (uint32_t i = 0; i < SPIN_COUNT && !ready; i++) {
+        std::this_thread::yield();
+        ready = pred();
+    }
+
+    if (!ready) {
+        SYSTRACE_NAME("CommandBufferQueue: parked");
+        std::unique_lock<utils::Mutex> lock(mLock);
+        // mParkedCount must be incremented before pred() is checked (under the lock), so that
+        // notify() either sees it, or happened before and pred() is true. pred()'s loads are
+        // not all sequentially consistent, the fence keeps them from being reordered before
+        // the increment.
+        mParkedCount.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        mCondition.wait(lock, pred);
+        mParkedCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+}
+
+void CommandBufferQueue::notify() const noexcept {
+    // this must be called after the state change it signals, which must be sequentially
+    // consistent with mParkedCount, see wait().
+    if (UTILS_UNLIKELY(mParkedCount.load(std::memory_order_seq_cst))) {
+        std::lock_guard<utils::Mutex> const lock(mLock);
+        mCondition.notify_all();
+    }
 }
 
 void CommandBufferQueue::requestExit() {
     SYSTRACE_CALL();
     SYSTRACE_TEXT("CommandBufferQueue::requestExit");
-    std::lock_guard<utils::Mutex> const lock(mLock);
-    mExitRequested = EXIT_REQUESTED;
-    mCondition.notify_one();
+    mExitRequested.store(EXIT_REQUESTED, std::memory_order_seq_cst);
+    notify();
 }
 
 bool CommandBufferQueue::isExitRequested() const {
     SYSTRACE_CALL();
-    std::lock_guard<utils::Mutex> const lock(mLock);
-    ASSERT_PRECONDITION( mExitRequested == 0 || mExitRequested == EXIT_REQUESTED,
-            "mExitRequested is corrupted (value = 0x%08x)!", mExitRequested);
-    return (bool)mExitRequested;
+    uint32_t const exitRequested = mExitRequested.load(std::memory_order_relaxed);
+    ASSERT_PRECONDITION( exitRequested == 0 || exitRequested == EXIT_REQUESTED,
+            "mExitRequested is corrupted (value = 0x%08x)!", exitRequested);
+    return (bool)exitRequested;
 }
 
 
@@ -68,76 +119,277 @@ void CommandBufferQueue::flush() noexcept {
     }
 
     // add the terminating command
-    // always guaranteed to have enough space for the NoopCommand
-    new(circularBuffer.allocate(sizeof(NoopCommand))) NoopCommand(nullptr);
+    // always guaranteed to have enough space for the NoopCommand, see setLimit() below
+    new(circularBuffer.allocate(CommandBase::align(sizeof(NoopCommand)))) NoopCommand(nullptr);
 
     // end of this slice
     void* const head = circularBuffer.getHead();
 
-    // beginning of this slice
+    // beginning of this slice in the circular buffer
     void* const tail = circularBuffer.getTail();
 
-    // size of this slice
+    // size of this slice in the circular buffer
     uint32_t const used = uint32_t(intptr_t(head) - intptr_t(tail));
 
-    circularBuffer.circularize();
+    // beginning of this slice, which is in retired storage if it was chained, see reserve()
+    bool const chained = mChainedSliceBegin != nullptr;
+    void* const begin = chained ? mChainedSliceBegin : tail;
+    mChainedSliceBegin = nullptr;
 
-    std::unique_lock<utils::Mutex> lock(mLock);
-    mCommandBuffersToExecute.push_back({ tail, head });
+    circularBuffer.circularize();
 
     // circular buffer is too small, we corrupted the stream
-    ASSERT_POSTCONDITION(used <= mFreeSpace,
+    // we never allocate past the limit, see CommandStream::allocateCommand()
+    ASSERT_POSTCONDITION(used <= mFreeSpace.load(std::memory_order_acquire),
             "Backend CommandStream overflow. Commands are corrupted and unrecoverable.\n"
             "Please increase minCommandBufferSizeMB inside the Config passed to Engine::create.\n"
             "Space used at this time: %u bytes",
             (unsigned)used);
 
-    // wait until there is enough space in the buffer
-    mFreeSpace -= used;
-    const size_t requiredSize = mRequiredSize;
+    uint64_t blockedTime = 0;
 
-#ifndef NDEBUG
-    size_t totalUsed = circularBuffer.size() - mFreeSpace;
+    // we're the only producer, so only the consumer can make room in the queue
+    uint32_t const sliceHead = mSliceHead.load(std::memory_order_relaxed);
+    auto hasRoomForSlice = [this, sliceHead]() {
+        return sliceHead - mSliceTail.load(std::memory_order_acquire) < SLICE_QUEUE_SIZE;
+    };
+    if (UTILS_HAS_THREADING) {
+        blockedTime += wait(hasRoomForSlice);
+    } else {
+        // without threads the consumer can't run until we return
+        ASSERT_POSTCONDITION(hasRoomForSlice(),
+                "Too many CommandStream flushes (%u) before commands were executed",
+                SLICE_QUEUE_SIZE);
+    }
+    mSlices[sliceHead % SLICE_QUEUE_SIZE] = { begin, head, used };
+
+    // the slice's memory is accounted for before the consumer can see it, so that mFreeSpace
+    // never exceeds the buffer size.
+    size_t const freeSpace = mFreeSpace.fetch_sub(used, std::memory_order_seq_cst) - used;
+    mSliceHead.store(sliceHead + 1, std::memory_order_seq_cst);
+    notify();
+
+    size_t const totalUsed = circularBuffer.size() - freeSpace;
     mHighWatermark = std::max(mHighWatermark, totalUsed);
-    if (UTILS_UNLIKELY(totalUsed > requiredSize)) {
+    mPeakUsedSinceResize = std::max(mPeakUsedSinceResize, totalUsed);
+    mFlushCountSinceResize++;
+
+#ifndef NDEBUG
+    if (UTILS_UNLIKELY(totalUsed > mRequiredSize)) {
         slog.d << "CommandStream used too much space: " << totalUsed
-            << ", out of " << requiredSize << " (will block)" << io::endl;
+            << ", out of " << mRequiredSize << " (will block)" << io::endl;
     }
 #endif
 
-    mCondition.notify_one();
-    if (UTILS_LIKELY(mFreeSpace < requiredSize)) {
+    // the storage used before the last resize is freed once the first slice recorded after
+    // it has executed, because that slice may still refer to data allocated in the old storage.
+    if (UTILS_UNLIKELY(!mRetiredBuffers.empty()) &&
+            mReleasedCount.load(std::memory_order_acquire) >= mRetiredBufferReleaseCount) {
+        mRetiredBuffers.clear();
+    }
+
+    size_t const size = circularBuffer.size();
+    if (UTILS_HAS_THREADING &&
+            UTILS_UNLIKELY(!chained && used > mRequiredSize && size < mMaxBufferSize)) {
+        // a single slice needed more than the guaranteed space (it had to wait in reserve()),
+        // grow the buffer for the next ones.
+        blockedTime += resize(std::min(size * 2, mMaxBufferSize));
+    } else if (UTILS_HAS_THREADING && UTILS_UNLIKELY(size > mMinBufferSize &&
+            mFlushCountSinceResize >= SHRINK_COOLDOWN_FLUSH_COUNT)) {
+        if (mPeakUsedSinceResize * 4 <= size) {
+            // the buffer has been mostly unused for a while, shrink it
+            blockedTime += resize(std::max(size / 2, mMinBufferSize));
+        } else {
+            // start a new cooldown period
+            mPeakUsedSinceResize = 0;
+            mFlushCountSinceResize = 0;
+        }
+    }
+
+    // wait until there is enough space in the buffer
+    const size_t requiredSize = mRequiredSize;
+    if (UTILS_LIKELY(mFreeSpace.load(std::memory_order_acquire) < requiredSize)) {
         SYSTRACE_NAME("waiting: CircularBuffer::flush()");
-        mCondition.wait(lock, [this, requiredSize]() -> bool {
-            return mFreeSpace >= requiredSize;
+        blockedTime += wait([this, requiredSize]() {
+            return mFreeSpace.load(std::memory_order_acquire) >= requiredSize;
         });
     }
+
+    // Commands can be recorded up to the space available now, minus the terminating NoopCommand.
+    // More space may become available in the meantime, but we only use it after the next flush.
+    circularBuffer.setLimit(static_cast<char*>(circularBuffer.getTail()) +
+            mFreeSpace.load(std::memory_order_acquire) -
+            CommandBase::align(sizeof(NoopCommand)));
+
+    if (blockedTime) {
+        mProducerBlockedTime.fetch_add(blockedTime, std::memory_order_relaxed);
+    }
+}
+
+void CommandBufferQueue::reserve(size_t size) noexcept {
+    SYSTRACE_CALL();
+
+    CircularBuffer& circularBuffer = mCircularBuffer;
+    size_t const terminator = CommandBase::align(sizeof(NoopCommand));
+    size_t const required = uintptr_t(circularBuffer.getHead()) -
+            uintptr_t(circularBuffer.getTail()) + size + terminator;
+
+    // The slice being recorded can't be flushed, because its commands may refer to memory
+    // allocated anywhere in it. At best, it can use the whole buffer, otherwise it continues in
+    // a larger one.
+    if (UTILS_UNLIKELY(required > circularBuffer.size())) {
+        size_t newSize = circularBuffer.size();
+        while (newSize < required && newSize < mMaxBufferSize) {
+            newSize = std::min(newSize * 2, mMaxBufferSize);
+        }
+        // the commands recorded so far stay in the current storage, the new one only needs to
+        // fit the new commands.
+        ASSERT_POSTCONDITION(UTILS_HAS_THREADING && size + terminator <= newSize &&
+                        newSize > circularBuffer.size(),
+                "Backend CommandStream overflow. The commands recorded since the last flush need "
+                "%u bytes, but the command buffer only has %u bytes.\n"
+                "Please increase commandBufferSizeMB or maxCommandBufferSizeMB inside the Config "
+                "passed to Engine::create, or flush the Engine more often.",
+                unsigned(required), unsigned(circularBuffer.size()));
+        uint64_t const blockedTime = chain(newSize);
+        if (blockedTime) {
+            mProducerBlockedTime.fetch_add(blockedTime, std::memory_order_relaxed);
+        }
+        return;
+    }
+
+    // the space after this slice is freed as the consumer releases older slices
+    auto hasRoom = [this, required]() {
+        return mFreeSpace.load(std::memory_order_acquire) >= required;
+    };
+    if (UTILS_HAS_THREADING) {
+        uint64_t const blockedTime = wait(hasRoom);
+        if (blockedTime) {
+            mProducerBlockedTime.fetch_add(blockedTime, std::memory_order_relaxed);
+        }
+    } else {
+        // without threads the consumer can't run until we return
+        ASSERT_POSTCONDITION(hasRoom(),
+                "Backend CommandStream overflow (%u bytes needed), commands can't be executed "
+                "before the next flush", unsigned(required));
+    }
+
+    circularBuffer.setLimit(static_cast<char*>(circularBuffer.getTail()) +
+            mFreeSpace.load(std::memory_order_acquire) - terminator);
+}
+
+uint64_t CommandBufferQueue::resize(size_t size) noexcept {
+    SYSTRACE_CALL();
+
+    // wait until all slices are released, so none of them refers to the current storage
+    uint32_t const sliceCount = mSliceHead.load(std::memory_order_relaxed);
+    uint64_t const blockedTime = wait([this, sliceCount]() {
+        return mReleasedCount.load(std::memory_order_acquire) == sliceCount;
+    });
+
+    // The commands recorded next may refer to data allocated before this flush (e.g. with
+    // CommandStream::allocate()), so the current storage is kept until the next slice is
+    // released.
+    auto buffer = std::make_unique<CircularBuffer>(size);
+    mCircularBuffer.swap(*buffer);
+    retire(std::move(buffer), sliceCount + 1);
+    return blockedTime;
+}
+
+uint64_t CommandBufferQueue::chain(size_t size) noexcept {
+    SYSTRACE_CALL();
+
+    // wait until the slices already flushed are released, so that only the one being recorded
+    // refers to the current storage, and the free space can be accounted for in the new one.
+    uint32_t const sliceCount = mSliceHead.load(std::memory_order_relaxed);
+    uint64_t const blockedTime = wait([this, sliceCount]() {
+        return mReleasedCount.load(std::memory_order_acquire) == sliceCount;
+    });
+
+    // The commands recorded so far stay where they are, they jump to the new storage once
+    // executed. There is always room for this NoopCommand, see setLimit().
+    CircularBuffer& circularBuffer = mCircularBuffer;
+    if (!mChainedSliceBegin) {
+        mChainedSliceBegin = circularBuffer.getTail();
+    }
+    auto buffer = std::make_unique<CircularBuffer>(size);
+    new(circularBuffer.allocate(CommandBase::align(sizeof(NoopCommand))))
+            NoopCommand(buffer->getTail());
+    circularBuffer.swap(*buffer);
+
+    // the previous storage is used until the slice being recorded is released
+    retire(std::move(buffer), sliceCount + 1);
+
+    circularBuffer.setLimit(static_cast<char*>(circularBuffer.getTail()) +
+            mFreeSpace.load(std::memory_order_acquire) -
+            CommandBase::align(sizeof(NoopCommand)));
+    return blockedTime;
+}
+
+void CommandBufferQueue::retire(std::unique_ptr<CircularBuffer> buffer,
+        uint32_t releaseCount) noexcept {
+    // the storage retired before is freed now, unless the slice being recorded still needs it
+    if (mReleasedCount.load(std::memory_order_acquire) >= mRetiredBufferReleaseCount) {
+        mRetiredBuffers.clear();
+    }
+    size_t const previousSize = buffer->size();
+    mRetiredBuffers.push_back(std::move(buffer));
+    mRetiredBufferReleaseCount = releaseCount;
+
+    // the guaranteed space scales with the buffer
+    size_t const size = mCircularBuffer.size();
+    size_t const blockSize = CircularBuffer::getBlockSize();
+    mRequiredSize = (mRequiredSize * (size / blockSize) / (previousSize / blockSize)
+            + blockSize - 1u) & ~(blockSize - 1u);
+
+    mFreeSpace.store(size, std::memory_order_seq_cst);
+    mPeakUsedSinceResize = 0;
+    mFlushCountSinceResize = 0;
+    mResizeCount++;
+
+    slog.i << "CommandStream buffer resized to " << size / 1024 << " KiB" << io::endl;
 }
 
 std::vector<CommandBufferQueue::Slice> CommandBufferQueue::waitForCommands() const {
     SYSTRACE_CALL();
     SYSTRACE_TEXT_COLOR("CommandBufferQueue::waitForCommands WAIT", COL_RED);
-    if (!UTILS_HAS_THREADING) {
-        return std::move(mCommandBuffersToExecute);
-    }
-    std::unique_lock<utils::Mutex> lock(mLock);
-    while (mCommandBuffersToExecute.empty() && !mExitRequested) {
-        mCondition.wait(lock);
+
+    uint32_t sliceTail = mSliceTail.load(std::memory_order_relaxed);
+    if (UTILS_HAS_THREADING) {
+        uint64_t const blockedTime = wait([this, sliceTail]() {
+            return mSliceHead.load(std::memory_order_acquire) != sliceTail ||
+                   mExitRequested.load(std::memory_order_relaxed);
+        });
+        if (blockedTime) {
+            mConsumerBlockedTime.fetch_add(blockedTime, std::memory_order_relaxed);
+        }
     }
 
-    ASSERT_PRECONDITION( mExitRequested == 0 || mExitRequested == EXIT_REQUESTED,
-            "mExitRequested is corrupted (value = 0x%08x)!", mExitRequested);
+    uint32_t const exitRequested = mExitRequested.load(std::memory_order_relaxed);
+    ASSERT_PRECONDITION( exitRequested == 0 || exitRequested == EXIT_REQUESTED,
+            "mExitRequested is corrupted (value = 0x%08x)!", exitRequested);
 
     SYSTRACE_TEXT_COLOR("CommandBufferQueue::waitForCommands FETCH", COL_LIME);
-    return std::move(mCommandBuffersToExecute);
+    std::vector<Slice> slices;
+    uint32_t const sliceHead = mSliceHead.load(std::memory_order_acquire);
+    slices.reserve(sliceHead - sliceTail);
+    for (; sliceTail != sliceHead; sliceTail++) {
+        slices.push_back(mSlices[sliceTail % SLICE_QUEUE_SIZE]);
+    }
+
+    // make room for the producer
+    mSliceTail.store(sliceTail, std::memory_order_seq_cst);
+    notify();
+
+    return slices;
 }
 
 void CommandBufferQueue::releaseBuffer(CommandBufferQueue::Slice const& buffer) {
     SYSTRACE_CALL();
     SYSTRACE_TEXT_COLOR("CommandBufferQueue::releaseBuffer", COL_YELLOW);
-    std::lock_guard<utils::Mutex> const lock(mLock);
-    mFreeSpace += uintptr_t(buffer.end) - uintptr_t(buffer.begin);
-    mCondition.notify_one();
+    mFreeSpace.fetch_add(buffer.size, std::memory_order_seq_cst);
+    mReleasedCount.fetch_add(1, std::memory_order_seq_cst);
+    notify();
 }
 
 } // namespace filament::backend
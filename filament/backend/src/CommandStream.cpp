@@ -15,17 +15,22 @@
  */
 
 #include "private/backend/CommandStream.h"
+#include "private/backend/CommandStreamCapture.h"
+#include "private/backend/CommandStreamProfiler.h"
 
 #if DEBUG_COMMAND_STREAM
 #include <utils/CallStack.h>
 #endif
 
 #include <utils/Log.h>
+#include <utils/Panic.h>
 #include <utils/Profiler.h>
 #include <utils/Systrace.h>
 
 #include <functional>
 
+#include <stdlib.h>
+
 #ifdef __ANDROID__
 #include <sys/system_properties.h>
 #endif
@@ -58,6 +63,18 @@ static UTILS_NOINLINE UTILS_UNUSED std::string extractMethodName(std::string& co
 
 // ------------------------------------------------------------------------------------------------
 
+const char* getCommandName(CommandId id) noexcept {
+    static constexpr const char* names[] = {
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                     #methodName,
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)     #methodName,
+#include "private/backend/DriverAPI.inc"
+    };
+    return id < CommandId::COUNT ? names[size_t(id)] : "unknown";
+}
+
+// ------------------------------------------------------------------------------------------------
+
 CommandStream::CommandStream(Driver& driver, CircularBuffer& buffer) noexcept
         : mDriver(driver),
           mCurrentBuffer(buffer),
@@ -110,11 +127,148 @@ void CommandStream::execute(void* buffer) {
     }
 }
 
+UTILS_NOINLINE
+void CommandStream::overflow(size_t size) {
+    SYSTRACE_CALL();
+    if (mOverflowHandler) {
+        mOverflowHandler(size);
+    }
+    ASSERT_POSTCONDITION(uintptr_t(mCurrentBuffer.getHead()) + size <=
+                    uintptr_t(mCurrentBuffer.getLimit()),
+            "Backend CommandStream overflow, a command of %u bytes doesn't fit.",
+            unsigned(size));
+}
+
 void CommandStream::queueCommand(std::function<void()> command) {
     SYSTRACE_CALL();
     new(allocateCommand(CustomCommand::align(sizeof(CustomCommand)))) CustomCommand(std::move(command));
 }
 
+// ------------------------------------------------------------------------------------------------
+
+// Destroys a segment after its commands have been executed
+class ReleaseSegmentCommand : public CommandBase {
+    CommandStreamSegment* mSegment;
+    static void execute(Driver&, CommandBase* base, intptr_t* next) noexcept {
+        *next = CommandBase::align(sizeof(ReleaseSegmentCommand));
+        delete static_cast<ReleaseSegmentCommand*>(base)->mSegment;
+    }
+public:
+    inline explicit ReleaseSegmentCommand(CommandStreamSegment* segment) noexcept
+            : CommandBase(execute), mSegment(segment) { }
+};
+
+CommandStreamSegment* CommandStream::createSegment(size_t capacity) {
+    assert_invariant(utils::ThreadUtils::isThisThread(mThreadId));
+    CommandStreamSegment* const segment = new CommandStreamSegment(mDriver, capacity);
+    // the segment's commands must be dispatched like ours, e.g. when capturing
+    segment->mStream.mDispatcher = mDispatcher;
+    return segment;
+}
+
+void CommandStream::insertSegment(CommandStreamSegment* segment) noexcept {
+    CircularBuffer& buffer = segment->mBuffer;
+    size_t const used = uintptr_t(buffer.getHead()) - uintptr_t(buffer.getTail());
+
+    // the segment's buffer is not bound-checked, so this is our last chance to catch this
+    ASSERT_POSTCONDITION(used <= segment->mCapacity,
+            "CommandStream segment overflow (%u bytes used out of %u)",
+            unsigned(used), unsigned(segment->mCapacity));
+
+    if (UTILS_UNLIKELY(!used)) {
+        delete segment;
+        return;
+    }
+
+    // both commands are allocated at once, so the segment jumps back right after the jump to it,
+    // even if the buffer overflows here.
+    size_t const jumpSize = CommandBase::align(sizeof(NoopCommand));
+    char* const p = static_cast<char*>(allocateCommand(
+            jumpSize + CommandBase::align(sizeof(ReleaseSegmentCommand))));
+
+    // jump to the segment's commands...
+    new(p) NoopCommand(buffer.getTail());
+
+    // ...which jump back here when done, where the segment is destroyed.
+    void* const release = p + jumpSize;
+    new(release) ReleaseSegmentCommand(segment);
+    new(buffer.allocate(CommandBase::align(sizeof(NoopCommand)))) NoopCommand(release);
+}
+
+CommandStreamSegment::CommandStreamSegment(Driver& driver, size_t capacity)
+        // room is always left for the NoopCommand jumping back to the main stream
+        : mData(::malloc(capacity + CommandBase::align(sizeof(NoopCommand)))),
+          mCapacity(capacity),
+          mBuffer(mData, capacity + CommandBase::align(sizeof(NoopCommand))),
+          mStream(driver, mBuffer) {
+    ASSERT_POSTCONDITION(mData, "couldn't allocate %u bytes for a CommandStream segment",
+            unsigned(capacity));
+    mBuffer.setLimit(static_cast<char*>(mData) + capacity);
+}
+
+CommandStreamSegment::~CommandStreamSegment() noexcept {
+    ::free(mData);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+bool CommandStream::startCommandCapture(const char* path) {
+    if (mCapture) {
+        return false;
+    }
+    CommandStreamCapture* const capture = CommandStreamCapture::create(path, mDispatcher);
+    if (!capture) {
+        return false;
+    }
+    // the capture must receive the commands before the first one using its dispatcher executes
+    queueCommand([capture]() { capture->activate(); });
+    mDispatcher = capture->getDispatcher();
+    mCapture = capture;
+    return true;
+}
+
+void CommandStream::stopCommandCapture() {
+    if (!mCapture) {
+        return;
+    }
+    // the commands recorded so far still go through the capture
+    assert_invariant(mDispatcher.endFrame_ == mCapture->getDispatcher().endFrame_);
+    mDispatcher = mCapture->getDriverDispatcher();
+    queueCommand([capture = mCapture]() {
+        capture->deactivate();
+        delete capture;
+    });
+    mCapture = nullptr;
+}
+
+bool CommandStream::startCommandProfiling() {
+    if (mProfiler) {
+        return false;
+    }
+    CommandStreamProfiler* const profiler = new CommandStreamProfiler(mDispatcher);
+    // the profiler must receive the commands before the first one using its dispatcher executes
+    queueCommand([profiler]() { profiler->activate(); });
+    mDispatcher = profiler->getDispatcher();
+    mProfiler = profiler;
+    return true;
+}
+
+void CommandStream::stopCommandProfiling() {
+    if (!mProfiler) {
+        return;
+    }
+    // the commands recorded so far are still accounted for
+    assert_invariant(mDispatcher.endFrame_ == mProfiler->getDispatcher().endFrame_);
+    mDispatcher = mProfiler->getDriverDispatcher();
+    queueCommand([profiler = mProfiler]() {
+        profiler->deactivate();
+        delete profiler;
+    });
+    mProfiler = nullptr;
+}
+
+// ------------------------------------------------------------------------------------------------
+
 template<typename... ARGS>
 template<void (Driver::*METHOD)(ARGS...)>
 template<std::size_t... I>
@@ -0,0 +1,680 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "private/backend/CommandStreamCapture.h"
+
+#include "private/backend/Driver.h"
+
+#include <backend/BufferDescriptor.h>
+#include <backend/PipelineState.h>
+#include <backend/PixelBufferDescriptor.h>
+#include <backend/Program.h>
+#include <backend/SamplerDescriptor.h>
+#include <backend/TargetBufferInfo.h>
+
+#include <utils/algorithm.h>
+#include <utils/CString.h>
+#include <utils/FixedCapacityVector.h>
+#include <utils/Hash.h>
+#include <utils/Log.h>
+#include <utils/Systrace.h>
+#include <utils/debug.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace utils;
+
+namespace filament::backend {
+
+// ------------------------------------------------------------------------------------------------
+// Serialization of the commands' arguments
+
+namespace {
+
+using Data = std::vector<uint8_t>;
+
+void writeBytes(Data& out, void const* data, size_t size) {
+    auto const* const p = static_cast<uint8_t const*>(data);
+    out.insert(out.end(), p, p + size);
+}
+
+void writeString(Data& out, const char* string, size_t length) {
+    uint32_t const size = uint32_t(length);
+    writeBytes(out, &size, sizeof(size));
+    writeBytes(out, string, size);
+}
+
+void serialize(Data& out, CString const& string) {
+    writeString(out, string.c_str_safe(), string.size());
+}
+
+template<typename T>
+void serialize(Data& out, T const& value) {
+    if constexpr (std::is_same_v<T, const char*>) {
+        writeString(out, value ? value : "", value ? strlen(value) : 0);
+    } else if constexpr (std::is_pointer_v<T>) {
+        // pointers are not meaningful outside of this process
+    } else {
+        static_assert(std::is_trivially_copyable_v<T>, "this argument type can't be captured");
+        writeBytes(out, &value, sizeof(T));
+    }
+}
+
+void serialize(Data& out, BufferDescriptor const& data) {
+    uint64_t const size = data.buffer ? data.size : 0;
+    serialize(out, size);
+    writeBytes(out, data.buffer, size);
+}
+
+void serialize(Data& out, PixelBufferDescriptor const& data) {
+    // pixels are large and seldom matter to the driver thread, only keep a digest of them
+    bool const compressed = data.type == PixelDataType::COMPRESSED;
+    serialize(out, uint64_t(data.size));
+    serialize(out, data.left);
+    serialize(out, data.top);
+    serialize(out, compressed ? data.imageSize : data.stride);
+    serialize(out, compressed ? uint16_t(data.compressedFormat) : uint16_t(data.format));
+    serialize(out, uint8_t(data.type));
+    serialize(out, uint8_t(data.alignment));
+    serialize(out, data.buffer ?
+            hash::murmurSlow(static_cast<uint8_t const*>(data.buffer), data.size, 0) : 0u);
+}
+
+void serialize(Data& out, Program const& program) {
+    for (Program::ShaderBlob const& blob : program.getShadersSource()) {
+        serialize(out, uint32_t(blob.size()));
+        writeBytes(out, blob.data(), blob.size());
+    }
+    for (CString const& name : program.getUniformBlockBindings()) {
+        serialize(out, name);
+    }
+    for (Program::SamplerGroupData const& group : program.getSamplerGroupInfo()) {
+        serialize(out, group.stageFlags);
+        serialize(out, uint32_t(group.samplers.size()));
+        for (Program::Sampler const& sampler : group.samplers) {
+            serialize(out, sampler.name);
+            serialize(out, sampler.binding);
+        }
+    }
+    for (Program::UniformInfo const& uniforms : program.getBindingUniformInfo()) {
+        serialize(out, uint32_t(uniforms.size()));
+        for (Program::Uniform const& uniform : uniforms) {
+            serialize(out, uniform.name);
+            serialize(out, uniform.offset);
+            serialize(out, uniform.size);
+            serialize(out, uniform.type);
+        }
+    }
+    serialize(out, uint32_t(program.getAttributes().size()));
+    for (auto const& [name, location] : program.getAttributes()) {
+        serialize(out, name);
+        serialize(out, location);
+    }
+    serialize(out, program.getName());
+    serialize(out, uint32_t(program.getSpecializationConstants().size()));
+    for (Program::SpecializationConstant const& constant : program.getSpecializationConstants()) {
+        serialize(out, constant.id);
+        serialize(out, uint8_t(constant.value.index()));
+        std::visit([&out](auto value) {
+            // all values are written on 32 bits
+            if constexpr (std::is_same_v<decltype(value), bool>) {
+                serialize(out, int32_t(value));
+            } else {
+                static_assert(sizeof(value) == sizeof(int32_t));
+                serialize(out, value);
+            }
+        }, constant.value);
+    }
+    serialize(out, program.getCacheId());
+    serialize(out, program.getPriorityQueue());
+}
+
+template<typename>
+struct MethodArguments;
+
+template<typename ... ARGS>
+struct MethodArguments<void (Driver::*)(ARGS...)> {
+    using type = std::tuple<std::decay_t<ARGS>...>;
+};
+
+// the arguments of a Driver method, as they're decoded from a capture
+template<typename M>
+using Arguments = typename MethodArguments<M>::type;
+
+// largest command in the CommandStream
+constexpr size_t MAX_COMMAND_SIZE = std::max({
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                                         \
+        CommandBase::align(sizeof(COMMAND_TYPE(methodName))),
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)                         \
+        CommandBase::align(sizeof(COMMAND_TYPE(methodName##R))),
+#include "private/backend/DriverAPI.inc"
+});
+
+void freeBuffer(void* buffer, size_t, void*) {
+    ::free(buffer);
+}
+
+} // anonymous namespace
+
+class CommandStreamReplay::Reader {
+public:
+    Reader(CommandStream& stream, uint8_t const* data, size_t size) noexcept
+            : mStream(stream), mCurrent(data), mEnd(data + size) {
+    }
+
+    // whether all the data was decoded, and only it
+    bool isValid() const noexcept { return !mFailed && mCurrent == mEnd; }
+
+    template<typename ... T>
+    void readArguments(std::tuple<T...>& args) {
+        std::apply([this](auto& ... arg) { (read(arg), ...); }, args);
+    }
+
+private:
+    bool check(size_t size) noexcept {
+        mFailed = mFailed || size > size_t(mEnd - mCurrent);
+        return !mFailed;
+    }
+
+    void readBytes(void* data, size_t size) noexcept {
+        if (!size) {
+            return;
+        }
+        if (check(size)) {
+            memcpy(data, mCurrent, size);
+            mCurrent += size;
+        } else {
+            memset(data, 0, size);
+        }
+    }
+
+    template<typename T>
+    T readValue() noexcept {
+        T value{};
+        readBytes(&value, sizeof(T));
+        return value;
+    }
+
+    // Reads an element count, which can't exceed the remaining number of bytes
+    uint32_t readCount() noexcept {
+        uint32_t const count = readValue<uint32_t>();
+        return check(count) ? count : 0;
+    }
+
+    CString readString() noexcept {
+        uint32_t const length = readCount();
+        CString string(reinterpret_cast<const char*>(mCurrent), length);
+        mCurrent += length;
+        return string;
+    }
+
+    template<typename T>
+    void read(T& value) {
+        if constexpr (std::is_same_v<T, const char*>) {
+            // like all strings passed to the CommandStream, this one must live in it
+            uint32_t const length = readCount();
+            char* const string = mStream.allocatePod<char>(length + 1);
+            readBytes(string, length);
+            string[length] = 0;
+            value = string;
+        } else if constexpr (std::is_pointer_v<T>) {
+            value = nullptr;
+        } else {
+            readBytes(&value, sizeof(T));
+        }
+    }
+
+    void read(BufferDescriptor& data) {
+        uint64_t const size = readValue<uint64_t>();
+        if (check(size)) {
+            void* const buffer = size ? ::malloc(size) : nullptr;
+            readBytes(buffer, size);
+            data = BufferDescriptor(buffer, size, &freeBuffer);
+        }
+    }
+
+    void read(PixelBufferDescriptor& data) {
+        uint64_t const size = readValue<uint64_t>();
+        uint32_t const left = readValue<uint32_t>();
+        uint32_t const top = readValue<uint32_t>();
+        uint32_t const strideOrImageSize = readValue<uint32_t>();
+        uint16_t const format = readValue<uint16_t>();
+        auto const type = PixelDataType(readValue<uint8_t>());
+        uint8_t const alignment = readValue<uint8_t>();
+        UTILS_UNUSED uint32_t const digest = readValue<uint32_t>();
+        if (mFailed) {
+            return;
+        }
+        // the pixels were not captured
+        void* const buffer = size ? ::calloc(size, 1) : nullptr;
+        if (type == PixelDataType::COMPRESSED) {
+            data = PixelBufferDescriptor(buffer, size,
+                    CompressedPixelDataType(format), strideOrImageSize, &freeBuffer);
+        } else {
+            data = PixelBufferDescriptor(buffer, size, PixelDataFormat(format), type,
+                    alignment, left, top, strideOrImageSize, &freeBuffer);
+        }
+    }
+
+    void read(Program& program) {
+        for (Program::ShaderBlob& blob : program.getShadersSource()) {
+            uint32_t const size = readCount();
+            Program::ShaderBlob data(size);
+            readBytes(data.data(), size);
+            blob = std::move(data);
+        }
+        for (CString& name : program.getUniformBlockBindings()) {
+            name = readString();
+        }
+        for (Program::SamplerGroupData& group : program.getSamplerGroupInfo()) {
+            read(group.stageFlags);
+            group.samplers = FixedCapacityVector<Program::Sampler>(readCount());
+            for (Program::Sampler& sampler : group.samplers) {
+                sampler.name = readString();
+                read(sampler.binding);
+            }
+        }
+        for (Program::UniformInfo& uniforms : program.getBindingUniformInfo()) {
+            uniforms = Program::UniformInfo(readCount());
+            for (Program::Uniform& uniform : uniforms) {
+                uniform.name = readString();
+                read(uniform.offset);
+                read(uniform.size);
+                read(uniform.type);
+            }
+        }
+        auto& attributes = program.getAttributes();
+        attributes = std::decay_t<decltype(attributes)>(readCount());
+        for (auto& [name, location] : attributes) {
+            name = readString();
+            read(location);
+        }
+        program.getName() = readString();
+        auto& constants = program.getSpecializationConstants();
+        constants = FixedCapacityVector<Program::SpecializationConstant>(readCount());
+        for (Program::SpecializationConstant& constant : constants) {
+            read(constant.id);
+            uint8_t const index = readValue<uint8_t>();
+            int32_t const value = readValue<int32_t>();
+            switch (index) {
+                case 0: constant.value = value; break;
+                case 1: constant.value = utils::bit_cast<float>(value); break;
+                case 2: constant.value = bool(value); break;
+                default: mFailed = true; break;
+            }
+        }
+        program.cacheId(readValue<uint64_t>());
+        program.priorityQueue(readValue<CompilerPriorityQueue>());
+    }
+
+    CommandStream& mStream;
+    uint8_t const* mCurrent;
+    uint8_t const* const mEnd;
+    bool mFailed = false;
+};
+
+// ------------------------------------------------------------------------------------------------
+// CommandStreamCapture
+
+// The capture receiving the commands executed on this thread, i.e. this driver's.
+static thread_local CommandStreamCapture* sCapture = nullptr;
+
+/*
+ * CaptureDispatcher's functions serialize a command, then execute it with the driver's
+ * Dispatcher.
+ */
+class CaptureDispatcher {
+public:
+    static Dispatcher make() noexcept;
+
+private:
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                                         \
+    static void methodName(Driver& driver, CommandBase* base, intptr_t* next) {                 \
+        using Cmd = COMMAND_TYPE(methodName);                                                   \
+        CommandStreamCapture* const capture = sCapture;                                         \
+        assert_invariant(capture);                                                              \
+        capture->write(CommandId::methodName, static_cast<Cmd*>(base)->getArguments());         \
+        capture->mDriverDispatcher.methodName##_(driver, base, next);                           \
+    }
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)                         \
+    static void methodName(Driver& driver, CommandBase* base, intptr_t* next) {                 \
+        using Cmd = COMMAND_TYPE(methodName##R);                                                \
+        CommandStreamCapture* const capture = sCapture;                                         \
+        assert_invariant(capture);                                                              \
+        capture->write(CommandId::methodName, static_cast<Cmd*>(base)->getArguments());         \
+        capture->mDriverDispatcher.methodName##_(driver, base, next);                           \
+    }
+#include "private/backend/DriverAPI.inc"
+};
+
+UTILS_NOINLINE
+Dispatcher CaptureDispatcher::make() noexcept {
+    Dispatcher dispatcher;
+
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                 \
+                dispatcher.methodName##_ = &CaptureDispatcher::methodName;
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) \
+                dispatcher.methodName##_ = &CaptureDispatcher::methodName;
+
+#include "private/backend/DriverAPI.inc"
+
+    return dispatcher;
+}
+
+CommandStreamCapture* CommandStreamCapture::create(
+        const char* path, Dispatcher const& dispatcher) noexcept {
+    FILE* const file = fopen(path, "wb");
+    if (!file) {
+        slog.e << "CommandStream capture: couldn't create " << path << io::endl;
+        return nullptr;
+    }
+
+    // The commands are identified by name, so that replays remain possible after the driver API
+    // changes.
+    Data header;
+    serialize(header, MAGIC);
+    serialize(header, VERSION);
+    serialize(header, uint32_t(CommandId::COUNT));
+    for (size_t i = 0; i < size_t(CommandId::COUNT); i++) {
+        serialize(header, getCommandName(CommandId(i)));
+    }
+    if (fwrite(header.data(), header.size(), 1, file) != 1) {
+        slog.e << "CommandStream capture: couldn't write to " << path << io::endl;
+        fclose(file);
+        return nullptr;
+    }
+
+    return new CommandStreamCapture(file, dispatcher);
+}
+
+CommandStreamCapture::CommandStreamCapture(FILE* file, Dispatcher const& dispatcher) noexcept
+        : mFile(file),
+          mDriverDispatcher(dispatcher),
+          mCaptureDispatcher(CaptureDispatcher::make()) {
+}
+
+CommandStreamCapture::~CommandStreamCapture() noexcept {
+    assert_invariant(sCapture != this);
+    fclose(mFile);
+}
+
+void CommandStreamCapture::activate() noexcept {
+    assert_invariant(!sCapture);
+    sCapture = this;
+}
+
+void CommandStreamCapture::deactivate() noexcept {
+    assert_invariant(sCapture == this);
+    sCapture = nullptr;
+}
+
+template<typename ... ARGS>
+void CommandStreamCapture::write(CommandId id, std::tuple<ARGS...> const& args) noexcept {
+    SYSTRACE_CALL();
+    if (UTILS_UNLIKELY(mFailed)) {
+        return;
+    }
+
+    Data& data = mData;
+    data.clear();
+    std::apply([&data](auto const& ... arg) { (serialize(data, arg), ...); }, args);
+
+    // each command is its id followed by the size of its arguments, and the arguments
+    uint16_t const command = uint16_t(id);
+    uint32_t const size = uint32_t(data.size());
+    mFailed = fwrite(&command, sizeof(command), 1, mFile) != 1 ||
+            fwrite(&size, sizeof(size), 1, mFile) != 1 ||
+            (size && fwrite(data.data(), size, 1, mFile) != 1);
+    if (UTILS_UNLIKELY(mFailed)) {
+        slog.e << "CommandStream capture: couldn't write " << getCommandName(id)
+               << ", the capture is incomplete" << io::endl;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+// CommandStreamReplay
+
+CommandStreamReplay::CommandStreamReplay(Driver& driver, size_t bufferSize)
+        : mDriver(driver),
+          mBuffer(bufferSize),
+          mStream(driver, mBuffer) {
+    mBuffer.setLimit(static_cast<char*>(mBuffer.getTail()) + mBuffer.size() -
+            CommandBase::align(sizeof(NoopCommand)));
+}
+
+CommandStreamReplay::~CommandStreamReplay() noexcept = default;
+
+template<typename T>
+void CommandStreamReplay::remap(Handle<T>& handle) const noexcept {
+    if (handle) {
+        auto const pos = mHandles.find(handle.getId());
+        if (UTILS_LIKELY(pos != mHandles.end())) {
+            handle = Handle<T>(pos->second);
+        } else {
+            // this handle was created before the capture started
+            handle.clear();
+        }
+    }
+}
+
+void CommandStreamReplay::remap(TargetBufferInfo& info) const noexcept {
+    remap(info.handle);
+}
+
+void CommandStreamReplay::remap(MRT& mrt) const noexcept {
+    for (size_t i = 0; i < MRT::MAX_SUPPORTED_RENDER_TARGET_COUNT; i++) {
+        remap(mrt[i]);
+    }
+}
+
+void CommandStreamReplay::remap(PipelineState& state) const noexcept {
+    remap(state.program);
+}
+
+void CommandStreamReplay::remapSamplers(BufferDescriptor& data) const noexcept {
+    // the sampler group's content is captured as bytes, but holds texture handles
+    auto* const samplers = static_cast<SamplerDescriptor*>(data.buffer);
+    for (size_t i = 0, c = data.size / sizeof(SamplerDescriptor); i < c; i++) {
+        remap(samplers[i].t);
+    }
+}
+
+template<typename ... ARGS>
+void CommandStreamReplay::remapArguments(CommandId id, std::tuple<ARGS...>& args) const noexcept {
+    std::apply([this](auto& ... arg) { (remap(arg), ...); }, args);
+    if constexpr (std::is_same_v<std::tuple<ARGS...>,
+            Arguments<decltype(&Driver::updateSamplerGroup)>>) {
+        if (id == CommandId::updateSamplerGroup) {
+            remapSamplers(std::get<1>(args));
+        }
+    }
+}
+
+size_t CommandStreamReplay::execute(CommandId id, Reader& reader) {
+    CommandStream& stream = mStream;
+    switch (id) {
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                                         \
+        case CommandId::methodName: {                                                           \
+            Arguments<decltype(&Driver::methodName)> args;                                      \
+            reader.readArguments(args);                                                         \
+            if (UTILS_UNLIKELY(!reader.isValid())) {                                            \
+                return 0;                                                                       \
+            }                                                                                   \
+            remapArguments(id, args);                                                           \
+            std::apply([&stream](auto& ... arg) {                                               \
+                stream.methodName(std::move(arg)...);                                           \
+            }, args);                                                                           \
+            return CommandBase::align(sizeof(COMMAND_TYPE(methodName)));                        \
+        }
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)                         \
+        case CommandId::methodName: {                                                           \
+            Arguments<decltype(&Driver::methodName##R)> args;                                   \
+            reader.readArguments(args);                                                         \
+            if (UTILS_UNLIKELY(!reader.isValid())) {                                            \
+                return 0;                                                                       \
+            }                                                                                   \
+            std::apply([this, &stream](auto& handle, auto& ... arg) {                           \
+                (remap(arg), ...);                                                              \
+                RetType const result = stream.methodName(std::move(arg)...);                    \
+                if (handle) {                                                                   \
+                    mHandles[handle.getId()] = result.getId();                                  \
+                }                                                                               \
+            }, args);                                                                           \
+            return CommandBase::align(sizeof(COMMAND_TYPE(methodName##R)));                     \
+        }
+#include "private/backend/DriverAPI.inc"
+        case CommandId::COUNT:
+            break;
+    }
+    return 0;
+}
+
+void CommandStreamReplay::flush() {
+    SYSTRACE_CALL();
+    CircularBuffer& buffer = mBuffer;
+    if (buffer.empty()) {
+        return;
+    }
+
+    // the limit always leaves room for the terminating command
+    new(buffer.allocate(CommandBase::align(sizeof(NoopCommand)))) NoopCommand(nullptr);
+    void* const begin = buffer.getTail();
+    buffer.circularize();
+
+    auto const start = std::chrono::steady_clock::now();
+    mStream.execute(begin);
+    mStatistics.executionTime += uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+
+    // call the callbacks scheduled by the driver, which also free the buffer descriptors
+    mDriver.purge();
+
+    // all the commands have been executed, the whole buffer is available
+    buffer.setLimit(static_cast<char*>(buffer.getTail()) + buffer.size() -
+            CommandBase::align(sizeof(NoopCommand)));
+}
+
+bool CommandStreamReplay::replay(const char* path) {
+    SYSTRACE_CALL();
+
+    FILE* const file = fopen(path, "rb");
+    if (!file) {
+        slog.e << "CommandStream replay: couldn't open " << path << io::endl;
+        return false;
+    }
+
+    auto read = [file](void* data, size_t size) {
+        return !size || fread(data, size, 1, file) == 1;
+    };
+
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint32_t commandCount = 0;
+    if (!read(&magic, sizeof(magic)) || magic != CommandStreamCapture::MAGIC ||
+        !read(&version, sizeof(version)) || version != CommandStreamCapture::VERSION ||
+        !read(&commandCount, sizeof(commandCount))) {
+        slog.e << "CommandStream replay: " << path
+               << " is not a capture file, or was created by an incompatible version" << io::endl;
+        fclose(file);
+        return false;
+    }
+
+    // maps the commands of the capture to ours, commands we don't know about are skipped
+    std::vector<CommandId> commands(commandCount, CommandId::COUNT);
+    bool success = true;
+    for (CommandId& command : commands) {
+        uint32_t length = 0;
+        std::string name;
+        success = read(&length, sizeof(length));
+        name.resize(success ? length : 0);
+        success = success && read(name.data(), name.size());
+        if (!success) {
+            break;
+        }
+        for (size_t i = 0; i < size_t(CommandId::COUNT); i++) {
+            if (name == getCommandName(CommandId(i))) {
+                command = CommandId(i);
+                break;
+            }
+        }
+    }
+
+    std::vector<uint8_t> data;
+    uint16_t command = 0;
+    while (success && read(&command, sizeof(command))) {
+        uint32_t size = 0;
+        success = read(&size, sizeof(size));
+        data.resize(success ? size : 0);
+        success = success && read(data.data(), data.size());
+        if (!success) {
+            slog.e << "CommandStream replay: " << path << " is truncated" << io::endl;
+            break;
+        }
+
+        CommandId const id = command < commands.size() ? commands[command] : CommandId::COUNT;
+        if (UTILS_UNLIKELY(id == CommandId::COUNT)) {
+            mStatistics.skippedCount++;
+            continue;
+        }
+
+        // A command can't be split across flushes, since its string argument is allocated in the
+        // CommandStream, so flush while there's still room for the largest command and a string.
+        size_t const room = uintptr_t(mBuffer.getLimit()) - uintptr_t(mBuffer.getHead());
+        if (UTILS_UNLIKELY(room <
+                MAX_COMMAND_SIZE + CommandBase::align(sizeof(NoopCommand) + data.size() + 1))) {
+            flush();
+        }
+
+        Reader reader(mStream, data.data(), data.size());
+        size_t const streamSize = execute(id, reader);
+        if (UTILS_UNLIKELY(!streamSize)) {
+            slog.e << "CommandStream replay: invalid arguments for " << getCommandName(id)
+                   << io::endl;
+            success = false;
+            break;
+        }
+
+        CommandStatistics& statistics = mStatistics.commands[size_t(id)];
+        statistics.count++;
+        statistics.captureSize += data.size();
+        statistics.streamSize += streamSize;
+
+        // like the Engine, execute the commands once per frame
+        if (id == CommandId::endFrame) {
+            mStatistics.frameCount++;
+            flush();
+        }
+    }
+
+    flush();
+    fclose(file);
+    return success;
+}
+
+} // namespace filament::backend
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "private/backend/CommandStreamProfiler.h"
+
+#include "private/backend/Driver.h"
+
+#include <utils/compiler.h>
+#include <utils/debug.h>
+#include <utils/ostream.h>
+
+#include <chrono>
+#include <mutex>
+#include <tuple>
+
+using namespace utils;
+
+namespace filament::backend {
+
+// The profiler receiving the commands executed on this thread, i.e. this driver's.
+static thread_local CommandStreamProfiler* sProfiler = nullptr;
+
+/*
+ * ProfilerDispatcher's functions execute a command with the driver's Dispatcher and account for
+ * it.
+ */
+class ProfilerDispatcher {
+public:
+    static Dispatcher make() noexcept;
+
+private:
+    template<CommandId ID, typename Cmd>
+    static void execute(CommandStreamProfiler& profiler, Dispatcher::Execute execute,
+            Driver& driver, CommandBase* base, intptr_t* next) {
+        uint32_t frameId = 0;
+        if constexpr (ID == CommandId::endFrame) {
+            // the arguments are gone once the command has executed
+            frameId = std::get<0>(static_cast<Cmd*>(base)->getArguments());
+        }
+
+        auto const start = std::chrono::steady_clock::now();
+        execute(driver, base, next);
+        auto const end = std::chrono::steady_clock::now();
+
+        profiler.record(ID, *next, uint64_t(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+
+        if constexpr (ID == CommandId::endFrame) {
+            profiler.endFrame(frameId);
+        }
+    }
+
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                                         \
+    static void methodName(Driver& driver, CommandBase* base, intptr_t* next) {                 \
+        CommandStreamProfiler* const profiler = sProfiler;                                      \
+        assert_invariant(profiler);                                                             \
+        execute<CommandId::methodName, COMMAND_TYPE(methodName)>(*profiler,                     \
+                profiler->mDriverDispatcher.methodName##_, driver, base, next);                 \
+    }
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)                         \
+    static void methodName(Driver& driver, CommandBase* base, intptr_t* next) {                 \
+        CommandStreamProfiler* const profiler = sProfiler;                                      \
+        assert_invariant(profiler);                                                             \
+        execute<CommandId::methodName, COMMAND_TYPE(methodName##R)>(*profiler,                  \
+                profiler->mDriverDispatcher.methodName##_, driver, base, next);                 \
+    }
+#include "private/backend/DriverAPI.inc"
+};
+
+UTILS_NOINLINE
+Dispatcher ProfilerDispatcher::make() noexcept {
+    Dispatcher dispatcher;
+
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                 \
+                dispatcher.methodName##_ = &ProfilerDispatcher::methodName;
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) \
+                dispatcher.methodName##_ = &ProfilerDispatcher::methodName;
+
+#include "private/backend/DriverAPI.inc"
+
+    return dispatcher;
+}
+
+CommandStreamProfiler::CommandStreamProfiler(Dispatcher const& dispatcher) noexcept
+        : mDriverDispatcher(dispatcher),
+          mProfilerDispatcher(ProfilerDispatcher::make()) {
+}
+
+void CommandStreamProfiler::activate() noexcept {
+    assert_invariant(!sProfiler);
+    sProfiler = this;
+}
+
+void CommandStreamProfiler::deactivate() noexcept {
+    assert_invariant(sProfiler == this);
+    sProfiler = nullptr;
+}
+
+void CommandStreamProfiler::endFrame(uint32_t frameId) noexcept {
+    mCurrentFrame.frameId = frameId;
+    {
+        std::lock_guard<utils::Mutex> const lock(mLock);
+        mLastFrame = mCurrentFrame;
+    }
+    mCurrentFrame = {};
+}
+
+CommandStreamProfiler::FrameStatistics CommandStreamProfiler::getFrameStatistics() const noexcept {
+    std::lock_guard<utils::Mutex> const lock(mLock);
+    return mLastFrame;
+}
+
+void CommandStreamProfiler::writeJson(io::ostream& out,
+        FrameStatistics const& statistics) noexcept {
+    out << "{\n  \"frameId\": " << statistics.frameId << ",\n  \"commands\": [";
+    const char* separator = "\n";
+    for (size_t i = 0; i < size_t(CommandId::COUNT); i++) {
+        CommandStatistics const& command = statistics.commands[i];
+        if (command.count) {
+            out << separator
+                << "    { \"name\": \"" << getCommandName(CommandId(i))
+                << "\", \"count\": " << command.count
+                << ", \"size\": " << command.size
+                << ", \"time\": " << command.time << " }";
+            separator = ",\n";
+        }
+    }
+    out << "\n  ]\n}" << io::endl;
+}
+
+} // namespace filament::backend
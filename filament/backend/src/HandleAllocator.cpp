@@ -18,7 +18,8 @@
 
 #include <utils/Panic.h>
 
-#include <stdlib.h>
+#include <algorithm>
+#include <mutex>
 
 namespace filament::backend {
 
@@ -27,15 +28,11 @@ using namespace utils;
 template <size_t P0, size_t P1, size_t P2>
 UTILS_NOINLINE
 HandleAllocator<P0, P1, P2>::Allocator::Allocator(AreaPolicy::HeapArea const& area)
-        : mArea(area) {
-    // TODO: we probably need a better way to set the size of these pools
-    const size_t unit = area.size() / 32;
-    const size_t offsetPool1 =      unit;
-    const size_t offsetPool2 = 16 * unit;
-    char* const p = (char*)area.begin();
-    mPool0 = PoolAllocator< P0, 16>(p, p + offsetPool1);
-    mPool1 = PoolAllocator< P1, 16>(p + offsetPool1, p + offsetPool2);
-    mPool2 = PoolAllocator< P2, 16>(p + offsetPool2, area.end());
+        // TODO: we probably need a better way to set the size of these pools
+        : mPool0((char*)area.begin(),                           (char*)area.begin() +      area.size() / 32),
+          mPool1((char*)area.begin() +      area.size() / 32,   (char*)area.begin() + 16 * (area.size() / 32)),
+          mPool2((char*)area.begin() + 16 * (area.size() / 32), area.end()),
+          mArea(area) {
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -47,58 +44,92 @@ HandleAllocator<P0, P1, P2>::HandleAllocator(const char* name, size_t size) noex
 
 template <size_t P0, size_t P1, size_t P2>
 HandleAllocator<P0, P1, P2>::~HandleAllocator() {
-    auto& overflowMap = mOverflowMap;
-    if (!overflowMap.empty()) {
+#ifndef NDEBUG
+    if (mOverflowHandleCount.load(std::memory_order_relaxed)) {
         PANIC_LOG("Not all handles have been freed. Probably leaking memory.");
-        // Free remaining handle memory
-        for (auto& entry : overflowMap) {
-            ::free(entry.second);
-        }
+    }
+#endif
+    uint32_t const count = mOverflowArenaCount.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < count; i++) {
+        delete mOverflowArenas[i];
     }
 }
 
 template <size_t P0, size_t P1, size_t P2>
 UTILS_NOINLINE
 void* HandleAllocator<P0, P1, P2>::handleToPointerSlow(HandleBase::HandleId id) const noexcept {
-    auto& overflowMap = mOverflowMap;
-    std::lock_guard lock(mLock);
-    auto pos = overflowMap.find(id);
-    if (pos != overflowMap.end()) {
-        return pos.value();
+    uint32_t const index = (id & ~OVERFLOW_HANDLE_FLAG) >> OVERFLOW_ARENA_SHIFT;
+    if (UTILS_UNLIKELY(index >= MAX_OVERFLOW_ARENA_COUNT)) {
+        // this is the null handle
+        return nullptr;
     }
-    return nullptr;
+    // whoever gave us this handle synchronized with its allocation, and therefore with the
+    // creation of its arena.
+    char* const base = (char*)mOverflowArenas[index]->area.begin();
+    size_t const offset = size_t(id & OVERFLOW_OFFSET_MASK) << Allocator::MIN_ALIGNMENT_SHIFT;
+    return static_cast<void*>(base + offset);
 }
 
 template <size_t P0, size_t P1, size_t P2>
 HandleBase::HandleId HandleAllocator<P0, P1, P2>::allocateHandleSlow(size_t size) noexcept {
-    void* p = ::malloc(size);
-    std::unique_lock lock(mLock);
-    HandleBase::HandleId id = (++mId) | HEAP_HANDLE_FLAG;
-    mOverflowMap.emplace(id, p);
-    lock.unlock();
-
-    if (UTILS_UNLIKELY(id == (HEAP_HANDLE_FLAG|1u))) { // meaning id was zero
-        PANIC_LOG("HandleAllocator arena is full, using slower system heap. Please increase "
-                  "the appropriate constant (e.g. FILAMENT_OPENGL_HANDLE_ARENA_SIZE_IN_MB).");
+    auto makeHandle = [this](uint32_t index, void* p) {
+        char* const base = (char*)mOverflowArenas[index]->area.begin();
+        size_t const offset = size_t((char*)p - base) >> Allocator::MIN_ALIGNMENT_SHIFT;
+        assert_invariant(offset <= OVERFLOW_OFFSET_MASK);
+#ifndef NDEBUG
+        mOverflowHandleCount.fetch_add(1, std::memory_order_relaxed);
+#endif
+        return HandleBase::HandleId(
+                OVERFLOW_HANDLE_FLAG | (index << OVERFLOW_ARENA_SHIFT) | uint32_t(offset));
+    };
+
+    // the most recent arenas are the most likely to have room
+    uint32_t const count = mOverflowArenaCount.load(std::memory_order_acquire);
+    for (uint32_t i = count; i-- > 0;) {
+        if (void* const p = mOverflowArenas[i]->allocator.alloc(size, 16, 0)) {
+            return makeHandle(i, p);
+        }
     }
-    return id;
-}
 
-template <size_t P0, size_t P1, size_t P2>
-void HandleAllocator<P0, P1, P2>::deallocateHandleSlow(HandleBase::HandleId id, size_t) noexcept {
-    assert_invariant(id & HEAP_HANDLE_FLAG);
-    void* p = nullptr;
-    auto& overflowMap = mOverflowMap;
-
-    std::unique_lock lock(mLock);
-    auto pos = overflowMap.find(id);
-    if (pos != overflowMap.end()) {
-        p = pos.value();
-        overflowMap.erase(pos);
+    std::lock_guard const lock(mLock);
+
+    // another thread might have created an arena in the meantime
+    uint32_t const index = mOverflowArenaCount.load(std::memory_order_relaxed);
+    for (uint32_t i = index; i-- > count;) {
+        if (void* const p = mOverflowArenas[i]->allocator.alloc(size, 16, 0)) {
+            return makeHandle(i, p);
+        }
+    }
+
+    ASSERT_POSTCONDITION(index < MAX_OVERFLOW_ARENA_COUNT,
+            "HandleAllocator \"%s\" is out of memory", mHandleArena.getName());
+
+    size_t const arenaSize = std::min(
+            mHandleArena.getArea().size() << (index + 1), MAX_OVERFLOW_ARENA_SIZE);
+    if (index == 0) {
+        slog.w << "HandleAllocator \"" << mHandleArena.getName() << "\" arena is full, "
+               << "growing it. Please increase the appropriate constant "
+               << "(e.g. FILAMENT_OPENGL_HANDLE_ARENA_SIZE_IN_MB or "
+               << "Engine::Config::driverHandleArenaSizeMB)." << io::endl;
     }
-    lock.unlock();
+    mOverflowArenas[index] = new OverflowArena(arenaSize);
+    mOverflowArenaCount.store(index + 1, std::memory_order_release);
 
-    ::free(p);
+    void* const p = mOverflowArenas[index]->allocator.alloc(size, 16, 0);
+    assert_invariant(p);
+    return makeHandle(index, p);
+}
+
+template <size_t P0, size_t P1, size_t P2>
+void HandleAllocator<P0, P1, P2>::deallocateHandleSlow(
+        HandleBase::HandleId id, size_t size) noexcept {
+    assert_invariant(id & OVERFLOW_HANDLE_FLAG);
+    uint32_t const index = (id & ~OVERFLOW_HANDLE_FLAG) >> OVERFLOW_ARENA_SHIFT;
+    assert_invariant(index < mOverflowArenaCount.load(std::memory_order_relaxed));
+    mOverflowArenas[index]->allocator.free(handleToPointerSlow(id), size);
+#ifndef NDEBUG
+    mOverflowHandleCount.fetch_sub(1, std::memory_order_relaxed);
+#endif
 }
 
 // Explicit template instantiations.
@@ -213,7 +213,8 @@ uint8_t NoopDriver::getMaxDrawBuffers() {
 }
 
 size_t NoopDriver::getMaxUniformBufferSize() {
-    return 16384u;
+    // large enough for the features that depend on it, e.g. Engine::Config::largeLightCount
+    return 65536u;
 }
 
 void NoopDriver::updateIndexBuffer(Handle<HwIndexBuffer> ibh, BufferDescriptor&& p,
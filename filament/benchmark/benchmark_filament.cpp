@@ -24,6 +24,7 @@
 #include "Culler.h"
 
 #include <utils/Allocator.h>
+#include <utils/JobSystem.h>
 
 #include <vector>
 #include <random>
@@ -103,3 +104,88 @@ BENCHMARK_F(FilamentCullingFixture, sphereCulling)(benchmark::State& state) {
         state.SetItemsProcessed(state.iterations() * BATCH_SIZE);
     }
 }
+
+class FilamentParallelCullingFixture : public benchmark::Fixture {
+protected:
+    Frustum frustum{};
+    std::vector<float3> boxesCenter;
+    std::vector<float3> boxesExtent;
+    Culler::result_type* UTILS_RESTRICT visibles = nullptr;
+    JobSystem* js = nullptr;
+
+public:
+    void SetUp(const ::benchmark::State& state) override {
+        std::default_random_engine gen; // NOLINT
+        std::uniform_real_distribution<float> rand(-100.0f, 100.0f);
+
+        const size_t count = Culler::round(size_t(state.range(0)));
+        frustum = Frustum{ mat4f::perspective(45.0f, 1.0f, 0.1f, 100.0f) };
+
+        boxesCenter.resize(count);
+        boxesExtent.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            float z = std::fabs(rand(gen));
+            boxesCenter[i] = {
+                    rand(gen, std::uniform_real_distribution<float>::param_type{ -z, z }),
+                    rand(gen, std::uniform_real_distribution<float>::param_type{ -z, z }),
+                    -z
+            };
+            boxesExtent[i] = {
+                    rand(gen, std::uniform_real_distribution<float>::param_type{ 0.11f, 25.0f }),
+                    rand(gen, std::uniform_real_distribution<float>::param_type{ 0.11f, 25.0f }),
+                    rand(gen, std::uniform_real_distribution<float>::param_type{ 0.11f, 25.0f })
+            };
+        }
+
+        visibles = (Culler::result_type*)utils::aligned_alloc(count * sizeof(*visibles), 32);
+
+        js = new JobSystem();
+        js->adopt();
+    }
+
+    void TearDown(const ::benchmark::State&) override {
+        js->emancipate();
+        delete js;
+        utils::aligned_free(visibles);
+        boxesCenter.clear();
+        boxesExtent.clear();
+    }
+};
+
+// Compares serial and parallel box culling for increasing renderable counts, this shows where
+// Engine::Config::parallelCullingThreshold should be set on a given device.
+
+BENCHMARK_DEFINE_F(FilamentParallelCullingFixture, boxCullingSerial)(benchmark::State& state) {
+    const size_t count = state.range(0);
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            Culler::Test::intersects(visibles, frustum,
+                    boxesCenter.data(), boxesExtent.data(), count);
+        }
+        benchmark::ClobberMemory();
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * count);
+    }
+}
+
+BENCHMARK_DEFINE_F(FilamentParallelCullingFixture, boxCullingParallel)(benchmark::State& state) {
+    const size_t count = state.range(0);
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            // a threshold of 1 always runs the parallel path
+            Culler::Test::intersects(*js, visibles, frustum,
+                    boxesCenter.data(), boxesExtent.data(), count, 1);
+        }
+        benchmark::ClobberMemory();
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * count);
+    }
+}
+
+BENCHMARK_REGISTER_F(FilamentParallelCullingFixture, boxCullingSerial)
+        ->RangeMultiplier(2)->Range(1 << 10, 1 << 18);
+
+BENCHMARK_REGISTER_F(FilamentParallelCullingFixture, boxCullingParallel)
+        ->RangeMultiplier(2)->Range(1 << 10, 1 << 18);
@@ -32,6 +32,9 @@ namespace utils {
 class Entity;
 class EntityManager;
 class JobSystem;
+namespace io {
+class ostream;
+} // namespace io
 } // namespace utils
 
 namespace filament {
@@ -221,6 +224,25 @@ public:
          */
         uint32_t commandBufferSizeMB = FILAMENT_COMMAND_BUFFER_SIZE_IN_MB;
 
+        /**
+         * Maximum size in MiB the low-level command buffer arena can grow to.
+         *
+         * When this is larger than commandBufferSizeMB, the command buffer doubles in size
+         * (up to this value) whenever a burst of commands doesn't fit in minCommandBufferSizeMB,
+         * for instance when many resources are created at once. It shrinks back towards
+         * commandBufferSizeMB once it has been mostly unused for a while. Resizing waits for
+         * all pending commands to be executed.
+         *
+         * If 0 (the default), the command buffer keeps its initial size. In both cases, a burst
+         * of commands that doesn't fit in the space available waits for the driver thread to
+         * execute pending commands. The commands recorded between two flushes (e.g. a frame)
+         * that don't fit in the command buffer at its current size continue in a larger one, as
+         * long as they fit in maxCommandBufferSizeMB.
+         *
+         * @see Engine::getCommandBufferStatistics
+         */
+        uint32_t maxCommandBufferSizeMB = 0;
+
 
         /**
          * Size in MiB of the per-frame data arena.
@@ -317,6 +339,88 @@ public:
          * The default value of 30 corresponds to about half a second at 60 fps.
          */
         uint32_t resourceAllocatorCacheMaxAge = 30;
+
+        /*
+         * When enabled, Scene only re-evaluates the renderables whose transform, bounding box,
+         * visibility, skinning, morphing or materials changed since the last frame, instead of
+         * rebuilding its per-frame data for all its renderables.
+         * This mostly benefits large scenes in which most renderables are static. Adding or
+         * removing entities, or creating or destroying components still triggers a full update.
+         */
+        bool sceneChangeTracking = false;
+
+        /*
+         * When enabled, along with sceneChangeTracking, the sorted commands of the color pass and
+         * of each shadow map are kept from one frame to the next, and reused as long as the
+         * camera, the visible renderables and the scene are unchanged. This mostly benefits
+         * static scenes, at the cost of keeping a copy of the commands of each pass.
+         * When some renderables change (e.g. a single renderable moving, or becoming visible),
+         * only their commands are regenerated and merged with the cached ones, but any change of
+         * the camera causes all the commands of the affected passes to be regenerated.
+         */
+        bool renderPassCommandCache = false;
+
+        /*
+         * When enabled, the shadow caster commands of all spot and point light shadow maps are
+         * generated and sorted once per frame, and each of these shadow maps only keeps a bitmask
+         * of the commands it needs to render. This reduces the memory used by the commands and
+         * the time spent generating them when there are many such shadow maps (point lights use
+         * six), at the cost of not sorting the shadow casters front-to-back for each light.
+         */
+        bool sharedShadowCasterCommands = false;
+
+        /*
+         * Minimum number of renderables in a Scene for frustum culling to be split into jobs
+         * running in parallel on the JobSystem. Below this count, culling is done on the calling
+         * thread, which is faster because of the JobSystem's overhead. 0 disables parallel
+         * culling entirely.
+         */
+        uint32_t parallelCullingThreshold = 16384;
+
+        /*
+         * When enabled, up to 1024 point and spot lights can be visible in a View at once,
+         * instead of 256. This requires uniform buffers of at least 64 KiB, it is ignored
+         * otherwise. The froxelizer uses up to 2 MiB more of the per-render-pass arena in this
+         * mode, perRenderPassArenaSizeMB is increased accordingly.
+         */
+        bool largeLightCount = false;
+
+        /*
+         * When enabled, automatic instancing draws up to 256 identical primitives at once instead
+         * of 64, and InstanceBuffer can hold as many instances. This requires uniform buffers of
+         * at least 64 KiB and the OpenGL backend, it is ignored otherwise. The per-renderable
+         * uniform buffer bound for each draw becomes 64 KiB instead of 16 KiB, and so does the
+         * uniform buffer of each renderable using an InstanceBuffer, regardless of its instance
+         * count. Skinned primitives using different bone offsets are never batched together.
+         */
+        bool largeInstanceBatches = false;
+
+        /*
+         * Minimum number of commands in a render pass for its driver commands to be recorded
+         * in parallel on the JobSystem, instead of on the calling thread. The commands recorded
+         * by each job are executed in the same order as if they were recorded serially. Passes
+         * with custom commands are always recorded on the calling thread. 0 (the default)
+         * disables parallel recording.
+         */
+        uint32_t parallelCommandRecordingThreshold = 0;
+
+        /*
+         * Minimum number of transform components for TransformManager to compute the world
+         * transforms in parallel on the JobSystem when a local transform transaction is
+         * committed. In that mode, the components are stored breadth-first, i.e. sorted by their
+         * depth in the hierarchy, and each level of the hierarchy is computed at once. 0 (the
+         * default) disables parallel transforms.
+         */
+        uint32_t parallelTransformThreshold = 0;
+
+        /*
+         * When set, the backend commands are written to a file at this path, from the Engine's
+         * creation to its destruction. Such a capture can be replayed without the application
+         * with the `cmdreplay` tool, e.g. to benchmark the driver thread. Capturing slows down
+         * the driver thread considerably and the file can grow large, this is a debugging aid.
+         * The string is copied when the Engine is created.
+         */
+        const char* commandStreamCapturePath = nullptr;
     };
 
 
@@ -575,6 +679,71 @@ public:
      */
     size_t getMaxAutomaticInstances() const noexcept;
 
+    /**
+     * Statistics about the low-level command buffer.
+     * @see getCommandBufferStatistics
+     */
+    struct CommandBufferStatistics {
+        size_t size = 0;                    //!< current size of the command buffer in bytes
+        size_t highWatermark = 0;           //!< largest space used at once in bytes
+        uint32_t resizeCount = 0;           //!< number of times the command buffer was resized
+        uint64_t mainThreadBlockedNs = 0;   //!< time spent by the main thread waiting for space
+        uint64_t driverThreadBlockedNs = 0; //!< time spent by the driver thread waiting for work
+    };
+
+    /**
+     * Returns statistics about the low-level command buffer, since this Engine was created.
+     * This must be called from the thread that created the Engine.
+     *
+     * @return the command buffer statistics
+     * @see Config::commandBufferSizeMB
+     * @see Config::maxCommandBufferSizeMB
+     */
+    CommandBufferStatistics getCommandBufferStatistics() const noexcept;
+
+    /**
+     * Statistics about one type of low-level command executed by the driver thread during a frame.
+     * @see getDriverCommandStatistics
+     */
+    struct DriverCommandStatistics {
+        const char* name = nullptr;         //!< name of the command, e.g. "draw"
+        uint32_t count = 0;                 //!< number of commands executed
+        uint32_t size = 0;                  //!< size of these commands in the command buffer
+        uint64_t time = 0;                  //!< time spent decoding and executing them, in ns
+    };
+
+    /**
+     * Enables or disables the accounting of the commands executed by the driver thread, per type
+     * of command. This adds a small overhead to each command, and is disabled by default.
+     *
+     * @param enabled true to enable the driver command statistics
+     * @see getDriverCommandStatistics
+     */
+    void setDriverCommandStatisticsEnabled(bool enabled) noexcept;
+
+    /**
+     * Returns the statistics of the last frame fully executed by the driver thread, one entry per
+     * type of command executed, sorted by decreasing time. This must be called from the thread
+     * that created the Engine.
+     *
+     * @param out   array receiving up to `count` entries, can be nullptr if `count` is 0
+     * @param count number of entries `out` can hold
+     * @return the number of types of command executed during that frame, which can be larger
+     *         than `count`. 0 if the statistics are disabled or no frame was executed yet.
+     * @see setDriverCommandStatisticsEnabled
+     */
+    size_t getDriverCommandStatistics(DriverCommandStatistics* out, size_t count) const noexcept;
+
+    /**
+     * Writes the statistics returned by getDriverCommandStatistics() as JSON. Nothing is written
+     * if the statistics are disabled. This must be called from the thread that created the
+     * Engine.
+     *
+     * @param out stream to write the statistics to
+     * @see setDriverCommandStatisticsEnabled
+     */
+    void dumpDriverCommandStatistics(utils::io::ostream& out) const noexcept;
+
     /**
      * Queries the device and platform for instanced stereo rendering support.
      *
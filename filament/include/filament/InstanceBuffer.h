@@ -17,6 +17,7 @@
 #ifndef TNT_FILAMENT_INSTANCEBUFFER_H
 #define TNT_FILAMENT_INSTANCEBUFFER_H
 
+#include <filament/Box.h>
 #include <filament/FilamentAPI.h>
 #include <filament/Engine.h>
 
@@ -70,6 +71,19 @@ public:
          */
         Builder& localTransforms(math::mat4f const* UTILS_NULLABLE localTransforms) noexcept;
 
+        /**
+         * Enables culling each instance individually against the camera frustum. Instances that
+         * are not visible are not drawn, and the visible ones are packed together, so
+         * \c getInstanceIndex() doesn't identify a given instance when culling is enabled.
+         *
+         * Instances are only culled individually when the renderable isn't rendered into any
+         * shadow map in the current frame, otherwise they are all drawn.
+         *
+         * @param boundingBox the bounding box of a single instance, in the instance's local
+         *                    space (i.e. before its local transform is applied)
+         */
+        Builder& culling(Box const& boundingBox) noexcept;
+
         /**
          * Creates the InstanceBuffer object and returns a pointer to it.
          */
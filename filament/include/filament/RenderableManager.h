@@ -352,6 +352,20 @@ public:
          */
         Builder& fog(bool enabled = true) noexcept;
 
+        /**
+         * Marks this renderable as static geometry, i.e. its transform, bounding box and
+         * visibility are not expected to change often.
+         *
+         * When Engine::Config::sceneChangeTracking is enabled, the Scene keeps its static
+         * renderables in a bounding volume hierarchy, so that culling them costs in proportion
+         * to what is visible rather than to the size of the scene. Changing a static renderable
+         * is allowed but causes the hierarchy to be rebuilt. This has no effect otherwise.
+         *
+         * @param enabled If true, this renderable is static geometry. False by default.
+         * @return A reference to this Builder for chaining calls.
+         */
+        Builder& staticGeometry(bool enabled = true) noexcept;
+
         /**
          * Enables GPU vertex skinning for up to 255 bones, 0 by default.
          *
@@ -532,7 +546,8 @@ public:
          * Specifies the number of draw instances of this renderable and an \c InstanceBuffer
          * containing their local transforms. The default is 1 instance and the maximum number of
          * instances allowed when supplying transforms is given by
-         * \c Engine::getMaxAutomaticInstances (64 on most platforms). 0 is invalid. The
+         * \c Engine::getMaxAutomaticInstances (64 on most platforms, see
+         * \c Engine::Config::largeInstanceBatches). 0 is invalid. The
          * \c InstanceBuffer must not be destroyed before this renderable.
          *
          * All instances are culled using the same bounding box, so care must be taken to make
@@ -654,6 +669,19 @@ public:
      */
     bool getFogEnabled(Instance instance) const noexcept;
 
+    /**
+     * Changes whether or not this renderable is static geometry.
+     * @see Builder::staticGeometry()
+     */
+    void setStaticGeometry(Instance instance, bool enable) noexcept;
+
+    /**
+     * Returns whether this renderable is static geometry.
+     * @return True if this renderable is static geometry.
+     * @see Builder::staticGeometry()
+     */
+    bool isStaticGeometry(Instance instance) const noexcept;
+
     /**
      * Enables or disables a light channel.
      * Light channel 0 is enabled by default.
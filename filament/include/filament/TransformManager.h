@@ -269,6 +269,41 @@ public:
      */
     void setTransform(Instance ci, const math::mat4& localTransform) noexcept;
 
+    /**
+     * Sets the local transforms of several transform components at once. This is equivalent to
+     * calling setTransform() for each of them.
+     *
+     * If a local transform transaction is open, the world transforms are computed when it is
+     * committed. Otherwise, when only a small fraction of the transform components are set,
+     * the world transforms of their subtrees are updated like setTransform() does. When many
+     * are set, all the world transforms are computed in a single pass over each hierarchy
+     * instead. In both cases, the Instances of the transform components stay valid.
+     *
+     * @param instances       Array of `count` instances of transform components.
+     * @param localTransforms Array of `count` local transforms (i.e. relative to the parent), one
+     *                        for each instance.
+     * @param count           Number of transforms to set.
+     * @see setTransform(Instance, const math::mat4f&)
+     */
+    void setTransforms(Instance const* UTILS_NONNULL instances,
+            const math::mat4f* UTILS_NONNULL localTransforms, size_t count) noexcept;
+
+    /**
+     * Sets the local transforms of several transform components at once and keeps double
+     * precision translations. This is equivalent to calling setTransform() for each of them, see
+     * setTransforms(Instance const*, const math::mat4f*, size_t) for how the world transforms
+     * are updated.
+     *
+     * @param instances       Array of `count` instances of transform components.
+     * @param localTransforms Array of `count` local transforms (i.e. relative to the parent), one
+     *                        for each instance.
+     * @param count           Number of transforms to set.
+     * @see setTransforms(Instance const*, const math::mat4f*, size_t)
+     * @see setTransform(Instance, const math::mat4&)
+     */
+    void setTransforms(Instance const* UTILS_NONNULL instances,
+            const math::mat4* UTILS_NONNULL localTransforms, size_t count) noexcept;
+
     /**
      * Returns the local transform of a transform component.
      * @param ci The instance of the transform component to query the local transform from.
@@ -329,6 +364,9 @@ public:
      *
      * @note If the local transform transaction is not open, this is a no-op.
      *
+     * @note Committing can reorder the transform components so that children come after their
+     *       parent, which invalidates their Instances.
+     *
      * @see openLocalTransformTransaction(), setTransform()
      */
     void commitLocalTransformTransaction() noexcept;
@@ -18,6 +18,8 @@
 
 #include <filament/Box.h>
 
+#include <utils/JobSystem.h>
+
 #include <math/fast.h>
 
 using namespace filament::math;
@@ -93,6 +95,33 @@ void Culler::intersects(
     }
 }
 
+void Culler::intersects(utils::JobSystem& js,
+        result_type* results,
+        Frustum const& frustum,
+        float3 const* center,
+        float3 const* extent,
+        size_t count, size_t bit, size_t parallelThreshold) noexcept {
+
+    if (!parallelThreshold || count < parallelThreshold) {
+        Culler::intersects(results, frustum, center, extent, count, bit);
+        return;
+    }
+
+    // Culler::intersects() must process multiples of MODULO primitives, so we split the work in
+    // groups of MODULO primitives, which guarantees that jobs never overlap. Like in the
+    // serial case, the last group can extend past count.
+    auto work = [results, &frustum, center, extent, bit](uint32_t start, uint32_t c) {
+        size_t const first = start * MODULO;
+        Culler::intersects(results + first, frustum,
+                center + first, extent + first, c * MODULO, bit);
+    };
+
+    uint32_t const groupCount = uint32_t(round(count) / MODULO);
+    auto* job = utils::jobs::parallel_for(js, nullptr, 0, groupCount,
+            std::cref(work), utils::jobs::CountSplitter<PARALLEL_GROUP_COUNT, 5>());
+    js.runAndWait(job);
+}
+
 /*
  * returns whether a box intersects with the frustum
  */
@@ -131,6 +160,15 @@ void Culler::Test::intersects(
     Culler::intersects(results, frustum, c, e, count, 0);
 }
 
+void Culler::Test::intersects(utils::JobSystem& js,
+        result_type* results,
+        Frustum const& frustum,
+        float3 const* c,
+        float3 const* e,
+        size_t count, size_t parallelThreshold) noexcept {
+    Culler::intersects(js, results, frustum, c, e, count, 0, parallelThreshold);
+}
+
 void Culler::Test::intersects(
         result_type* UTILS_RESTRICT results,
         Frustum const& UTILS_RESTRICT frustum,
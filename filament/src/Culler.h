@@ -25,6 +25,10 @@
 #include <math/vec4.h>
 #include <math/vec2.h>
 
+namespace utils {
+class JobSystem;
+} // namespace utils
+
 namespace filament {
 
 /*
@@ -53,6 +57,17 @@ public:
             math::float3 const* extent,
             size_t count, size_t bit) noexcept;
 
+    /*
+     * Same as above, but the work is split in chunks processed in parallel by the JobSystem
+     * when count is at least parallelThreshold (and parallelThreshold is not 0).
+     */
+    static void intersects(utils::JobSystem& js,
+            result_type* results,
+            Frustum const& frustum,
+            math::float3 const* center,
+            math::float3 const* extent,
+            size_t count, size_t bit, size_t parallelThreshold) noexcept;
+
     /*
      * returns whether each sphere in an array intersects with the frustum
      */
@@ -84,11 +99,22 @@ public:
                 math::float3 const* e,
                 size_t count) noexcept;
 
+        static void intersects(utils::JobSystem& js,
+                result_type* results,
+                Frustum const& frustum,
+                math::float3 const* c,
+                math::float3 const* e,
+                size_t count, size_t parallelThreshold) noexcept;
+
         static void intersects(result_type* results,
                 Frustum const& frustum,
                 math::float4 const* b,
                 size_t count) noexcept;
     };
+
+private:
+    // Minimum number of groups of MODULO primitives processed by a single culling job
+    static constexpr size_t PARALLEL_GROUP_COUNT = 512;
 };
 
 } // namespace filament
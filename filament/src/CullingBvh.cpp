@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CullingBvh.h"
+
+#include "Culler.h"
+
+#include <utils/debug.h>
+#include <utils/Systrace.h>
+
+#include <math/vec4.h>
+
+#include <algorithm>
+#include <limits>
+
+using namespace filament::math;
+
+namespace filament {
+
+static constexpr uint32_t LEAF_SIZE = Culler::MODULO;
+
+CullingBvh::CullingBvh() noexcept = default;
+
+CullingBvh::~CullingBvh() noexcept = default;
+
+void CullingBvh::clear() noexcept {
+    mNodes.clear();
+    mCenters.clear();
+    mExtents.clear();
+    mPayloads.clear();
+    mCount = 0;
+}
+
+void CullingBvh::build(float3 const* center, float3 const* extent,
+        uint32_t const* payload, size_t count) {
+    SYSTRACE_CALL();
+
+    clear();
+    if (!count) {
+        return;
+    }
+
+    // the boxes are partitioned by their center, which we keep along with their index for
+    // better locality.
+    std::vector<Item> items(count);
+    for (size_t i = 0; i < count; i++) {
+        items[i] = { center[i], uint32_t(i) };
+    }
+
+    // because of how the boxes are split (see buildNode), only the last leaf can be partial
+    size_t const leafCount = (count + LEAF_SIZE - 1) / LEAF_SIZE;
+    mNodes.reserve(2 * leafCount - 1);
+    mCenters.reserve(leafCount * LEAF_SIZE);
+    mExtents.reserve(leafCount * LEAF_SIZE);
+    mPayloads.reserve(leafCount * LEAF_SIZE);
+
+    buildNode(items.data(), count, center, extent, payload);
+    mCount = count;
+}
+
+uint32_t CullingBvh::buildNode(Item* items, size_t count,
+        float3 const* center, float3 const* extent, uint32_t const* payload) {
+    assert_invariant(count > 0);
+
+    uint32_t const index = uint32_t(mNodes.size());
+    mNodes.emplace_back();
+
+    float3 lo{ std::numeric_limits<float>::max() };
+    float3 hi{ std::numeric_limits<float>::lowest() };
+
+    if (count <= LEAF_SIZE) {
+        // leaves always use LEAF_SIZE slots, the unused ones never intersect anything
+        uint32_t const first = uint32_t(mCenters.size());
+        for (size_t i = 0; i < LEAF_SIZE; i++) {
+            if (i < count) {
+                uint32_t const j = items[i].index;
+                lo = min(lo, center[j] - extent[j]);
+                hi = max(hi, center[j] + extent[j]);
+                mCenters.push_back(center[j]);
+                mExtents.push_back(extent[j]);
+                mPayloads.push_back(payload[j]);
+            } else {
+                mCenters.emplace_back(0);
+                mExtents.emplace_back(0);
+                mPayloads.push_back(INVALID_PAYLOAD);
+            }
+        }
+        mNodes[index] = { (hi + lo) * 0.5f, (hi - lo) * 0.5f, first, LEAF_SIZE, 0 };
+        return index;
+    }
+
+    // split along the largest axis of the centers' bounds
+    for (size_t i = 0; i < count; i++) {
+        lo = min(lo, items[i].center);
+        hi = max(hi, items[i].center);
+    }
+    float3 const size = hi - lo;
+    size_t const axis = size.x >= size.y ? (size.x >= size.z ? 0 : 2) : (size.y >= size.z ? 1 : 2);
+
+    // the left half is rounded up to a multiple of LEAF_SIZE, so that all leaves but the
+    // last one of the subtree are full.
+    size_t const half = (count / 2 + LEAF_SIZE - 1) & ~size_t(LEAF_SIZE - 1);
+    assert_invariant(half > 0 && half < count);
+    std::nth_element(items, items + half, items + count,
+            [axis](Item const& a, Item const& b) {
+                return a.center[axis] < b.center[axis];
+            });
+
+    uint32_t const left = buildNode(items, half, center, extent, payload);
+    uint32_t const right = buildNode(items + half, count - half, center, extent, payload);
+
+    // note: mNodes may have been reallocated by the calls above
+    Node const& l = mNodes[left];
+    Node const& r = mNodes[right];
+    lo = min(l.center - l.extent, r.center - r.extent);
+    hi = max(l.center + l.extent, r.center + r.extent);
+    uint32_t const first = l.first;
+    uint32_t const slots = r.first + r.count - first;
+    mNodes[index] = { (hi + lo) * 0.5f, (hi - lo) * 0.5f, first, slots, right };
+    return index;
+}
+
+size_t CullingBvh::intersects(Frustum const& frustum, uint32_t* UTILS_RESTRICT out) const noexcept {
+    if (UTILS_UNLIKELY(mNodes.empty())) {
+        return 0;
+    }
+
+    float4 const* const UTILS_RESTRICT planes = frustum.getNormalizedPlanes();
+    Node const* const UTILS_RESTRICT nodes = mNodes.data();
+    uint32_t const* const UTILS_RESTRICT payloads = mPayloads.data();
+
+    struct Entry {
+        uint32_t node;
+        uint32_t mask;      // planes straddled by the node's parent
+    };
+
+    // the depth of the tree is at most log2(count / LEAF_SIZE) + 1
+    Entry stack[64];
+    size_t sp = 0;
+    stack[sp++] = { 0, 0x3F };
+
+    size_t visibleCount = 0;
+    while (sp) {
+        auto [n, mask] = stack[--sp];
+        Node const& node = nodes[n];
+
+        // classify the node against the planes its parent straddles, a node is outside if it's
+        // entirely in front of any plane.
+        bool outside = false;
+        for (size_t j = 0; j < 6; j++) {
+            if (mask & (1u << j)) {
+                float const d = dot(planes[j].xyz, node.center) + planes[j].w;
+                float const r = dot(abs(planes[j].xyz), node.extent);
+                if (d - r > 0) {
+                    outside = true;
+                    break;
+                }
+                if (d + r < 0) {
+                    // the node is entirely behind this plane, so are its children
+                    mask &= ~(1u << j);
+                }
+            }
+        }
+
+        if (outside) {
+            continue;
+        }
+
+        if (!mask) {
+            // the node is entirely inside the frustum, accept all of its boxes
+            for (size_t i = node.first, e = node.first + node.count; i < e; i++) {
+                if (payloads[i] != INVALID_PAYLOAD) {
+                    out[visibleCount++] = payloads[i];
+                }
+            }
+            continue;
+        }
+
+        if (node.count == LEAF_SIZE) {
+            // the leaf straddles the frustum, test its boxes individually
+            Culler::result_type results[LEAF_SIZE] = {};
+            Culler::intersects(results, frustum,
+                    mCenters.data() + node.first, mExtents.data() + node.first, LEAF_SIZE, 0);
+            for (size_t i = 0; i < LEAF_SIZE; i++) {
+                uint32_t const p = payloads[node.first + i];
+                if ((results[i] & 1u) && p != INVALID_PAYLOAD) {
+                    out[visibleCount++] = p;
+                }
+            }
+            continue;
+        }
+
+        assert_invariant(sp + 2 <= sizeof(stack) / sizeof(stack[0]));
+        stack[sp++] = { node.right, mask };
+        stack[sp++] = { n + 1, mask };
+    }
+
+    return visibleCount;
+}
+
+} // namespace filament
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_CULLINGBVH_H
+#define TNT_FILAMENT_CULLINGBVH_H
+
+#include <filament/Frustum.h>
+
+#include <utils/compiler.h>
+
+#include <math/vec3.h>
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+/*
+ * A bounding volume hierarchy of axis-aligned boxes, used to cull large sets of boxes that
+ * don't move, such that whole subtrees are accepted or rejected with a single test.
+ *
+ * Each box is associated with a user-provided 32-bits value (the payload), which is what
+ * intersects() returns for the visible boxes.
+ *
+ * Leaves hold up to Culler::MODULO boxes, stored contiguously and padded to Culler::MODULO,
+ * so that leaves intersecting the frustum can be processed by the regular SIMD Culler.
+ */
+class CullingBvh {
+public:
+    CullingBvh() noexcept;
+    ~CullingBvh() noexcept;
+
+    CullingBvh(CullingBvh const&) = delete;
+    CullingBvh& operator=(CullingBvh const&) = delete;
+
+    // (re)builds the hierarchy from scratch
+    void build(math::float3 const* center, math::float3 const* extent,
+            uint32_t const* payload, size_t count);
+
+    void clear() noexcept;
+
+    // number of boxes in the hierarchy
+    size_t size() const noexcept { return mCount; }
+
+    bool empty() const noexcept { return mCount == 0; }
+
+    /*
+     * Writes the payload of each box intersecting the frustum into `out`, which must be large
+     * enough to hold size() entries. Returns the number of entries written.
+     * A box is reported visible exactly when Culler::intersects() would report it visible,
+     * up to floating-point rounding.
+     */
+    size_t intersects(Frustum const& frustum, uint32_t* UTILS_RESTRICT out) const noexcept;
+
+private:
+    struct Node {
+        math::float3 center;    // bounding box of all the boxes in this subtree
+        math::float3 extent;
+        uint32_t first;         // first slot of this subtree's boxes
+        uint32_t count;         // number of slots used by this subtree (Culler::MODULO for leaves)
+        uint32_t right;         // index of the right child (the left child follows this node)
+    };
+
+    struct Item {
+        math::float3 center;
+        uint32_t index;
+    };
+
+    static constexpr uint32_t INVALID_PAYLOAD = 0xFFFFFFFFu;
+
+    uint32_t buildNode(Item* items, size_t count, math::float3 const* center,
+            math::float3 const* extent, uint32_t const* payload);
+
+    std::vector<Node> mNodes;
+    std::vector<math::float3> mCenters;
+    std::vector<math::float3> mExtents;
+    std::vector<uint32_t> mPayloads;
+    size_t mCount = 0;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_CULLINGBVH_H
@@ -327,6 +327,23 @@ size_t Engine::getMaxAutomaticInstances() const noexcept {
     return downcast(this)->getMaxAutomaticInstances();
 }
 
+Engine::CommandBufferStatistics Engine::getCommandBufferStatistics() const noexcept {
+    return downcast(this)->getCommandBufferStatistics();
+}
+
+void Engine::setDriverCommandStatisticsEnabled(bool enabled) noexcept {
+    downcast(this)->setDriverCommandStatisticsEnabled(enabled);
+}
+
+size_t Engine::getDriverCommandStatistics(
+        DriverCommandStatistics* out, size_t count) const noexcept {
+    return downcast(this)->getDriverCommandStatistics(out, count);
+}
+
+void Engine::dumpDriverCommandStatistics(utils::io::ostream& out) const noexcept {
+    downcast(this)->dumpDriverCommandStatistics(out);
+}
+
 const Engine::Config& Engine::getConfig() const noexcept {
     return downcast(this)->getConfig();
 }
@@ -26,6 +26,7 @@
 #include <filament/Viewport.h>
 
 #include <utils/BinaryTreeArray.h>
+#include <utils/JobSystem.h>
 #include <utils/Systrace.h>
 #include <utils/debug.h>
 
@@ -52,16 +53,26 @@ static constexpr float FROXEL_LAST_SLICE_DISTANCE = 100;
 // The record buffer is limited by both the UBO size and our use of 16-bits indices.
 constexpr size_t RECORD_BUFFER_ENTRY_COUNT  = CONFIG_MINSPEC_UBO_SIZE;    // 16 KiB UBO minspec
 
-// Buffer needed for Froxelizer internal data structures (~256 KiB)
+// With large light counts, records are 16-bits and the record buffer is a 64 KiB UBO
+constexpr size_t RECORD_BUFFER_LARGE_ENTRY_COUNT = 65536 / sizeof(uint16_t);
+
+// Buffer needed for Froxelizer internal data structures (~384 KiB), this includes the
+// temporary storage of updateBoundingSpheres(), that is 2 floats for each of the at most
+// 2 * FROXEL_BUFFER_MAX_ENTRY_COUNT + 2 corners of the froxels in a slice.
 constexpr size_t PER_FROXELDATA_ARENA_SIZE = sizeof(float4) *
                                                  (FROXEL_BUFFER_MAX_ENTRY_COUNT +
                                                   FROXEL_BUFFER_MAX_ENTRY_COUNT + 3 +
-                                                  FROXEL_SLICE_COUNT / 4 + 1);
+                                                  FROXEL_SLICE_COUNT / 4 + 1 +
+                                                  FROXEL_BUFFER_MAX_ENTRY_COUNT + 1);
+
+// Below this number of froxels, the bounding spheres are computed on the calling thread
+static constexpr size_t FROXEL_PARALLEL_BOUNDING_SPHERES_MIN_COUNT = 4096;
 
 // number of lights processed by one group (e.g. 32)
 static constexpr size_t LIGHT_PER_GROUP = sizeof(Froxelizer::LightGroupType) * 8;
 
-// number of groups (i.e. jobs) to use for froxelization (e.g. 8)
+// minimum number of groups (i.e. jobs) to use for froxelization (e.g. 8), more groups are used
+// with large light counts.
 static constexpr size_t GROUP_COUNT =
         (CONFIG_MAX_LIGHT_COUNT + LIGHT_PER_GROUP - 1) / LIGHT_PER_GROUP;
 
@@ -69,9 +80,12 @@ static constexpr size_t GROUP_COUNT =
 static_assert(CONFIG_MAX_LIGHT_INDEX <= std::numeric_limits<Froxelizer::RecordBufferType>::max(),
         "can't have more than 256 lights");
 
+static_assert(CONFIG_MAX_LIGHT_COUNT_LARGE - 1 <= std::numeric_limits<uint16_t>::max(),
+        "can't have more than 65536 lights with 16-bits records");
+
 // Record buffer cannot be larger than 65K entries because froxels use uint16_t to store indices
 // to it.
-static_assert(RECORD_BUFFER_ENTRY_COUNT <= 65536,
+static_assert(RECORD_BUFFER_ENTRY_COUNT <= 65536 && RECORD_BUFFER_LARGE_ENTRY_COUNT <= 65536,
         "RecordBuffer cannot be larger than 65536 entries");
 
 static_assert(RECORD_BUFFER_ENTRY_COUNT <= CONFIG_MINSPEC_UBO_SIZE,
@@ -97,7 +111,11 @@ static bool fuzzyEqual(mat4f const& UTILS_RESTRICT l, mat4f const& UTILS_RESTRIC
 
 
 Froxelizer::Froxelizer(FEngine& engine)
-        : mArena("froxel", PER_FROXELDATA_ARENA_SIZE),
+        : mJobSystem(engine.getJobSystem()),
+          mArena("froxel", PER_FROXELDATA_ARENA_SIZE),
+          mLargeLightCount(engine.hasLargeLightCount()),
+          mRecordBufferEntryCount(mLargeLightCount ?
+                  RECORD_BUFFER_LARGE_ENTRY_COUNT : RECORD_BUFFER_ENTRY_COUNT),
           mZLightNear(FROXEL_FIRST_SLICE_DEPTH),
           mZLightFar(FROXEL_LAST_SLICE_DISTANCE)
 {
@@ -114,7 +132,7 @@ Froxelizer::Froxelizer(FEngine& engine)
             FROXEL_BUFFER_MAX_ENTRY_COUNT,
             engine.getDriverApi().getMaxUniformBufferSize() / 16u);
 
-    mRecordsBuffer = driverApi.createBufferObject(RECORD_BUFFER_ENTRY_COUNT,
+    mRecordsBuffer = driverApi.createBufferObject(getRecordBufferSize(),
             BufferObjectBinding::UNIFORM, BufferUsage::DYNAMIC);
 
     mFroxelsBuffer = driverApi.createBufferObject(getFroxelBufferEntryCount() * 16u,
@@ -169,7 +187,8 @@ void Froxelizer::setProjection(const mat4f& projection,
 
 bool Froxelizer::prepare(
         FEngine::DriverApi& driverApi, ArenaScope& arena, filament::Viewport const& viewport,
-        const mat4f& projection, float projectionNear, float projectionFar) noexcept {
+        const mat4f& projection, float projectionNear, float projectionFar,
+        size_t lightCount) noexcept {
     setViewport(viewport);
     setProjection(projection, projectionNear, projectionFar);
 
@@ -188,24 +207,33 @@ bool Froxelizer::prepare(
             driverApi.allocatePod<FroxelEntry>(getFroxelBufferEntryCount()),
             getFroxelBufferEntryCount() };
 
-    // record buffer (~16 KiB)
+    // record buffer (~16 KiB, ~64 KiB with large light counts)
     mRecordBufferUser = {
-            driverApi.allocatePod<RecordBufferType>(RECORD_BUFFER_ENTRY_COUNT),
-            RECORD_BUFFER_ENTRY_COUNT };
+            driverApi.allocatePod<RecordBufferType>(getRecordBufferSize()),
+            getRecordBufferSize() };
 
     /*
-     * Temporary allocations for processing all froxel data
+     * Temporary allocations for processing all froxel data, these depend on the number of lights
      */
 
-    // light records per froxel (~256 KiB)
+    // each group holds LIGHT_PER_GROUP lights, and we need an even number of groups per
+    // LightRecord word.
+    assert_invariant(lightCount <= (mLargeLightCount ?
+            CONFIG_MAX_LIGHT_COUNT_LARGE : CONFIG_MAX_LIGHT_COUNT));
+    mLightRecordWordCount = lightCount <= CONFIG_MAX_LIGHT_COUNT ? 4 : 16;
+    mGroupCount = uint32_t(std::max(GROUP_COUNT,
+            2 * ((lightCount + 2 * LIGHT_PER_GROUP - 1) / (2 * LIGHT_PER_GROUP))));
+
+    // light records per froxel (~256 KiB, ~1 MiB with 1024 lights)
     mLightRecords = {
-            arena.allocate<LightRecord>(getFroxelBufferEntryCount(), CACHELINE_SIZE),
-            getFroxelBufferEntryCount() };
+            arena.allocate<uint64_t>(getFroxelBufferEntryCount() * mLightRecordWordCount,
+                    CACHELINE_SIZE),
+            getFroxelBufferEntryCount() * mLightRecordWordCount };
 
-    // froxel thread data (~256 KiB)
+    // froxel thread data (~256 KiB, ~1 MiB with 1024 lights)
     mFroxelShardedData = {
-            arena.allocate<FroxelThreadData>(GROUP_COUNT, CACHELINE_SIZE),
-            uint32_t(GROUP_COUNT)
+            arena.allocate<FroxelThreadData>(mGroupCount, CACHELINE_SIZE),
+            mGroupCount
     };
 
     assert_invariant(mFroxelBufferUser.begin());
@@ -261,62 +289,85 @@ void Froxelizer::computeFroxelLayout(
 }
 
 UTILS_NOINLINE
-void Froxelizer::updateBoundingSpheres(
+void Froxelizer::updateBoundingSpheres(JobSystem& js,
         math::float4* const UTILS_RESTRICT boundingSpheres,
         size_t froxelCountX, size_t froxelCountY, size_t froxelCountZ,
         math::float4 const* UTILS_RESTRICT planesX,
         math::float4 const* UTILS_RESTRICT planesY,
-        float const* UTILS_RESTRICT planesZ) noexcept {
+        float const* UTILS_RESTRICT planesZ,
+        float* UTILS_RESTRICT scratch) noexcept {
 
     SYSTRACE_CALL();
 
-    // TODO: this could potentially be parallel_for'ized
-
     /*
      * Now compute the bounding sphere of each froxel, which is needed for spotlights
-     * We intersect 3 planes of the frustum to find each 8 corners.
+     * Each of the 8 corners of a froxel is the intersection of 3 planes of the frustum. Because
+     * the X and Y planes go through the origin and the Z planes are perpendicular to the z-axis,
+     * these corners are on the rays where the X and Y planes intersect. So we first compute
+     * these rays, and then each corner is one of the froxel's 4 rays scaled by the distance of
+     * one of its 2 Z planes.
      */
 
     UTILS_ASSUME(froxelCountX > 0);
     UTILS_ASSUME(froxelCountY > 0);
 
-    for (size_t iz = 0, fi = 0, nz = froxelCountZ; iz < nz; ++iz) {
-        float4 planes[6];
-        planes[4] =  float4{ 0, 0, 1, planesZ[iz + 0] };
-        planes[5] = -float4{ 0, 0, 1, planesZ[iz + 1] };
-        for (size_t iy = 0, ny = froxelCountY; iy < ny; ++iy) {
-            planes[2] =  planesY[iy];
-            planes[3] = -planesY[iy + 1];
-            for (size_t ix = 0, nx = froxelCountX; ix < nx; ++ix) {
-                planes[0] =  planesX[ix];
-                planes[1] = -planesX[ix + 1];
-
-                float3 const p0 = planeIntersection(planes[0], planes[2], planes[4]);
-                float3 const p1 = planeIntersection(planes[1], planes[2], planes[4]);
-                float3 const p2 = planeIntersection(planes[0], planes[3], planes[4]);
-                float3 const p3 = planeIntersection(planes[1], planes[3], planes[4]);
-                float3 const p4 = planeIntersection(planes[0], planes[2], planes[5]);
-                float3 const p5 = planeIntersection(planes[1], planes[2], planes[5]);
-                float3 const p6 = planeIntersection(planes[0], planes[3], planes[5]);
-                float3 const p7 = planeIntersection(planes[1], planes[3], planes[5]);
-
-                float3 const c = (p0 + p1 + p2 + p3 + p4 + p5 + p6 + p7) * 0.125f;
-
-                float const d0 = length2(p0 - c);
-                float const d1 = length2(p1 - c);
-                float const d2 = length2(p2 - c);
-                float const d3 = length2(p3 - c);
-                float const d4 = length2(p4 - c);
-                float const d5 = length2(p5 - c);
-                float const d6 = length2(p6 - c);
-                float const d7 = length2(p7 - c);
-
-                float const r = std::sqrt(std::max({ d0, d1, d2, d3, d4, d5, d6, d7 }));
-
-                assert_invariant(getFroxelIndex(ix, iy, iz, froxelCountX, froxelCountY) == fi);
-                boundingSpheres[fi++] = { c, r };
+    // rays are stored as x and y arrays (their z is 1), so that the loop below vectorizes
+    size_t const rayCountX = froxelCountX + 1;
+    size_t const rayCount = rayCountX * (froxelCountY + 1);
+    float* const UTILS_RESTRICT raysX = scratch;
+    float* const UTILS_RESTRICT raysY = scratch + rayCount;
+    for (size_t iy = 0, ny = froxelCountY; iy <= ny; ++iy) {
+        for (size_t ix = 0, nx = froxelCountX; ix <= nx; ++ix) {
+            assert_invariant(planesX[ix].w == 0 && planesY[iy].w == 0);
+            // this is planeIntersection() with the z = -1 plane
+            float3 const r = cross(planesX[ix].xyz, planesY[iy].xyz);
+            raysX[iy * rayCountX + ix] = r.x / r.z;
+            raysY[iy * rayCountX + ix] = r.y / r.z;
+        }
+    }
+
+    auto work = [=](uint32_t const first, uint32_t const count) {
+        for (size_t iz = first; iz < first + count; ++iz) {
+            // the sphere's center is on the average ray, halfway between the Z planes
+            float const z0 = planesZ[iz + 0];
+            float const z1 = planesZ[iz + 1];
+            float const zc = (z0 + z1) * 0.5f;
+            float const dz = (z1 - z0) * 0.5f;
+            float4* const UTILS_RESTRICT spheres =
+                    boundingSpheres + getFroxelIndex(0, 0, iz, froxelCountX, froxelCountY);
+            for (size_t iy = 0, ny = froxelCountY; iy < ny; ++iy) {
+                float const* const UTILS_RESTRICT x0 = raysX + iy * rayCountX;
+                float const* const UTILS_RESTRICT x1 = x0 + rayCountX;
+                float const* const UTILS_RESTRICT y0 = raysY + iy * rayCountX;
+                float const* const UTILS_RESTRICT y1 = y0 + rayCountX;
+                float4* const UTILS_RESTRICT out = spheres + iy * froxelCountX;
+                // this loop is vectorized by the compiler
+                for (size_t ix = 0, nx = froxelCountX; ix < nx; ++ix) {
+                    float const rx[4] = { x0[ix], x0[ix + 1], x1[ix], x1[ix + 1] };
+                    float const ry[4] = { y0[ix], y0[ix + 1], y1[ix], y1[ix + 1] };
+                    float const cx = (rx[0] + rx[1] + rx[2] + rx[3]) * (0.25f * zc);
+                    float const cy = (ry[0] + ry[1] + ry[2] + ry[3]) * (0.25f * zc);
+                    float d = 0.0f;
+                    for (size_t i = 0; i < 4; i++) {
+                        float const dx0 = z0 * rx[i] - cx;
+                        float const dy0 = z0 * ry[i] - cy;
+                        float const dx1 = z1 * rx[i] - cx;
+                        float const dy1 = z1 * ry[i] - cy;
+                        d = std::max(d, std::max(dx0 * dx0 + dy0 * dy0, dx1 * dx1 + dy1 * dy1));
+                    }
+                    out[ix] = { -cx, -cy, -zc, std::sqrt(d + dz * dz) };
+                }
             }
         }
+    };
+
+    if (froxelCountX * froxelCountY * froxelCountZ < FROXEL_PARALLEL_BOUNDING_SPHERES_MIN_COUNT) {
+        work(0, froxelCountZ);
+    } else {
+        // one job per Z slice
+        auto* job = jobs::parallel_for(js, nullptr, 0, uint32_t(froxelCountZ),
+                std::cref(work), jobs::CountSplitter<1, 4>());
+        js.runAndWait(job);
     }
 }
 
@@ -422,9 +473,13 @@ bool Froxelizer::update() noexcept {
             planesY[i] = float4{ normalize(p.xyz), 0 };  // p.w is guaranteed to be 0
         }
 
-        updateBoundingSpheres(mBoundingSpheres,
+        // temporary storage for updateBoundingSpheres(), freed right away
+        float* const scratch = mArena.alloc<float>(2 * (mFroxelCountX + 1) * (mFroxelCountY + 1));
+        assert_invariant(scratch);
+        updateBoundingSpheres(mJobSystem, mBoundingSpheres,
                 mFroxelCountX, mFroxelCountY, mFroxelCountZ,
-                planesX, planesY, mDistancesZ);
+                planesX, planesY, mDistancesZ, scratch);
+        mArena.rewind(scratch);
 
         // note: none of the values below are affected by the projection offset, scale or rotation.
         float const Pz = mProjection[2][2];
@@ -505,8 +560,12 @@ void Froxelizer::commit(backend::DriverApi& driverApi) {
     driverApi.updateBufferObject(mFroxelsBuffer,
             { mFroxelBufferUser.data(), getFroxelBufferEntryCount() * 16u }, 0);
 
+    // only the records actually used are uploaded, the UBO must be updated by multiples of 16 bytes
+    size_t const recordSize = mLargeLightCount ? sizeof(uint16_t) : sizeof(RecordBufferType);
+    size_t const recordBufferUsedSize = std::max(size_t(16),
+            (mRecordBufferUsedCount * recordSize + 15u) & ~size_t(15u));
     driverApi.updateBufferObject(mRecordsBuffer,
-            { mRecordBufferUser.data(), RECORD_BUFFER_ENTRY_COUNT }, 0);
+            { mRecordBufferUser.data(), recordBufferUsedSize }, 0);
 
 #ifndef NDEBUG
     mFroxelBufferUser.clear();
@@ -520,12 +579,19 @@ void Froxelizer::froxelizeLights(FEngine& engine,
         const FScene::LightSoa& UTILS_RESTRICT lightData) noexcept {
     // note: this is called asynchronously
     froxelizeLoop(engine, viewMatrix, lightData);
-    froxelizeAssignRecordsCompress();
+    if (!mLargeLightCount) {
+        froxelizeAssignRecordsCompress<RecordBufferType, 4>();
+    } else if (mLightRecordWordCount == 4) {
+        froxelizeAssignRecordsCompress<uint16_t, 4>();
+    } else {
+        froxelizeAssignRecordsCompress<uint16_t, 16>();
+    }
 
 #ifndef NDEBUG
     if (lightData.size()) {
         // go through every froxel
-        auto const& recordBufferUser(mRecordBufferUser);
+        auto const* const records8 = mRecordBufferUser.data();
+        auto const* const records16 = reinterpret_cast<uint16_t const*>(mRecordBufferUser.data());
         auto gpuFroxelEntries(mFroxelBufferUser);
         gpuFroxelEntries.set(gpuFroxelEntries.begin(),
                 mFroxelCountX * mFroxelCountY * mFroxelCountZ);
@@ -533,10 +599,12 @@ void Froxelizer::froxelizeLights(FEngine& engine,
             // go through every light for that froxel
             for (size_t i = 0; i < entry.count(); i++) {
                 // get the light index
-                assert_invariant(entry.offset() + i < RECORD_BUFFER_ENTRY_COUNT);
+                assert_invariant(entry.offset() + i < mRecordBufferEntryCount);
 
-                size_t const lightIndex = recordBufferUser[entry.offset() + i];
-                assert_invariant(lightIndex <= CONFIG_MAX_LIGHT_INDEX);
+                size_t const lightIndex = mLargeLightCount ?
+                        records16[entry.offset() + i] : records8[entry.offset() + i];
+                assert_invariant(lightIndex <= (mLargeLightCount ?
+                        CONFIG_MAX_LIGHT_COUNT_LARGE : CONFIG_MAX_LIGHT_COUNT) - 1);
 
                 // make sure it corresponds to an existing light
                 assert_invariant(lightIndex < lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT);
@@ -554,12 +622,17 @@ void Froxelizer::froxelizeLoop(FEngine& engine,
     Slice<FroxelThreadData> froxelThreadData = mFroxelShardedData;
     memset(froxelThreadData.data(), 0, froxelThreadData.sizeInBytes());
 
+    // prepare() must have been called with the same number of lights
+    assert_invariant(lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT <=
+            mGroupCount * LIGHT_PER_GROUP);
+
     auto& lcm = engine.getLightManager();
     auto const* UTILS_RESTRICT spheres      = lightData.data<FScene::POSITION_RADIUS>();
     auto const* UTILS_RESTRICT directions   = lightData.data<FScene::DIRECTION>();
     auto const* UTILS_RESTRICT instances    = lightData.data<FScene::LIGHT_INSTANCE>();
 
-    auto process = [ this, &froxelThreadData,
+    size_t const groupCount = mGroupCount;
+    auto process = [ this, &froxelThreadData, groupCount,
                      spheres, directions, instances, &viewMatrix, &lcm ]
             (size_t count, size_t offset, size_t stride) {
 
@@ -588,8 +661,8 @@ void Froxelizer::froxelizeLoop(FEngine& engine,
                 light.invSin = std::min(maxInvSin, light.invSin);
             }
 
-            const size_t group = i % GROUP_COUNT;
-            const size_t bit   = i / GROUP_COUNT;
+            const size_t group = i % groupCount;
+            const size_t bit   = i / groupCount;
             assert_invariant(bit < LIGHT_PER_GROUP);
 
             FroxelThreadData& threadData = froxelThreadData[group];
@@ -597,15 +670,15 @@ void Froxelizer::froxelizeLoop(FEngine& engine,
         }
     };
 
-    // we do 64 lights per job
+    // we do one job per group, i.e. at most LIGHT_PER_GROUP lights per job
     JobSystem& js = engine.getJobSystem();
 
     constexpr bool SINGLE_THREADED = false;
     if (!SINGLE_THREADED) {
         auto *parent = js.createJob();
-        for (size_t i = 0; i < GROUP_COUNT; i++) {
+        for (size_t i = 0; i < groupCount; i++) {
             js.run(jobs::createJob(js, parent, std::cref(process),
-                    lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT, i, GROUP_COUNT));
+                    lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT, i, groupCount));
         }
         js.runAndWait(parent);
     } else {
@@ -615,11 +688,17 @@ void Froxelizer::froxelizeLoop(FEngine& engine,
     }
 }
 
+template<typename RecordType, size_t WORD_COUNT>
 void Froxelizer::froxelizeAssignRecordsCompress() noexcept {
 
     SYSTRACE_CALL();
 
+    using Record = LightRecord<WORD_COUNT>;
+    static_assert(sizeof(Record) == WORD_COUNT * sizeof(uint64_t));
+    assert_invariant(mLightRecordWordCount == WORD_COUNT);
+
     Slice<FroxelThreadData> const froxelThreadData = mFroxelShardedData;
+    size_t const groupCount = mGroupCount;
 
     // convert froxel data from N groups of M bits to LightRecord::bitset, so we can
     // easily compare adjacent froxels, for compaction. The conversion loops below get
@@ -627,11 +706,14 @@ void Froxelizer::froxelizeAssignRecordsCompress() noexcept {
 
     // this gets very well vectorized...
 
-    utils::Slice<LightRecord> records(mLightRecords);
+    using container_type = typename Record::bitset::container_type;
+    constexpr size_t r = sizeof(container_type) / sizeof(LightGroupType);
+    assert_invariant(groupCount % r == 0 && groupCount / r <= WORD_COUNT);
+
+    // the words past groupCount / r are left cleared
+    Record* const UTILS_RESTRICT records = reinterpret_cast<Record*>(mLightRecords.data());
     for (size_t j = 0, jc = getFroxelBufferEntryCount(); j < jc; j++) {
-        for (size_t i = 0; i < LightRecord::bitset::WORLD_COUNT; i++) {
-            using container_type = LightRecord::bitset::container_type;
-            constexpr size_t r = sizeof(container_type) / sizeof(LightGroupType);
+        for (size_t i = 0, ic = groupCount / r; i < ic; i++) {
             container_type b = froxelThreadData[i * r][j];
             for (size_t k = 0; k < r; k++) {
                 b |= (container_type(froxelThreadData[i * r + k][j]) << (LIGHT_PER_GROUP * k));
@@ -640,7 +722,7 @@ void Froxelizer::froxelizeAssignRecordsCompress() noexcept {
         }
     }
 
-    LightRecord::bitset allLights{};
+    typename Record::bitset allLights{};
     for (size_t j = 0, jc = getFroxelBufferEntryCount(); j < jc; j++) {
         allLights |= records[j].lights;
     }
@@ -649,18 +731,20 @@ void Froxelizer::froxelizeAssignRecordsCompress() noexcept {
     FroxelEntry* const UTILS_RESTRICT froxels = mFroxelBufferUser.data();
 
     const size_t froxelCountX = mFroxelCountX;
-    RecordBufferType* const UTILS_RESTRICT froxelRecords = mRecordBufferUser.data();
+    const size_t recordBufferEntryCount = mRecordBufferEntryCount;
+    RecordType* const UTILS_RESTRICT froxelRecords =
+            reinterpret_cast<RecordType*>(mRecordBufferUser.data());
 
     // initialize the first record with all lights in the scene -- this will be used only if
     // we run out of record space.
     const uint8_t allLightsCount = (uint8_t)std::min(size_t(255), allLights.count());
     offset += allLightsCount;
-    allLights.forEachSetBit([point = froxelRecords, froxelRecords](size_t l) mutable {
+    allLights.forEachSetBit([point = froxelRecords, froxelRecords, groupCount](size_t l) mutable {
         // make sure to keep this code branch-less
         const size_t word = l / LIGHT_PER_GROUP;
         const size_t bit  = l % LIGHT_PER_GROUP;
-        l = (bit * GROUP_COUNT) | (word % GROUP_COUNT);
-        *point = (RecordBufferType)l;
+        l = bit * groupCount + word;
+        *point = (RecordType)l;
         // we need to "cancel" the write operation if we have more than 255 spot or point lights
         // (this is a limitation of the data type used to store the light counts per froxel)
         point += (point - froxelRecords < 255) ? 1 : 0;
@@ -670,7 +754,7 @@ void Froxelizer::froxelizeAssignRecordsCompress() noexcept {
     UTILS_UNUSED size_t reused = 0;
 
     for (size_t i = 0, c = mFroxelCount; i < c;) {
-        LightRecord b = records[i];
+        Record b = records[i];
         if (b.lights.none()) {
             froxels[i++].u32 = 0;
             continue;
@@ -681,7 +765,7 @@ void Froxelizer::froxelizeAssignRecordsCompress() noexcept {
         FroxelEntry entry{ offset, uint8_t(std::min(size_t(255), b.lights.count())) };
         const size_t lightCount = entry.count();
 
-        if (UTILS_UNLIKELY(offset + lightCount >= RECORD_BUFFER_ENTRY_COUNT)) {
+        if (UTILS_UNLIKELY(offset + lightCount >= recordBufferEntryCount)) {
 #ifndef NDEBUG
             slog.d << "out of space: " << i << ", at " << offset << io::endl;
 #endif
@@ -698,12 +782,12 @@ void Froxelizer::froxelizeAssignRecordsCompress() noexcept {
 
         // iterate the bitfield
         auto * const beginPoint = froxelRecords + offset;
-        b.lights.forEachSetBit([point = beginPoint, beginPoint](size_t l) mutable {
+        b.lights.forEachSetBit([point = beginPoint, beginPoint, groupCount](size_t l) mutable {
             // make sure to keep this code branch-less
             const size_t word = l / LIGHT_PER_GROUP;
             const size_t bit  = l % LIGHT_PER_GROUP;
-            l = (bit * GROUP_COUNT) | (word % GROUP_COUNT);
-            *point = (RecordBufferType)l;
+            l = bit * groupCount + word;
+            *point = (RecordType)l;
             // we need to "cancel" the write operation if we have more than 255 spot or point lights
             // (this is a limitation of the data type used to store the light counts per froxel)
             point += (point - beginPoint < 255) ? 1 : 0;
@@ -732,7 +816,7 @@ void Froxelizer::froxelizeAssignRecordsCompress() noexcept {
     }
 out_of_memory:
     // FIXME: on big-endian systems we need to change the endianness of the record buffer
-    ;
+    mRecordBufferUsedCount = offset;
 }
 
 static inline float2 project(mat4f const& p, float3 const& v) noexcept {
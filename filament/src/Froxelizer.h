@@ -61,6 +61,7 @@ public:
 // {4 x float4}            {index into        RG_U16 {offset, point-count, spot-count}
 // (spot/point            light texture}
 //                     {uint4 -> 16 indices}
+//                     (8 w/ large light counts)
 //
 //  +----+                     +-+                     +----+
 // 0|....| <------------+     0| |         +-----------|0230| (e.g. offset=02, 3-lights)
@@ -76,7 +77,7 @@ public:
 //  |....|                                          h = num froxels
 //  |....|
 //  +----+
-// 256 lights max
+// 256 lights max (1024 w/ large light counts)
 //
 
 class Froxelizer {
@@ -107,11 +108,13 @@ public:
      * projection        camera projection matrix
      * projectionNear    near plane
      * projectionFar     far plane
+     * lightCount        number of point and spot lights that will be froxelized
      *
      * return true if updateUniforms() needs to be called
      */
     bool prepare(backend::DriverApi& driverApi, ArenaScope& arena, Viewport const& viewport,
-            const math::mat4f& projection, float projectionNear, float projectionFar) noexcept;
+            const math::mat4f& projection, float projectionNear, float projectionFar,
+            size_t lightCount) noexcept;
 
     Froxel getFroxelAt(size_t x, size_t y, size_t z) const noexcept;
     size_t getFroxelCountX() const noexcept { return mFroxelCountX; }
@@ -148,13 +151,18 @@ public:
     };
 
     // we can't change this easily because the shader expects 16 indices per uint4
+    // (8 indices per uint4 with large light counts, in which case each record uses 2 entries)
     using RecordBufferType = uint8_t;
 
     const utils::Slice<FroxelEntry>& getFroxelBufferUser() const { return mFroxelBufferUser; }
     const utils::Slice<RecordBufferType>& getRecordBufferUser() const { return mRecordBufferUser; }
 
+    math::float4 getFroxelBoundingSphere(size_t x, size_t y, size_t z) const noexcept {
+        return mBoundingSpheres[getFroxelIndex(x, y, z, mFroxelCountX, mFroxelCountY)];
+    }
+
     // this is chosen so froxelizePointAndSpotLight() vectorizes 4 froxel tests / spotlight
-    // with 256 lights this implies 8 jobs (256 / 32) for froxelization.
+    // with 256 lights this implies 8 jobs (256 / 32) for froxelization, 32 jobs with 1024 lights.
     using LightGroupType = uint32_t;
 
 private:
@@ -162,8 +170,16 @@ private:
         return mFroxelBufferEntryCount;
     }
 
+    // size of the record buffer in bytes
+    size_t getRecordBufferSize() const noexcept {
+        return mRecordBufferEntryCount *
+                (mLargeLightCount ? sizeof(uint16_t) : sizeof(RecordBufferType));
+    }
+
+    // WORD_COUNT is 4 for up to 256 lights, 16 for up to 1024 lights
+    template<size_t WORD_COUNT>
     struct LightRecord {
-        using bitset = utils::bitset<uint64_t, (CONFIG_MAX_LIGHT_COUNT + 63) / 64>;
+        using bitset = utils::bitset<uint64_t, WORD_COUNT>;
         bitset lights;
     };
 
@@ -198,6 +214,7 @@ private:
     void froxelizeLoop(FEngine& engine,
             math::mat4f const& viewMatrix, const FScene::LightSoa& lightData) noexcept;
 
+    template<typename RecordType, size_t WORD_COUNT>
     void froxelizeAssignRecordsCompress() noexcept;
 
     void froxelizePointAndSpotLight(FroxelThreadData& froxelThread, size_t bit,
@@ -207,12 +224,14 @@ private:
             utils::Slice<RecordBufferType> const& lightList,
             const FScene::LightSoa& lightData, size_t lightRecordsOffset) noexcept;
 
-    static void updateBoundingSpheres(
+    // scratch must hold 2 * (froxelCountX + 1) * (froxelCountY + 1) floats
+    static void updateBoundingSpheres(utils::JobSystem& js,
             math::float4* UTILS_RESTRICT boundingSpheres,
             size_t froxelCountX, size_t froxelCountY, size_t froxelCountZ,
             math::float4 const* UTILS_RESTRICT planesX,
             math::float4 const* UTILS_RESTRICT planesY,
-            float const* UTILS_RESTRICT planesZ) noexcept;
+            float const* UTILS_RESTRICT planesZ,
+            float* UTILS_RESTRICT scratch) noexcept;
 
     static size_t getFroxelIndex(size_t ix, size_t iy, size_t iz,
             size_t froxelCountX, size_t froxelCountY) noexcept {
@@ -231,8 +250,10 @@ private:
             math::uint2* dim, uint16_t* countX, uint16_t* countY, uint16_t* countZ,
             size_t froxelBufferEntryCount, Viewport const& viewport) noexcept;
 
+    utils::JobSystem& mJobSystem;
+
     // internal state dependent on the viewport and needed for froxelizing
-    LinearAllocatorArena mArena;                        // ~256 KiB
+    LinearAllocatorArena mArena;                        // ~384 KiB
 
     // 4096 froxels fits in a 16KiB buffer, the minimum guaranteed in GLES 3.x and Vulkan 1.1
     size_t mFroxelBufferEntryCount = 4096;
@@ -246,10 +267,10 @@ private:
     // allocations in the per frame arena
     utils::Slice<FroxelThreadData> mFroxelShardedData;  // 256 KiB w/  256 lights and 8192 froxels
     utils::Slice<FroxelEntry> mFroxelBufferUser;        //  32 KiB w/ 8192 froxels
-    utils::Slice<LightRecord> mLightRecords;            // 256 KiB w/  256 lights
+    utils::Slice<uint64_t> mLightRecords;               // 256 KiB w/  256 lights (LightRecord)
 
     // allocations in the command stream
-    utils::Slice<RecordBufferType> mRecordBufferUser;   //  16 KiB
+    utils::Slice<RecordBufferType> mRecordBufferUser;   //  16 KiB (64 KiB w/ large light counts)
 
     uint16_t mFroxelCountX = 0;
     uint16_t mFroxelCountY = 0;
@@ -264,6 +285,13 @@ private:
     backend::BufferObjectHandle mRecordsBuffer;
     backend::BufferObjectHandle mFroxelsBuffer;
 
+    // with large light counts, records are 16-bits indices
+    bool const mLargeLightCount;
+    uint32_t mRecordBufferEntryCount = 0;   // capacity of the record buffer, in records
+    uint32_t mRecordBufferUsedCount = 0;    // records used by the last froxelizeLights()
+    uint32_t mGroupCount = 0;               // number of FroxelThreadData, i.e. of jobs
+    uint32_t mLightRecordWordCount = 0;     // number of uint64_t per froxel in mLightRecords
+
     // needed for update()
     Viewport mViewport;
     math::float4 mParamsZ = {};
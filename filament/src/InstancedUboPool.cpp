@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "InstancedUboPool.h"
+
+#include <private/filament/UibStructs.h>
+
+#include <utils/debug.h>
+#include <utils/Systrace.h>
+
+#include <algorithm>
+
+namespace filament {
+
+using namespace utils;
+using namespace backend;
+
+// Allocations are aligned so that they can be bound with bindBufferRange(). PerRenderableData
+// is already sized for this, see UibStructs.h.
+static constexpr uint32_t ALLOCATION_ALIGNMENT = sizeof(PerRenderableData);
+
+// Buffers are at least this large, and their size is rounded to a multiple of it.
+static constexpr uint32_t BUFFER_SIZE_ROUNDING = 16384;
+
+static constexpr uint32_t align(uint32_t v, uint32_t alignment) noexcept {
+    return (v + alignment - 1) & ~(alignment - 1);
+}
+
+InstancedUboPool::InstancedUboPool() noexcept = default;
+
+InstancedUboPool::~InstancedUboPool() noexcept {
+    for (Frame const& frame : mFrames) {
+        assert_invariant(frame.buffers.empty());
+    }
+}
+
+void InstancedUboPool::terminate(DriverApi& driver) noexcept {
+    for (Frame& frame : mFrames) {
+        for (Buffer const& buffer : frame.buffers) {
+            driver.destroyBufferObject(buffer.handle);
+        }
+        frame = {};
+    }
+}
+
+InstancedUboPool::Buffer InstancedUboPool::createBuffer(
+        DriverApi& driver, uint32_t capacity) noexcept {
+    capacity = align(capacity, BUFFER_SIZE_ROUNDING);
+    return { driver.createBufferObject(capacity,
+            BufferObjectBinding::UNIFORM, BufferUsage::DYNAMIC), capacity };
+}
+
+void InstancedUboPool::advance(DriverApi& driver) noexcept {
+    mCurrentFrame = (mCurrentFrame + 1) % FRAME_COUNT;
+    Frame& frame = mFrames[mCurrentFrame];
+    if (UTILS_UNLIKELY(frame.buffers.size() > 1)) {
+        // this frame ran out of space last time, replace its buffers with one large enough
+        SYSTRACE_CALL();
+        for (Buffer const& buffer : frame.buffers) {
+            driver.destroyBufferObject(buffer.handle);
+        }
+        frame.buffers.clear();
+        frame.buffers.push_back(createBuffer(driver, frame.size + frame.padding));
+    }
+    frame.offset = 0;
+    frame.size = 0;
+    frame.padding = 0;
+}
+
+InstancedUboPool::Allocation InstancedUboPool::allocate(
+        DriverApi& driver, uint32_t size, uint32_t bindingSize) noexcept {
+    Frame& frame = mFrames[mCurrentFrame];
+    uint32_t offset = align(frame.offset, ALLOCATION_ALIGNMENT);
+    // a whole binding is bound even for the last instance of an allocation, so each buffer is
+    // padded by that much.
+    frame.padding = std::max(frame.padding, bindingSize);
+    if (UTILS_UNLIKELY(frame.buffers.empty() ||
+            offset + size + bindingSize > frame.buffers.back().capacity)) {
+        // we need a new buffer, advance() will merge it with the others of this frame. It's
+        // sized for the whole frame so far, so that we don't run out again soon.
+        frame.buffers.push_back(createBuffer(driver,
+                align(frame.size, ALLOCATION_ALIGNMENT) + size + bindingSize));
+        offset = 0;
+    }
+    frame.offset = offset + size;
+    frame.size = align(frame.size, ALLOCATION_ALIGNMENT) + size;
+    return { frame.buffers.back().handle, offset };
+}
+
+void InstancedUboPool::upload(DriverApi& driver, Allocation const& allocation,
+        void const* data, uint32_t size, bool isStagingBuffer) noexcept {
+    if (isStagingBuffer) {
+        driver.updateBufferObject(allocation.handle, {
+                data, size,
+                +[](void* buffer, size_t, void* user) {
+                    static_cast<StagingPool*>(user)->put(buffer);
+                }, &mStagingPool }, allocation.offset);
+    } else {
+        // data lives in the command stream
+        driver.updateBufferObject(allocation.handle, { data, size }, allocation.offset);
+    }
+}
+
+void* InstancedUboPool::getStagingBuffer(uint32_t size) noexcept {
+    return mStagingPool.get(size);
+}
+
+} // namespace filament
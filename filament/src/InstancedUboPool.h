@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_INSTANCEDUBOPOOL_H
+#define TNT_FILAMENT_INSTANCEDUBOPOOL_H
+
+#include "BufferPoolAllocator.h"
+
+#include <backend/Handle.h>
+#include <private/backend/DriverApi.h>
+
+#include <utils/Allocator.h>
+
+#include <array>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+/*
+ * InstancedUboPool owns the uniform buffers holding the per-renderable data of automatically
+ * instanced primitives (see RenderPass::instanceify()).
+ *
+ * Each frame gets its own buffer, which is sub-allocated linearly, so that updating it doesn't
+ * stall on the GPU still reading a previous frame. If a frame runs out of space an additional
+ * buffer is created; the next time that frame's slot comes around, its buffers are replaced by
+ * a single one large enough for all of them. In steady state no buffer is created.
+ *
+ * The heap staging buffers used for large uploads are pooled as well.
+ *
+ * All methods except the staging buffer callback must be called from the main thread.
+ */
+class InstancedUboPool {
+public:
+    // number of frames that can use the pool's buffers concurrently
+    static constexpr size_t FRAME_COUNT = 4;
+
+    struct Allocation {
+        backend::Handle<backend::HwBufferObject> handle;
+        uint32_t offset = 0;
+    };
+
+    InstancedUboPool() noexcept;
+    ~InstancedUboPool() noexcept;
+
+    InstancedUboPool(InstancedUboPool const& rhs) = delete;
+    InstancedUboPool& operator=(InstancedUboPool const& rhs) = delete;
+
+    void terminate(backend::DriverApi& driver) noexcept;
+
+    // Starts a new frame. This must be called once per frame, before any allocate().
+    void advance(backend::DriverApi& driver) noexcept;
+
+    // Returns `size` bytes of uniform buffer at an offset suitably aligned for bindBufferRange().
+    // `bindingSize` bytes can be bound anywhere within the returned range.
+    Allocation allocate(backend::DriverApi& driver, uint32_t size, uint32_t bindingSize) noexcept;
+
+    // Uploads `size` bytes at the given allocation. If `data` was obtained with
+    // getStagingBuffer() it is returned to the pool when the upload is done.
+    void upload(backend::DriverApi& driver, Allocation const& allocation,
+            void const* data, uint32_t size, bool isStagingBuffer) noexcept;
+
+    // Returns a heap buffer of at least `size` bytes, for uploads too large to be allocated
+    // in the command stream.
+    void* getStagingBuffer(uint32_t size) noexcept;
+
+private:
+    struct Buffer {
+        backend::Handle<backend::HwBufferObject> handle;
+        uint32_t capacity = 0;
+    };
+
+    struct Frame {
+        std::vector<Buffer> buffers;    // the last one is being sub-allocated
+        uint32_t offset = 0;            // offset of the next allocation in buffers.back()
+        uint32_t size = 0;              // capacity needed to hold all allocations of this frame
+        uint32_t padding = 0;           // largest binding size used this frame
+    };
+
+    Buffer createBuffer(backend::DriverApi& driver, uint32_t capacity) noexcept;
+
+    std::array<Frame, FRAME_COUNT> mFrames;
+    size_t mCurrentFrame = 0;
+
+    // released from the driver thread
+    using StagingPool = BufferPoolAllocator<FRAME_COUNT, alignof(std::max_align_t),
+            utils::HeapAllocator, utils::LockingPolicy::Mutex>;
+    StagingPool mStagingPool;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_INSTANCEDUBOPOOL_H
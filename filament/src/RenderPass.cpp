@@ -16,6 +16,7 @@
 
 #include "RenderPass.h"
 
+#include "InstancedUboPool.h"
 #include "RenderPrimitive.h"
 #include "ShadowMap.h"
 
@@ -28,8 +29,11 @@
 #include <utils/JobSystem.h>
 #include <utils/Systrace.h>
 
+#include <algorithm>
 #include <utility>
 
+#include <stdlib.h>
+
 using namespace utils;
 using namespace filament::math;
 
@@ -38,8 +42,10 @@ namespace filament {
 using namespace backend;
 
 RenderPass::RenderPass(FEngine& engine,
-        RenderPass::Arena& arena) noexcept
-        : mCommandArena(arena),
+        RenderPass::Arena& commandArena, RenderPass::Arena& primitiveInfoArena) noexcept
+        : mCommandArena(commandArena),
+          mPrimitiveInfoArena(primitiveInfoArena),
+          mPerRenderableUibSize(engine.getPerRenderableUibSize()),
           mCustomCommands(engine.getPerRenderPassAllocator()) {
 }
 
@@ -57,13 +63,37 @@ RenderPass::Command* RenderPass::append(size_t count) noexcept {
         mCommandBegin = mCommandEnd = curr;
     }
     mCommandEnd += count;
+    mCommandStorageEnd = mCommandEnd;
+    return curr;
+}
+
+RenderPass::PrimitiveInfo* RenderPass::appendPrimitiveInfos(size_t count) noexcept {
+    // same as append(), the PrimitiveInfos of a pass are contiguous so that they can be
+    // referenced by index.
+    PrimitiveInfo* const curr = mPrimitiveInfoArena.alloc<PrimitiveInfo>(count);
+    assert_invariant(curr);
+    assert_invariant(mPrimitiveInfoBegin == nullptr || curr == mPrimitiveInfoEnd);
+    if (mPrimitiveInfoBegin == nullptr) {
+        mPrimitiveInfoBegin = mPrimitiveInfoEnd = curr;
+    }
+    mPrimitiveInfoEnd += count;
     return curr;
 }
 
 void RenderPass::resize(size_t count) noexcept {
+    // Note: the PrimitiveInfos are not trimmed, because the remaining commands can reference
+    // any of them.
     if (mCommandBegin) {
         mCommandEnd = mCommandBegin + count;
+    }
+}
+
+void RenderPass::trimCommandStorage() noexcept {
+    // commands of other passes may have been allocated since ours (see reserveCommands()),
+    // in which case we can't give the memory back.
+    if (mCommandBegin && mCommandArena.getCurrent() == mCommandStorageEnd) {
         mCommandArena.rewind(mCommandEnd);
+        mCommandStorageEnd = mCommandEnd;
     }
 }
 
@@ -94,60 +124,226 @@ void RenderPass::appendCommands(FEngine& engine, CommandTypeFlags const commandT
     utils::Range<uint32_t> const vr = mVisibleRenderables;
     // trace the number of visible renderables
     SYSTRACE_VALUE32("visibleRenderables", vr.size());
+
+    if (!vr.empty()) {
+        // up-to-date summed primitive counts needed for generateCommands()
+        updateSummedPrimitiveCounts(const_cast<FScene::RenderableSoa&>(*mRenderableSoa), vr);
+    }
+
+    if (appendCachedCommands(engine, commandTypeFlags)) {
+        // the commands of the renderables that changed since they were cached
+        if (mReservedCount) {
+            generateReservedCommands(engine);
+        }
+        // the programs could have been invalidated since they were cached
+        prepareCommandPrograms(mCommandBegin, mCommandEnd);
+        return;
+    }
+
     if (UTILS_UNLIKELY(vr.empty())) {
         return;
     }
 
-    JobSystem& js = engine.getJobSystem();
-    const RenderFlags renderFlags = mFlags;
-    const Variant variant = mVariant;
-    const FScene::VisibleMaskType visibilityMask = mVisibilityMask;
+    reserveCommandStorage(commandTypeFlags, vr);
+    Command const* const curr = mReservedWriter.commands;
+    uint32_t const commandCount = mReservedCount;
+    generateReservedCommands(engine);
+
+    // Go over all the commands and call prepareProgram().
+    // This must be done from the main thread.
+    prepareCommandPrograms(curr, curr + commandCount);
+}
+
+void RenderPass::reserveCommands(FEngine& engine, CommandTypeFlags const commandTypeFlags) noexcept {
+    assert_invariant(mRenderableSoa);
+    assert_invariant(mCommandBegin == nullptr);
+
+    if (appendCachedCommands(engine, commandTypeFlags)) {
+        return;
+    }
+    if (!mVisibleRenderables.empty()) {
+        reserveCommandStorage(commandTypeFlags, mVisibleRenderables);
+    }
+}
+
+void RenderPass::generateAndSortCommands(FEngine& engine) noexcept {
+    SYSTRACE_CALL();
+    if (mReservedCount) {
+        generateReservedCommands(engine);
+    }
+    sortAndTrimCommands(engine.getJobSystem());
+}
+
+void RenderPass::finalizeCommands(FEngine& engine) noexcept {
+    SYSTRACE_CALL();
+    prepareCommandPrograms(mCommandBegin, mCommandEnd);
+    if (engine.isAutomaticInstancingEnabled() && !(mFlags & DISABLE_AUTOMATIC_INSTANCING)) {
+        instanceify(engine);
+    }
+    trimCommandStorage();
+}
+
+bool RenderPass::appendCachedCommands(FEngine& engine, CommandTypeFlags const commandTypeFlags) {
+    // the cache can only be used for the first commands of the pass, and if we only generate
+    // commands once.
+    if (mCommandCache && mCommandBegin == nullptr) {
+        utils::Range<uint32_t> const vr = mVisibleRenderables;
+        CommandCache::Key const key{
+                .soa = mRenderableSoa,
+                .sceneRevision = mSceneRevision,
+                .materialInstanceStateVersion = engine.getMaterialInstanceStateVersion(),
+                .first = vr.first,
+                .last = vr.last,
+                .cameraPosition = mCameraPosition,
+                .cameraForward = mCameraForwardVector,
+                .visibilityMask = mVisibilityMask,
+                .commandTypeFlags = commandTypeFlags,
+                .renderFlags = mFlags,
+                .variant = mVariant };
+
+        FScene::VisibleMaskType const* const visibleMasks = getVisibleMasks();
+        Range<uint32_t> const outdated = mCommandCache->getOutdatedRange(key,
+                *mRenderableSoa, visibleMasks, mRenderableRevisions);
+
+        if (outdated.first == vr.first && outdated.last == vr.last) {
+            mCommandCache->reset(key, *mRenderableSoa, visibleMasks);
+            mCacheState = CacheState::MISS;
+            return false;
+        }
+
+        // use the cached commands of the renderables which didn't change, they stay sorted.
+        auto const& cachedCommands = mCommandCache->mCommands;
+        auto const& cachedInfos = mCommandCache->mPrimitiveInfos;
+        auto isOutdated = [outdated](PrimitiveInfo const& info) {
+            return info.index >= outdated.first && info.index < outdated.last;
+        };
+        size_t const count = outdated.empty() ? cachedCommands.size() :
+                std::count_if(cachedInfos.begin(), cachedInfos.end(),
+                        [&isOutdated](PrimitiveInfo const& info) { return !isOutdated(info); });
+        if (count) {
+            Command* curr = append(count);
+            PrimitiveInfo* const infos = appendPrimitiveInfos(count);
+            assert_invariant(infos == mPrimitiveInfoBegin);
+
+            // the instance count of InstanceBuffers can change every frame when their
+            // instances are culled, see FScene::updateUBOs().
+            auto const* const soaInstanceInfo = mRenderableSoa->data<FScene::INSTANCES>();
+            uint32_t const eyeCount = (mFlags & IS_STEREOSCOPIC) ?
+                    engine.getConfig().stereoscopicEyeCount : 1;
+            for (Command const& command : cachedCommands) {
+                PrimitiveInfo const& info = cachedInfos[command.infoIndex];
+                if (isOutdated(info)) {
+                    continue;
+                }
+                uint32_t const index = uint32_t(curr - mCommandBegin);
+                *curr++ = { .key = command.key, .infoIndex = index };
+                infos[index] = info;
+                if (UTILS_UNLIKELY(info.instanceBufferHandle)) {
+                    infos[index].instanceCount =
+                            (soaInstanceInfo[info.index].count * eyeCount) |
+                            PrimitiveInfo::USER_INSTANCE_MASK;
+                }
+            }
+        }
+        mCachedCommandCount = uint32_t(count);
+
+        if (outdated.empty()) {
+            // the cache stays valid for this revision
+            mCommandCache->mKey = key;
+            mCommandCache->mHitCount++;
+            mCacheState = CacheState::HIT;
+            return true;
+        }
 
-    // up-to-date summed primitive counts needed for generateCommands()
+        // the commands of the outdated renderables are generated, then merged with the cached
+        // ones by sortCommands(), which also updates the cache.
+        mCommandCache->reset(key, *mRenderableSoa, visibleMasks);
+        mCommandCache->mPatchCount++;
+        reserveCommandStorage(commandTypeFlags, outdated);
+        mCacheState = CacheState::PATCH;
+        return true;
+    } else if (mCacheState == CacheState::MISS) {
+        // we're generating commands more than once, we can't cache them.
+        mCacheState = CacheState::NONE;
+    } else if (mCacheState == CacheState::PATCH) {
+        // same as above, but the beginning of the pass is still sorted
+        mCacheState = CacheState::HIT;
+    }
+    return false;
+}
+
+void RenderPass::reserveCommandStorage(CommandTypeFlags const commandTypeFlags,
+        Range<uint32_t> const vr) noexcept {
     FScene::RenderableSoa const& soa = *mRenderableSoa;
-    updateSummedPrimitiveCounts(const_cast<FScene::RenderableSoa&>(soa), vr);
 
     // compute how much maximum storage we need for this pass
-    uint32_t commandCount = FScene::getPrimitiveCount(soa, vr.last);
+    uint32_t commandCount = FScene::getPrimitiveCount(soa, vr.first, vr.last);
     // double the color pass for transparent objects that need to render twice
     const bool colorPass  = bool(commandTypeFlags & CommandTypeFlags::COLOR);
     const bool depthPass  = bool(commandTypeFlags & CommandTypeFlags::DEPTH);
     commandCount *= uint32_t(colorPass * 2 + depthPass);
     commandCount += 1; // for the sentinel
     Command* const curr = append(commandCount);
+    PrimitiveInfo* const infos = appendPrimitiveInfos(commandCount);
+
+    mReservedWriter = { curr, infos, uint32_t(infos - mPrimitiveInfoBegin), vr.first };
+    mReservedRange = vr;
+    mReservedCount = commandCount;
+    mReservedCommandTypeFlags = commandTypeFlags;
+}
+
+void RenderPass::generateReservedCommands(FEngine& engine) noexcept {
+    utils::Range<uint32_t> const vr = mReservedRange;
+    JobSystem& js = engine.getJobSystem();
+    const CommandTypeFlags commandTypeFlags = mReservedCommandTypeFlags;
+    const CommandWriter writer = mReservedWriter;
+    const uint32_t commandCount = std::exchange(mReservedCount, 0);
+    const RenderFlags renderFlags = mFlags;
+    const Variant variant = mVariant;
+    const FScene::VisibleMaskType visibilityMask = mVisibilityMask;
+    FScene::VisibleMaskType const* const visibleMasks = getVisibleMasks();
+    FScene::RenderableSoa const& soa = *mRenderableSoa;
 
     auto stereoscopicEyeCount =
             renderFlags & IS_STEREOSCOPIC ? engine.getConfig().stereoscopicEyeCount : 1;
 
+    // without a forward vector, all commands are at the same distance from the camera
+    const bool depthSorting = !(renderFlags & DISABLE_DEPTH_SORTING);
     const float3 cameraPosition(mCameraPosition);
-    const float3 cameraForwardVector(mCameraForwardVector);
-    auto work = [commandTypeFlags, curr, &soa, variant, renderFlags, visibilityMask, cameraPosition,
-                 cameraForwardVector, stereoscopicEyeCount]
+    const float3 cameraForwardVector(depthSorting ? mCameraForwardVector : float3{});
+    auto work = [commandTypeFlags, writer, &soa, variant, renderFlags, visibleMasks,
+                 visibilityMask, cameraPosition, cameraForwardVector, stereoscopicEyeCount]
             (uint32_t startIndex, uint32_t indexCount) {
-        RenderPass::generateCommands(commandTypeFlags, curr,
-                soa, { startIndex, startIndex + indexCount }, variant, renderFlags, visibilityMask,
-                cameraPosition, cameraForwardVector, stereoscopicEyeCount);
+        RenderPass::generateCommands(commandTypeFlags, writer,
+                soa, { startIndex, startIndex + indexCount }, variant, renderFlags,
+                visibleMasks, visibilityMask, cameraPosition, cameraForwardVector,
+                stereoscopicEyeCount);
     };
 
-    if (vr.size() <= JOBS_PARALLEL_FOR_COMMANDS_COUNT) {
-        work(vr.first, vr.size());
+    // small passes are generated inline, it's not worth creating a job.
+    auto functor = std::cref(work);
+    jobs::AdaptiveSplitter const splitter(js);
+    if (!splitter.split<decltype(functor)>(0, vr.size())) {
+        splitter.execute(functor, vr.first, vr.size());
     } else {
         auto* jobCommandsParallel = jobs::parallel_for(js, nullptr, vr.first, (uint32_t)vr.size(),
-                std::cref(work), jobs::CountSplitter<JOBS_PARALLEL_FOR_COMMANDS_COUNT, 5>());
+                functor, splitter);
         js.runAndWait(jobCommandsParallel);
     }
 
     // always add an "eof" command
     // "eof" command. these commands are guaranteed to be sorted last in the
     // command buffer.
-    curr[commandCount - 1].key = uint64_t(Pass::SENTINEL);
+    writer.commands[commandCount - 1].key = uint64_t(Pass::SENTINEL);
+}
 
-    // Go over all the commands and call prepareProgram().
-    // This must be done from the main thread.
-    for (Command const* first = curr, *last = curr + commandCount ; first != last ; ++first) {
+void RenderPass::prepareCommandPrograms(Command const* first, Command const* last) const noexcept {
+    PrimitiveInfo const* const infos = mPrimitiveInfoBegin;
+    for (; first != last ; ++first) {
         if (UTILS_LIKELY((first->key & CUSTOM_MASK) == uint64_t(CustomCommand::PASS))) {
-            auto ma = first->primitive.mi->getMaterial();
-            ma->prepareProgram(first->primitive.materialVariant);
+            PrimitiveInfo const& info = infos[first->infoIndex];
+            auto ma = info.mi->getMaterial();
+            ma->prepareProgram(info.materialVariant);
         }
     }
 }
@@ -168,26 +364,188 @@ void RenderPass::appendCustomCommand(uint8_t channel, Pass pass, CustomCommand c
     cmd |= uint64_t(order) << CUSTOM_ORDER_SHIFT;
     cmd |= uint64_t(index);
 
+    // custom commands don't have a PrimitiveInfo
     Command* const curr = append(1);
     curr->key = cmd;
+    curr->infoIndex = 0;
 }
 
 void RenderPass::sortCommands(FEngine& engine) noexcept {
+    sortAndTrimCommands(engine.getJobSystem());
+    if (engine.isAutomaticInstancingEnabled() && !(mFlags & DISABLE_AUTOMATIC_INSTANCING)) {
+        instanceify(engine);
+    }
+    trimCommandStorage();
+}
+
+void RenderPass::sortAndTrimCommands(JobSystem& js) noexcept {
     SYSTRACE_NAME("sort and trim commands");
 
-    std::sort(mCommandBegin, mCommandEnd);
+    CommandCache* const cache = std::exchange(mCommandCache, nullptr);
+    CacheState const cacheState = std::exchange(mCacheState, CacheState::NONE);
+
+    size_t const count = mCommandEnd - mCommandBegin;
+    if (cacheState == CacheState::HIT || cacheState == CacheState::PATCH) {
+        // the cached commands are already sorted and trimmed, we only need to sort the commands
+        // appended since (e.g. patched or custom commands) and merge them in.
+        Command* const middle = mCommandBegin + mCachedCommandCount;
+        if (middle != mCommandEnd) {
+            std::sort(middle, mCommandEnd);
+            std::inplace_merge(mCommandBegin, middle, mCommandEnd);
+            Command const* const last = std::partition_point(mCommandBegin, mCommandEnd,
+                    [](Command const& c) {
+                        return c.key != uint64_t(Pass::SENTINEL);
+                    });
+            resize(uint32_t(last - mCommandBegin));
+        }
+    } else if (count < RADIX_SORT_MIN_COMMANDS_COUNT) {
+        std::sort(mCommandBegin, mCommandEnd);
+
+        // find the last command
+        Command const* const last = std::partition_point(mCommandBegin, mCommandEnd,
+                [](Command const& c) {
+                    return c.key != uint64_t(Pass::SENTINEL);
+                });
+
+        resize(uint32_t(last - mCommandBegin));
+    } else {
+        resize(radixSortCommands(js, mCommandBegin, count));
+    }
+
+    if (cacheState == CacheState::MISS || cacheState == CacheState::PATCH) {
+        // remember the commands before they're instanced, because instancing depends on data
+        // that can change every frame.
+        cache->store(mCommandBegin, mCommandEnd, mPrimitiveInfoBegin);
+    }
+}
+
+size_t RenderPass::radixSortCommands(JobSystem& js,
+        Command* const commands, size_t const count) noexcept {
+    SYSTRACE_CALL();
+
+    /*
+     * This is an LSD radix sort, 8 bits at a time. Passes over bytes which are the same for all
+     * commands (e.g. channel and pass bits) are skipped.
+     */
+
+    constexpr size_t RADIX_BITS = 8;
+    constexpr size_t RADIX_SIZE = 1u << RADIX_BITS;
+    constexpr size_t DIGIT_COUNT = sizeof(CommandKey) * 8 / RADIX_BITS;
+    using Histogram = uint32_t[RADIX_SIZE];
+
+    auto digit = [](CommandKey key, size_t d) -> uint32_t {
+        return uint32_t(key >> (d * RADIX_BITS)) & (RADIX_SIZE - 1);
+    };
+
+    // split the work into equal chunks, each processed by a job
+    size_t const jobCount = std::max<size_t>(1, std::min({
+            count / JOBS_PARALLEL_SORT_COMMANDS_COUNT,
+            js.getThreadCount() + 1, JOBS_PARALLEL_SORT_MAX_JOBS_COUNT }));
+    size_t const chunkSize = (count + jobCount - 1) / jobCount;
+
+    // scratch memory: a set of commands to ping-pong with, and a set of histograms per chunk
+    void* const scratch = ::malloc(
+            sizeof(Command) * count + sizeof(Histogram) * DIGIT_COUNT * jobCount);
+    if (UTILS_UNLIKELY(!scratch)) {
+        // std::stable_sort() is still stable, and works in place when it can't allocate memory
+        std::stable_sort(commands, commands + count);
+        return std::partition_point(commands, commands + count,
+                [](Command const& c) {
+                    return c.key != uint64_t(Pass::SENTINEL);
+                }) - commands;
+    }
+    Command* src = commands;
+    Command* dst = static_cast<Command*>(scratch);
+    auto* const histograms = reinterpret_cast<Histogram*>(dst + count);
+
+    // runs work(first, last, chunk) for each chunk, in parallel if we have several chunks
+    auto forEachChunk = [&js, jobCount, chunkSize, count](auto const& work) {
+        auto job = [&work, chunkSize, count](uint32_t start, uint32_t c) {
+            for (size_t chunk = start; chunk < start + c; chunk++) {
+                work(chunk * chunkSize, std::min(count, (chunk + 1) * chunkSize), chunk);
+            }
+        };
+        if (jobCount == 1) {
+            job(0, 1);
+        } else {
+            auto* parallelJob = jobs::parallel_for(js, nullptr, 0, uint32_t(jobCount),
+                    std::cref(job), jobs::CountSplitter<1, 5>());
+            js.runAndWait(parallelJob);
+        }
+    };
+
+    // compute the histograms of all the digits
+    forEachChunk([commands, histograms, &digit](size_t first, size_t last, size_t chunk) {
+        Histogram* const h = histograms + chunk * DIGIT_COUNT;
+        std::fill_n(&h[0][0], DIGIT_COUNT * RADIX_SIZE, 0u);
+        for (size_t i = first; i < last; i++) {
+            CommandKey const key = commands[i].key;
+            for (size_t d = 0; d < DIGIT_COUNT; d++) {
+                h[d][digit(key, d)]++;
+            }
+        }
+    });
+
+    bool moved = false;
+    for (size_t d = 0; d < DIGIT_COUNT; d++) {
+        // skip digits that are the same in all the commands
+        uint32_t const v = digit(src[0].key, d);
+        uint32_t total = 0;
+        for (size_t chunk = 0; chunk < jobCount; chunk++) {
+            total += histograms[chunk * DIGIT_COUNT + d][v];
+        }
+        if (total == count) {
+            continue;
+        }
+
+        // once commands have moved between chunks, the histograms need to be recomputed
+        if (moved) {
+            forEachChunk([src, histograms, &digit, d](size_t first, size_t last, size_t chunk) {
+                uint32_t* const h = histograms[chunk * DIGIT_COUNT + d];
+                std::fill_n(h, RADIX_SIZE, 0u);
+                for (size_t i = first; i < last; i++) {
+                    h[digit(src[i].key, d)]++;
+                }
+            });
+        }
+
+        // turn the histograms into offsets, such that chunks scatter in order (the sort is stable)
+        uint32_t offset = 0;
+        for (size_t r = 0; r < RADIX_SIZE; r++) {
+            for (size_t chunk = 0; chunk < jobCount; chunk++) {
+                uint32_t& h = histograms[chunk * DIGIT_COUNT + d][r];
+                uint32_t const c = h;
+                h = offset;
+                offset += c;
+            }
+        }
+
+        forEachChunk([src, dst, histograms, &digit, d](size_t first, size_t last, size_t chunk) {
+            uint32_t* const UTILS_RESTRICT offsets = histograms[chunk * DIGIT_COUNT + d];
+            for (size_t i = first; i < last; i++) {
+                Command const& c = src[i];
+                dst[offsets[digit(c.key, d)]++] = c;
+            }
+        });
+
+        std::swap(src, dst);
+        moved = true;
+    }
 
     // find the last command
-    Command const* const last = std::partition_point(mCommandBegin, mCommandEnd,
+    Command const* const last = std::partition_point(src, src + count,
             [](Command const& c) {
                 return c.key != uint64_t(Pass::SENTINEL);
             });
+    size_t const commandCount = last - src;
 
-    resize(uint32_t(last - mCommandBegin));
-
-    if (engine.isAutomaticInstancingEnabled()) {
-        instanceify(engine);
+    // the sorted commands may have ended-up in the scratch buffer
+    if (src != commands) {
+        std::copy_n(src, commandCount, commands);
     }
+
+    ::free(scratch);
+    return commandCount;
 }
 
 void RenderPass::execute(FEngine& engine, const char* name,
@@ -206,6 +564,9 @@ void RenderPass::execute(FEngine& engine, const char* name,
     driver.endRenderPass();
 }
 
+// Staging buffers for auto-instancing up to this size are allocated in the command stream
+static constexpr size_t INSTANCED_UBO_INLINE_STAGING_MAX_SIZE = 64 * 1024;
+
 void RenderPass::instanceify(FEngine& engine) noexcept {
     SYSTRACE_NAME("instanceify");
 
@@ -221,47 +582,53 @@ void RenderPass::instanceify(FEngine& engine) noexcept {
 
     Command* curr = mCommandBegin;
     Command* const last = mCommandEnd;
+    PrimitiveInfo* const UTILS_RESTRICT infos = mPrimitiveInfoBegin;
 
     Command* firstSentinel = nullptr;
     PerRenderableData const* uboData = nullptr;
     PerRenderableData* stagingBuffer = nullptr;
     uint32_t stagingBufferSize = 0;
+    bool isHeapStagingBuffer = false;
     uint32_t instancedPrimitiveOffset = 0;
 
-    // TODO: for the case of instancing we could actually use 128 instead of 64 instances
-    constexpr size_t maxInstanceCount = CONFIG_MAX_INSTANCES;
+    // 64 instances, or 256 with Engine::Config::largeInstanceBatches
+    size_t const maxInstanceCount = engine.getMaxAutomaticInstances();
 
     while (curr != last) {
 
         // we can't have nice things! No more than maxInstanceCount due to UBO size limits
         Command const* const e = std::find_if_not(curr, std::min(last, curr + maxInstanceCount),
-                [lhs = *curr](Command const& rhs) {
-            // primitives must be identical to be instanced. Currently, instancing doesn't support
-            // skinning/morphing.
-            return  lhs.primitive.mi                == rhs.primitive.mi                 &&
-                    lhs.primitive.primitiveHandle   == rhs.primitive.primitiveHandle    &&
-                    lhs.primitive.rasterState       == rhs.primitive.rasterState        &&
-                    lhs.primitive.skinningHandle    == rhs.primitive.skinningHandle     &&
-                    lhs.primitive.skinningOffset    == rhs.primitive.skinningOffset     &&
-                    lhs.primitive.morphWeightBuffer == rhs.primitive.morphWeightBuffer  &&
-                    lhs.primitive.morphTargetBuffer == rhs.primitive.morphTargetBuffer  &&
-                    lhs.primitive.skinningTexture   == rhs.primitive.skinningTexture    ;
+                [&lhs = infos[curr->infoIndex], infos](Command const& command) {
+            PrimitiveInfo const& rhs = infos[command.infoIndex];
+            // primitives must be identical to be instanced, including their skinning and
+            // morphing bindings: the per-instance data has no bone offset.
+            return  lhs.mi                == rhs.mi                 &&
+                    lhs.primitiveHandle   == rhs.primitiveHandle    &&
+                    lhs.rasterState       == rhs.rasterState        &&
+                    lhs.skinningHandle    == rhs.skinningHandle     &&
+                    lhs.skinningOffset    == rhs.skinningOffset     &&
+                    lhs.morphWeightBuffer == rhs.morphWeightBuffer  &&
+                    lhs.morphTargetBuffer == rhs.morphTargetBuffer  &&
+                    lhs.skinningTexture   == rhs.skinningTexture    ;
         });
 
         uint32_t const instanceCount = e - curr;
         assert_invariant(instanceCount > 0);
-        assert_invariant(instanceCount <= CONFIG_MAX_INSTANCES);
+        assert_invariant(instanceCount <= maxInstanceCount);
 
         if (UTILS_UNLIKELY(instanceCount > 1)) {
             drawCallsSavedCount += instanceCount - 1;
 
             // allocate our staging buffer only if needed
             if (UTILS_UNLIKELY(!stagingBuffer)) {
-                // TODO: use stream inline buffer for small sizes
-                // TODO: use a pool for larger heap buffers
-                // buffer large enough for all instances data
+                // buffer large enough for all instances data, small ones are allocated inline
+                // in the command stream, larger ones come from the engine's pool.
                 stagingBufferSize = sizeof(PerRenderableData) * (last - curr);
-                stagingBuffer = (PerRenderableData*)::malloc(stagingBufferSize);
+                isHeapStagingBuffer = stagingBufferSize > INSTANCED_UBO_INLINE_STAGING_MAX_SIZE;
+                stagingBuffer = isHeapStagingBuffer ?
+                        (PerRenderableData*)engine.getInstancedUboPool().getStagingBuffer(
+                                stagingBufferSize) :
+                        engine.getDriverApi().allocatePod<PerRenderableData>(last - curr);
                 uboData = mRenderableSoa->data<FScene::UBO>();
             }
 
@@ -269,12 +636,12 @@ void RenderPass::instanceify(FEngine& engine) noexcept {
             assert_invariant(instancedPrimitiveOffset + instanceCount
                              <= stagingBufferSize / sizeof(PerRenderableData));
             for (uint32_t i = 0; i < instanceCount; i++) {
-                stagingBuffer[instancedPrimitiveOffset + i] = uboData[curr[i].primitive.index];
+                stagingBuffer[instancedPrimitiveOffset + i] = uboData[infos[curr[i].infoIndex].index];
             }
 
             // make the first command instanced
-            curr[0].primitive.instanceCount = instanceCount;
-            curr[0].primitive.index = instancedPrimitiveOffset;
+            infos[curr[0].infoIndex].instanceCount = instanceCount;
+            infos[curr[0].infoIndex].index = instancedPrimitiveOffset;
             instancedPrimitiveOffset += instanceCount;
 
             // cancel commands that are now instances
@@ -293,20 +660,17 @@ void RenderPass::instanceify(FEngine& engine) noexcept {
 
         // we have instanced primitives
         DriverApi& driver = engine.getDriverApi();
+        InstancedUboPool& pool = engine.getInstancedUboPool();
 
-        // TODO: maybe use a pool? so we can reuse the buffer.
-        // create a ubo to hold the instanced primitive data
-        mInstancedUboHandle = driver.createBufferObject(
-                sizeof(PerRenderableData) * instancedPrimitiveOffset + sizeof(PerRenderableUib),
-                BufferObjectBinding::UNIFORM, backend::BufferUsage::STATIC);
+        // get room for the instanced primitive data in this frame's ubo
+        uint32_t const size = sizeof(PerRenderableData) * instancedPrimitiveOffset;
+        InstancedUboPool::Allocation const allocation =
+                pool.allocate(driver, size, engine.getPerRenderableUibSize());
+        mInstancedUboHandle = allocation.handle;
+        mInstancedUboOffset = allocation.offset;
 
         // copy our instanced ubo data
-        driver.updateBufferObjectUnsynchronized(mInstancedUboHandle, {
-                stagingBuffer, sizeof(PerRenderableData) * instancedPrimitiveOffset,
-                +[](void* buffer, size_t, void*) {
-                    ::free(buffer);
-                }
-        }, 0);
+        pool.upload(driver, allocation, stagingBuffer, size, isHeapStagingBuffer);
 
         stagingBuffer = nullptr;
 
@@ -325,7 +689,7 @@ void RenderPass::instanceify(FEngine& engine) noexcept {
 /* static */
 UTILS_ALWAYS_INLINE // this function exists only to make the code more readable. we want it inlined.
 inline              // and we don't need it in the compilation unit
-void RenderPass::setupColorCommand(Command& cmdDraw, Variant variant,
+void RenderPass::setupColorCommand(DrawCommand& cmdDraw, Variant variant,
         FMaterialInstance const* const UTILS_RESTRICT mi, bool inverseFrontFaces) noexcept {
 
     FMaterial const * const UTILS_RESTRICT ma = mi->getMaterial();
@@ -374,11 +738,11 @@ void RenderPass::setupColorCommand(Command& cmdDraw, Variant variant,
 
 /* static */
 UTILS_NOINLINE
-void RenderPass::generateCommands(uint32_t commandTypeFlags, Command* const commands,
+void RenderPass::generateCommands(uint32_t commandTypeFlags, CommandWriter const writer,
         FScene::RenderableSoa const& soa, Range<uint32_t> range,
         Variant variant, RenderFlags renderFlags,
-        FScene::VisibleMaskType visibilityMask, float3 cameraPosition, float3 cameraForward,
-        uint8_t instancedStereoEyeCount) noexcept {
+        FScene::VisibleMaskType const* visibleMasks, FScene::VisibleMaskType visibilityMask,
+        float3 cameraPosition, float3 cameraForward, uint8_t instancedStereoEyeCount) noexcept {
 
     SYSTRACE_CALL();
 
@@ -392,10 +756,12 @@ void RenderPass::generateCommands(uint32_t commandTypeFlags, Command* const comm
     const bool colorPass  = bool(commandTypeFlags & CommandTypeFlags::COLOR);
     const bool depthPass  = bool(commandTypeFlags & CommandTypeFlags::DEPTH);
     const size_t commandsPerPrimitive = uint32_t(colorPass * 2 + depthPass);
-    const size_t offsetBegin = FScene::getPrimitiveCount(soa, range.first) * commandsPerPrimitive;
-    const size_t offsetEnd   = FScene::getPrimitiveCount(soa, range.last) * commandsPerPrimitive;
-    Command* curr = commands + offsetBegin;
-    Command* const last = commands + offsetEnd;
+    const size_t offsetBegin =
+            FScene::getPrimitiveCount(soa, writer.first, range.first) * commandsPerPrimitive;
+    const size_t offsetEnd =
+            FScene::getPrimitiveCount(soa, writer.first, range.last) * commandsPerPrimitive;
+    Command* curr = writer.commands + offsetBegin;
+    Command* const last = writer.commands + offsetEnd;
 
     /*
      * The switch {} below is to coerce the compiler into generating different versions of
@@ -408,14 +774,14 @@ void RenderPass::generateCommands(uint32_t commandTypeFlags, Command* const comm
 
     switch (commandTypeFlags & (CommandTypeFlags::COLOR | CommandTypeFlags::DEPTH)) {
         case CommandTypeFlags::COLOR:
-            curr = generateCommandsImpl<CommandTypeFlags::COLOR>(commandTypeFlags, curr,
-                    soa, range, variant, renderFlags, visibilityMask, cameraPosition, cameraForward,
-                    instancedStereoEyeCount);
+            curr = generateCommandsImpl<CommandTypeFlags::COLOR>(commandTypeFlags, writer, curr,
+                    soa, range, variant, renderFlags, visibleMasks, visibilityMask,
+                    cameraPosition, cameraForward, instancedStereoEyeCount);
             break;
         case CommandTypeFlags::DEPTH:
-            curr = generateCommandsImpl<CommandTypeFlags::DEPTH>(commandTypeFlags, curr,
-                    soa, range, variant, renderFlags, visibilityMask, cameraPosition, cameraForward,
-                    instancedStereoEyeCount);
+            curr = generateCommandsImpl<CommandTypeFlags::DEPTH>(commandTypeFlags, writer, curr,
+                    soa, range, variant, renderFlags, visibleMasks, visibilityMask,
+                    cameraPosition, cameraForward, instancedStereoEyeCount);
             break;
         default:
             // we should never end-up here
@@ -435,9 +801,11 @@ void RenderPass::generateCommands(uint32_t commandTypeFlags, Command* const comm
 template<uint32_t commandTypeFlags>
 UTILS_NOINLINE
 RenderPass::Command* RenderPass::generateCommandsImpl(uint32_t extraFlags,
-        Command* UTILS_RESTRICT curr,
+        CommandWriter const writer, Command* UTILS_RESTRICT curr,
         FScene::RenderableSoa const& UTILS_RESTRICT soa, Range<uint32_t> range,
-        Variant const variant, RenderFlags renderFlags, FScene::VisibleMaskType visibilityMask,
+        Variant const variant, RenderFlags renderFlags,
+        FScene::VisibleMaskType const* UTILS_RESTRICT visibleMasks,
+        FScene::VisibleMaskType visibilityMask,
         float3 cameraPosition, float3 cameraForward, uint8_t instancedStereoEyeCount) noexcept {
 
     // generateCommands() writes both the draw and depth commands simultaneously such that
@@ -459,16 +827,23 @@ RenderPass::Command* RenderPass::generateCommandsImpl(uint32_t extraFlags,
     auto const* const UTILS_RESTRICT soaPrimitives          = soa.data<FScene::PRIMITIVES>();
     auto const* const UTILS_RESTRICT soaSkinning            = soa.data<FScene::SKINNING_BUFFER>();
     auto const* const UTILS_RESTRICT soaMorphing            = soa.data<FScene::MORPHING_BUFFER>();
-    auto const* const UTILS_RESTRICT soaVisibilityMask      = soa.data<FScene::VISIBLE_MASK>();
     auto const* const UTILS_RESTRICT soaInstanceInfo        = soa.data<FScene::INSTANCES>();
 
     const bool hasShadowing = renderFlags & HAS_SHADOWING;
     const bool viewInverseFrontFaces = renderFlags & HAS_INVERSE_FRONT_FACES;
     const bool hasInstancedStereo = renderFlags & IS_STEREOSCOPIC;
 
-    Command cmdColor;
+    // writes a command and its PrimitiveInfo
+    auto emit = [writer](Command* UTILS_RESTRICT curr, DrawCommand const& cmd, CommandKey key) {
+        size_t const i = curr - writer.commands;
+        curr->key = key;
+        curr->infoIndex = writer.firstIndex + uint32_t(i);
+        writer.infos[i] = cmd.primitive;
+    };
+
+    DrawCommand cmdColor;
 
-    Command cmdDepth;
+    DrawCommand cmdDepth;
     if constexpr (isDepthPass) {
         cmdDepth.primitive.materialVariant = variant;
         cmdDepth.primitive.rasterState = {};
@@ -482,7 +857,7 @@ RenderPass::Command* RenderPass::generateCommandsImpl(uint32_t extraFlags,
 
     for (uint32_t i = range.first; i < range.last; ++i) {
         // Check if this renderable passes the visibilityMask.
-        if (UTILS_UNLIKELY(!(soaVisibilityMask[i] & visibilityMask))) {
+        if (UTILS_UNLIKELY(!(visibleMasks[i] & visibilityMask))) {
             continue;
         }
 
@@ -648,8 +1023,7 @@ RenderPass::Command* RenderPass::generateCommandsImpl(uint32_t extraFlags,
                     // cancel command if both front and back faces are culled
                     key |= select(mi->getCullingMode() == CullingMode::FRONT_AND_BACK);
 
-                    *curr = cmdColor;
-                    curr->key = key;
+                    emit(curr, cmdColor, key);
                     ++curr;
 
                     // TWO_PASSES_TWO_SIDES: this command will be issued first, draw back sides (i.e. cull front)
@@ -673,10 +1047,9 @@ RenderPass::Command* RenderPass::generateCommandsImpl(uint32_t extraFlags,
                     cmdColor.key |= makeField(distanceBits >> 22u, Z_BUCKET_MASK, Z_BUCKET_SHIFT);
                 }
 
-                *curr = cmdColor;
-
                 // cancel command if both front and back faces are culled
-                curr->key |= select(mi->getCullingMode() == CullingMode::FRONT_AND_BACK);
+                emit(curr, cmdColor,
+                        cmdColor.key | select(mi->getCullingMode() == CullingMode::FRONT_AND_BACK));
 
                 ++curr;
             }
@@ -709,10 +1082,9 @@ RenderPass::Command* RenderPass::generateCommandsImpl(uint32_t extraFlags,
                         & !(depthFilterAlphaMaskedObjects & rs.alphaToCoverage))
                             | writeDepthForShadowCasters;
 
-                *curr = cmdDepth;
-
                 // cancel command if both front and back faces are culled
-                curr->key |= select(mi->getCullingMode() == CullingMode::FRONT_AND_BACK);
+                emit(curr, cmdDepth,
+                        cmdDepth.key | select(mi->getCullingMode() == CullingMode::FRONT_AND_BACK));
 
                 ++curr;
             }
@@ -754,9 +1126,73 @@ void RenderPass::Executor::overrideScissor(backend::Viewport const& scissor) noe
 }
 
 void RenderPass::Executor::execute(FEngine& engine, const char*) const noexcept {
+    size_t const threshold = engine.getConfig().parallelCommandRecordingThreshold;
+    if (UTILS_UNLIKELY(threshold && mCommands.size() >= threshold && mCustomCommands.empty() &&
+            DriverApi::hasSegments())) {
+        executeParallel(engine);
+        return;
+    }
     execute(engine.getDriverApi(), mCommands.begin(), mCommands.end());
 }
 
+// Upper bound of the command stream space used by execute() for a single Command: rebinding the
+// material instance, the per-renderable, skinning and morphing bindings, and the draw call.
+static constexpr size_t MAX_COMMAND_STREAM_SIZE_PER_COMMAND =
+        CommandBase::align(sizeof(COMMAND_TYPE(bindUniformBuffer))) * 2 +
+        CommandBase::align(sizeof(COMMAND_TYPE(bindBufferRange))) * 2 +
+        CommandBase::align(sizeof(COMMAND_TYPE(bindSamplers))) * 5 +
+        CommandBase::align(sizeof(COMMAND_TYPE(draw)));
+
+UTILS_NOINLINE
+void RenderPass::Executor::executeParallel(FEngine& engine) const noexcept {
+    SYSTRACE_CALL();
+
+    // Each job records a range of commands in its own CommandStream segment, the segments are
+    // then inserted in order in the engine's CommandStream. Custom commands can't be executed
+    // this way, since they may use the engine's CommandStream directly.
+    assert_invariant(mCustomCommands.empty());
+
+    DriverApi& driver = engine.getDriverApi();
+    JobSystem& js = engine.getJobSystem();
+
+    constexpr size_t MAX_SEGMENT_COUNT = 16;
+    size_t const commandCount = mCommands.size();
+    size_t const segmentCount = std::min(MAX_SEGMENT_COUNT, js.getThreadCount() + 1);
+    size_t const commandsPerSegment = (commandCount + segmentCount - 1) / segmentCount;
+
+    CommandStreamSegment* segments[MAX_SEGMENT_COUNT];
+
+    auto record = [this](CommandStreamSegment* segment, Command const* first, Command const* last) {
+        DriverApi& stream = segment->getStream();
+        stream.debugThreading();
+        execute(stream, first, last);
+    };
+
+    auto* parent = js.createJob();
+    for (size_t i = 0; i < segmentCount; i++) {
+        Command const* const first =
+                mCommands.begin() + std::min(i * commandsPerSegment, commandCount);
+        Command const* const last =
+                mCommands.begin() + std::min((i + 1) * commandsPerSegment, commandCount);
+        segments[i] = driver.createSegment((last - first) * MAX_COMMAND_STREAM_SIZE_PER_COMMAND);
+        js.run(jobs::createJob(js, parent, std::cref(record), segments[i], first, last));
+    }
+    js.runAndWait(parent);
+
+    for (size_t i = 0; i < segmentCount; i++) {
+        driver.insertSegment(segments[i]);
+    }
+}
+
+static inline bool hasSameSkinningBindings(
+        RenderPass::PrimitiveInfo const& lhs, RenderPass::PrimitiveInfo const& rhs) noexcept {
+    return lhs.skinningHandle == rhs.skinningHandle &&
+           lhs.skinningOffset == rhs.skinningOffset &&
+           lhs.skinningTexture == rhs.skinningTexture &&
+           lhs.morphWeightBuffer == rhs.morphWeightBuffer &&
+           lhs.morphTargetBuffer == rhs.morphTargetBuffer;
+}
+
 UTILS_NOINLINE // no need to be inlined
 void RenderPass::Executor::execute(backend::DriverApi& driver,
         const Command* first, const Command* last) const noexcept {
@@ -779,31 +1215,57 @@ void RenderPass::Executor::execute(backend::DriverApi& driver,
 
         FMaterialInstance const* UTILS_RESTRICT mi = nullptr;
         FMaterial const* UTILS_RESTRICT ma = nullptr;
+
+        // Per-renderable bindings last emitted, so we don't encode redundant ones (e.g. for the
+        // primitives of a same renderable, or renderables sharing a skeleton).
+        Handle<HwBufferObject> boundUboHandle;
+        uint32_t boundUboOffset = 0;
+        PrimitiveInfo const* UTILS_RESTRICT boundSkinningInfo = nullptr;
+
         auto const* UTILS_RESTRICT pCustomCommands = mCustomCommands.data();
+        PrimitiveInfo const* const UTILS_RESTRICT pPrimitiveInfos = mPrimitiveInfos;
+        uint32_t const* const UTILS_RESTRICT pCommandMask = mCommandMask;
+        Command const* const pCommands = mCommands.data();
 
         first--;
         while (++first != last) {
             assert_invariant(first->key != uint64_t(Pass::SENTINEL));
 
+            if (UTILS_UNLIKELY(pCommandMask)) {
+                size_t const i = first - pCommands;
+                if (!(pCommandMask[i / 32] & (1u << (i % 32)))) {
+                    continue;
+                }
+            }
+
             /*
              * Be careful when changing code below, this is the hot inner-loop
              */
 
             if (UTILS_UNLIKELY((first->key & CUSTOM_MASK) != uint64_t(CustomCommand::PASS))) {
-                mi = nullptr; // custom command could change the currently bound MaterialInstance
+                // custom command could change the currently bound MaterialInstance and buffers
+                mi = nullptr;
+                boundUboHandle = {};
+                boundSkinningInfo = nullptr;
                 uint32_t const index = (first->key & CUSTOM_INDEX_MASK) >> CUSTOM_INDEX_SHIFT;
                 assert_invariant(index < mCustomCommands.size());
                 pCustomCommands[index]();
                 continue;
             }
 
+            // commands are sorted, but their PrimitiveInfo aren't, fetch the next one early.
+            if (UTILS_LIKELY(first + 1 != last)) {
+                UTILS_PREFETCH(pPrimitiveInfos + first[1].infoIndex);
+            }
+
+            // per-renderable uniform
+            const PrimitiveInfo info = pPrimitiveInfos[first->infoIndex];
+
             // primitiveHandle may be invalid if no geometry was set on the renderable.
-            if (UTILS_UNLIKELY(!first->primitive.primitiveHandle)) {
+            if (UTILS_UNLIKELY(!info.primitiveHandle)) {
                 continue;
             }
 
-            // per-renderable uniform
-            const PrimitiveInfo info = first->primitive;
             pipeline.rasterState = info.rasterState;
 
             if (UTILS_UNLIKELY(mi != info.mi)) {
@@ -856,67 +1318,163 @@ void RenderPass::Executor::execute(backend::DriverApi& driver,
                         (info.instanceCount & PrimitiveInfo::USER_INSTANCE_MASK) != 0u;
                 if (!userInstancing && instanceCount > 1) {
                     // automatic instancing
-                    return { mInstancedUboHandle, info.index * sizeof(PerRenderableData) };
+                    return { mInstancedUboHandle,
+                             mInstancedUboOffset + info.index * sizeof(PerRenderableData) };
                 } else {
                     // manual instancing
                     return { mUboHandle, info.index * sizeof(PerRenderableData) };
                 }
             };
 
-            // bind per-renderable uniform block. there is no need to attempt to skip this command
-            // because the backends already do this.
+            // bind per-renderable uniform block. The backends would skip this as well, but it's
+            // cheaper not to encode it in the first place.
             auto const [perObjectUboHandle, offset] = getPerObjectUboHandle();
             assert_invariant(perObjectUboHandle);
-            driver.bindBufferRange(BufferObjectBinding::UNIFORM,
-                    +UniformBindingPoints::PER_RENDERABLE,
-                    perObjectUboHandle,
-                    offset,
-                    sizeof(PerRenderableUib));
-
-            if (UTILS_UNLIKELY(info.skinningHandle)) {
-                // note: we can't bind less than sizeof(PerRenderableBoneUib) due to glsl limitations
+            if (perObjectUboHandle != boundUboHandle || offset != boundUboOffset) {
+                boundUboHandle = perObjectUboHandle;
+                boundUboOffset = offset;
                 driver.bindBufferRange(BufferObjectBinding::UNIFORM,
-                        +UniformBindingPoints::PER_RENDERABLE_BONES,
-                        info.skinningHandle,
-                        info.skinningOffset * sizeof(PerRenderableBoneUib::BoneData),
-                        sizeof(PerRenderableBoneUib));
-                // note: always bind the skinningTexture because the shader needs it.
-                driver.bindSamplers(+SamplerBindingPoints::PER_RENDERABLE_SKINNING,
-                        info.skinningTexture);
-                // note: even if only skinning is enabled, binding morphTargetBuffer is needed.
-                driver.bindSamplers(+SamplerBindingPoints::PER_RENDERABLE_MORPHING,
-                        info.morphTargetBuffer);
-           }
-
-            if (UTILS_UNLIKELY(info.morphWeightBuffer)) {
-                // Instead of using a UBO per primitive, we could also have a single UBO for all
-                // primitives and use bindUniformBufferRange which might be more efficient.
-                driver.bindUniformBuffer(+UniformBindingPoints::PER_RENDERABLE_MORPHING,
-                        info.morphWeightBuffer);
-                driver.bindSamplers(+SamplerBindingPoints::PER_RENDERABLE_MORPHING,
-                        info.morphTargetBuffer);
-                // note: even if only morphing is enabled, binding skinningTexture is needed.
-                driver.bindSamplers(+SamplerBindingPoints::PER_RENDERABLE_SKINNING,
-                        info.skinningTexture);
+                        +UniformBindingPoints::PER_RENDERABLE,
+                        perObjectUboHandle,
+                        offset,
+                        mPerRenderableUibSize);
+            }
+
+            // skinning and morphing bindings are only emitted when they differ from the ones of the
+            // last skinned or morphed primitive.
+            if (UTILS_UNLIKELY((info.skinningHandle || info.morphWeightBuffer) &&
+                    !(boundSkinningInfo && hasSameSkinningBindings(*boundSkinningInfo, info)))) {
+                boundSkinningInfo = &pPrimitiveInfos[first->infoIndex];
+
+                if (info.skinningHandle) {
+                    // note: we can't bind less than sizeof(PerRenderableBoneUib) due to glsl
+                    // limitations
+                    driver.bindBufferRange(BufferObjectBinding::UNIFORM,
+                            +UniformBindingPoints::PER_RENDERABLE_BONES,
+                            info.skinningHandle,
+                            info.skinningOffset * sizeof(PerRenderableBoneUib::BoneData),
+                            sizeof(PerRenderableBoneUib));
+                    // note: always bind the skinningTexture because the shader needs it.
+                    driver.bindSamplers(+SamplerBindingPoints::PER_RENDERABLE_SKINNING,
+                            info.skinningTexture);
+                    // note: even if only skinning is enabled, binding morphTargetBuffer is needed.
+                    driver.bindSamplers(+SamplerBindingPoints::PER_RENDERABLE_MORPHING,
+                            info.morphTargetBuffer);
+                }
+
+                if (info.morphWeightBuffer) {
+                    // Instead of using a UBO per primitive, we could also have a single UBO for all
+                    // primitives and use bindUniformBufferRange which might be more efficient.
+                    driver.bindUniformBuffer(+UniformBindingPoints::PER_RENDERABLE_MORPHING,
+                            info.morphWeightBuffer);
+                    driver.bindSamplers(+SamplerBindingPoints::PER_RENDERABLE_MORPHING,
+                            info.morphTargetBuffer);
+                    // note: even if only morphing is enabled, binding skinningTexture is needed.
+                    driver.bindSamplers(+SamplerBindingPoints::PER_RENDERABLE_SKINNING,
+                            info.skinningTexture);
+                }
             }
 
             driver.draw(pipeline, info.primitiveHandle, instanceCount);
         }
     }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+RenderPass::CommandCache::CommandCache() noexcept = default;
+
+RenderPass::CommandCache::CommandCache(CommandCache&& rhs) noexcept = default;
 
-    if (mInstancedUboHandle) {
-        driver.destroyBufferObject(mInstancedUboHandle);
+RenderPass::CommandCache& RenderPass::CommandCache::operator=(CommandCache&& rhs) noexcept = default;
+
+RenderPass::CommandCache::~CommandCache() noexcept = default;
+
+void RenderPass::CommandCache::clear() noexcept {
+    mValid = false;
+    mCommands = {};
+    mPrimitiveInfos = {};
+    mRenderables = {};
+    mVisibleMasks = {};
+}
+
+bool RenderPass::CommandCache::Key::operator==(Key const& rhs) const noexcept {
+    return soa == rhs.soa &&
+           sceneRevision == rhs.sceneRevision &&
+           materialInstanceStateVersion == rhs.materialInstanceStateVersion &&
+           first == rhs.first &&
+           last == rhs.last &&
+           cameraPosition == rhs.cameraPosition &&
+           cameraForward == rhs.cameraForward &&
+           visibilityMask == rhs.visibilityMask &&
+           commandTypeFlags == rhs.commandTypeFlags &&
+           renderFlags == rhs.renderFlags &&
+           variant == rhs.variant;
+}
+
+Range<uint32_t> RenderPass::CommandCache::getOutdatedRange(Key const& key,
+        FScene::RenderableSoa const& soa, FScene::VisibleMaskType const* visibleMasks,
+        uint32_t const* renderableRevisions) const noexcept {
+    Key k = key;
+    k.sceneRevision = mKey.sceneRevision;
+    if (!mValid || !(mKey == k) ||
+            (key.sceneRevision != mKey.sceneRevision && !renderableRevisions)) {
+        return { key.first, key.last };
     }
 
+    // the commands refer to the renderables by index, so a renderable's commands are outdated
+    // if it's not the same renderable anymore, if its visibility changed, or if it was updated
+    // since the commands were cached.
+    auto const* const renderables = soa.data<FScene::RENDERABLE_INSTANCE>();
+    bool const revisionChanged = key.sceneRevision != mKey.sceneRevision;
+    uint32_t first = key.last;
+    uint32_t last = key.last;
+    for (uint32_t i = key.first; i < key.last; i++) {
+        uint32_t const j = i - key.first;
+        if (mRenderables[j] != renderables[i] || mVisibleMasks[j] != visibleMasks[i] ||
+                (revisionChanged && int32_t(renderableRevisions[i] - mKey.sceneRevision) > 0)) {
+            first = std::min(first, i);
+            last = i + 1;
+        }
+    }
+    return { first, last };
+}
+
+void RenderPass::CommandCache::reset(Key const& key, FScene::RenderableSoa const& soa,
+        FScene::VisibleMaskType const* visibleMasks) {
+    mKey = key;
+    mValid = false;
+    mRenderables.assign(soa.data<FScene::RENDERABLE_INSTANCE>() + key.first,
+            soa.data<FScene::RENDERABLE_INSTANCE>() + key.last);
+    mVisibleMasks.assign(visibleMasks + key.first, visibleMasks + key.last);
+}
+
+void RenderPass::CommandCache::store(Command const* first, Command const* last,
+        PrimitiveInfo const* infos) {
+    SYSTRACE_CALL();
+    mCommands.clear();
+    mPrimitiveInfos.clear();
+    mCommands.reserve(last - first);
+    mPrimitiveInfos.reserve(last - first);
+    for (; first != last; ++first) {
+        if ((first->key & CUSTOM_MASK) == uint64_t(CustomCommand::PASS)) {
+            mCommands.push_back({ .key = first->key, .infoIndex = uint32_t(mPrimitiveInfos.size()) });
+            mPrimitiveInfos.push_back(infos[first->infoIndex]);
+        }
+    }
+    mValid = true;
 }
 
 // ------------------------------------------------------------------------------------------------
 
 RenderPass::Executor::Executor(RenderPass const* pass, Command const* b, Command const* e) noexcept
         : mCommands(b, e),
+          mPrimitiveInfos(pass->mPrimitiveInfoBegin),
           mCustomCommands(pass->mCustomCommands.data(), pass->mCustomCommands.size()),
           mUboHandle(pass->mUboHandle),
           mInstancedUboHandle(pass->mInstancedUboHandle),
+          mInstancedUboOffset(pass->mInstancedUboOffset),
+          mPerRenderableUibSize(pass->mPerRenderableUibSize),
           mScissorViewport(pass->mScissorViewport),
           mPolygonOffsetOverride(false),
           mScissorOverride(false) {
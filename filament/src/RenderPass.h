@@ -39,6 +39,9 @@
 #include <limits>
 #include <vector>
 
+// for gtest
+class RenderPassTest;
+
 namespace filament {
 
 class FMaterialInstance;
@@ -247,10 +250,15 @@ public:
     };
     static_assert(sizeof(PrimitiveInfo) == 48);
 
-    struct alignas(8) Command {     // 64 bytes
+    /*
+     * A Command only holds its sorting key and the index of its PrimitiveInfo, which is stored
+     * separately (see RenderPass::getPrimitiveInfo()), so that sorting, instancing and trimming
+     * only move 16 bytes per command. Custom commands don't have a PrimitiveInfo.
+     */
+    struct alignas(8) Command {     // 16 bytes
         CommandKey key = 0;         //  8 bytes
-        PrimitiveInfo primitive;    // 48 bytes
-        uint64_t reserved[1] = {};  //  8 bytes
+        uint32_t infoIndex = 0;     //  4 bytes
+        uint32_t reserved = 0;      //  4 bytes
         bool operator < (Command const& rhs) const noexcept { return key < rhs.key; }
         // placement new declared as "throw" to avoid the compiler's null-check
         inline void* operator new (std::size_t, void* ptr) {
@@ -258,7 +266,7 @@ public:
             return ptr;
         }
     };
-    static_assert(sizeof(Command) == 64);
+    static_assert(sizeof(Command) == 16);
     static_assert(std::is_trivially_destructible_v<Command>,
             "Command isn't trivially destructible");
 
@@ -266,19 +274,31 @@ public:
     static constexpr RenderFlags HAS_SHADOWING           = 0x01;
     static constexpr RenderFlags HAS_INVERSE_FRONT_FACES = 0x02;
     static constexpr RenderFlags IS_STEREOSCOPIC         = 0x04;
+    // commands are not instanced, so that each one draws a single renderable
+    static constexpr RenderFlags DISABLE_AUTOMATIC_INSTANCING = 0x08;
+    // commands are not sorted by distance to the camera, which then doesn't need to be set
+    static constexpr RenderFlags DISABLE_DEPTH_SORTING   = 0x10;
 
-    // Arena used for commands
+    // Arena used for commands and their PrimitiveInfo
     using Arena = utils::Arena<
             utils::LinearAllocator,                 // note: can't change this allocator
             utils::LockingPolicy::NoLock,
             utils::TrackingPolicy::HighWatermark,
             utils::AreaPolicy::StaticArea>;
 
+    // Fraction of the per-frame commands area that should be used for the Commands themselves,
+    // the rest holds their PrimitiveInfo.
+    static constexpr size_t getCommandArenaSize(size_t size) noexcept {
+        return (size * sizeof(Command) / (sizeof(Command) + sizeof(PrimitiveInfo)))
+                & ~(utils::CACHELINE_SIZE - 1);
+    }
+
     /*
      * Create a RenderPass.
-     * The Arena is used to allocate commands which are then owned by the Arena.
+     * The Arenas are used to allocate commands and their PrimitiveInfo respectively, which are
+     * then owned by the Arenas.
      */
-    RenderPass(FEngine& engine, Arena& arena) noexcept;
+    RenderPass(FEngine& engine, Arena& commandArena, Arena& primitiveInfoArena) noexcept;
 
     // Copy the RenderPass as is. This can be used to create a RenderPass from a "template"
     // by copying from an "empty" RenderPass.
@@ -287,6 +307,64 @@ public:
     // allocated commands ARE NOT freed, they're owned by the Arena
     ~RenderPass() noexcept;
 
+    /*
+     * Keeps the sorted commands of a RenderPass from one frame to the next, so they can be reused
+     * as long as nothing they depend on changed. See setCommandCache().
+     */
+    class CommandCache {
+    public:
+        CommandCache() noexcept;
+        CommandCache(CommandCache&& rhs) noexcept;
+        CommandCache& operator=(CommandCache&& rhs) noexcept;
+        ~CommandCache() noexcept;
+
+        // forget the cached commands
+        void clear() noexcept;
+
+        // number of times the cached commands were used unchanged, or patched
+        uint32_t getHitCount() const noexcept { return mHitCount; }
+        uint32_t getPatchCount() const noexcept { return mPatchCount; }
+
+    private:
+        friend class RenderPass;
+
+        // everything appendCommands() depends on, besides the renderables themselves
+        struct Key {
+            FScene::RenderableSoa const* soa = nullptr;
+            uint32_t sceneRevision = 0;
+            uint32_t materialInstanceStateVersion = 0;
+            uint32_t first = 0;
+            uint32_t last = 0;
+            math::float3 cameraPosition{};
+            math::float3 cameraForward{};
+            FScene::VisibleMaskType visibilityMask = 0;
+            CommandTypeFlags commandTypeFlags{};
+            RenderFlags renderFlags = 0;
+            Variant variant{};
+            bool operator==(Key const& rhs) const noexcept;
+        };
+
+        // Returns the range of renderables whose cached commands are out of date, that is all
+        // of them if the cache can't be used at all.
+        utils::Range<uint32_t> getOutdatedRange(Key const& key,
+                FScene::RenderableSoa const& soa, FScene::VisibleMaskType const* visibleMasks,
+                uint32_t const* renderableRevisions) const noexcept;
+        void reset(Key const& key, FScene::RenderableSoa const& soa,
+                FScene::VisibleMaskType const* visibleMasks);
+        void store(Command const* first, Command const* last, PrimitiveInfo const* infos);
+
+        Key mKey;
+        bool mValid = false;
+        // sorted commands (without custom commands) and their PrimitiveInfo
+        std::vector<Command> mCommands;
+        std::vector<PrimitiveInfo> mPrimitiveInfos;
+        // renderable instance and visibility mask of each renderable the commands were built from
+        std::vector<FRenderableManager::Instance> mRenderables;
+        std::vector<FScene::VisibleMaskType> mVisibleMasks;
+        uint32_t mHitCount = 0;
+        uint32_t mPatchCount = 0;
+    };
+
     // a box that both offsets the viewport and clips it
     void setScissorViewport(backend::Viewport viewport) noexcept;
 
@@ -304,15 +382,37 @@ public:
     // variant to use
     void setVariant(Variant variant) noexcept { mVariant = variant; }
 
+    // Sets the cache used by the next appendCommands() and sortCommands(), if the pass is empty.
+    // Cached commands are used if the pass' settings and its renderables are the same as when
+    // they were cached. Only the commands of the renderables that changed since, either in the
+    // scene (see FScene::getRenderableRevisions()) or in their visibility, are regenerated. These
+    // are the commands of the smallest range of renderables containing all the changed ones.
+    // The cache is then updated with the new commands.
+    void setCommandCache(CommandCache* cache, FScene const& scene) noexcept {
+        mCommandCache = cache;
+        mSceneRevision = scene.getRevision();
+        mRenderableRevisions = scene.getRenderableRevisions();
+    }
+
     // Sets the visibility mask, which is AND-ed against each Renderable's VISIBLE_MASK to determine
     // if the renderable is visible for this pass.
     // Defaults to all 1's, which means all renderables in this render pass will be rendered.
     void setVisibilityMask(FScene::VisibleMaskType mask) noexcept { mVisibilityMask = mask; }
 
+    // Sets the visibility masks to use instead of the SOA's VISIBLE_MASK, indexed the same way.
+    // This allows passes with different visibility (e.g. shadow maps) to share the same SOA.
+    // Defaults to nullptr, which means the SOA's VISIBLE_MASK is used.
+    void setVisibleMasks(FScene::VisibleMaskType const* masks) noexcept { mVisibleMasks = masks; }
+
     Command const* begin() const noexcept { return mCommandBegin; }
     Command const* end() const noexcept { return mCommandEnd; }
     bool empty() const noexcept { return begin() == end(); }
 
+    // PrimitiveInfo of a (non-custom) command of this pass
+    PrimitiveInfo const& getPrimitiveInfo(Command const& command) const noexcept {
+        return mPrimitiveInfoBegin[command.infoIndex];
+    }
+
     // This is the main function of this class, this appends commands to the pass using
     // the current camera, geometry and flags set. This can be called multiple times if needed.
     void appendCommands(FEngine& engine, CommandTypeFlags commandTypeFlags) noexcept;
@@ -320,6 +420,25 @@ public:
     // sorts and instanceify commands then trims sentinels
     void sortCommands(FEngine& engine) noexcept;
 
+    /*
+     * appendCommands() followed by sortCommands(), split in three steps so that the commands of
+     * several passes can be generated concurrently (e.g. one job per shadow map). The pass must
+     * be empty and the summed primitive counts of its renderables must be up-to-date, see
+     * updateSummedPrimitiveCounts().
+     * - reserveCommands() allocates the commands, it must be called from the main thread.
+     * - generateAndSortCommands() can be called from any thread, it doesn't touch the arenas.
+     * - finalizeCommands() prepares the programs, instanceify the commands and gives the storage
+     *   of the trimmed commands back to the arena, it must be called from the main thread.
+     */
+    void reserveCommands(FEngine& engine, CommandTypeFlags commandTypeFlags) noexcept;
+    void generateAndSortCommands(FEngine& engine) noexcept;
+    void finalizeCommands(FEngine& engine) noexcept;
+
+    // Computes the SUMMED_PRIMITIVE_COUNT of the renderables in vr, which can then be used by
+    // all passes whose renderables are within vr.
+    static void updateSummedPrimitiveCounts(
+            FScene::RenderableSoa& renderableData, utils::Range<uint32_t> vr) noexcept;
+
     // Helper to execute all the commands generated by this RenderPass
     void execute(FEngine& engine, const char* name,
             backend::Handle<backend::HwRenderTarget> renderTarget,
@@ -334,11 +453,15 @@ public:
 
         // these fields are constant after creation
         utils::Slice<Command> mCommands;
+        PrimitiveInfo const* mPrimitiveInfos = nullptr;
         utils::Slice<CustomCommandFn> mCustomCommands;
         backend::Handle<backend::HwBufferObject> mUboHandle;
         backend::Handle<backend::HwBufferObject> mInstancedUboHandle;
+        uint32_t mInstancedUboOffset = 0;
+        uint32_t mPerRenderableUibSize = 0;
         backend::Viewport mScissorViewport;
 
+        uint32_t const* mCommandMask = nullptr;  // commands to execute, all if null
         backend::Viewport mScissor{};            // value of scissor override
         backend::PolygonOffset mPolygonOffset{}; // value of the override
         bool mPolygonOffsetOverride : 1;         // whether to override the polygon offset setting
@@ -349,6 +472,8 @@ public:
         void execute(backend::DriverApi& driver,
                 const Command* first, const Command* last) const noexcept;
 
+        void executeParallel(FEngine& engine) const noexcept;
+
     public:
         Executor() = default;
         Executor(Executor const& rhs);
@@ -362,6 +487,11 @@ public:
         void overrideScissor(backend::Viewport const* scissor) noexcept;
         void overrideScissor(backend::Viewport const& scissor) noexcept;
 
+        // if non-null, only the commands whose bit is set in mask are executed. The bit of the
+        // i-th command of this executor is (mask[i / 32] >> (i % 32)) & 1.
+        // This allows several executors to share the same commands.
+        void setCommandMask(uint32_t const* mask) noexcept { mCommandMask = mask; }
+
         void execute(FEngine& engine, const char* name) const noexcept;
     };
 
@@ -387,54 +517,105 @@ public:
     void appendCustomCommand(uint8_t channel, Pass pass, CustomCommand custom, uint32_t order,
             Executor::CustomCommandFn command);
 
-
 private:
+    friend class ::RenderPassTest;
     friend class FRenderer;
 
+    // below this command count, std::sort() is faster than radixSortCommands()
+    static constexpr size_t RADIX_SORT_MIN_COMMANDS_COUNT = 2048;
+
+    // Sorts commands by key, keeping the order of commands with the same key, and returns the
+    // number of commands before the first sentinel. Only these commands are valid afterwards.
+    static size_t radixSortCommands(utils::JobSystem& js,
+            Command* commands, size_t count) noexcept;
+
     Command* append(size_t count) noexcept;
+    PrimitiveInfo* appendPrimitiveInfos(size_t count) noexcept;
+    // resize() only trims the commands of this pass, trimCommandStorage() then gives their
+    // storage back to the command arena if possible, it must be called from the main thread.
     void resize(size_t count) noexcept;
+    void trimCommandStorage() noexcept;
     void instanceify(FEngine& engine) noexcept;
 
-    // we choose the command count per job to minimize JobSystem overhead.
-    // on a Pixel 4, 2048 commands is about half a millisecond of processing.
-    static constexpr size_t JOBS_PARALLEL_FOR_COMMANDS_COUNT = 2048;
-    static constexpr size_t JOBS_PARALLEL_FOR_COMMANDS_SIZE  =
-            sizeof(Command) * JOBS_PARALLEL_FOR_COMMANDS_COUNT;
+    // we sort in parallel jobs only when each job gets at least this many commands
+    static constexpr size_t JOBS_PARALLEL_SORT_COMMANDS_COUNT = 8192;
+    static constexpr size_t JOBS_PARALLEL_SORT_MAX_JOBS_COUNT = 16;
+
+    // a command along with its PrimitiveInfo, while it's being generated
+    struct DrawCommand {
+        CommandKey key = 0;
+        PrimitiveInfo primitive;
+    };
+
+    // The PrimitiveInfo of commands[i] is written in infos[i], and has index (firstIndex + i).
+    // commands[0] is the first command of the renderable `first`.
+    struct CommandWriter {
+        Command* commands;
+        PrimitiveInfo* infos;
+        uint32_t firstIndex;
+        uint32_t first;
+    };
+
+    // appends the cached commands if the command cache can be used, returns whether it was
+    bool appendCachedCommands(FEngine& engine, CommandTypeFlags commandTypeFlags);
+
+    // allocates the commands of the renderables in range, to be written by
+    // generateReservedCommands()
+    void reserveCommandStorage(CommandTypeFlags commandTypeFlags,
+            utils::Range<uint32_t> range) noexcept;
+    void generateReservedCommands(FEngine& engine) noexcept;
+
+    // prepares the programs used by the given commands, must be called from the main thread
+    void prepareCommandPrograms(Command const* first, Command const* last) const noexcept;
 
-    static_assert(JOBS_PARALLEL_FOR_COMMANDS_SIZE % utils::CACHELINE_SIZE == 0,
-            "Size of Commands jobs must be multiple of a cache-line size");
+    void sortAndTrimCommands(utils::JobSystem& js) noexcept;
 
-    static inline void generateCommands(uint32_t commandTypeFlags, Command* commands,
+    FScene::VisibleMaskType const* getVisibleMasks() const noexcept {
+        return mVisibleMasks ? mVisibleMasks : mRenderableSoa->data<FScene::VISIBLE_MASK>();
+    }
+
+    static inline void generateCommands(uint32_t commandTypeFlags, CommandWriter writer,
             FScene::RenderableSoa const& soa, utils::Range<uint32_t> range,
             Variant variant, RenderFlags renderFlags,
-            FScene::VisibleMaskType visibilityMask,
+            FScene::VisibleMaskType const* visibleMasks, FScene::VisibleMaskType visibilityMask,
             math::float3 cameraPosition, math::float3 cameraForward,
             uint8_t instancedStereoEyeCount) noexcept;
 
     template<uint32_t commandTypeFlags>
-    static inline Command* generateCommandsImpl(uint32_t extraFlags, Command* curr,
+    static inline Command* generateCommandsImpl(uint32_t extraFlags,
+            CommandWriter writer, Command* curr,
             FScene::RenderableSoa const& soa, utils::Range<uint32_t> range,
-            Variant variant, RenderFlags renderFlags, FScene::VisibleMaskType visibilityMask,
+            Variant variant, RenderFlags renderFlags,
+            FScene::VisibleMaskType const* visibleMasks, FScene::VisibleMaskType visibilityMask,
             math::float3 cameraPosition, math::float3 cameraForward,
             uint8_t instancedStereoEyeCount) noexcept;
 
-    static void setupColorCommand(Command& cmdDraw, Variant variant,
+    static void setupColorCommand(DrawCommand& cmdDraw, Variant variant,
             FMaterialInstance const* mi, bool inverseFrontFaces) noexcept;
 
-    static void updateSummedPrimitiveCounts(
-            FScene::RenderableSoa& renderableData, utils::Range<uint32_t> vr) noexcept;
-
     // a reference to the Engine, mostly to get to things like JobSystem
 
     // Arena where all Commands are allocated. The Arena owns the commands.
     Arena& mCommandArena;
 
+    // Arena where the PrimitiveInfo of all Commands are allocated.
+    Arena& mPrimitiveInfoArena;
+
     // Pointer to the first command
     Command* mCommandBegin = nullptr;
 
     // Pointer to one past the last command
     Command* mCommandEnd = nullptr;
 
+    // Pointer to one past the storage allocated for the commands, see trimCommandStorage()
+    Command* mCommandStorageEnd = nullptr;
+
+    // Pointer to the first PrimitiveInfo, Command::infoIndex is relative to it
+    PrimitiveInfo* mPrimitiveInfoBegin = nullptr;
+
+    // Pointer to one past the last PrimitiveInfo
+    PrimitiveInfo* mPrimitiveInfoEnd = nullptr;
+
     // the SOA containing the renderables we're interested in
     FScene::RenderableSoa const* mRenderableSoa = nullptr;
 
@@ -443,7 +624,14 @@ private:
 
     // the UBO containing the data for the renderables
     backend::Handle<backend::HwBufferObject> mUboHandle;
+
+    // the UBO containing the data for automatically instanced renderables, owned by the engine's
+    // InstancedUboPool, and where this pass' data starts in it
     backend::Handle<backend::HwBufferObject> mInstancedUboHandle;
+    uint32_t mInstancedUboOffset = 0;
+
+    // size of the PER_RENDERABLE uniform block bindings, see FEngine::getPerRenderableUibSize()
+    uint32_t mPerRenderableUibSize;
 
     // info about the camera
     math::float3 mCameraPosition{};
@@ -458,10 +646,32 @@ private:
     // Additional visibility mask
     FScene::VisibleMaskType mVisibilityMask = std::numeric_limits<FScene::VisibleMaskType>::max();
 
+    // Visibility masks used instead of the SOA's, if not null
+    FScene::VisibleMaskType const* mVisibleMasks = nullptr;
+
+    // Commands allocated by reserveCommands() and not generated yet
+    CommandWriter mReservedWriter{};
+    utils::Range<uint32_t> mReservedRange{};
+    uint32_t mReservedCount = 0;
+    CommandTypeFlags mReservedCommandTypeFlags{};
+
     backend::Viewport mScissorViewport{ 0, 0,
             std::numeric_limits<int32_t>::max(),
             std::numeric_limits<int32_t>::max() };
 
+    // cache set with setCommandCache(), and how it was used by appendCommands()
+    enum class CacheState : uint8_t {
+        NONE,   // the cache isn't used
+        HIT,    // the pass starts with mCachedCommandCount sorted commands from the cache
+        PATCH,  // same as HIT, and the cache will be updated by sortCommands()
+        MISS    // the cache will be updated by sortCommands()
+    };
+    CommandCache* mCommandCache = nullptr;
+    uint32_t const* mRenderableRevisions = nullptr;
+    uint32_t mSceneRevision = 0;
+    uint32_t mCachedCommandCount = 0;
+    CacheState mCacheState = CacheState::NONE;
+
     // a vector for our custom commands
     using CustomCommandVector = std::vector<Executor::CustomCommandFn,
             utils::STLAllocator<Executor::CustomCommandFn, LinearAllocatorArena>>;
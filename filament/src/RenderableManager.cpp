@@ -189,4 +189,12 @@ bool RenderableManager::getFogEnabled(RenderableManager::Instance instance) cons
     return downcast(this)->getFogEnabled(instance);
 }
 
+void RenderableManager::setStaticGeometry(RenderableManager::Instance instance, bool enable) noexcept {
+    downcast(this)->setStaticGeometry(instance, enable);
+}
+
+bool RenderableManager::isStaticGeometry(RenderableManager::Instance instance) const noexcept {
+    return downcast(this)->isStaticGeometry(instance);
+}
+
 } // namespace filament
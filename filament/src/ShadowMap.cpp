@@ -334,14 +334,13 @@ ShadowMap::ShaderParameters ShadowMap::updateSpot(FEngine& engine,
 
 ShadowMap::ShaderParameters ShadowMap::updatePoint(FEngine& engine,
         const FScene::LightSoa& lightData, size_t index, filament::CameraInfo const&,
-        const ShadowMapInfo& shadowMapInfo, FScene const& scene, uint8_t face) noexcept {
+        const ShadowMapInfo& shadowMapInfo,
+        FScene::VisibleMaskType const* UTILS_RESTRICT visibleMasks, utils::Range<uint32_t> range,
+        uint8_t face) noexcept {
 
     // check if this shadow map has anything to render
     mHasVisibleShadows = false;
-    FScene::RenderableSoa const& UTILS_RESTRICT soa = scene.getRenderableData();
-    auto const* const UTILS_RESTRICT visibleMasks = soa.data<FScene::VISIBLE_MASK>();
-    size_t const c = soa.size();
-    for (size_t i = 0; i < c; i++) {
+    for (uint32_t const i : range) {
         if (visibleMasks[i] & VISIBLE_DYN_SHADOW_RENDERABLE) {
             mHasVisibleShadows = true;
             break;
@@ -32,6 +32,8 @@
 #include <math/mat4.h>
 #include <math/vec4.h>
 
+#include <utils/Range.h>
+
 namespace filament {
 
 class RenderPass;
@@ -152,9 +154,12 @@ public:
             const ShadowMapInfo& shadowMapInfo, FScene const& scene,
             SceneInfo sceneInfo) noexcept;
 
+    // visibleMasks holds the visibility of the shadow casters in range for this shadow map
     ShadowMap::ShaderParameters updatePoint(FEngine& engine,
             const FScene::LightSoa& lightData, size_t index, filament::CameraInfo const& camera,
-            const ShadowMapInfo& shadowMapInfo, FScene const& scene, uint8_t face) noexcept;
+            const ShadowMapInfo& shadowMapInfo,
+            FScene::VisibleMaskType const* visibleMasks, utils::Range<uint32_t> range,
+            uint8_t face) noexcept;
 
     // Do we have visible shadows. Valid after calling update().
     bool hasVisibleShadows() const noexcept { return mHasVisibleShadows; }
@@ -26,6 +26,10 @@
 
 #include <utils/debug.h>
 #include <utils/FixedCapacityVector.h>
+#include <utils/JobSystem.h>
+
+#include <algorithm>
+#include <vector>
 
 namespace filament {
 
@@ -209,43 +213,91 @@ FrameGraphId<FrameGraphTexture> ShadowMapManager::render(FEngine& engine, FrameG
                 scene, mainCameraInfo, userTime, passTemplate = pass](
                     FrameGraphResources const&, auto const& data, DriverApi& driver) {
 
-                // Note: we could almost parallel_for the loop below, the problem currently is
-                // that updatePrimitivesLod() updates temporary global state.
-                // prepareSpotShadowMap() also update the visibility of renderable. These two
-                // pieces of state are needed only until shadowMap.render() returns.
-                // Conceptually, we could store this out-of-band.
-
-                // Generate a RenderPass for each shadow map
-                for (auto const& entry : data.passList) {
-                    ShadowMap& shadowMap = *entry.shadowMap;
-
-                    // for spot shadow map, we need to do the culling
-                    switch (shadowMap.getShadowType()) {
-                        case ShadowType::DIRECTIONAL:
-                            break;
-                        case ShadowType::SPOT:
-                            prepareSpotShadowMap(shadowMap, engine, view, mainCameraInfo,
-                                    scene->getRenderableData(), entry.range,
-                                    scene->getLightData(), mSceneInfo);
-                            break;
-                        case ShadowType::POINT:
-                            preparePointShadowMap(shadowMap, engine, view, mainCameraInfo,
-                                    scene->getRenderableData(), entry.range,
-                                    scene->getLightData(), mSceneInfo);
-                            break;
+                auto& passList = data.passList;
+                FScene::RenderableSoa& renderableData = scene->getRenderableData();
+                utils::JobSystem& js = engine.getJobSystem();
+
+                // Each shadow map is culled and has its commands generated in its own job. The
+                // state that used to be shared between shadow maps is either computed once for
+                // all of them beforehand, or stored per shadow map, and everything that talks to
+                // the driver stays on this thread.
+                // All passes use renderables from the [0, last) range.
+                uint32_t last = 0;
+                for (auto const& entry : passList) {
+                    last = std::max(last, entry.range.last);
+                }
+
+                // updatePrimitivesLod must be run before generating the commands, currently the
+                // level of detail doesn't depend on the camera, so we can do it for all passes.
+                view.updatePrimitivesLod(engine, mainCameraInfo, renderableData, { 0, last });
+                RenderPass::updateSummedPrimitiveCounts(renderableData, { 0, last });
+
+                // visibility of the shadow casters of each spot and point shadow map, with room
+                // for the padding processed past the end of the range by the culling code.
+                size_t const stride = (last + 0x1Fu) & ~0xFu;
+                size_t const spotCount = std::count_if(passList.begin(), passList.end(),
+                        [](auto const& entry) { return !entry.shadowMap->isDirectionalShadow(); });
+                std::vector<FScene::VisibleMaskType> visibleMasks(spotCount * stride);
+
+                auto passes = utils::FixedCapacityVector<RenderPass>::with_capacity(
+                        passList.size() + 1);
+                auto passVisibleMasks =
+                        utils::FixedCapacityVector<FScene::VisibleMaskType*>::with_capacity(
+                                passList.size());
+                for (size_t i = 0, spot = 0; i < passList.size(); i++) {
+                    auto& pass = passes.emplace_back(passTemplate);
+                    pass.setVisibilityMask(passList[i].visibilityMask);
+                    pass.setGeometry(renderableData,
+                            passList[i].range, scene->getRenderableUBO());
+                    FScene::VisibleMaskType* masks = nullptr;
+                    if (!passList[i].shadowMap->isDirectionalShadow()) {
+                        masks = visibleMasks.data() + stride * spot++;
+                        pass.setVisibleMasks(masks);
                     }
+                    passVisibleMasks.push_back(masks);
+                }
 
-                    if (shadowMap.hasVisibleShadows()) {
-                        // Note: this loop can generate a lot of commands that come out of the
-                        //       "per frame command arena". The allocation persists until the
-                        //       end of the frame.
-                        //       One way to possibly mitigate this, would be to always use the
-                        //       same command buffer for all shadow map, but then we'd generate
-                        //       a lot of unneeded draw calls.
-                        //       To do this efficiently, we'd need a way to cull draw calls already
-                        //       recorded in the command buffer, per shadow map.
+                // for spot and point shadow maps, we need to do the culling
+                ShadowUib* const shadowUib = spotCount ? &mShadowUb.edit() : nullptr;
+                auto cull = [&](uint32_t start, uint32_t count) {
+                    for (size_t i = start; i < start + count; i++) {
+                        auto const& entry = passList[i];
+                        ShadowMap& shadowMap = *entry.shadowMap;
+                        FScene::VisibleMaskType* const masks = passVisibleMasks[i];
+                        switch (shadowMap.getShadowType()) {
+                            case ShadowType::DIRECTIONAL:
+                                break;
+                            case ShadowType::SPOT:
+                                prepareSpotShadowMap(shadowMap, engine, view, mainCameraInfo,
+                                        renderableData, entry.range, masks,
+                                        scene->getLightData(), mSceneInfo, *shadowUib);
+                                break;
+                            case ShadowType::POINT:
+                                preparePointShadowMap(shadowMap, engine, view, mainCameraInfo,
+                                        renderableData, entry.range, masks,
+                                        scene->getLightData(), mSceneInfo, *shadowUib);
+                                break;
+                        }
+                    }
+                };
+                if (spotCount) {
+                    auto* job = utils::jobs::parallel_for(js, nullptr,
+                            0, uint32_t(passList.size()),
+                            std::cref(cull), utils::jobs::CountSplitter<1, 5>());
+                    js.runAndWait(job);
+                }
 
+                // With shared commands, the spot and point shadow maps all render the commands
+                // of a single pass, generated for the shadow casters visible in any of them.
+                bool const shared = spotCount && engine.getConfig().sharedShadowCasterCommands;
 
+                // passes whose commands need to be generated
+                auto pending = utils::FixedCapacityVector<RenderPass*>::with_capacity(
+                        passList.size() + 1);
+
+                for (size_t i = 0; i < passList.size(); i++) {
+                    ShadowMap& shadowMap = *passList[i].shadowMap;
+                    if (shadowMap.hasVisibleShadows()) {
                         // cameraInfo only valid after calling update
                         const CameraInfo cameraInfo{ shadowMap.getCamera(), mainCameraInfo };
 
@@ -257,23 +309,138 @@ FrameGraphId<FrameGraphTexture> ShadowMapManager::render(FEngine& engine, FrameG
                                 vsmShadowOptions.highPrecision);
                         shadowMap.commit(transaction, driver);
 
-                        // updatePrimitivesLod must be run before RenderPass::appendCommands.
-                        view.updatePrimitivesLod(engine,
-                                cameraInfo, scene->getRenderableData(), entry.range);
+                        if (shared && !shadowMap.isDirectionalShadow()) {
+                            continue;
+                        }
 
-                        // generate and sort the commands for rendering the shadow map
-                        RenderPass pass(passTemplate);
+                        // Note: this loop can generate a lot of commands that come out of the
+                        //       "per frame command arena". The allocation persists until the
+                        //       end of the frame. See Engine::Config::sharedShadowCasterCommands.
+                        RenderPass& pass = passes[i];
                         pass.setCamera(cameraInfo);
-                        pass.setVisibilityMask(entry.visibilityMask);
-                        pass.setGeometry(scene->getRenderableData(),
-                                entry.range, scene->getRenderableUBO());
-                        pass.appendCommands(engine, RenderPass::SHADOW);
-                        pass.sortCommands(engine);
+                        if (engine.isRenderPassCommandCacheEnabled()) {
+                            if (mCommandCaches.empty()) {
+                                mCommandCaches.resize(CONFIG_MAX_SHADOWMAPS);
+                            }
+                            pass.setCommandCache(&mCommandCaches[shadowMap.getShadowIndex()],
+                                    *scene);
+                        }
+                        pass.reserveCommands(engine, RenderPass::SHADOW);
+                        pending.push_back(&pass);
+                    }
+                }
+
+                std::vector<FScene::VisibleMaskType> sharedVisibleMasks;
+                RenderPass* sharedPass = nullptr;
+                if (shared) {
+                    // the shared commands are generated for the union of the visible shadow
+                    // casters, they're not sorted by distance, since each light is different.
+                    // The pass' camera is then unused, a fixed one is set so that the command
+                    // cache doesn't depend on the view's camera.
+                    auto ranges = utils::FixedCapacityVector<utils::Range<uint32_t>>::with_capacity(
+                            spotCount);
+                    auto masks = utils::FixedCapacityVector<FScene::VisibleMaskType const*>::
+                            with_capacity(spotCount);
+                    for (size_t i = 0; i < passList.size(); i++) {
+                        if (passVisibleMasks[i] && passList[i].shadowMap->hasVisibleShadows()) {
+                            ranges.push_back(passList[i].range);
+                            masks.push_back(passVisibleMasks[i]);
+                        }
+                    }
+                    sharedVisibleMasks.resize(stride);
+                    utils::Range<uint32_t> const range = mergeVisibleMasks(
+                            sharedVisibleMasks.data(), ranges.data(), masks.data(), ranges.size());
+                    if (!range.empty()) {
+                        sharedPass = &passes.emplace_back(passTemplate);
+                        sharedPass->setRenderFlags(sharedPass->getRenderFlags() |
+                                RenderPass::DISABLE_AUTOMATIC_INSTANCING |
+                                RenderPass::DISABLE_DEPTH_SORTING);
+                        sharedPass->setCamera(CameraInfo{});
+                        sharedPass->setVisibilityMask(VISIBLE_DYN_SHADOW_RENDERABLE);
+                        sharedPass->setVisibleMasks(sharedVisibleMasks.data());
+                        sharedPass->setGeometry(renderableData,
+                                range, scene->getRenderableUBO());
+                        if (engine.isRenderPassCommandCacheEnabled()) {
+                            sharedPass->setCommandCache(&mSharedCommandCache, *scene);
+                        }
+                        sharedPass->reserveCommands(engine, RenderPass::SHADOW);
+                        pending.push_back(sharedPass);
+                    }
+                }
 
-                        entry.executor = pass.getExecutor();
+                // generate and sort the commands for rendering each shadow map
+                auto generate = [&pending, &engine](uint32_t start, uint32_t count) {
+                    for (size_t i = start; i < start + count; i++) {
+                        pending[i]->generateAndSortCommands(engine);
+                    }
+                };
+                if (!pending.empty()) {
+                    auto* job = utils::jobs::parallel_for(js, nullptr,
+                            0, uint32_t(pending.size()),
+                            std::cref(generate), utils::jobs::CountSplitter<1, 5>());
+                    js.runAndWait(job);
+                }
+
+                for (RenderPass* pass : pending) {
+                    pass->finalizeCommands(engine);
+                }
+
+                size_t wordCount = 0;
+                if (sharedPass) {
+                    // find which of the shared commands each shadow map needs to render
+                    RenderPass::Command const* const commands = sharedPass->begin();
+                    size_t const commandCount = sharedPass->end() - commands;
+                    wordCount = (commandCount + 31) / 32;
+                    std::vector<uint32_t> renderables(commandCount);
+                    for (size_t j = 0; j < commandCount; j++) {
+                        // commands aren't instanced, so index is the renderable's
+                        renderables[j] = sharedPass->getPrimitiveInfo(commands[j]).index;
+                        // and they're all at the same depth
+                        assert_invariant((commands[j].key & RenderPass::Z_BUCKET_MASK) ==
+                                (commands[0].key & RenderPass::Z_BUCKET_MASK));
+                    }
+
+                    mSharedCommandMasks.assign(spotCount * wordCount, 0);
+                    auto cullCommands = [&](uint32_t start, uint32_t count) {
+                        for (size_t i = start; i < start + count; i++) {
+                            auto const* const masks = passVisibleMasks[i];
+                            if (!masks || !passList[i].shadowMap->hasVisibleShadows()) {
+                                continue;
+                            }
+                            size_t const spot = (masks - visibleMasks.data()) / stride;
+                            uint32_t* const UTILS_RESTRICT bits =
+                                    mSharedCommandMasks.data() + spot * wordCount;
+                            // the masks are only valid in the shadow map's own range
+                            utils::Range<uint32_t> const range = passList[i].range;
+                            for (size_t j = 0; j < commandCount; j++) {
+                                uint32_t const r = renderables[j];
+                                bool const visible = range.contains(r) &&
+                                        (masks[r] & VISIBLE_DYN_SHADOW_RENDERABLE);
+                                bits[j / 32] |= uint32_t(visible) << (j % 32);
+                            }
+                        }
+                    };
+                    auto* job = utils::jobs::parallel_for(js, nullptr,
+                            0, uint32_t(passList.size()),
+                            std::cref(cullCommands), utils::jobs::CountSplitter<1, 5>());
+                    js.runAndWait(job);
+                }
+
+                for (size_t i = 0; i < passList.size(); i++) {
+                    auto const& entry = passList[i];
+                    if (entry.shadowMap->hasVisibleShadows()) {
+                        if (shared && !entry.shadowMap->isDirectionalShadow()) {
+                            size_t const spot =
+                                    (passVisibleMasks[i] - visibleMasks.data()) / stride;
+                            entry.executor = sharedPass->getExecutor();
+                            entry.executor.setCommandMask(
+                                    mSharedCommandMasks.data() + spot * wordCount);
+                        } else {
+                            entry.executor = passes[i].getExecutor();
+                        }
 
                         if (!view.hasVSM()) {
-                            auto const* options = shadowMap.getShadowOptions();
+                            auto const* options = entry.shadowMap->getShadowOptions();
                             const PolygonOffset polygonOffset = { // handle reversed Z
                                     .slope    = -options->polygonOffsetSlope,
                                     .constant = -options->polygonOffsetConstant
@@ -542,7 +709,7 @@ ShadowMapManager::ShadowTechnique ShadowMapManager::updateCascadeShadowMaps(FEng
 
         if (hasVisibleShadows) {
             Frustum const& frustum = shadowMap.getCamera().getCullingFrustum();
-            FView::cullRenderables(engine.getJobSystem(), renderableData, frustum,
+            FView::cullRenderables(engine, *scene, frustum,
                     VISIBLE_DIR_SHADOW_RENDERABLE_BIT);
         }
     }
@@ -653,6 +820,30 @@ ShadowMapManager::ShadowTechnique ShadowMapManager::updateCascadeShadowMaps(FEng
     return shadowTechnique;
 }
 
+utils::Range<uint32_t> ShadowMapManager::mergeVisibleMasks(
+        FScene::VisibleMaskType* UTILS_RESTRICT mergedMasks,
+        utils::Range<uint32_t> const* UTILS_RESTRICT ranges,
+        FScene::VisibleMaskType const* const* UTILS_RESTRICT visibleMasks,
+        size_t const count) noexcept {
+    if (!count) {
+        return {};
+    }
+    utils::Range<uint32_t> merged = ranges[0];
+    for (size_t i = 1; i < count; i++) {
+        merged.first = std::min(merged.first, ranges[i].first);
+        merged.last = std::max(merged.last, ranges[i].last);
+    }
+    // the ranges don't necessarily cover the whole merged range
+    std::fill(mergedMasks + merged.first, mergedMasks + merged.last, 0);
+    for (size_t i = 0; i < count; i++) {
+        FScene::VisibleMaskType const* const UTILS_RESTRICT masks = visibleMasks[i];
+        for (uint32_t const j : ranges[i]) {
+            mergedMasks[j] |= masks[j];
+        }
+    }
+    return merged;
+}
+
 void ShadowMapManager::updateSpotVisibilityMasks(
         uint8_t visibleLayers,
         uint8_t const* UTILS_RESTRICT layers,
@@ -679,8 +870,10 @@ void ShadowMapManager::updateSpotVisibilityMasks(
 
 void ShadowMapManager::prepareSpotShadowMap(ShadowMap& shadowMap,
         FEngine& engine, FView& view, CameraInfo const& mainCameraInfo,
-        FScene::RenderableSoa& renderableData, utils::Range<uint32_t> range,
-        FScene::LightSoa& lightData, ShadowMap::SceneInfo const& sceneInfo) noexcept {
+        FScene::RenderableSoa const& renderableData, utils::Range<uint32_t> range,
+        FScene::VisibleMaskType* visibleMasks,
+        FScene::LightSoa& lightData, ShadowMap::SceneInfo const& sceneInfo,
+        ShadowUib& shadowUib) const noexcept {
     auto& lcm = engine.getLightManager();
 
     const size_t lightIndex = shadowMap.getLightIndex();
@@ -704,9 +897,8 @@ void ShadowMapManager::prepareSpotShadowMap(ShadowMap& shadowMap,
     // Cull shadow casters
     float3 const* worldAABBCenter = renderableData.data<FScene::WORLD_AABB_CENTER>();
     float3 const* worldAABBExtent = renderableData.data<FScene::WORLD_AABB_EXTENT>();
-    FScene::VisibleMaskType* visibleArray = renderableData.data<FScene::VISIBLE_MASK>();
     Culler::intersects(
-            visibleArray + range.first,
+            visibleMasks + range.first,
             frustum,
             worldAABBCenter + range.first,
             worldAABBExtent + range.first,
@@ -720,7 +912,7 @@ void ShadowMapManager::prepareSpotShadowMap(ShadowMap& shadowMap,
             view.getVisibleLayers(),
             layers + range.first,
             visibility + range.first,
-            visibleArray + range.first,
+            visibleMasks + range.first,
             range.size());
 
     // update the shadow map frustum/camera
@@ -743,18 +935,18 @@ void ShadowMapManager::prepareSpotShadowMap(ShadowMap& shadowMap,
         // note: normalBias is set to zero for VSM
         const float normalBias = shadowMapInfo.vsm ? 0.0f : options->normalBias;
 
-        auto& s = mShadowUb.edit();
+        auto& shadow = shadowUib.shadows[shadowIndex];
         const double n = shadowMap.getCamera().getNear();
         const double f = shadowMap.getCamera().getCullingFar();
-        s.shadows[shadowIndex].layer = shadowMap.getLayer();
-        s.shadows[shadowIndex].lightFromWorldMatrix = shaderParameters.lightSpace;
-        s.shadows[shadowIndex].scissorNormalized = shaderParameters.scissorNormalized;
-        s.shadows[shadowIndex].normalBias = normalBias * wsTexelSizeAtOneMeter;
-        s.shadows[shadowIndex].lightFromWorldZ = shaderParameters.lightFromWorldZ;
-        s.shadows[shadowIndex].texelSizeAtOneMeter = wsTexelSizeAtOneMeter;
-        s.shadows[shadowIndex].nearOverFarMinusNear = float(n / (f - n));
-        s.shadows[shadowIndex].elvsm = options->vsm.elvsm;
-        s.shadows[shadowIndex].bulbRadiusLs =
+        shadow.layer = shadowMap.getLayer();
+        shadow.lightFromWorldMatrix = shaderParameters.lightSpace;
+        shadow.scissorNormalized = shaderParameters.scissorNormalized;
+        shadow.normalBias = normalBias * wsTexelSizeAtOneMeter;
+        shadow.lightFromWorldZ = shaderParameters.lightFromWorldZ;
+        shadow.texelSizeAtOneMeter = wsTexelSizeAtOneMeter;
+        shadow.nearOverFarMinusNear = float(n / (f - n));
+        shadow.elvsm = options->vsm.elvsm;
+        shadow.bulbRadiusLs =
                 mSoftShadowOptions.penumbraScale * options->shadowBulbRadius
                         / wsTexelSizeAtOneMeter;
 
@@ -763,9 +955,10 @@ void ShadowMapManager::prepareSpotShadowMap(ShadowMap& shadowMap,
 
 void ShadowMapManager::preparePointShadowMap(ShadowMap& shadowMap,
         FEngine& engine, FView& view, CameraInfo const& mainCameraInfo,
-        FScene::RenderableSoa& renderableData, utils::Range<uint32_t> range,
-        FScene::LightSoa& lightData,
-        ShadowMap::SceneInfo const& sceneInfo) noexcept {
+        FScene::RenderableSoa const& renderableData, utils::Range<uint32_t> range,
+        FScene::VisibleMaskType* visibleMasks,
+        FScene::LightSoa& lightData, ShadowMap::SceneInfo const& sceneInfo,
+        ShadowUib& shadowUib) const noexcept {
 
     const uint8_t face = shadowMap.getFace();
     const size_t lightIndex = shadowMap.getLightIndex();
@@ -785,9 +978,8 @@ void ShadowMapManager::preparePointShadowMap(ShadowMap& shadowMap,
     // Cull shadow casters
     float3 const* worldAABBCenter = renderableData.data<FScene::WORLD_AABB_CENTER>();
     float3 const* worldAABBExtent = renderableData.data<FScene::WORLD_AABB_EXTENT>();
-    FScene::VisibleMaskType* visibleArray = renderableData.data<FScene::VISIBLE_MASK>();
     Culler::intersects(
-            visibleArray + range.first,
+            visibleMasks + range.first,
             frustum,
             worldAABBCenter + range.first,
             worldAABBExtent + range.first,
@@ -801,7 +993,7 @@ void ShadowMapManager::preparePointShadowMap(ShadowMap& shadowMap,
             view.getVisibleLayers(),
             layers + range.first,
             visibility + range.first,
-            visibleArray + range.first,
+            visibleMasks + range.first,
             range.size());
 
     // update the shadow map frustum/camera
@@ -815,7 +1007,7 @@ void ShadowMapManager::preparePointShadowMap(ShadowMap& shadowMap,
     };
 
     auto shaderParameters = shadowMap.updatePoint(mEngine, lightData, lightIndex,
-            mainCameraInfo, shadowMapInfo, *view.getScene(), face);
+            mainCameraInfo, shadowMapInfo, visibleMasks, range, face);
 
 
     // and if we need to generate it, update all the UBO data
@@ -825,18 +1017,18 @@ void ShadowMapManager::preparePointShadowMap(ShadowMap& shadowMap,
         // note: normalBias is set to zero for VSM
         const float normalBias = shadowMapInfo.vsm ? 0.0f : options->normalBias;
 
-        auto& s = mShadowUb.edit();
+        auto& shadow = shadowUib.shadows[shadowIndex];
         const double n = shadowMap.getCamera().getNear();
         const double f = shadowMap.getCamera().getCullingFar();
-        s.shadows[shadowIndex].layer = shadowMap.getLayer();
-        s.shadows[shadowIndex].lightFromWorldMatrix = shaderParameters.lightSpace;
-        s.shadows[shadowIndex].scissorNormalized = shaderParameters.scissorNormalized;
-        s.shadows[shadowIndex].normalBias = normalBias * wsTexelSizeAtOneMeter;
-        s.shadows[shadowIndex].lightFromWorldZ = shaderParameters.lightFromWorldZ;
-        s.shadows[shadowIndex].texelSizeAtOneMeter = wsTexelSizeAtOneMeter;
-        s.shadows[shadowIndex].nearOverFarMinusNear = float(n / (f - n));
-        s.shadows[shadowIndex].elvsm = options->vsm.elvsm;
-        s.shadows[shadowIndex].bulbRadiusLs =
+        shadow.layer = shadowMap.getLayer();
+        shadow.lightFromWorldMatrix = shaderParameters.lightSpace;
+        shadow.scissorNormalized = shaderParameters.scissorNormalized;
+        shadow.normalBias = normalBias * wsTexelSizeAtOneMeter;
+        shadow.lightFromWorldZ = shaderParameters.lightFromWorldZ;
+        shadow.texelSizeAtOneMeter = wsTexelSizeAtOneMeter;
+        shadow.nearOverFarMinusNear = float(n / (f - n));
+        shadow.elvsm = options->vsm.elvsm;
+        shadow.bulbRadiusLs =
                 mSoftShadowOptions.penumbraScale * options->shadowBulbRadius
                         / wsTexelSizeAtOneMeter;
     }
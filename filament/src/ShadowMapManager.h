@@ -19,6 +19,7 @@
 
 #include <filament/Viewport.h>
 
+#include "RenderPass.h"
 #include "ShadowMap.h"
 #include "TypedUniformBuffer.h"
 
@@ -37,12 +38,12 @@
 
 #include <array>
 #include <memory>
+#include <vector>
 
 namespace filament {
 
 class FView;
 class FrameGraph;
-class RenderPass;
 
 struct ShadowMappingUniforms {
     math::float4 cascadeSplits;
@@ -103,6 +104,15 @@ public:
         return getShadowMap(0).getDebugCamera();
     }
 
+    // Merges the visibility masks of `count` spot and point shadow maps, each only valid within
+    // its own range of renderables, into mergedMasks. Returns the union of the ranges, outside of
+    // which mergedMasks is left untouched.
+    static utils::Range<uint32_t> mergeVisibleMasks(
+            FScene::VisibleMaskType* UTILS_RESTRICT mergedMasks,
+            utils::Range<uint32_t> const* UTILS_RESTRICT ranges,
+            FScene::VisibleMaskType const* const* UTILS_RESTRICT visibleMasks,
+            size_t count) noexcept;
+
 private:
     ShadowMapManager::ShadowTechnique updateCascadeShadowMaps(FEngine& engine,
             FView& view, CameraInfo cameraInfo, FScene::RenderableSoa& renderableData,
@@ -114,16 +124,21 @@ private:
     void calculateTextureRequirements(FEngine&, FView& view,
             FScene::LightSoa const&) noexcept;
 
+    // Culls the shadow casters in range into visibleMasks (indexed like renderableData), updates
+    // the shadow map and its entry in shadowUib. Can be called from any thread.
     void prepareSpotShadowMap(ShadowMap& shadowMap,
             FEngine& engine, FView& view, CameraInfo const& mainCameraInfo,
-            FScene::RenderableSoa& renderableData, utils::Range<uint32_t> range,
-            FScene::LightSoa& lightData, ShadowMap::SceneInfo const& sceneInfo) noexcept;
+            FScene::RenderableSoa const& renderableData, utils::Range<uint32_t> range,
+            FScene::VisibleMaskType* visibleMasks,
+            FScene::LightSoa& lightData, ShadowMap::SceneInfo const& sceneInfo,
+            ShadowUib& shadowUib) const noexcept;
 
     void preparePointShadowMap(ShadowMap& map,
             FEngine& engine, FView& view, CameraInfo const& mainCameraInfo,
-            FScene::RenderableSoa& renderableData, utils::Range<uint32_t> range,
-            FScene::LightSoa& lightData,
-            ShadowMap::SceneInfo const& sceneInfo) noexcept;
+            FScene::RenderableSoa const& renderableData, utils::Range<uint32_t> range,
+            FScene::VisibleMaskType* visibleMasks,
+            FScene::LightSoa& lightData, ShadowMap::SceneInfo const& sceneInfo,
+            ShadowUib& shadowUib) const noexcept;
 
     static void updateSpotVisibilityMasks(
             uint8_t visibleLayers,
@@ -189,6 +204,14 @@ private:
     uint32_t mDirectionalShadowMapCount = 0;
     uint32_t mSpotShadowMapCount = 0;
 
+    // commands of each shadow map kept across frames, see Engine::Config::renderPassCommandCache
+    std::vector<RenderPass::CommandCache> mCommandCaches;
+    RenderPass::CommandCache mSharedCommandCache;
+
+    // bitmasks of the commands rendered by each spot and point shadow map, when they share their
+    // commands, see Engine::Config::sharedShadowCasterCommands
+    std::vector<uint32_t> mSharedCommandMasks;
+
     ShadowMap& getShadowMap(size_t index) noexcept {
         assert_invariant(index < CONFIG_MAX_SHADOWMAPS);
         return *std::launder(reinterpret_cast<ShadowMap*>(&mShadowMapCache[index]));
@@ -70,6 +70,16 @@ void TransformManager::setTransform(Instance ci, const mat4& model) noexcept {
     downcast(this)->setTransform(ci, model);
 }
 
+void TransformManager::setTransforms(Instance const* instances,
+        const mat4f* models, size_t count) noexcept {
+    downcast(this)->setTransforms(instances, models, count);
+}
+
+void TransformManager::setTransforms(Instance const* instances,
+        const mat4* models, size_t count) noexcept {
+    downcast(this)->setTransforms(instances, models, count);
+}
+
 const mat4f& TransformManager::getTransform(Instance ci) const noexcept {
     return downcast(this)->getTransform(ci);
 }
@@ -174,6 +174,7 @@ void FLightManager::create(const FLightManager::Builder& builder, utils::Entity
     }
     Instance const i = manager.addComponent(entity);
     assert_invariant(i);
+    mStructureVersion++;
 
     if (i) {
         // This needs to happen before we call the set() methods below
@@ -210,6 +211,7 @@ void FLightManager::destroy(utils::Entity e) noexcept {
     if (i) {
         auto& manager = mManager;
         manager.removeComponent(e);
+        mStructureVersion++;
     }
 }
 
@@ -78,6 +78,11 @@ public:
 
     void destroy(utils::Entity e) noexcept;
 
+    // Changes each time instances are created, destroyed or moved, used by FScene::prepare().
+    uint32_t getStructureVersion() const noexcept {
+        return mStructureVersion;
+    }
+
     void prepare(backend::DriverApi& driver) const noexcept;
 
     struct LightType {
@@ -310,6 +315,7 @@ private:
 
     Sim mManager;
     FEngine& mEngine;
+    uint32_t mStructureVersion = 0;
 };
 
 FILAMENT_DOWNCAST(LightManager)
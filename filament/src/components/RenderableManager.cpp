@@ -58,6 +58,7 @@ struct RenderableManager::BuilderDetails {
     bool mScreenSpaceContactShadows : 1;
     bool mSkinningBufferMode : 1;
     bool mFogEnabled : 1;
+    bool mStaticGeometry : 1;
     size_t mSkinningBoneCount = 0;
     size_t mMorphTargetCount = 0;
     Bone const* mUserBones = nullptr;
@@ -75,7 +76,8 @@ struct RenderableManager::BuilderDetails {
     explicit BuilderDetails(size_t count)
             : mEntries(count), mCulling(true), mCastShadows(false),
               mReceiveShadows(true), mScreenSpaceContactShadows(false),
-              mSkinningBufferMode(false),  mFogEnabled(true), mBonePairs() {
+              mSkinningBufferMode(false),  mFogEnabled(true), mStaticGeometry(false),
+              mBonePairs() {
     }
     // this is only needed for the explicit instantiation below
     BuilderDetails() = default;
@@ -237,6 +239,11 @@ RenderableManager::Builder& RenderableManager::Builder::fog(bool enabled) noexce
     return *this;
 }
 
+RenderableManager::Builder& RenderableManager::Builder::staticGeometry(bool enabled) noexcept {
+    mImpl->mStaticGeometry = enabled;
+    return *this;
+}
+
 RenderableManager::Builder& RenderableManager::Builder::morphing(size_t targetCount) noexcept {
     mImpl->mMorphTargetCount = targetCount;
     return *this;
@@ -390,11 +397,13 @@ RenderableManager::Builder::Result RenderableManager::Builder::build(Engine& eng
 
     ASSERT_PRECONDITION(mImpl->mSkinningBoneCount <= CONFIG_MAX_BONE_COUNT,
             "bone count > %u", CONFIG_MAX_BONE_COUNT);
-    ASSERT_PRECONDITION(mImpl->mInstanceCount <= CONFIG_MAX_INSTANCES || !mImpl->mInstanceBuffer,
-            "instance count is %zu, but instance count is limited to CONFIG_MAX_INSTANCES (%zu) "
-            "instances when supplying transforms via an InstanceBuffer.",
+    ASSERT_PRECONDITION(mImpl->mInstanceCount <= engine.getMaxAutomaticInstances() ||
+                    !mImpl->mInstanceBuffer,
+            "instance count is %zu, but instance count is limited to "
+            "Engine::getMaxAutomaticInstances() (%zu) instances when supplying transforms via an "
+            "InstanceBuffer.",
             mImpl->mInstanceCount,
-            CONFIG_MAX_INSTANCES);
+            engine.getMaxAutomaticInstances());
     if (mImpl->mInstanceBuffer) {
         size_t const bufferInstanceCount = mImpl->mInstanceBuffer->mInstanceCount;
         ASSERT_PRECONDITION(mImpl->mInstanceCount <= bufferInstanceCount,
@@ -474,7 +483,8 @@ RenderableManager::Builder& RenderableManager::Builder::instances(size_t instanc
 
 RenderableManager::Builder& RenderableManager::Builder::instances(
         size_t instanceCount, InstanceBuffer* instanceBuffer) noexcept {
-    mImpl->mInstanceCount = clamp(instanceCount, (size_t)1, CONFIG_MAX_INSTANCES);
+    // the upper limit depends on the Engine, it's checked in build()
+    mImpl->mInstanceCount = clamp(instanceCount, (size_t)1, CONFIG_MAX_INSTANCES_LARGE);
     mImpl->mInstanceBuffer = downcast(instanceBuffer);
     return *this;
 }
@@ -502,6 +512,7 @@ void FRenderableManager::create(
     }
     Instance const ci = manager.addComponent(entity);
     assert_invariant(ci);
+    mStructureVersion++;
 
     if (ci) {
         // create and initialize all needed RenderPrimitives
@@ -526,6 +537,7 @@ void FRenderableManager::create(
         setSkinning(ci, false);
         setMorphing(ci, builder->mMorphTargetCount);
         setFogEnabled(ci, builder->mFogEnabled);
+        setStaticGeometry(ci, builder->mStaticGeometry);
         mManager[ci].channels = builder->mLightChannels;
 
         InstancesInfo& instances = manager[ci].instances;
@@ -533,10 +545,10 @@ void FRenderableManager::create(
         instances.buffer = builder->mInstanceBuffer;
         if (instances.buffer) {
             // Allocate our instance buffer for this Renderable. We always allocate a size to match
-            // PerRenderableUib, regardless of the number of instances. This is because the buffer
-            // will get bound to the PER_RENDERABLE UBO, and we can't bind a buffer smaller than the
-            // full size of the UBO.
-            instances.handle = driver.createBufferObject(sizeof(PerRenderableUib),
+            // the PER_RENDERABLE uniform block, regardless of the number of instances. This is
+            // because the buffer will get bound to the PER_RENDERABLE UBO, and we can't bind a
+            // buffer smaller than the full size of the UBO.
+            instances.handle = driver.createBufferObject(engine.getPerRenderableUibSize(),
                     BufferObjectBinding::UNIFORM, backend::BufferUsage::DYNAMIC);
         }
 
@@ -667,6 +679,7 @@ void FRenderableManager::destroy(utils::Entity e) noexcept {
     if (ci) {
         destroyComponent(ci);
         mManager.removeComponent(e);
+        mStructureVersion++;
     }
 }
 
@@ -754,6 +767,7 @@ void FRenderableManager::setMaterialInstanceAt(Instance instance, uint8_t level,
                     material->getName().c_str_safe(), (uint8_t)material->getFeatureLevel());
 
             primitives[primitiveIndex].setMaterialInstance(mi);
+            markDirty(instance);
             AttributeBitset const required = material->getRequiredAttributes();
             AttributeBitset const declared = primitives[primitiveIndex].getEnabledAttributes();
             if (UTILS_UNLIKELY((declared & required) != required)) {
@@ -784,6 +798,7 @@ void FRenderableManager::setBlendOrderAt(Instance instance, uint8_t level,
         Slice<FRenderPrimitive>& primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             primitives[primitiveIndex].setBlendOrder(order);
+            markDirty(instance);
         }
     }
 }
@@ -794,6 +809,7 @@ void FRenderableManager::setGlobalBlendOrderEnabledAt(Instance instance, uint8_t
         Slice<FRenderPrimitive>& primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             primitives[primitiveIndex].setGlobalBlendOrderEnabled(enabled);
+            markDirty(instance);
         }
     }
 }
@@ -817,6 +833,7 @@ void FRenderableManager::setGeometryAt(Instance instance, uint8_t level, size_t
         if (primitiveIndex < primitives.size()) {
             primitives[primitiveIndex].set(mHwRenderPrimitiveFactory, mEngine.getDriverApi(),
                     type, vertices, indices, offset, 0, vertices->getVertexCount() - 1, count);
+            markDirty(instance);
         }
     }
 }
@@ -883,6 +900,7 @@ void FRenderableManager::setSkinningBuffer(FRenderableManager::Instance ci,
     bones.handle = skinningBuffer->getHwHandle();
     bones.count = uint16_t(count);
     bones.offset = uint16_t(offset);
+    markDirty(ci);
 }
 
 static void updateMorphWeights(FEngine& engine, backend::Handle<backend::HwBufferObject> handle,
@@ -925,6 +943,7 @@ void FRenderableManager::setMorphTargetBufferAt(Instance instance, uint8_t level
         if (primitiveIndex < morphTargets.size()) {
             morphTargets[primitiveIndex] = { morphTargetBuffer, (uint32_t)offset,
                                              (uint32_t)count };
+            markDirty(instance);
         }
     }
 }
@@ -954,6 +973,7 @@ void FRenderableManager::setLightChannel(Instance ci, unsigned int channel, bool
             const uint8_t mask = 1u << channel;
             mManager[ci].channels &= ~mask;
             mManager[ci].channels |= enable ? mask : 0u;
+            markDirty(ci);
         }
     }
 }
@@ -65,6 +65,7 @@ public:
         bool screenSpaceContactShadows  : 1;
         bool reversedWindingOrder       : 1;
         bool fog                        : 1;
+        bool staticGeometry             : 1;
     };
 
     static_assert(sizeof(Visibility) == sizeof(uint16_t), "Visibility should be 16 bits");
@@ -115,6 +116,28 @@ public:
 
     void destroy(utils::Entity e) noexcept;
 
+    /*
+     * Change tracking, used by FScene::prepare().
+     *
+     * Instances are stamped with the current epoch each time the state mirrored by
+     * FScene::RenderableSoa changes. A client records the epoch returned by advanceEpoch() and
+     * later considers instances stamped with a more recent epoch as dirty.
+     * The structure version changes each time instances are created, destroyed or moved, which
+     * invalidates all instances held by clients.
+     */
+
+    uint32_t getVersion(Instance instance) const noexcept {
+        return mManager[instance].version;
+    }
+
+    uint32_t getStructureVersion() const noexcept {
+        return mStructureVersion;
+    }
+
+    uint32_t advanceEpoch() noexcept {
+        return mEpoch++;
+    }
+
     inline void setAxisAlignedBoundingBox(Instance instance, const Box& aabb) noexcept;
 
     inline void setLayerMask(Instance instance, uint8_t select, uint8_t values) noexcept;
@@ -133,6 +156,8 @@ public:
     inline void setCulling(Instance instance, bool enable) noexcept;
     inline void setFogEnabled(Instance instance, bool enable) noexcept;
     inline bool getFogEnabled(Instance instance) const noexcept;
+    inline void setStaticGeometry(Instance instance, bool enable) noexcept;
+    inline bool isStaticGeometry(Instance instance) const noexcept;
 
     inline void setPrimitives(Instance instance, utils::Slice<FRenderPrimitive> const& primitives) noexcept;
 
@@ -210,6 +235,11 @@ public:
 
 private:
     void destroyComponent(Instance ci) noexcept;
+
+    void markDirty(Instance instance) noexcept {
+        mManager[instance].version = mEpoch;
+    }
+
     static void destroyComponentPrimitives(
             HwRenderPrimitiveFactory& factory, backend::DriverApi& driver,
             utils::Slice<FRenderPrimitive>& primitives) noexcept;
@@ -241,7 +271,8 @@ private:
         VISIBILITY,             // user data
         PRIMITIVES,             // user data
         BONES,                  // filament data, UBO storing a pointer to the bones information
-        MORPH_TARGETS
+        MORPH_TARGETS,
+        VERSION                 // filament data, epoch of the last change
     };
 
     using Base = utils::SingleInstanceComponentManager<
@@ -253,7 +284,8 @@ private:
             Visibility,                      // VISIBILITY
             utils::Slice<FRenderPrimitive>,  // PRIMITIVES
             Bones,                           // BONES
-            utils::Slice<MorphTargets>       // MORPH_TARGETS
+            utils::Slice<MorphTargets>,      // MORPH_TARGETS
+            uint32_t                         // VERSION
     >;
 
     struct Sim : public Base {
@@ -277,6 +309,7 @@ private:
                 Field<PRIMITIVES>           primitives;
                 Field<BONES>                bones;
                 Field<MORPH_TARGETS>        morphTargets;
+                Field<VERSION>              version;
             };
         };
 
@@ -291,6 +324,8 @@ private:
     Sim mManager;
     FEngine& mEngine;
     HwRenderPrimitiveFactory mHwRenderPrimitiveFactory;
+    uint32_t mEpoch = 1;
+    uint32_t mStructureVersion = 0;
 };
 
 FILAMENT_DOWNCAST(RenderableManager)
@@ -298,6 +333,7 @@ FILAMENT_DOWNCAST(RenderableManager)
 void FRenderableManager::setAxisAlignedBoundingBox(Instance instance, const Box& aabb) noexcept {
     if (instance) {
         mManager[instance].aabb = aabb;
+        markDirty(instance);
     }
 }
 
@@ -306,12 +342,14 @@ void FRenderableManager::setLayerMask(Instance instance,
     if (instance) {
         uint8_t& layers = mManager[instance].layers;
         layers = (layers & ~select) | (values & select);
+        markDirty(instance);
     }
 }
 
 void FRenderableManager::setLayerMask(Instance instance, uint8_t layerMask) noexcept {
     if (instance) {
         mManager[instance].layers = layerMask;
+        markDirty(instance);
     }
 }
 
@@ -319,6 +357,7 @@ void FRenderableManager::setPriority(Instance instance, uint8_t priority) noexce
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.priority = std::min(priority, uint8_t(0x7));
+        markDirty(instance);
     }
 }
 
@@ -326,6 +365,7 @@ void FRenderableManager::setChannel(Instance instance, uint8_t channel) noexcept
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.channel = std::min(channel, uint8_t(0x3));
+        markDirty(instance);
     }
 }
 
@@ -333,6 +373,7 @@ void FRenderableManager::setCastShadows(Instance instance, bool enable) noexcept
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.castShadows = enable;
+        markDirty(instance);
     }
 }
 
@@ -340,6 +381,7 @@ void FRenderableManager::setReceiveShadows(Instance instance, bool enable) noexc
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.receiveShadows = enable;
+        markDirty(instance);
     }
 }
 
@@ -347,6 +389,7 @@ void FRenderableManager::setScreenSpaceContactShadows(Instance instance, bool en
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.screenSpaceContactShadows = enable;
+        markDirty(instance);
     }
 }
 
@@ -354,6 +397,7 @@ void FRenderableManager::setCulling(Instance instance, bool enable) noexcept {
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.culling = enable;
+        markDirty(instance);
     }
 }
 
@@ -361,6 +405,7 @@ void FRenderableManager::setFogEnabled(Instance instance, bool enable) noexcept
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.fog = enable;
+        markDirty(instance);
     }
 }
 
@@ -368,10 +413,23 @@ bool FRenderableManager::getFogEnabled(RenderableManager::Instance instance) con
     return getVisibility(instance).fog;
 }
 
+void FRenderableManager::setStaticGeometry(Instance instance, bool enable) noexcept {
+    if (instance) {
+        Visibility& visibility = mManager[instance].visibility;
+        visibility.staticGeometry = enable;
+        markDirty(instance);
+    }
+}
+
+bool FRenderableManager::isStaticGeometry(Instance instance) const noexcept {
+    return getVisibility(instance).staticGeometry;
+}
+
 void FRenderableManager::setSkinning(Instance instance, bool enable) noexcept {
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.skinning = enable;
+        markDirty(instance);
     }
 }
 
@@ -379,6 +437,7 @@ void FRenderableManager::setMorphing(Instance instance, bool enable) noexcept {
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.morphing = enable;
+        markDirty(instance);
     }
 }
 
@@ -19,8 +19,13 @@
 #include <math/mat4.h>
 
 #include <utils/debug.h>
+#include <utils/JobSystem.h>
+#include <utils/Systrace.h>
 #include <filament/TransformManager.h>
 
+#include <algorithm>
+#include <functional>
+#include <vector>
 
 using namespace utils;
 using namespace filament::math;
@@ -44,6 +49,12 @@ void FTransformManager::setAccurateTranslationsEnabled(bool enable) noexcept {
     }
 }
 
+void FTransformManager::setParallelTransforms(JobSystem* js, size_t threshold) noexcept {
+    mJobSystem = threshold ? js : nullptr;
+    mParallelThreshold = threshold;
+    mHierarchyChanged = true;
+}
+
 void FTransformManager::create(Entity entity) {
     create(entity, 0, mat4f{});
 }
@@ -59,6 +70,7 @@ void FTransformManager::create(Entity entity, Instance parent, const mat4f& loca
     Instance const i = manager.addComponent(entity);
     assert_invariant(i);
     assert_invariant(i != parent);
+    mStructureVersion++;
 
     if (i && i != parent) {
         manager[i].parent = 0;
@@ -81,6 +93,7 @@ void FTransformManager::create(Entity entity, Instance parent, const mat4& local
     Instance const i = manager.addComponent(entity);
     assert_invariant(i);
     assert_invariant(i != parent);
+    mStructureVersion++;
 
     if (i && i != parent) {
         manager[i].parent = 0;
@@ -159,6 +172,7 @@ void FTransformManager::destroy(Entity e) noexcept {
 
         // 2) remove the component
         Instance const moved = manager.removeComponent(e);
+        mStructureVersion++;
 
         // 3) update the references to the entry now with Instance i
         if (moved != i) {
@@ -174,6 +188,7 @@ void FTransformManager::setTransform(Instance ci, const mat4f& model) noexcept {
         // store our local transform
         manager[ci].local = model;
         manager[ci].localTranslationLo = {};
+        manager[ci].version = mEpoch;
         updateNodeTransform(ci);
     }
 }
@@ -185,10 +200,64 @@ void FTransformManager::setTransform(Instance ci, const mat4& model) noexcept {
         // store our local transform + accurate translation information
         manager[ci].local = mat4f(model);
         manager[ci].localTranslationLo = float3{ model[3].xyz - float3{ model[3].xyz }};
+        manager[ci].version = mEpoch;
         updateNodeTransform(ci);
     }
 }
 
+void FTransformManager::setTransforms(Instance const* UTILS_RESTRICT instances,
+        const mat4f* UTILS_RESTRICT models, size_t count) noexcept {
+    auto& manager = mManager;
+    uint32_t const epoch = mEpoch;
+    for (size_t k = 0; k < count; k++) {
+        Instance const ci = instances[k];
+        validateNode(ci);
+        if (UTILS_LIKELY(ci)) {
+            manager.elementAt<LOCAL>(ci) = models[k];
+            manager.elementAt<LOCAL_LO>(ci) = {};
+            manager.elementAt<VERSION>(ci) = epoch;
+        }
+    }
+    updateWorldTransforms(instances, count);
+}
+
+void FTransformManager::setTransforms(Instance const* UTILS_RESTRICT instances,
+        const mat4* UTILS_RESTRICT models, size_t count) noexcept {
+    auto& manager = mManager;
+    uint32_t const epoch = mEpoch;
+    for (size_t k = 0; k < count; k++) {
+        Instance const ci = instances[k];
+        validateNode(ci);
+        if (UTILS_LIKELY(ci)) {
+            mat4 const& model = models[k];
+            manager.elementAt<LOCAL>(ci) = mat4f(model);
+            manager.elementAt<LOCAL_LO>(ci) = float3{ model[3].xyz - float3{ model[3].xyz }};
+            manager.elementAt<VERSION>(ci) = epoch;
+        }
+    }
+    updateWorldTransforms(instances, count);
+}
+
+void FTransformManager::updateWorldTransforms(
+        Instance const* UTILS_RESTRICT instances, size_t count) noexcept {
+    if (UTILS_UNLIKELY(mLocalTransformTransactionOpen)) {
+        return;
+    }
+    // A single pass over all the transforms visits each of them only once, but costs the same
+    // regardless of how many were set, so when only a few were set, we update their subtrees.
+    // Subtrees can overlap, in which case some transforms are computed more than once.
+    // Either way, the nodes don't move, so that the caller's Instances stay valid.
+    if (count * 8 < mManager.getComponentCount()) {
+        for (size_t k = 0; k < count; k++) {
+            if (UTILS_LIKELY(instances[k])) {
+                updateNodeTransform(instances[k]);
+            }
+        }
+    } else {
+        computeAllWorldTransformsInPlace();
+    }
+}
+
 void FTransformManager::updateNodeTransform(Instance i) noexcept {
     if (UTILS_UNLIKELY(mLocalTransformTransactionOpen)) {
         return;
@@ -206,6 +275,7 @@ void FTransformManager::updateNodeTransform(Instance i) noexcept {
             manager[parent].world, manager[i].local,
             manager[parent].worldTranslationLo, manager[i].localTranslationLo,
             mAccurateTranslations);
+    manager[i].version = mEpoch;
 
     // update our children's world transforms
     Instance const child = manager[i].firstChild;
@@ -228,8 +298,16 @@ void FTransformManager::commitLocalTransformTransaction() noexcept {
 void FTransformManager::computeAllWorldTransforms() noexcept {
     auto& manager = mManager;
 
+    if (mJobSystem && manager.getComponentCount() >= mParallelThreshold) {
+        computeAllWorldTransformsByLevel();
+        return;
+    }
+    // the next parallel update must sort the nodes again
+    mHierarchyChanged = true;
+
     // swapNode() below needs some temporary storage which we provide here
     const bool accurate = mAccurateTranslations;
+    const uint32_t epoch = mEpoch;
     auto& soa = manager.getSoA();
     soa.ensureCapacity(soa.size() + 1);
 
@@ -238,20 +316,171 @@ void FTransformManager::computeAllWorldTransforms() noexcept {
         while (UTILS_UNLIKELY(Instance(manager[i].parent) > i)) {
             swapNode(i, manager[i].parent);
         }
-        Instance const parent = manager[i].parent;
-        assert_invariant(parent < i);
+        assert_invariant(Instance(manager[i].parent) < i);
+        updateWorldTransform(manager, i, accurate, epoch);
+    }
+}
 
-        FTransformManager::computeWorldTransform(
-                manager[i].world, manager[i].worldTranslationLo,
-                manager[parent].world, manager[i].local,
-                manager[parent].worldTranslationLo, manager[i].localTranslationLo,
-                accurate);
+void FTransformManager::computeAllWorldTransformsByLevel() noexcept {
+    SYSTRACE_CALL();
+    auto& manager = mManager;
+
+    if (mHierarchyChanged) {
+        sortNodesByLevel();
+        mHierarchyChanged = false;
+    }
+
+    // The parents of a level are all in the previous levels, so all the nodes of a level can be
+    // computed in parallel.
+    const bool accurate = mAccurateTranslations;
+    const uint32_t epoch = mEpoch;
+    auto work = [&manager, accurate, epoch](uint32_t start, uint32_t count) {
+        for (Instance i(start), e(start + count); i != e; ++i) {
+            updateWorldTransform(manager, i, accurate, epoch);
+        }
+    };
+
+    // below this many nodes, a level is computed faster on the calling thread
+    constexpr uint32_t PARALLEL_LEVEL_MIN_SIZE = 1024;
+
+    JobSystem& js = *mJobSystem;
+    for (size_t level = 0; level + 1 < mLevels.size(); level++) {
+        uint32_t const start = mLevels[level];
+        uint32_t const count = mLevels[level + 1] - start;
+        if (count < PARALLEL_LEVEL_MIN_SIZE) {
+            work(start, count);
+        } else {
+            auto* job = jobs::parallel_for(js, nullptr, start, count,
+                    std::cref(work), jobs::CountSplitter<256, 5>());
+            js.runAndWait(job);
+        }
+    }
+}
+
+void FTransformManager::computeAllWorldTransformsInPlace() noexcept {
+    SYSTRACE_CALL();
+    auto& manager = mManager;
+
+    // Unlike computeAllWorldTransforms(), this doesn't sort the nodes so that children come after
+    // their parent, instead each hierarchy is traversed from its root.
+    const bool accurate = mAccurateTranslations;
+    const uint32_t epoch = mEpoch;
+    for (Instance i = manager.begin(), e = manager.end(); i != e; ++i) {
+        if (!Instance(manager[i].parent)) {
+            updateWorldTransform(manager, i, accurate, epoch);
+            Instance const child = manager[i].firstChild;
+            if (UTILS_UNLIKELY(child)) {
+                updateSubtreeWorldTransforms(manager, child, accurate, epoch);
+            }
+        }
+    }
+}
+
+void FTransformManager::sortNodesByLevel() noexcept {
+    SYSTRACE_CALL();
+    auto& manager = mManager;
+    Instance const end = manager.end();
+
+    // 1. compute the depth of each node, its parent might not be before it in the array
+    constexpr uint32_t UNKNOWN = ~0u;
+    std::vector<uint32_t> depths(end, UNKNOWN);
+    std::vector<Instance> ancestors;
+    uint32_t maxDepth = 0;
+    for (Instance i = manager.begin(); i != end; ++i) {
+        Instance n = i;
+        while (n && depths[n] == UNKNOWN) {
+            ancestors.push_back(n);
+            n = manager[n].parent;
+        }
+        uint32_t depth = n ? depths[n] + 1 : 0;
+        while (!ancestors.empty()) {
+            depths[ancestors.back()] = depth++;
+            ancestors.pop_back();
+        }
+        maxDepth = std::max(maxDepth, depths[i]);
+    }
+
+    // 2. find where each level starts, and the node wanted at each position. The relative order
+    // of the nodes within a level is preserved.
+    mLevels.assign(maxDepth + 2, 0);
+    for (Instance i = manager.begin(); i != end; ++i) {
+        mLevels[depths[i] + 1]++;
+    }
+    mLevels[0] = manager.begin();
+    for (size_t level = 1; level < mLevels.size(); level++) {
+        mLevels[level] += mLevels[level - 1];
+    }
+    std::vector<uint32_t> order(end);
+    std::vector<uint32_t> offsets(mLevels.begin(), mLevels.end() - 1);
+    for (Instance i = manager.begin(); i != end; ++i) {
+        order[offsets[depths[i]]++] = i;
+    }
+
+    // 3. move the nodes into place, swapNode() needs some temporary storage past the end.
+    // 'nodes' is the node at each position, and 'positions' the position of each node, both
+    // identified by their position before sorting.
+    auto& soa = manager.getSoA();
+    soa.ensureCapacity(soa.size() + 1);
+    std::vector<uint32_t> nodes(end);
+    std::vector<uint32_t> positions(end);
+    for (uint32_t i = 0; i < uint32_t(end); i++) {
+        nodes[i] = i;
+        positions[i] = i;
+    }
+    for (Instance i = manager.begin(); i != end; ++i) {
+        uint32_t const node = order[i];
+        uint32_t const position = positions[node];
+        if (position != uint32_t(i)) {
+            swapNode(i, position);
+            positions[nodes[i]] = position;
+            nodes[position] = nodes[i];
+            positions[node] = i;
+            nodes[i] = node;
+        }
+    }
+}
+
+void FTransformManager::updateWorldTransform(Sim& manager, Instance i,
+        bool accurate, uint32_t epoch) noexcept {
+    Instance const parent = manager[i].parent;
+
+    // only stamp the transforms that actually changed, so that committing a transaction
+    // doesn't invalidate the whole hierarchy.
+    mat4f const world = manager[i].world;
+    float3 const worldTranslationLo = manager[i].worldTranslationLo;
+
+    FTransformManager::computeWorldTransform(
+            manager[i].world, manager[i].worldTranslationLo,
+            manager[parent].world, manager[i].local,
+            manager[parent].worldTranslationLo, manager[i].localTranslationLo,
+            accurate);
+
+    if (UTILS_UNLIKELY(hasChanged(world, worldTranslationLo,
+            manager[i].world, manager[i].worldTranslationLo))) {
+        manager[i].version = epoch;
+    }
+}
+
+void FTransformManager::updateSubtreeWorldTransforms(Sim& manager, Instance i,
+        bool accurate, uint32_t epoch) noexcept {
+    while (i) {
+        updateWorldTransform(manager, i, accurate, epoch);
+
+        // assume we don't have a deep hierarchy
+        Instance const child = manager[i].firstChild;
+        if (UTILS_UNLIKELY(child)) {
+            updateSubtreeWorldTransforms(manager, child, accurate, epoch);
+        }
+
+        // process our next sibling
+        i = manager[i].next;
     }
 }
 
 // Inserts a parentless node in the hierarchy
 void FTransformManager::insertNode(Instance i, Instance parent) noexcept {
     auto& manager = mManager;
+    mHierarchyChanged = true;
 
     assert_invariant(manager[i].parent == Instance{});
 
@@ -285,7 +514,9 @@ void FTransformManager::swapNode(Instance i, Instance j) noexcept {
     std::swap(manager.elementAt<LOCAL_LO>(i), manager.elementAt<LOCAL_LO>(j));
     std::swap(manager.elementAt<WORLD>(i),    manager.elementAt<WORLD>(j));
     std::swap(manager.elementAt<WORLD_LO>(i), manager.elementAt<WORLD_LO>(j));
+    std::swap(manager.elementAt<VERSION>(i),  manager.elementAt<VERSION>(j));
     manager.swap(i, j); // this swaps the data relative to SingleInstanceComponentManager
+    mStructureVersion++;
 
     // now swap the linked-list references, to do that correctly we must use a temporary
     // node to fix-up the linked-list pointers
@@ -318,6 +549,7 @@ void FTransformManager::swapNode(Instance i, Instance j) noexcept {
 // (making everybody orphaned).
 void FTransformManager::removeNode(Instance i) noexcept {
     auto& manager = mManager;
+    mHierarchyChanged = true;
     Instance const parent = manager[i].parent;
     Instance const prev = manager[i].prev;
     Instance const next = manager[i].next;
@@ -373,6 +605,7 @@ void FTransformManager::updateNode(Instance i) noexcept {
 
 void FTransformManager::transformChildren(Sim& manager, Instance i) noexcept {
     const bool accurate = mAccurateTranslations;
+    const uint32_t epoch = mEpoch;
     while (i) {
         // update child's world transform
         Instance const parent = manager[i].parent;
@@ -381,6 +614,7 @@ void FTransformManager::transformChildren(Sim& manager, Instance i) noexcept {
                 manager[parent].world, manager[i].local,
                 manager[parent].worldTranslationLo, manager[i].localTranslationLo,
                 accurate);
+        manager[i].version = epoch;
 
         // assume we don't have a deep hierarchy
         Instance const child = manager[i].firstChild;
@@ -428,6 +662,14 @@ void FTransformManager::computeWorldTransform(
 }
 
 
+bool FTransformManager::hasChanged(
+        mat4f const& oldWorld, float3 const& oldWorldTranslationLo,
+        mat4f const& newWorld, float3 const& newWorldTranslationLo) noexcept {
+    return oldWorld[0] != newWorld[0] || oldWorld[1] != newWorld[1] ||
+           oldWorld[2] != newWorld[2] || oldWorld[3] != newWorld[3] ||
+           oldWorldTranslationLo != newWorldTranslationLo;
+}
+
 void FTransformManager::validateNode(UTILS_UNUSED_IN_RELEASE Instance i) noexcept {
 #ifndef NDEBUG
     auto& manager = mManager;
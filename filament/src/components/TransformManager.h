@@ -28,6 +28,15 @@
 
 #include <math/mat4.h>
 
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace utils {
+class JobSystem;
+} // namespace utils
+
 namespace filament {
 
 class UTILS_PRIVATE FTransformManager : public TransformManager {
@@ -75,6 +84,11 @@ public:
         return mAccurateTranslations;
     }
 
+    // When there are at least 'threshold' components, commitLocalTransformTransaction() stores
+    // the hierarchy breadth-first and computes the world transforms of each level in parallel.
+    // A null JobSystem or a threshold of 0 disables this. See Engine::Config.
+    void setParallelTransforms(utils::JobSystem* js, size_t threshold) noexcept;
+
     void create(utils::Entity entity);
 
     void create(utils::Entity entity, Instance parent, const math::mat4f& localTransform);
@@ -109,6 +123,10 @@ public:
 
     void setTransform(Instance ci, const math::mat4& model) noexcept;
 
+    void setTransforms(Instance const* instances, const math::mat4f* models, size_t count) noexcept;
+
+    void setTransforms(Instance const* instances, const math::mat4* models, size_t count) noexcept;
+
     const math::mat4f& getTransform(Instance ci) const noexcept {
         return mManager[ci].local;
     }
@@ -133,6 +151,26 @@ public:
         return r;
     }
 
+    /*
+     * Change tracking, used by FScene::prepare().
+     *
+     * Instances are stamped with the current epoch each time their local or world transform
+     * changes. The structure version changes each time instances are created, destroyed or
+     * moved. See FRenderableManager.
+     */
+
+    uint32_t getVersion(Instance ci) const noexcept {
+        return mManager[ci].version;
+    }
+
+    uint32_t getStructureVersion() const noexcept {
+        return mStructureVersion;
+    }
+
+    uint32_t advanceEpoch() noexcept {
+        return mEpoch++;
+    }
+
 private:
     struct Sim;
 
@@ -144,13 +182,26 @@ private:
     void swapNode(Instance i, Instance j) noexcept;
     void transformChildren(Sim& manager, Instance firstChild) noexcept;
 
+    void updateWorldTransforms(Instance const* instances, size_t count) noexcept;
     void computeAllWorldTransforms() noexcept;
+    void computeAllWorldTransformsByLevel() noexcept;
+    void computeAllWorldTransformsInPlace() noexcept;
+    void sortNodesByLevel() noexcept;
+
+    static void updateWorldTransform(Sim& manager, Instance i,
+            bool accurate, uint32_t epoch) noexcept;
+    static void updateSubtreeWorldTransforms(Sim& manager, Instance firstChild,
+            bool accurate, uint32_t epoch) noexcept;
 
     static void computeWorldTransform(math::mat4f& outWorld, math::float3& inoutWorldTranslationLo,
             math::mat4f const& pt, math::mat4f const& local,
             math::float3 const& ptTranslationLo, math::float3 const& localTranslationLo,
             bool accurate);
 
+    static bool hasChanged(
+            math::mat4f const& oldWorld, math::float3 const& oldWorldTranslationLo,
+            math::mat4f const& newWorld, math::float3 const& newWorldTranslationLo) noexcept;
+
     friend class TransformManager::children_iterator;
 
     enum {
@@ -162,6 +213,7 @@ private:
         FIRST_CHILD,    // instance to our first child
         NEXT,           // instance to our next sibling
         PREV,           // instance to our previous sibling
+        VERSION,        // epoch of the last change
     };
 
     using Base = utils::SingleInstanceComponentManager<
@@ -172,7 +224,8 @@ private:
             Instance,       // parent
             Instance,       // firstChild
             Instance,       // next
-            Instance        // prev
+            Instance,       // prev
+            uint32_t        // version
     >;
 
     struct Sim : public Base {
@@ -197,6 +250,7 @@ private:
                 Field<FIRST_CHILD>  firstChild;
                 Field<NEXT>         next;
                 Field<PREV>         prev;
+                Field<VERSION>      version;
             };
         };
 
@@ -209,8 +263,16 @@ private:
     };
 
     Sim mManager;
+    uint32_t mEpoch = 1;
+    uint32_t mStructureVersion = 0;
     bool mLocalTransformTransactionOpen = false;
     bool mAccurateTranslations = false;
+
+    // Parallel transforms. Once sorted, level n spans [mLevels[n], mLevels[n + 1]).
+    utils::JobSystem* mJobSystem = nullptr;
+    size_t mParallelThreshold = 0;
+    std::vector<uint32_t> mLevels;
+    bool mHierarchyChanged = true;
 };
 
 FILAMENT_DOWNCAST(TransformManager)
@@ -681,8 +681,9 @@ FColorGrading::FColorGrading(FEngine& engine, const Builder& builder) {
     // Multithreadedly generate the tone mapping 3D look-up table using 32 jobs
     // Slices are 8 KiB (128 cache lines) apart.
     // This takes about 3-6ms on Android in Release
+    // The slices run in the background lane, so they don't delay frame-critical jobs.
     JobSystem& js = engine.getJobSystem();
-    auto *slices = js.createJob();
+    auto *slices = js.createJob(nullptr, JobSystem::Lane::BACKGROUND);
     for (size_t b = 0; b < c.lutDimension; b++) {
         auto *job = js.createJob(slices,
                 [data, converted, b, &c, &configLock, builder](JobSystem&, JobSystem::Job*) {
@@ -38,6 +38,10 @@
 
 #include <filament/MaterialEnums.h>
 
+#include <private/filament/EngineEnums.h>
+#include <private/filament/UibStructs.h>
+
+#include <private/backend/CommandStreamProfiler.h>
 #include <private/backend/PlatformFactory.h>
 
 #include <backend/DriverEnums.h>
@@ -51,6 +55,7 @@
 #include <utils/ThreadUtils.h>
 
 #include <algorithm>
+#include <array>
 #include <memory>
 
 #include "generated/resources/materials.h"
@@ -202,7 +207,8 @@ FEngine::FEngine(Engine::Builder const& builder) :
         mCameraManager(*this),
         mCommandBufferQueue(
                 builder->mConfig.minCommandBufferSizeMB * MiB,
-                builder->mConfig.commandBufferSizeMB * MiB),
+                builder->mConfig.commandBufferSizeMB * MiB,
+                builder->mConfig.maxCommandBufferSizeMB * MiB),
         mPerRenderPassAllocator(
                 "FEngine::mPerRenderPassAllocator",
                 builder->mConfig.perRenderPassArenaSizeMB * MiB),
@@ -218,6 +224,14 @@ FEngine::FEngine(Engine::Builder const& builder) :
     // (it may not be the case)
     mJobSystem.adopt();
 
+    mTransformManager.setParallelTransforms(&mJobSystem, mConfig.parallelTransformThreshold);
+
+    // the capture starts in init(), which can be called after the builder is gone
+    if (mConfig.commandStreamCapturePath) {
+        mCommandStreamCapturePath = CString(mConfig.commandStreamCapturePath);
+        mConfig.commandStreamCapturePath = mCommandStreamCapturePath.c_str();
+    }
+
     slog.i << "FEngine (" << sizeof(void*) * 8 << " bits) created at " << this << " "
            << "(threading is " << (UTILS_HAS_THREADING ? "enabled)" : "disabled)") << io::endl;
 }
@@ -248,6 +262,19 @@ void FEngine::init() {
 
     DriverApi& driverApi = getDriverApi();
 
+    // a burst of commands that doesn't fit in the space guaranteed by the last flush waits for
+    // the driver thread to free more space.
+    driverApi.setOverflowHandler([this](size_t size) {
+        mCommandBufferQueue.reserve(size);
+    });
+
+    if (UTILS_UNLIKELY(mConfig.commandStreamCapturePath)) {
+        if (driverApi.startCommandCapture(mConfig.commandStreamCapturePath)) {
+            slog.i << "Capturing the command stream to "
+                   << mConfig.commandStreamCapturePath << io::endl;
+        }
+    }
+
 #if defined(FILAMENT_SUPPORTS_OPENXR)
     VulkanOpenxrPlatform* ptr = dynamic_cast<VulkanOpenxrPlatform*>(mPlatform);
     if (ptr) ptr->driverApi = &driverApi;
@@ -262,6 +289,21 @@ void FEngine::init() {
     slog.i << "Backend feature level: " << int(driverApi.getFeatureLevel()) << io::endl;
     slog.i << "FEngine feature level: " << int(mActiveFeatureLevel) << io::endl;
 
+    // the lights and froxel records UBOs need 64 KiB with large light counts
+    if (mConfig.largeLightCount && driverApi.getMaxUniformBufferSize() >=
+            CONFIG_MAX_LIGHT_COUNT_LARGE * sizeof(LightsUib)) {
+        mMaxLightCount = CONFIG_MAX_LIGHT_COUNT_LARGE;
+    }
+
+    // the array of the PER_RENDERABLE UBO can only be resized when it's sized by a specialization
+    // constant, which is only the case with the OpenGL backend.
+    if (mConfig.largeInstanceBatches && mBackend == Backend::OPENGL &&
+            mActiveFeatureLevel > FeatureLevel::FEATURE_LEVEL_0 &&
+            driverApi.getMaxUniformBufferSize() >=
+                    CONFIG_MAX_INSTANCES_LARGE * sizeof(PerRenderableData)) {
+        mMaxAutomaticInstances = CONFIG_MAX_INSTANCES_LARGE;
+    }
+
 
     mResourceAllocator = new ResourceAllocator(mConfig, driverApi);
 
@@ -436,9 +478,13 @@ void FEngine::shutdown() {
 #ifndef NDEBUG
     // print out some statistics about this run
     size_t const wm = mCommandBufferQueue.getHighWatermark();
-    size_t const wmpct = wm / (getCommandBufferSize() / 100);
+    size_t const wmpct = wm / (mCommandBufferQueue.getSize() / 100);
     slog.d << "CircularBuffer: High watermark "
            << wm / 1024 << " KiB (" << wmpct << "%)" << io::endl;
+    slog.d << "CommandBufferQueue: blocked "
+           << mCommandBufferQueue.getProducerBlockedTime() / 1000000 << " ms (main thread), "
+           << mCommandBufferQueue.getConsumerBlockedTime() / 1000000 << " ms (driver thread)"
+           << io::endl;
 #endif
 
     DriverApi& driver = getDriverApi();
@@ -448,6 +494,7 @@ void FEngine::shutdown() {
      */
 
     mPostProcessManager.terminate(driver);  // free-up post-process manager resources
+    mInstancedUboPool.terminate(driver);    // free-up auto-instancing buffers
     mResourceAllocator->terminate();
     mDFG.terminate(*this);                  // free-up the DFG
     mRenderableManager.terminate();         // free-up all renderables
@@ -507,6 +554,12 @@ void FEngine::shutdown() {
      * Shutdown the backend...
      */
 
+    // profiling is stopped first, it was started after the capture
+    driver.stopCommandProfiling();
+
+    // the capture file is closed after the last captured command executes
+    driver.stopCommandCapture();
+
     // There might be commands added by the `terminate()` calls, so we need to flush all commands
     // up to this point. After flushCommandBuffer() is called, all pending commands are guaranteed
     // to be executed before the driver thread exits.
@@ -544,6 +597,9 @@ void FEngine::prepare() {
     // skipped if the UBO hasn't changed. Still we could have a lot of these.
     FEngine::DriverApi& driver = getDriverApi();
 
+    // auto-instancing uses a new set of buffers each frame
+    mInstancedUboPool.advance(driver);
+
     for (auto& materialInstanceList: mMaterialInstances) {
         materialInstanceList.second.forEach([&driver](FMaterialInstance* item) {
             item->commit(driver);
@@ -699,6 +755,59 @@ int FEngine::loop() {
     return 0;
 }
 
+Engine::CommandBufferStatistics FEngine::getCommandBufferStatistics() const noexcept {
+    return {
+            .size = mCommandBufferQueue.getSize(),
+            .highWatermark = mCommandBufferQueue.getHighWatermark(),
+            .resizeCount = mCommandBufferQueue.getResizeCount(),
+            .mainThreadBlockedNs = mCommandBufferQueue.getProducerBlockedTime(),
+            .driverThreadBlockedNs = mCommandBufferQueue.getConsumerBlockedTime()
+    };
+}
+
+void FEngine::setDriverCommandStatisticsEnabled(bool enabled) noexcept {
+    DriverApi& driver = getDriverApi();
+    if (enabled) {
+        driver.startCommandProfiling();
+    } else {
+        driver.stopCommandProfiling();
+    }
+}
+
+size_t FEngine::getDriverCommandStatistics(
+        DriverCommandStatistics* out, size_t count) const noexcept {
+    CommandStreamProfiler const* const profiler =
+            const_cast<FEngine*>(this)->getDriverApi().getCommandProfiler();
+    if (!profiler) {
+        return 0;
+    }
+    CommandStreamProfiler::FrameStatistics const statistics = profiler->getFrameStatistics();
+    std::array<DriverCommandStatistics, size_t(CommandId::COUNT)> commands;
+    size_t commandCount = 0;
+    for (size_t i = 0; i < size_t(CommandId::COUNT); i++) {
+        auto const& command = statistics.commands[i];
+        if (command.count) {
+            commands[commandCount++] = {
+                    .name = getCommandName(CommandId(i)),
+                    .count = command.count,
+                    .size = command.size,
+                    .time = command.time };
+        }
+    }
+    std::sort(commands.begin(), commands.begin() + commandCount,
+            [](auto const& lhs, auto const& rhs) { return lhs.time > rhs.time; });
+    std::copy_n(commands.begin(), std::min(count, commandCount), out);
+    return commandCount;
+}
+
+void FEngine::dumpDriverCommandStatistics(utils::io::ostream& out) const noexcept {
+    CommandStreamProfiler const* const profiler =
+            const_cast<FEngine*>(this)->getDriverApi().getCommandProfiler();
+    if (profiler) {
+        CommandStreamProfiler::writeJson(out, profiler->getFrameStatistics());
+    }
+}
+
 void FEngine::flushCommandBuffer(CommandBufferQueue& commandQueue) {
     SYSTRACE_CALL();
     getDriver().purge();
@@ -1318,11 +1427,22 @@ Engine::Config Engine::BuilderDetails::validateConfig(const Config* const pConfi
             config.commandBufferSizeMB,
             config.minCommandBufferSizeMB * CONCURRENT_FRAME_COUNT);
 
+    if (config.maxCommandBufferSizeMB) {
+        config.maxCommandBufferSizeMB = std::max(
+                config.maxCommandBufferSizeMB,
+                config.commandBufferSizeMB);
+    }
+
     // Enforce pre-render-pass arena rule-of-thumb
     config.perRenderPassArenaSizeMB = std::max(
             config.perRenderPassArenaSizeMB,
             config.perFrameCommandsSizeMB + COMMAND_ARENA_OVERHEAD);
 
+    // The froxelizer's per-frame data grows with the number of lights
+    if (config.largeLightCount) {
+        config.perRenderPassArenaSizeMB += 2;
+    }
+
     // This value gets validated during driver creation, so pass it through
     config.driverHandleArenaSizeMB = config.driverHandleArenaSizeMB;
 
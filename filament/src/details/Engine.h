@@ -21,6 +21,7 @@
 
 #include "Allocators.h"
 #include "DFG.h"
+#include "InstancedUboPool.h"
 #include "PostProcessManager.h"
 #include "ResourceList.h"
 
@@ -46,6 +47,7 @@
 #include "private/backend/DriverApi.h"
 
 #include <private/filament/EngineEnums.h>
+#include <private/filament/UibStructs.h>
 #include <private/filament/BufferInterfaceBlock.h>
 
 #include <filament/ColorGrading.h>
@@ -71,6 +73,7 @@ using MaterialKey = uint32_t;
 
 #include <utils/compiler.h>
 #include <utils/Allocator.h>
+#include <utils/CString.h>
 #include <utils/JobSystem.h>
 #include <utils/CountDownLatch.h>
 
@@ -178,8 +181,21 @@ public:
         return mActiveFeatureLevel;
     }
 
+    CommandBufferStatistics getCommandBufferStatistics() const noexcept;
+
+    void setDriverCommandStatisticsEnabled(bool enabled) noexcept;
+
+    size_t getDriverCommandStatistics(DriverCommandStatistics* out, size_t count) const noexcept;
+
+    void dumpDriverCommandStatistics(utils::io::ostream& out) const noexcept;
+
     size_t getMaxAutomaticInstances() const noexcept {
-        return CONFIG_MAX_INSTANCES;
+        return mMaxAutomaticInstances;
+    }
+
+    // size of the PER_RENDERABLE uniform block, all its bindings must be this size
+    uint32_t getPerRenderableUibSize() const noexcept {
+        return uint32_t(mMaxAutomaticInstances * sizeof(PerRenderableData));
     }
 
     bool isStereoSupported() const noexcept { return getDriver().isStereoSupported(); }
@@ -196,6 +212,10 @@ public:
         return mPostProcessManager;
     }
 
+    InstancedUboPool& getInstancedUboPool() noexcept {
+        return mInstancedUboPool;
+    }
+
     FRenderableManager& getRenderableManager() noexcept {
         return mRenderableManager;
     }
@@ -403,6 +423,21 @@ public:
         return mAutomaticInstancingEnabled;
     }
 
+    // the command cache relies on the scene's change tracking to know when it's stale
+    bool isRenderPassCommandCacheEnabled() const noexcept {
+        return mConfig.renderPassCommandCache && mConfig.sceneChangeTracking;
+    }
+
+    // Incremented each time a material instance's state that is baked into RenderPass commands
+    // (e.g. culling or transparency mode) changes.
+    void markMaterialInstanceStateChanged() noexcept {
+        mMaterialInstanceStateVersion++;
+    }
+
+    uint32_t getMaterialInstanceStateVersion() const noexcept {
+        return mMaterialInstanceStateVersion;
+    }
+
     backend::Handle<backend::HwTexture> getOneTexture() const { return mDummyOneTexture; }
     backend::Handle<backend::HwTexture> getZeroTexture() const { return mDummyZeroTexture; }
     backend::Handle<backend::HwTexture> getOneTextureArray() const { return mDummyOneTextureArray; }
@@ -416,6 +451,10 @@ public:
     size_t getRequestedDriverHandleArenaSize() const noexcept { return mConfig.driverHandleArenaSizeMB * MiB; }
     Config const& getConfig() const noexcept { return mConfig; }
 
+    // maximum number of point and spot lights visible in a View, see Config::largeLightCount
+    size_t getMaxLightCount() const noexcept { return mMaxLightCount; }
+    bool hasLargeLightCount() const noexcept { return mMaxLightCount > CONFIG_MAX_LIGHT_COUNT; }
+
     bool hasFeatureLevel(backend::FeatureLevel neededFeatureLevel) const noexcept {
         return FEngine::getActiveFeatureLevel() >= neededFeatureLevel;
     }
@@ -454,9 +493,12 @@ private:
 
     Backend mBackend;
     FeatureLevel mActiveFeatureLevel = FeatureLevel::FEATURE_LEVEL_1;
+    size_t mMaxLightCount = CONFIG_MAX_LIGHT_COUNT;
+    size_t mMaxAutomaticInstances = CONFIG_MAX_INSTANCES;
     Platform* mPlatform = nullptr;
     bool mOwnPlatform = false;
     bool mAutomaticInstancingEnabled = false;
+    uint32_t mMaterialInstanceStateVersion = 0;
     void* mSharedGLContext = nullptr;
     backend::Handle<backend::HwRenderPrimitive> mFullScreenTriangleRph;
     FVertexBuffer* mFullScreenTriangleVb = nullptr;
@@ -464,6 +506,7 @@ private:
     math::mat4f mUvFromClipMatrix;
 
     PostProcessManager mPostProcessManager;
+    InstancedUboPool mInstancedUboPool;
 
     utils::EntityManager& mEntityManager;
     FRenderableManager mRenderableManager;
@@ -542,6 +585,7 @@ private:
 
     // Creation parameters
     Config mConfig;
+    utils::CString mCommandStreamCapturePath;   // storage for mConfig.commandStreamCapturePath
 
 public:
     // these are the debug properties used by FDebug. They're accessed directly by modules who need them.
@@ -19,6 +19,7 @@
 #include <details/Engine.h>
 #include <private/filament/UibStructs.h>
 
+#include "Culler.h"
 #include "FilamentAPI-impl.h"
 
 #include <math/mat3.h>
@@ -31,6 +32,8 @@ using namespace backend;
 struct InstanceBuffer::BuilderDetails {
     size_t mInstanceCount = 0;
     math::mat4f const* mLocalTransforms = nullptr;
+    Box mCullingBox;
+    bool mCulling = false;
 };
 
 using BuilderType = InstanceBuffer;
@@ -50,6 +53,12 @@ InstanceBuffer::Builder& InstanceBuffer::Builder::localTransforms(
     return *this;
 }
 
+InstanceBuffer::Builder& InstanceBuffer::Builder::culling(Box const& boundingBox) noexcept {
+    mImpl->mCullingBox = boundingBox;
+    mImpl->mCulling = true;
+    return *this;
+}
+
 InstanceBuffer* InstanceBuffer::Builder::build(Engine& engine) {
     ASSERT_PRECONDITION(mImpl->mInstanceCount >= 1, "instanceCount must be >= 1.");
     ASSERT_PRECONDITION(mImpl->mInstanceCount <= engine.getMaxAutomaticInstances(),
@@ -62,7 +71,9 @@ InstanceBuffer* InstanceBuffer::Builder::build(Engine& engine) {
 
 // ------------------------------------------------------------------------------------------------
 
-FInstanceBuffer::FInstanceBuffer(FEngine& engine, const Builder& builder) {
+FInstanceBuffer::FInstanceBuffer(FEngine& engine, const Builder& builder)
+        : mCullingBox(builder->mCullingBox),
+          mCulling(builder->mCulling) {
     mInstanceCount = builder->mInstanceCount;
 
     mLocalTransforms.reserve(mInstanceCount);
@@ -85,28 +96,39 @@ void FInstanceBuffer::setLocalTransforms(
     memcpy(mLocalTransforms.data() + offset, localTransforms, sizeof(math::mat4f) * count);
 }
 
-void FInstanceBuffer::prepare(FEngine& engine, math::mat4f rootTransform,
-        const PerRenderableData& ubo, Handle<HwBufferObject> handle) {
-    DriverApi& driver = engine.getDriverApi();
-
-    // TODO: allocate this staging buffer from a pool.
-    uint32_t stagingBufferSize = sizeof(PerRenderableUib);
-    PerRenderableData* stagingBuffer = (PerRenderableData*)::malloc(stagingBufferSize);
-    // TODO: consider using JobSystem to parallelize this.
-    for (size_t i = 0, c = mInstanceCount; i < c; i++) {
-        stagingBuffer[i] = ubo;
-        math::mat4f model = rootTransform * mLocalTransforms[i];
-        stagingBuffer[i].worldFromModelMatrix = model;
+size_t FInstanceBuffer::prepare(PerRenderableData* UTILS_RESTRICT stagingBuffer,
+        size_t instanceCount, math::mat4f const& rootTransform, PerRenderableData const& ubo,
+        Frustum const* frustum) const noexcept {
+    assert_invariant(instanceCount <= mInstanceCount);
 
+    auto write = [&ubo](PerRenderableData& UTILS_RESTRICT data, math::mat4f const& model) {
+        data = ubo;
+        data.worldFromModelMatrix = model;
         math::mat3f m = math::mat3f::getTransformForNormals(model.upperLeft());
-        stagingBuffer[i].worldFromModelNormalMatrix = math::prescaleForNormals(m);
+        data.worldFromModelNormalMatrix = math::prescaleForNormals(m);
+    };
+
+    if (!mCulling || !frustum) {
+        for (size_t i = 0; i < instanceCount; i++) {
+            write(stagingBuffer[i], rootTransform * mLocalTransforms[i]);
+        }
+        return instanceCount;
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < instanceCount; i++) {
+        math::mat4f const model = rootTransform * mLocalTransforms[i];
+        if (Culler::intersects(*frustum, rigidTransform(mCullingBox, model))) {
+            write(stagingBuffer[count++], model);
+        }
+    }
+
+    if (UTILS_UNLIKELY(!count)) {
+        // we can't draw zero instances, keep the first one, it'll be clipped.
+        write(stagingBuffer[0], rootTransform * mLocalTransforms[0]);
+        count = 1;
     }
-    driver.updateBufferObject(handle, {
-            stagingBuffer, stagingBufferSize,
-            +[](void* buffer, size_t, void*) {
-                ::free(buffer);
-            }
-    }, 0);
+    return count;
 }
 
 void FInstanceBuffer::terminate(FEngine& engine) {
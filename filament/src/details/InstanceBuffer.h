@@ -19,6 +19,7 @@
 
 #include "downcast.h"
 
+#include <filament/Box.h>
 #include <filament/InstanceBuffer.h>
 
 #include <backend/Handle.h>
@@ -30,6 +31,7 @@
 namespace filament {
 
 class FEngine;
+class Frustum;
 
 struct PerRenderableData;
 
@@ -43,14 +45,20 @@ public:
 
     void setLocalTransforms(math::mat4f const* localTransforms, size_t count, size_t offset);
 
-    void prepare(FEngine& engine, math::mat4f rootTransform, const PerRenderableData& ubo,
-            backend::Handle<backend::HwBufferObject> handle);
+    // Writes the per-renderable data of the first instanceCount instances into stagingBuffer and
+    // returns how many were written. When culling is enabled and frustum is not null, only the
+    // instances intersecting the frustum are written. This can be called from any thread.
+    size_t prepare(PerRenderableData* stagingBuffer, size_t instanceCount,
+            math::mat4f const& rootTransform, PerRenderableData const& ubo,
+            Frustum const* frustum) const noexcept;
 
 private:
     friend class RenderableManager;
 
     utils::FixedCapacityVector<math::mat4f> mLocalTransforms;
     size_t mInstanceCount;
+    Box mCullingBox;
+    bool mCulling;
 };
 
 FILAMENT_DOWNCAST(InstanceBuffer)
@@ -234,7 +234,7 @@ FMaterial::FMaterial(FEngine& engine, const Material::Builder& builder)
 
     // Feature level 0 doesn't support instancing
     int const maxInstanceCount = (engine.getActiveFeatureLevel() == FeatureLevel::FEATURE_LEVEL_0)
-            ? 1 : CONFIG_MAX_INSTANCES;
+            ? 1 : int(engine.getMaxAutomaticInstances());
 
     int const maxFroxelBufferHeight = std::min(
             FROXEL_BUFFER_MAX_ENTRY_COUNT / 4,
@@ -271,6 +271,9 @@ FMaterial::FMaterial(FEngine& engine, const Material::Builder& builder)
     mSpecializationConstants.push_back({
                     +ReservedSpecializationConstants::CONFIG_STEREO_EYE_COUNT,
                     (int)engine.getConfig().stereoscopicEyeCount });
+    mSpecializationConstants.push_back({
+                    +ReservedSpecializationConstants::CONFIG_LARGE_LIGHT_COUNT,
+                    engine.hasLargeLightCount() });
     if (UTILS_UNLIKELY(engine.getShaderLanguage() == ShaderLanguage::ESSL1)) {
         // The actual value of this spec-constant is set in the OpenGLDriver backend.
         mSpecializationConstants.push_back({
@@ -254,10 +254,31 @@ bool FMaterialInstance::isDoubleSided() const noexcept {
 
 void FMaterialInstance::setTransparencyMode(TransparencyMode mode) noexcept {
     mTransparencyMode = mode;
+    mMaterial->getEngine().markMaterialInstanceStateChanged();
+}
+
+void FMaterialInstance::setCullingMode(CullingMode culling) noexcept {
+    mCulling = culling;
+    mMaterial->getEngine().markMaterialInstanceStateChanged();
+}
+
+void FMaterialInstance::setColorWrite(bool enable) noexcept {
+    mColorWrite = enable;
+    mMaterial->getEngine().markMaterialInstanceStateChanged();
+}
+
+void FMaterialInstance::setDepthWrite(bool enable) noexcept {
+    mDepthWrite = enable;
+    mMaterial->getEngine().markMaterialInstanceStateChanged();
+}
+
+void FMaterialInstance::setDepthFunc(RasterState::DepthFunc depthFunc) noexcept {
+    mDepthFunc = depthFunc;
+    mMaterial->getEngine().markMaterialInstanceStateChanged();
 }
 
 void FMaterialInstance::setDepthCulling(bool enable) noexcept {
-    mDepthFunc = enable ? RasterState::DepthFunc::GE : RasterState::DepthFunc::A;
+    setDepthFunc(enable ? RasterState::DepthFunc::GE : RasterState::DepthFunc::A);
 }
 
 bool FMaterialInstance::isDepthCullingEnabled() const noexcept {
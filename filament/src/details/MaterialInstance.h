@@ -101,9 +101,7 @@ public:
 
     backend::RasterState::DepthFunc getDepthFunc() const noexcept { return mDepthFunc; }
 
-    void setDepthFunc(backend::RasterState::DepthFunc depthFunc) noexcept {
-        mDepthFunc = depthFunc;
-    }
+    void setDepthFunc(backend::RasterState::DepthFunc depthFunc) noexcept;
 
     void setPolygonOffset(float scale, float constant) noexcept {
         // handle reversed Z
@@ -130,11 +128,11 @@ public:
 
     void setTransparencyMode(TransparencyMode mode) noexcept;
 
-    void setCullingMode(CullingMode culling) noexcept { mCulling = culling; }
+    void setCullingMode(CullingMode culling) noexcept;
 
-    void setColorWrite(bool enable) noexcept { mColorWrite = enable; }
+    void setColorWrite(bool enable) noexcept;
 
-    void setDepthWrite(bool enable) noexcept { mDepthWrite = enable; }
+    void setDepthWrite(bool enable) noexcept;
 
     void setStencilWrite(bool enable) noexcept { mStencilState.stencilWrite = enable; }
 
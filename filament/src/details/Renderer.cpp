@@ -127,7 +127,8 @@ FRenderer::~FRenderer() noexcept {
     size_t const wmpct = wm / (mEngine.getPerFrameCommandsSize() / 100);
     slog.d << "Renderer: Commands High watermark "
     << wm / 1024 << " KiB (" << wmpct << "%), "
-    << wm / sizeof(Command) << " commands, " << sizeof(Command) << " bytes/command"
+    << wm / (sizeof(Command) + sizeof(PrimitiveInfo)) << " commands, "
+    << sizeof(Command) + sizeof(PrimitiveInfo) << " bytes/command"
     << io::endl;
 #endif
 }
@@ -672,18 +673,22 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
     FScene& scene = *view.getScene();
 
     // Allocate some space for our commands in the per-frame Arena, and use that space as
-    // an Arena for commands. All this space is released when we exit this method.
+    // two Arenas, one for the commands and one for their PrimitiveInfo.
+    // All this space is released when we exit this method.
     size_t const perFrameCommandsSize = engine.getPerFrameCommandsSize();
+    size_t const commandArenaSize = RenderPass::getCommandArenaSize(perFrameCommandsSize);
     void* const arenaBegin = arena.allocate(perFrameCommandsSize, CACHELINE_SIZE);
+    void* const arenaSplit = pointermath::add(arenaBegin, commandArenaSize);
     void* const arenaEnd = pointermath::add(arenaBegin, perFrameCommandsSize);
-    RenderPass::Arena commandArena("Command Arena", { arenaBegin, arenaEnd });
+    RenderPass::Arena commandArena("Command Arena", { arenaBegin, arenaSplit });
+    RenderPass::Arena primitiveInfoArena("PrimitiveInfo Arena", { arenaSplit, arenaEnd });
 
     RenderPass::RenderFlags renderFlags = 0;
     if (view.hasShadowing())                renderFlags |= RenderPass::HAS_SHADOWING;
     if (view.isFrontFaceWindingInverted())  renderFlags |= RenderPass::HAS_INVERSE_FRONT_FACES;
     if (view.hasInstancedStereo())          renderFlags |= RenderPass::IS_STEREOSCOPIC;
 
-    RenderPass pass(engine, commandArena);
+    RenderPass pass(engine, commandArena, primitiveInfoArena);
     pass.setRenderFlags(renderFlags);
 
     Variant variant;
@@ -922,6 +927,9 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
     // This one doesn't need to be a FrameGraph pass because it always happens by construction
     // (i.e. it won't be culled, unless everything is culled), so no need to complexify things.
     pass.setVariant(variant);
+    if (engine.isRenderPassCommandCacheEnabled()) {
+        pass.setCommandCache(&view.getColorPassCommandCache(), scene);
+    }
     pass.appendCommands(engine, RenderPass::COLOR);
 
     // color-grading as subpass is done either by the color pass or the TAA pass if any
@@ -1200,7 +1208,12 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
     // save the current history entry and destroy the oldest entry
     view.commitFrameHistory(engine);
 
-    recordHighWatermark(commandArena.getListener().getHighWatermark());
+    // record the usage of the most used of the two arenas, relative to the whole area
+    recordHighWatermark(std::max(
+            commandArena.getListener().getHighWatermark()
+                    * perFrameCommandsSize / commandArenaSize,
+            primitiveInfoArena.getListener().getHighWatermark()
+                    * perFrameCommandsSize / (perFrameCommandsSize - commandArenaSize)));
 }
 
 } // namespace filament
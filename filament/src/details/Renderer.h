@@ -138,6 +138,7 @@ public:
 private:
     friend class Renderer;
     using Command = RenderPass::Command;
+    using PrimitiveInfo = RenderPass::PrimitiveInfo;
     using clock = std::chrono::steady_clock;
     using Epoch = clock::time_point;
     using duration = clock::duration;
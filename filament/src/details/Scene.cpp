@@ -27,6 +27,7 @@
 #include "details/Skybox.h"
 
 #include "BufferPoolAllocator.h"
+#include "ShadowMap.h"
 
 #include <utils/compiler.h>
 #include <utils/EntityManager.h>
@@ -47,18 +48,37 @@ namespace filament {
 
 FScene::FScene(FEngine& engine) :
         mEngine(engine), mSharedState(std::make_shared<SharedState>()) {
+    if (engine.getConfig().sceneChangeTracking) {
+        mChangeTracking = std::make_unique<ChangeTracking>();
+        engine.getEntityManager().registerListener(mChangeTracking.get());
+    }
 }
 
 FScene::~FScene() noexcept = default;
 
+bool FScene::canPrepareIncrementally(mat4 const& worldTransform,
+        bool shadowReceiversAreCasters) noexcept {
+    ChangeTracking& ct = *mChangeTracking;
+    FEngine& engine = mEngine;
+
+    // this must always be called, to reset the flag
+    bool const entitiesChanged = ct.entitiesChanged.exchange(false, std::memory_order_relaxed);
+
+    return !entitiesChanged &&
+           ct.renderableStructureVersion == engine.getRenderableManager().getStructureVersion() &&
+           ct.transformStructureVersion == engine.getTransformManager().getStructureVersion() &&
+           ct.lightStructureVersion == engine.getLightManager().getStructureVersion() &&
+           ct.shadowReceiversAreCasters == shadowReceiversAreCasters &&
+           ct.worldTransform[0] == worldTransform[0] &&
+           ct.worldTransform[1] == worldTransform[1] &&
+           ct.worldTransform[2] == worldTransform[2] &&
+           ct.worldTransform[3] == worldTransform[3];
+}
 
 void FScene::prepare(utils::JobSystem& js,
         LinearAllocatorArena& allocator,
         mat4 const& worldTransform,
         bool shadowReceiversAreCasters) noexcept {
-    // TODO: can we skip this in most cases? Since we rely on indices staying the same,
-    //       we could only skip, if nothing changed in the RCM.
-
     SYSTRACE_CALL();
 
     SYSTRACE_CONTEXT();
@@ -68,8 +88,8 @@ void FScene::prepare(utils::JobSystem& js,
 
     FEngine& engine = mEngine;
     EntityManager const& em = engine.getEntityManager();
-    FRenderableManager const& rcm = engine.getRenderableManager();
-    FTransformManager const& tcm = engine.getTransformManager();
+    FRenderableManager& rcm = engine.getRenderableManager();
+    FTransformManager& tcm = engine.getTransformManager();
     FLightManager const& lcm = engine.getLightManager();
     // go through the list of entities, and gather the data of those that are renderables
     auto& sceneData = mRenderableData;
@@ -84,48 +104,84 @@ void FScene::prepare(utils::JobSystem& js,
     using LightInstanceContainer = FixedCapacityVector<LightContainerData,
             utils::STLAllocator< LightContainerData, LinearAllocatorArena >, false>;
 
+    /*
+     * With change tracking, we only need to gather the scene's renderables and lights when
+     * the scene or the components changed structurally, otherwise we reuse last frame's data
+     * and only update the renderables that changed.
+     */
+
+    ChangeTracking* const ct = mChangeTracking.get();
+    bool const incremental = ct && canPrepareIncrementally(worldTransform, shadowReceiversAreCasters);
+    uint32_t const renderableEpoch = ct ? rcm.advanceEpoch() : 0;
+    uint32_t const transformEpoch = ct ? tcm.advanceEpoch() : 0;
+
     RenderableInstanceContainer renderableInstances{
-            RenderableInstanceContainer::with_capacity(entities.size(), allocator) };
+            RenderableInstanceContainer::with_capacity(incremental ? 0 : entities.size(), allocator) };
 
     LightInstanceContainer lightInstances{
-            LightInstanceContainer::with_capacity(entities.size(), allocator) };
-
-    SYSTRACE_NAME_BEGIN("InstanceLoop");
+            LightInstanceContainer::with_capacity(incremental ? 0 : entities.size(), allocator) };
 
     // find the max intensity directional light index in our local array
     float maxIntensity = 0.0f;
     std::pair<LightManager::Instance, TransformManager::Instance> directionalLightInstances{};
 
-    /*
-     * First compute the exact number of renderables and lights in the scene.
-     * Also find the main directional light.
-     */
+    LightContainerData const* lights = nullptr;
+    size_t lightCount = 0;
+
+    if (UTILS_LIKELY(!incremental)) {
+        SYSTRACE_NAME_BEGIN("InstanceLoop");
 
-    for (Entity const e: entities) {
-        if (UTILS_LIKELY(em.isAlive(e))) {
-            auto ti = tcm.getInstance(e);
-            auto li = lcm.getInstance(e);
-            auto ri = rcm.getInstance(e);
-            if (li) {
-                // we handle the directional light here because it'd prevent multithreading below
-                if (UTILS_UNLIKELY(lcm.isDirectionalLight(li))) {
-                    // we don't store the directional lights, because we only have a single one
-                    if (lcm.getIntensity(li) >= maxIntensity) {
-                        maxIntensity = lcm.getIntensity(li);
-                        directionalLightInstances = { li, ti };
+        if (ct) {
+            ct->directionalLightInstances.clear();
+        }
+
+        /*
+         * First compute the exact number of renderables and lights in the scene.
+         * Also find the main directional light.
+         */
+
+        for (Entity const e: entities) {
+            if (UTILS_LIKELY(em.isAlive(e))) {
+                auto ti = tcm.getInstance(e);
+                auto li = lcm.getInstance(e);
+                auto ri = rcm.getInstance(e);
+                if (li) {
+                    // we handle the directional light here because it'd prevent multithreading below
+                    if (UTILS_UNLIKELY(lcm.isDirectionalLight(li))) {
+                        // we don't store the directional lights, because we only have a single one
+                        if (lcm.getIntensity(li) >= maxIntensity) {
+                            maxIntensity = lcm.getIntensity(li);
+                            directionalLightInstances = { li, ti };
+                        }
+                        if (ct) {
+                            ct->directionalLightInstances.emplace_back(li, ti);
+                        }
+                    } else {
+                        lightInstances.emplace_back(li, ti);
                     }
-                } else {
-                    lightInstances.emplace_back(li, ti);
+                }
+                if (ri) {
+                    renderableInstances.emplace_back(ri, ti);
                 }
             }
-            if (ri) {
-                renderableInstances.emplace_back(ri, ti);
+        }
+
+        lights = lightInstances.data();
+        lightCount = lightInstances.size();
+
+        SYSTRACE_NAME_END();
+    } else {
+        // the intensity of the directional lights could have changed
+        for (auto const& [li, ti] : ct->directionalLightInstances) {
+            if (lcm.getIntensity(li) >= maxIntensity) {
+                maxIntensity = lcm.getIntensity(li);
+                directionalLightInstances = { li, ti };
             }
         }
+        lights = ct->lightInstances.data();
+        lightCount = ct->lightInstances.size();
     }
 
-    SYSTRACE_NAME_END();
-
     /*
      * Evaluate the capacity needed for the renderable and light SoAs
      */
@@ -148,7 +204,7 @@ void FScene::prepare(utils::JobSystem& js,
 
     // TODO: the resize below could happen in a job
 
-    if (sceneData.size() != renderableInstances.size()) {
+    if (!incremental && sceneData.size() != renderableInstances.size()) {
         sceneData.clear();
         if (sceneData.capacity() < renderableDataCapacity) {
             sceneData.setCapacity(renderableDataCapacity);
@@ -157,68 +213,141 @@ void FScene::prepare(utils::JobSystem& js,
         sceneData.resize(renderableInstances.size());
     }
 
-    if (lightData.size() != lightInstances.size() + DIRECTIONAL_LIGHTS_COUNT) {
+    if (lightData.size() != lightCount + DIRECTIONAL_LIGHTS_COUNT) {
+        assert_invariant(!incremental);
         lightData.clear();
         if (lightData.capacity() < lightDataCapacity) {
             lightData.setCapacity(lightDataCapacity);
         }
-        assert_invariant(lightInstances.size() + DIRECTIONAL_LIGHTS_COUNT <= lightData.capacity());
-        lightData.resize(lightInstances.size() + DIRECTIONAL_LIGHTS_COUNT);
+        assert_invariant(lightCount + DIRECTIONAL_LIGHTS_COUNT <= lightData.capacity());
+        lightData.resize(lightCount + DIRECTIONAL_LIGHTS_COUNT);
+    }
+
+    /*
+     * Record the state needed to prepare the next frame incrementally
+     */
+
+    if (ct && !incremental) {
+        ct->transformInstances.resize(rcm.getComponentCount() + 1);
+        for (auto const& [ri, ti] : renderableInstances) {
+            ct->transformInstances[ri.asValue()] = ti;
+        }
+        ct->lightInstances.assign(lightInstances.begin(), lightInstances.end());
+        // all the renderables are updated, and the revision always changes below
+        ct->renderableRevisions.assign(renderableInstances.size(), mRevision + 1);
+        ct->worldTransform = worldTransform;
+        ct->renderableStructureVersion = rcm.getStructureVersion();
+        ct->transformStructureVersion = tcm.getStructureVersion();
+        ct->lightStructureVersion = lcm.getStructureVersion();
+        ct->shadowReceiversAreCasters = shadowReceiversAreCasters;
     }
 
     /*
      * Fill the SoA with the JobSystem
      */
 
-    auto renderableWork = [first = renderableInstances.data(), &rcm, &tcm, &worldTransform,
-                 &sceneData, shadowReceiversAreCasters](auto* p, auto c) {
-        SYSTRACE_NAME("renderableWork");
+    auto updateRenderable = [&rcm, &tcm, &worldTransform, &sceneData, shadowReceiversAreCasters](
+            size_t index, RenderableManager::Instance ri, TransformManager::Instance ti) {
+        // this is where we go from double to float for our transforms
+        const mat4f shaderWorldTransform{
+                worldTransform * tcm.getWorldTransformAccurate(ti) };
+        const bool reversedWindingOrder = det(shaderWorldTransform.upperLeft()) < 0;
 
-        for (size_t i = 0; i < c; i++) {
-            auto [ri, ti] = p[i];
+        // compute the world AABB so we can perform culling
+        const Box worldAABB = rigidTransform(rcm.getAABB(ri), shaderWorldTransform);
 
-            // this is where we go from double to float for our transforms
-            const mat4f shaderWorldTransform{
-                    worldTransform * tcm.getWorldTransformAccurate(ti) };
-            const bool reversedWindingOrder = det(shaderWorldTransform.upperLeft()) < 0;
+        auto visibility = rcm.getVisibility(ri);
+        visibility.reversedWindingOrder = reversedWindingOrder;
+        if (shadowReceiversAreCasters && visibility.receiveShadows) {
+            visibility.castShadows = true;
+        }
 
-            // compute the world AABB so we can perform culling
-            const Box worldAABB = rigidTransform(rcm.getAABB(ri), shaderWorldTransform);
+        // FIXME: We compute and store the local scale because it's needed for glTF but
+        //        we need a better way to handle this
+        const mat4f& transform = tcm.getTransform(ti);
+        float const scale = (length(transform[0].xyz) + length(transform[1].xyz) +
+                             length(transform[2].xyz)) / 3.0f;
+
+        assert_invariant(index < sceneData.size());
+
+        sceneData.elementAt<RENDERABLE_INSTANCE>(index) = ri;
+        sceneData.elementAt<WORLD_TRANSFORM>(index)     = shaderWorldTransform;
+        sceneData.elementAt<VISIBILITY_STATE>(index)    = visibility;
+        sceneData.elementAt<SKINNING_BUFFER>(index)     = rcm.getSkinningBufferInfo(ri);
+        sceneData.elementAt<MORPHING_BUFFER>(index)     = rcm.getMorphingBufferInfo(ri);
+        sceneData.elementAt<INSTANCES>(index)           = rcm.getInstancesInfo(ri);
+        sceneData.elementAt<WORLD_AABB_CENTER>(index)   = worldAABB.center;
+        sceneData.elementAt<VISIBLE_MASK>(index)        = 0;
+        sceneData.elementAt<CHANNELS>(index)            = rcm.getChannels(ri);
+        sceneData.elementAt<LAYERS>(index)              = rcm.getLayerMask(ri);
+        sceneData.elementAt<WORLD_AABB_EXTENT>(index)   = worldAABB.halfExtent;
+        //sceneData.elementAt<PRIMITIVES>(index)          = {}; // already initialized, Slice<>
+        sceneData.elementAt<SUMMED_PRIMITIVE_COUNT>(index) = 0;
+        //sceneData.elementAt<UBO>(index)                 = {}; // not needed here
+        sceneData.elementAt<USER_DATA>(index)           = scale;
+    };
+
+    // only used with change tracking, whether a renderable changed since the last prepare()
+    auto isDirty = [&rcm, &tcm,
+            renderableEpoch = ct ? ct->renderableEpoch : 0,
+            transformEpoch = ct ? ct->transformEpoch : 0](
+                    RenderableManager::Instance ri, TransformManager::Instance ti) {
+        // epochs can wrap around, a very old instance could be treated as dirty, which is safe.
+        auto isNewer = [](uint32_t version, uint32_t epoch) {
+            return int32_t(version - epoch) > 0;
+        };
+        return isNewer(rcm.getVersion(ri), renderableEpoch) ||
+               isNewer(tcm.getVersion(ti), transformEpoch);
+    };
 
-            auto visibility = rcm.getVisibility(ri);
-            visibility.reversedWindingOrder = reversedWindingOrder;
-            if (shadowReceiversAreCasters && visibility.receiveShadows) {
-                visibility.castShadows = true;
+    auto renderableWork = [first = renderableInstances.data(), &updateRenderable,
+            &rcm, &isDirty, ct](auto* p, auto c) {
+        SYSTRACE_NAME("renderableWork");
+        for (size_t i = 0; i < c; i++) {
+            auto [ri, ti] = p[i];
+            updateRenderable(std::distance(first, p) + i, ri, ti);
+            // with change tracking, check whether the static geometry needs to be rebuilt
+            if (ct && UTILS_UNLIKELY(rcm.isStaticGeometry(ri))) {
+                auto const& inStaticGeometry = ct->inStaticGeometry;
+                if (ri.asValue() >= inStaticGeometry.size() ||
+                        !inStaticGeometry[ri.asValue()] || isDirty(ri, ti)) {
+                    ct->staticGeometryChanged.store(true, std::memory_order_relaxed);
+                }
             }
+        }
+    };
 
-            // FIXME: We compute and store the local scale because it's needed for glTF but
-            //        we need a better way to handle this
-            const mat4f& transform = tcm.getTransform(ti);
-            float const scale = (length(transform[0].xyz) + length(transform[1].xyz) +
-                                 length(transform[2].xyz)) / 3.0f;
-
-            size_t const index = std::distance(first, p) + i;
-            assert_invariant(index < sceneData.size());
-
-            sceneData.elementAt<RENDERABLE_INSTANCE>(index) = ri;
-            sceneData.elementAt<WORLD_TRANSFORM>(index)     = shaderWorldTransform;
-            sceneData.elementAt<VISIBILITY_STATE>(index)    = visibility;
-            sceneData.elementAt<SKINNING_BUFFER>(index)     = rcm.getSkinningBufferInfo(ri);
-            sceneData.elementAt<MORPHING_BUFFER>(index)     = rcm.getMorphingBufferInfo(ri);
-            sceneData.elementAt<INSTANCES>(index)           = rcm.getInstancesInfo(ri);
-            sceneData.elementAt<WORLD_AABB_CENTER>(index)   = worldAABB.center;
-            sceneData.elementAt<VISIBLE_MASK>(index)        = 0;
-            sceneData.elementAt<CHANNELS>(index)            = rcm.getChannels(ri);
-            sceneData.elementAt<LAYERS>(index)              = rcm.getLayerMask(ri);
-            sceneData.elementAt<WORLD_AABB_EXTENT>(index)   = worldAABB.halfExtent;
-            //sceneData.elementAt<PRIMITIVES>(index)          = {}; // already initialized, Slice<>
-            sceneData.elementAt<SUMMED_PRIMITIVE_COUNT>(index) = 0;
-            //sceneData.elementAt<UBO>(index)                 = {}; // not needed here
-            sceneData.elementAt<USER_DATA>(index)           = scale;
+    // only used with change tracking, this updates the renderables that changed in place
+    auto dirtyRenderableWork = [&sceneData, &updateRenderable, &isDirty, ct,
+            transformInstances = ct ? ct->transformInstances.data() : nullptr,
+            revision = mRevision + 1](
+                    uint32_t start, uint32_t count) {
+        SYSTRACE_NAME("dirtyRenderableWork");
+        for (size_t index = start, end = start + count; index < end; index++) {
+            auto const ri = sceneData.elementAt<RENDERABLE_INSTANCE>(index);
+            auto const ti = transformInstances[ri.asValue()];
+            if (UTILS_UNLIKELY(isDirty(ri, ti))) {
+                ct->renderablesChanged.store(true, std::memory_order_relaxed);
+                ct->renderableRevisions[index] = revision;
+                bool const wasStatic = sceneData.elementAt<VISIBILITY_STATE>(index).staticGeometry;
+                float3 const center = sceneData.elementAt<WORLD_AABB_CENTER>(index);
+                float3 const extent = sceneData.elementAt<WORLD_AABB_EXTENT>(index);
+                updateRenderable(index, ri, ti);
+                // the static geometry only needs to be rebuilt if a static renderable moved
+                bool const isStatic = sceneData.elementAt<VISIBILITY_STATE>(index).staticGeometry;
+                if (UTILS_UNLIKELY(wasStatic != isStatic || (isStatic &&
+                        (center != sceneData.elementAt<WORLD_AABB_CENTER>(index) ||
+                         extent != sceneData.elementAt<WORLD_AABB_EXTENT>(index))))) {
+                    ct->staticGeometryChanged.store(true, std::memory_order_relaxed);
+                }
+            } else {
+                sceneData.elementAt<VISIBLE_MASK>(index) = 0;
+                sceneData.elementAt<SUMMED_PRIMITIVE_COUNT>(index) = 0;
+            }
         }
     };
 
-    auto lightWork = [first = lightInstances.data(), &lcm, &tcm, &worldTransform,
+    auto lightWork = [first = lights, &lcm, &tcm, &worldTransform,
             &lightData](auto* p, auto c) {
         SYSTRACE_NAME("lightWork");
         for (size_t i = 0; i < c; i++) {
@@ -246,19 +375,27 @@ void FScene::prepare(utils::JobSystem& js,
 
     JobSystem::Job* rootJob = js.createJob();
 
-    auto* renderableJob = jobs::parallel_for(js, rootJob,
-            renderableInstances.data(), renderableInstances.size(),
-            std::cref(renderableWork), jobs::CountSplitter<128, 5>());
+    auto* renderableJob = incremental ?
+            jobs::parallel_for(js, rootJob, 0, uint32_t(sceneData.size()),
+                    std::cref(dirtyRenderableWork), jobs::AdaptiveSplitter(js)) :
+            jobs::parallel_for(js, rootJob,
+                    renderableInstances.data(), renderableInstances.size(),
+                    std::cref(renderableWork), jobs::AdaptiveSplitter(js));
 
     auto* lightJob = jobs::parallel_for(js, rootJob,
-            lightInstances.data(), lightInstances.size(),
-            std::cref(lightWork), jobs::CountSplitter<32, 5>());
+            lights, lightCount,
+            std::cref(lightWork), jobs::AdaptiveSplitter(js));
 
     js.run(renderableJob);
     js.run(lightJob);
 
     // Everything below can be done in parallel.
 
+    if (ct) {
+        ct->renderableEpoch = renderableEpoch;
+        ct->transformEpoch = transformEpoch;
+    }
+
     /*
      * Handle the directional light separately
      */
@@ -324,6 +461,116 @@ void FScene::prepare(utils::JobSystem& js,
     js.runAndWait(rootJob);
 
     SYSTRACE_NAME_END();
+
+    if (!incremental || ct->renderablesChanged.exchange(false, std::memory_order_relaxed)) {
+        mRevision++;
+    }
+
+    if (ct) {
+        prepareStaticGeometry();
+    }
+}
+
+void FScene::prepareStaticGeometry() noexcept {
+    SYSTRACE_CALL();
+
+    ChangeTracking& ct = *mChangeTracking;
+    RenderableSoa const& sceneData = mRenderableData;
+    FRenderableManager const& rcm = mEngine.getRenderableManager();
+
+    bool changed = ct.staticGeometryChanged.exchange(false, std::memory_order_relaxed);
+    if (!changed && ct.staticGeometry.empty()) {
+        // there were no static renderables, and none appeared
+        return;
+    }
+
+    /*
+     * Record the row of each renderable, since they could have been moved by the previous
+     * frame, and gather the non-static renderables, which are culled linearly.
+     */
+
+    size_t const count = sceneData.size();
+    auto const* const instances = sceneData.data<RENDERABLE_INSTANCE>();
+    auto const* const visibility = sceneData.data<VISIBILITY_STATE>();
+
+    ct.rows.resize(rcm.getComponentCount() + 1);
+    ct.dynamicRows.clear();
+    size_t staticCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        ct.rows[instances[i].asValue()] = uint32_t(i);
+        if (visibility[i].staticGeometry) {
+            staticCount++;
+        } else {
+            ct.dynamicRows.push_back(uint32_t(i));
+        }
+    }
+
+    // this catches static renderables that left the scene
+    changed = changed || staticCount != ct.staticGeometry.size();
+
+    if (changed) {
+        std::vector<float3> centers;
+        std::vector<float3> extents;
+        std::vector<uint32_t> payloads;
+        centers.reserve(staticCount);
+        extents.reserve(staticCount);
+        payloads.reserve(staticCount);
+        ct.inStaticGeometry.assign(rcm.getComponentCount() + 1, false);
+        for (size_t i = 0; i < count; i++) {
+            if (visibility[i].staticGeometry) {
+                centers.push_back(sceneData.elementAt<WORLD_AABB_CENTER>(i));
+                extents.push_back(sceneData.elementAt<WORLD_AABB_EXTENT>(i));
+                payloads.push_back(instances[i].asValue());
+                ct.inStaticGeometry[instances[i].asValue()] = true;
+            }
+        }
+        ct.staticGeometry.build(centers.data(), extents.data(), payloads.data(), staticCount);
+        ct.visibleStaticGeometry.resize(staticCount);
+    }
+
+    if (ct.staticGeometry.empty()) {
+        return;
+    }
+
+    // the Culler processes multiples of Culler::MODULO elements
+    size_t const dynamicCount = ct.dynamicRows.size();
+    size_t const dynamicCapacity = Culler::round(dynamicCount);
+    ct.dynamicCenters.resize(dynamicCapacity);
+    ct.dynamicExtents.resize(dynamicCapacity);
+    ct.dynamicVisibility.resize(dynamicCapacity);
+    for (size_t i = 0; i < dynamicCount; i++) {
+        uint32_t const row = ct.dynamicRows[i];
+        ct.dynamicCenters[i] = sceneData.elementAt<WORLD_AABB_CENTER>(row);
+        ct.dynamicExtents[i] = sceneData.elementAt<WORLD_AABB_EXTENT>(row);
+    }
+}
+
+void FScene::cullRenderables(JobSystem& js, Frustum const& frustum,
+        size_t bit, size_t parallelThreshold) noexcept {
+    SYSTRACE_CALL();
+    assert_invariant(hasStaticGeometry());
+
+    ChangeTracking& ct = *mChangeTracking;
+    VisibleMaskType* const visibleArray = mRenderableData.data<VISIBLE_MASK>();
+    VisibleMaskType const visibleBit = VisibleMaskType(1u << bit);
+
+    // static renderables: the bit is already cleared, only set it for the visible ones
+    size_t const visibleCount = ct.staticGeometry.intersects(frustum,
+            ct.visibleStaticGeometry.data());
+    for (size_t i = 0; i < visibleCount; i++) {
+        visibleArray[ct.rows[ct.visibleStaticGeometry[i]]] |= visibleBit;
+    }
+
+    // dynamic renderables: same as FView::cullRenderables(), then scattered to their row
+    size_t const dynamicCount = ct.dynamicRows.size();
+    Culler::intersects(js, ct.dynamicVisibility.data(), frustum,
+            ct.dynamicCenters.data(), ct.dynamicExtents.data(), dynamicCount, bit,
+            parallelThreshold);
+    for (size_t i = 0; i < dynamicCount; i++) {
+        uint32_t const row = ct.dynamicRows[i];
+        visibleArray[row] = (visibleArray[row] & ~visibleBit) |
+                (ct.dynamicVisibility[i] & visibleBit);
+    }
 }
 
 void FScene::prepareVisibleRenderables(Range<uint32_t> visibleRenderables) noexcept {
@@ -384,7 +631,8 @@ void FScene::prepareVisibleRenderables(Range<uint32_t> visibleRenderables) noexc
 
 void FScene::updateUBOs(
         Range<uint32_t> visibleRenderables,
-        Handle<HwBufferObject> renderableUbh) noexcept {
+        Handle<HwBufferObject> renderableUbh,
+        Frustum const* instanceCullingFrustum) noexcept {
     SYSTRACE_CALL();
     FEngine::DriverApi& driver = mEngine.getDriverApi();
 
@@ -408,13 +656,46 @@ void FScene::updateUBOs(
     PerRenderableData const* const uboData = mRenderableData.data<UBO>();
     mat4f const* const worldTransformData = mRenderableData.data<WORLD_TRANSFORM>();
 
-    // prepare each InstanceBuffer.
-    FRenderableManager::InstancesInfo const* instancesData = mRenderableData.data<INSTANCES>();
+    // prepare each InstanceBuffer. Instances of renderables that are only visible from the
+    // camera can be culled individually, the draw count is updated accordingly.
+    FRenderableManager const& rcm = mEngine.getRenderableManager();
+    FRenderableManager::InstancesInfo* const instancesData = mRenderableData.data<INSTANCES>();
+    auto const* const renderableInstances = mRenderableData.data<RENDERABLE_INSTANCE>();
+    VisibleMaskType const* const visibleMasks = mRenderableData.data<VISIBLE_MASK>();
+    auto& instanceBufferWork = mInstanceBufferWork;
+    instanceBufferWork.clear();
     for (uint32_t const i : visibleRenderables) {
-        auto& instancesInfo = instancesData[i];
-        if (UTILS_UNLIKELY(instancesInfo.buffer)) {
-            instancesInfo.buffer->prepare(
-                    mEngine, worldTransformData[i], uboData[i], instancesInfo.handle);
+        if (UTILS_UNLIKELY(instancesData[i].buffer)) {
+            // the count in the SoA can be the culled count of a previous frame
+            uint16_t const count = rcm.getInstancesInfo(renderableInstances[i]).count;
+            instanceBufferWork.push_back({
+                    .stagingBuffer = driver.allocatePod<PerRenderableData>(count),
+                    .index = i,
+                    .count = count,
+                    .cull = visibleMasks[i] == VISIBLE_RENDERABLE });
+        }
+    }
+
+    if (UTILS_UNLIKELY(!instanceBufferWork.empty())) {
+        auto work = [&instanceBufferWork, instancesData, worldTransformData, uboData,
+                instanceCullingFrustum](uint32_t start, uint32_t count) {
+            for (uint32_t j = start; j < start + count; j++) {
+                InstanceBufferWork& w = instanceBufferWork[j];
+                w.count = uint16_t(instancesData[w.index].buffer->prepare(
+                        w.stagingBuffer, w.count, worldTransformData[w.index], uboData[w.index],
+                        w.cull ? instanceCullingFrustum : nullptr));
+            }
+        };
+
+        JobSystem& js = mEngine.getJobSystem();
+        auto* job = jobs::parallel_for(js, nullptr, 0, uint32_t(instanceBufferWork.size()),
+                std::cref(work), jobs::CountSplitter<4, 5>());
+        js.runAndWait(job);
+
+        for (InstanceBufferWork const& w : instanceBufferWork) {
+            instancesData[w.index].count = w.count;
+            driver.updateBufferObject(instancesData[w.index].handle,
+                    { w.stagingBuffer, w.count * sizeof(PerRenderableData) }, 0);
         }
     }
 
@@ -449,10 +730,13 @@ void FScene::updateUBOs(
     }
 }
 
-void FScene::terminate(FEngine&) {
+void FScene::terminate(FEngine& engine) {
     SYSTRACE_CALL();
     // DO NOT destroy this UBO, it's owned by the View
     mRenderableViewUbh.clear();
+    if (mChangeTracking) {
+        engine.getEntityManager().unregisterListener(mChangeTracking.get());
+    }
 }
 
 void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope&,
@@ -542,18 +826,27 @@ UTILS_NOINLINE
 void FScene::addEntity(Entity entity) {
     SYSTRACE_CALL();
     mEntities.insert(entity);
+    if (mChangeTracking) {
+        mChangeTracking->entitiesChanged.store(true, std::memory_order_relaxed);
+    }
 }
 
 UTILS_NOINLINE
 void FScene::addEntities(const Entity* entities, size_t count) {
     SYSTRACE_CALL();
     mEntities.insert(entities, entities + count);
+    if (mChangeTracking) {
+        mChangeTracking->entitiesChanged.store(true, std::memory_order_relaxed);
+    }
 }
 
 UTILS_NOINLINE
 void FScene::remove(Entity entity) {
     SYSTRACE_CALL();
     mEntities.erase(entity);
+    if (mChangeTracking) {
+        mChangeTracking->entitiesChanged.store(true, std::memory_order_relaxed);
+    }
 }
 
 UTILS_NOINLINE
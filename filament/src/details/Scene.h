@@ -21,6 +21,7 @@
 
 #include "Allocators.h"
 #include "Culler.h"
+#include "CullingBvh.h"
 
 #include "components/LightManager.h"
 #include "components/RenderableManager.h"
@@ -29,10 +30,12 @@
 #include "BufferPoolAllocator.h"
 
 #include <filament/Box.h>
+#include <filament/Frustum.h>
 #include <filament/Scene.h>
 
 #include <utils/compiler.h>
 #include <utils/Entity.h>
+#include <utils/EntityManager.h>
 #include <utils/Slice.h>
 #include <utils/StructureOfArrays.h>
 #include <utils/Range.h>
@@ -42,7 +45,10 @@
 
 #include <tsl/robin_set.h>
 
+#include <atomic>
 #include <memory>
+#include <utility>
+#include <vector>
 
 namespace filament {
 
@@ -184,11 +190,37 @@ public:
     LightSoa const& getLightData() const noexcept { return mLightData; }
     LightSoa& getLightData() noexcept { return mLightData; }
 
+    // instanceCullingFrustum is used to cull the instances of InstanceBuffers that have culling
+    // enabled, it can be null.
     void updateUBOs(utils::Range<uint32_t> visibleRenderables,
-            backend::Handle<backend::HwBufferObject> renderableUbh) noexcept;
+            backend::Handle<backend::HwBufferObject> renderableUbh,
+            Frustum const* instanceCullingFrustum) noexcept;
 
     bool hasContactShadows() const noexcept;
 
+    // Changes each time prepare() updates the data of any renderable. Without change tracking,
+    // this changes at each prepare().
+    uint32_t getRevision() const noexcept { return mRevision; }
+
+    // The revision at which each renderable of getRenderableData() was last updated, this is
+    // only available with change tracking, nullptr otherwise.
+    uint32_t const* getRenderableRevisions() const noexcept {
+        return mChangeTracking ? mChangeTracking->renderableRevisions.data() : nullptr;
+    }
+
+    // whether static renderables are culled with a bounding volume hierarchy
+    bool hasStaticGeometry() const noexcept {
+        return mChangeTracking && !mChangeTracking->staticGeometry.empty();
+    }
+
+    /*
+     * Sets `bit` of VISIBLE_MASK for each renderable intersecting the frustum. Static renderables
+     * are culled with the bounding volume hierarchy, the others with the regular Culler.
+     * This requires hasStaticGeometry() and `bit` to be cleared for all renderables.
+     */
+    void cullRenderables(utils::JobSystem& js, Frustum const& frustum,
+            size_t bit, size_t parallelThreshold) noexcept;
+
 private:
     friend class Scene;
     void setSkybox(FSkybox* skybox) noexcept;
@@ -206,6 +238,11 @@ private:
     static inline void computeLightRanges(math::float2* zrange,
             CameraInfo const& camera, const math::float4* spheres, size_t count) noexcept;
 
+    bool canPrepareIncrementally(math::mat4 const& worldTransform,
+            bool shadowReceiversAreCasters) noexcept;
+
+    void prepareStaticGeometry() noexcept;
+
     FEngine& mEngine;
     FSkybox* mSkybox = nullptr;
     FIndirectLight* mIndirectLight = nullptr;
@@ -228,12 +265,83 @@ private:
     LightSoa mLightData;
     backend::Handle<backend::HwBufferObject> mRenderableViewUbh; // This is actually owned by the view.
     bool mHasContactShadows = false;
+    uint32_t mRevision = 0;
 
     // State shared between Scene and driver callbacks.
     struct SharedState {
         BufferPoolAllocator<3> mBufferPoolAllocator = {};
     };
     std::shared_ptr<SharedState> mSharedState;
+
+    // InstanceBuffers prepared by updateUBOs(), kept here to reuse the storage
+    struct InstanceBufferWork {
+        PerRenderableData* stagingBuffer;
+        uint32_t index;         // index of the renderable in the SoA
+        uint16_t count;         // number of instances, then number of instances to draw
+        bool cull;              // whether instances can be culled individually
+    };
+    std::vector<InstanceBufferWork> mInstanceBufferWork;
+
+    /*
+     * State kept across frames when Engine::Config::sceneChangeTracking is enabled. It allows
+     * prepare() to skip gathering the scene's renderables and lights, and to only update the
+     * rows of mRenderableData whose renderable or transform changed since the last prepare().
+     * Note that rows don't move during an incremental prepare() (but FView may partition them).
+     */
+    struct ChangeTracking : public utils::EntityManager::Listener {
+        using LightInstances =
+                std::vector<std::pair<LightManager::Instance, TransformManager::Instance>>;
+
+        // this is called on the thread destroying the entities
+        void onEntitiesDestroyed(size_t, utils::Entity const*) noexcept override {
+            entitiesChanged.store(true, std::memory_order_relaxed);
+        }
+
+        // set when the list of entities (or their liveness) changed
+        std::atomic<bool> entitiesChanged = true;
+
+        // set when an incremental prepare() updated any renderable
+        std::atomic<bool> renderablesChanged = false;
+
+        // revision at which each row of mRenderableData was last updated
+        std::vector<uint32_t> renderableRevisions;
+
+        // transform instance of each renderable instance in the scene
+        std::vector<TransformManager::Instance> transformInstances;
+        LightInstances lightInstances;
+        LightInstances directionalLightInstances;
+
+        math::mat4 worldTransform;
+        uint32_t renderableEpoch = 0;
+        uint32_t transformEpoch = 0;
+        uint32_t renderableStructureVersion = 0;
+        uint32_t transformStructureVersion = 0;
+        uint32_t lightStructureVersion = 0;
+        bool shadowReceiversAreCasters = false;
+
+        /*
+         * Static geometry (see RenderableManager::Builder::staticGeometry()). The hierarchy is
+         * indexed by renderable instance because rows move, so we record the row of each
+         * renderable instance at each prepare().
+         */
+
+        // set when a static renderable changed, or a renderable became static
+        std::atomic<bool> staticGeometryChanged = false;
+        // world AABBs of the static renderables
+        CullingBvh staticGeometry;
+        // whether each renderable instance is in staticGeometry
+        std::vector<bool> inStaticGeometry;
+        // row in mRenderableData of each renderable instance
+        std::vector<uint32_t> rows;
+        // scratch space for the visible static renderables
+        std::vector<uint32_t> visibleStaticGeometry;
+        // rows of the non-static renderables, and a copy of their AABB for the Culler
+        std::vector<uint32_t> dynamicRows;
+        std::vector<math::float3> dynamicCenters;
+        std::vector<math::float3> dynamicExtents;
+        std::vector<Culler::result_type> dynamicVisibility;
+    };
+    std::unique_ptr<ChangeTracking> mChangeTracking;
 };
 
 FILAMENT_DOWNCAST(Scene)
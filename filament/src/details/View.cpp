@@ -89,7 +89,7 @@ FView::FView(FEngine& engine)
 #endif
 
     // allocate UBOs
-    mLightUbh = driver.createBufferObject(CONFIG_MAX_LIGHT_COUNT * sizeof(LightsUib),
+    mLightUbh = driver.createBufferObject(engine.getMaxLightCount() * sizeof(LightsUib),
             BufferObjectBinding::UNIFORM, BufferUsage::DYNAMIC);
 
     mIsDynamicResolutionSupported = driver.isFrameTimeSupported();
@@ -357,7 +357,7 @@ void FView::prepareLighting(FEngine& engine, ArenaScope& arena,
         scene->prepareDynamicLights(cameraInfo, arena, mLightUbh);
     }
 
-    // here the array of visible lights has been shrunk to CONFIG_MAX_LIGHT_COUNT
+    // here the array of visible lights has been shrunk to FEngine::getMaxLightCount()
     SYSTRACE_VALUE32("visibleLights", lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT);
 
     /*
@@ -482,8 +482,9 @@ void FView::prepare(FEngine& engine, DriverApi& driver, ArenaScope& arena,
                 [&engine, &arena, &viewMatrix = cameraInfo.view, &cullingFrustum,
                  &lightData = scene->getLightData()]
                         (JobSystem&, JobSystem::Job*) {
-                    FView::prepareVisibleLights(engine.getLightManager(), arena,
-                            viewMatrix, cullingFrustum, lightData);
+                    FView::prepareVisibleLights(engine.getLightManager(),
+                            engine.getMaxLightCount(), arena, viewMatrix, cullingFrustum,
+                            lightData);
                 }));
     }
 
@@ -503,7 +504,7 @@ void FView::prepare(FEngine& engine, DriverApi& driver, ArenaScope& arena,
          * (this will set the VISIBLE_RENDERABLE bit)
          */
 
-        prepareVisibleRenderables(js, cullingFrustum, renderableData);
+        prepareVisibleRenderables(engine, cullingFrustum, *scene);
 
 
         /*
@@ -531,7 +532,8 @@ void FView::prepare(FEngine& engine, DriverApi& driver, ArenaScope& arena,
         if (hasDynamicLighting()) {
             auto& froxelizer = mFroxelizer;
             if (froxelizer.prepare(driver, arena, viewport,
-                    cameraInfo.projection, cameraInfo.zn, cameraInfo.zf)) {
+                    cameraInfo.projection, cameraInfo.zn, cameraInfo.zf,
+                    lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT)) {
                 // TODO: might be more consistent to do this in prepareLighting(), but it's not
                 //       strictly necessary
                 mPerViewUniforms.prepareDynamicLights(mFroxelizer);
@@ -629,13 +631,15 @@ void FView::prepare(FEngine& engine, DriverApi& driver, ArenaScope& arena,
                 const size_t count = std::max(size_t(16u), (4u * merged.size() + 2u) / 3u);
                 mRenderableUBOSize = uint32_t(count * sizeof(PerRenderableData));
                 driver.destroyBufferObject(mRenderableUbh);
-                mRenderableUbh = driver.createBufferObject(mRenderableUBOSize + sizeof(PerRenderableUib),
+                mRenderableUbh = driver.createBufferObject(
+                        mRenderableUBOSize + engine.getPerRenderableUibSize(),
                         BufferObjectBinding::UNIFORM, BufferUsage::DYNAMIC);
             } else {
                 // TODO: should we shrink the underlying UBO at some point?
             }
             assert_invariant(mRenderableUbh);
-            scene->updateUBOs(merged, mRenderableUbh);
+            scene->updateUBOs(merged, mRenderableUbh,
+                    isFrustumCullingEnabled() ? &cullingFrustum : nullptr);
         }
     }
 
@@ -813,45 +817,43 @@ void FView::commitFroxels(DriverApi& driverApi) const noexcept {
 }
 
 UTILS_NOINLINE
-void FView::prepareVisibleRenderables(JobSystem& js,
-        Frustum const& frustum, FScene::RenderableSoa& renderableData) const noexcept {
+void FView::prepareVisibleRenderables(FEngine& engine,
+        Frustum const& frustum, FScene& scene) const noexcept {
     SYSTRACE_CALL();
+    FScene::RenderableSoa& renderableData = scene.getRenderableData();
     if (UTILS_LIKELY(isFrustumCullingEnabled())) {
-        FView::cullRenderables(js, renderableData, frustum, VISIBLE_RENDERABLE_BIT);
+        FView::cullRenderables(engine, scene, frustum, VISIBLE_RENDERABLE_BIT);
     } else {
         std::uninitialized_fill(renderableData.begin<FScene::VISIBLE_MASK>(),
                   renderableData.end<FScene::VISIBLE_MASK>(), VISIBLE_RENDERABLE);
     }
 }
 
-void FView::cullRenderables(JobSystem&,
-        FScene::RenderableSoa& renderableData, Frustum const& frustum, size_t bit) noexcept {
+void FView::cullRenderables(FEngine& engine,
+        FScene& scene, Frustum const& frustum, size_t bit) noexcept {
     SYSTRACE_CALL();
 
+    if (UTILS_UNLIKELY(scene.hasStaticGeometry())) {
+        scene.cullRenderables(engine.getJobSystem(), frustum, bit,
+                engine.getConfig().parallelCullingThreshold);
+        return;
+    }
+
+    FScene::RenderableSoa& renderableData = scene.getRenderableData();
     float3 const* worldAABBCenter = renderableData.data<FScene::WORLD_AABB_CENTER>();
     float3 const* worldAABBExtent = renderableData.data<FScene::WORLD_AABB_EXTENT>();
     FScene::VisibleMaskType* visibleArray = renderableData.data<FScene::VISIBLE_MASK>();
 
-    // culling job (this runs on multiple threads)
-    auto functor = [&frustum, worldAABBCenter, worldAABBExtent, visibleArray, bit]
-            (uint32_t index, uint32_t c) {
-        Culler::intersects(
-                visibleArray + index,
-                frustum,
-                worldAABBCenter + index,
-                worldAABBExtent + index, c, bit);
-    };
-
-    // Note: we can't use jobs::parallel_for() here because Culler::intersects() must process
-    //       multiples of eight primitives.
-    // Moreover, even with a large number of primitives, the overhead of the JobSystem is too
-    // large compared to the run time of Culler::intersects, e.g.: ~100us for 4000 primitives
-    // on Pixel4.
-    functor(0, renderableData.size());
+    // Note: the overhead of the JobSystem is large compared to the run time of
+    // Culler::intersects, e.g.: ~100us for 4000 primitives on Pixel4, so we only split the
+    // work in parallel jobs for large scenes. See Engine::Config::parallelCullingThreshold.
+    Culler::intersects(engine.getJobSystem(),
+            visibleArray, frustum, worldAABBCenter, worldAABBExtent, renderableData.size(), bit,
+            engine.getConfig().parallelCullingThreshold);
 }
 
-void FView::prepareVisibleLights(FLightManager const& lcm, ArenaScope& rootArena,
-        mat4f const& viewMatrix, Frustum const& frustum,
+void FView::prepareVisibleLights(FLightManager const& lcm, size_t maxLightCount,
+        ArenaScope& rootArena, mat4f const& viewMatrix, Frustum const& frustum,
         FScene::LightSoa& lightData) noexcept {
     SYSTRACE_CALL();
     assert_invariant(lightData.size() > FScene::DIRECTIONAL_LIGHTS_COUNT);
@@ -908,7 +910,8 @@ void FView::prepareVisibleLights(FLightManager const& lcm, ArenaScope& rootArena
 
 
     /*
-     * Some lights might be left out if there are more than the GPU buffer allows (i.e. 256).
+     * Some lights might be left out if there are more than the GPU buffer allows (i.e. 256,
+     * or 1024 with Engine::Config::largeLightCount).
      *
      * We always sort lights by distance to the camera so that:
      * - we can build light trees later
@@ -939,7 +942,7 @@ void FView::prepareVisibleLights(FLightManager const& lcm, ArenaScope& rootArena
     }
 
     // drop excess lights
-    lightData.resize(std::min(size, CONFIG_MAX_LIGHT_COUNT + FScene::DIRECTIONAL_LIGHTS_COUNT));
+    lightData.resize(std::min(size, maxLightCount + FScene::DIRECTIONAL_LIGHTS_COUNT));
 }
 
 // These methods need to exist so clang honors the __restrict__ keyword, which in turn
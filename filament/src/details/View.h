@@ -29,6 +29,7 @@
 #include "Froxelizer.h"
 #include "PerViewUniforms.h"
 #include "PIDController.h"
+#include "RenderPass.h"
 #include "ShadowMap.h"
 #include "ShadowMapManager.h"
 #include "TypedUniformBuffer.h"
@@ -373,6 +374,11 @@ public:
         return mVisibleRenderables;
     }
 
+    // commands of the color pass kept across frames, see Engine::Config::renderPassCommandCache
+    RenderPass::CommandCache& getColorPassCommandCache() noexcept {
+        return mColorPassCommandCache;
+    }
+
     Range const& getVisibleDirectionalShadowCasters() const noexcept {
         return mVisibleDirectionalShadowCasters;
     }
@@ -398,7 +404,7 @@ public:
         }
     }
 
-    static void cullRenderables(utils::JobSystem& js, FScene::RenderableSoa& renderableData,
+    static void cullRenderables(FEngine& engine, FScene& scene,
             Frustum const& frustum, size_t bit) noexcept;
 
     PerViewUniforms const& getPerViewUniforms() const noexcept { return mPerViewUniforms; }
@@ -457,11 +463,11 @@ private:
         PickingQueryResult result;
     };
 
-    void prepareVisibleRenderables(utils::JobSystem& js,
-            Frustum const& frustum, FScene::RenderableSoa& renderableData) const noexcept;
+    void prepareVisibleRenderables(FEngine& engine,
+            Frustum const& frustum, FScene& scene) const noexcept;
 
-    static void prepareVisibleLights(FLightManager const& lcm, ArenaScope& rootArena,
-            math::mat4f const& viewMatrix, Frustum const& frustum,
+    static void prepareVisibleLights(FLightManager const& lcm, size_t maxLightCount,
+            ArenaScope& rootArena, math::mat4f const& viewMatrix, Frustum const& frustum,
             FScene::LightSoa& lightData) noexcept;
 
     static inline void computeLightCameraDistances(float* distances,
@@ -556,6 +562,8 @@ private:
 
     ShadowMapManager mShadowMapManager;
 
+    RenderPass::CommandCache mColorPassCommandCache;
+
     std::array<math::float4, 4> mMaterialGlobals = {{
                                                             { 0, 0, 0, 1 },
                                                             { 0, 0, 0, 1 },
@@ -0,0 +1,643 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <backend/Platform.h>
+
+#include <backend/BufferDescriptor.h>
+#include <backend/SamplerDescriptor.h>
+
+#include <private/backend/CircularBuffer.h>
+#include <private/backend/CommandBufferQueue.h>
+#include <private/backend/CommandStream.h>
+#include <private/backend/CommandStreamCapture.h>
+#include <private/backend/CommandStreamProfiler.h>
+#include <private/backend/Dispatcher.h>
+#include <private/backend/Driver.h>
+#include <private/backend/PlatformFactory.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+
+using namespace filament;
+using namespace backend;
+
+/*
+ * A driver doing nothing, except recording the handles it creates and the content of the
+ * sampler groups it receives.
+ */
+class RecordingDriver final : public Driver {
+public:
+    explicit RecordingDriver(HandleBase::HandleId firstHandle) noexcept
+            : mNextHandle(firstHandle) {
+    }
+
+    std::vector<HandleBase::HandleId> createdHandles;
+    std::vector<std::pair<SamplerGroupHandle, std::vector<SamplerDescriptor>>> samplerGroups;
+
+private:
+    void purge() noexcept override { }
+    ShaderModel getShaderModel() const noexcept override { return ShaderModel::DESKTOP; }
+    void debugCommandBegin(CommandStream*, bool, const char*) noexcept override { }
+    void debugCommandEnd(CommandStream*, bool, const char*) noexcept override { }
+
+    Dispatcher getDispatcher() const noexcept override {
+        Dispatcher dispatcher;
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                                         \
+        dispatcher.methodName##_ = &Commands::skip<COMMAND_TYPE(methodName)>;
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)                         \
+        dispatcher.methodName##_ = &Commands::skip<COMMAND_TYPE(methodName##R)>;
+#include <private/backend/DriverAPI.inc>
+        dispatcher.updateSamplerGroup_ = &Commands::updateSamplerGroup;
+        return dispatcher;
+    }
+
+    struct Commands {
+        template<typename Cmd>
+        static void skip(Driver&, CommandBase* base, intptr_t* next) noexcept {
+            *next = CommandBase::align(sizeof(Cmd));
+            static_cast<Cmd*>(base)->~Cmd();
+        }
+
+        static void updateSamplerGroup(Driver& driver, CommandBase* base, intptr_t* next) {
+            using Cmd = COMMAND_TYPE(updateSamplerGroup);
+            auto const& [sgh, data] = static_cast<Cmd*>(base)->getArguments();
+            auto const* const samplers = static_cast<SamplerDescriptor const*>(data.buffer);
+            static_cast<RecordingDriver&>(driver).samplerGroups.emplace_back(sgh,
+                    std::vector<SamplerDescriptor>(samplers,
+                            samplers + data.size / sizeof(SamplerDescriptor)));
+            skip<Cmd>(driver, base, next);
+        }
+    };
+
+#define DECL_DRIVER_API(methodName, paramsDecl, params)
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)                    \
+    RetType methodName(paramsDecl) override { return RetType(); }
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)                         \
+    RetType methodName##S() noexcept override {                                                 \
+        createdHandles.push_back(mNextHandle);                                                  \
+        return RetType(mNextHandle++);                                                          \
+    }
+#include <private/backend/DriverAPI.inc>
+
+    HandleBase::HandleId mNextHandle;
+};
+
+class CommandStreamTest : public testing::Test {
+protected:
+    void SetUp() override {
+        platform = PlatformFactory::create(&backend);
+        driver = platform->createDriver(nullptr, {});
+    }
+
+    void TearDown() override {
+        driver->terminate();
+        delete driver;
+        PlatformFactory::destroy(&platform);
+    }
+
+    // terminates the commands recorded in 'buffer' since the last call and executes them
+    static void execute(CommandStream& stream, CircularBuffer& buffer) {
+        new(buffer.allocate(CommandBase::align(sizeof(NoopCommand)))) NoopCommand(nullptr);
+        void* const tail = buffer.getTail();
+        buffer.circularize();
+        stream.execute(tail);
+    }
+
+    Backend backend = Backend::NOOP;
+    Platform* platform = nullptr;
+    Driver* driver = nullptr;
+};
+
+TEST_F(CommandStreamTest, Segments) {
+    if (!CommandStream::hasSegments()) {
+        GTEST_SKIP() << "segments are not available with FILAMENT_DEBUG_COMMANDS";
+    }
+
+    constexpr size_t SEGMENT_COUNT = 8;
+    constexpr size_t COMMANDS_PER_SEGMENT = 100;
+
+    // a command is recorded before each segment, so we can check where segments are inserted
+    auto record = [](CommandStream& stream, std::vector<size_t>& out, size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            stream.queueCommand([&out, i]() { out.push_back(i); });
+        }
+    };
+
+    // reference: all the commands recorded sequentially in the main stream
+    std::vector<size_t> expected;
+    {
+        CircularBuffer buffer(65536);
+        CommandStream stream(*driver, buffer);
+        for (size_t i = 0; i < SEGMENT_COUNT; i++) {
+            size_t const base = i * (COMMANDS_PER_SEGMENT + 1);
+            record(stream, expected, base, base + 1);
+            record(stream, expected, base + 1, base + 1 + COMMANDS_PER_SEGMENT);
+        }
+        execute(stream, buffer);
+    }
+    ASSERT_EQ(SEGMENT_COUNT * (COMMANDS_PER_SEGMENT + 1), expected.size());
+
+    // the same commands, with each range recorded concurrently in its own segment
+    std::vector<size_t> result;
+    {
+        CircularBuffer buffer(65536);
+        CommandStream stream(*driver, buffer);
+
+        CommandStreamSegment* segments[SEGMENT_COUNT];
+        for (auto& segment : segments) {
+            segment = stream.createSegment(COMMANDS_PER_SEGMENT * 128);
+        }
+
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < SEGMENT_COUNT; i++) {
+            threads.emplace_back([&, i]() {
+                CommandStream& segmentStream = segments[i]->getStream();
+                segmentStream.debugThreading();
+                size_t const base = i * (COMMANDS_PER_SEGMENT + 1);
+                record(segmentStream, result, base + 1, base + 1 + COMMANDS_PER_SEGMENT);
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        // the segments are inserted in order, regardless of when they were recorded
+        for (size_t i = 0; i < SEGMENT_COUNT; i++) {
+            size_t const base = i * (COMMANDS_PER_SEGMENT + 1);
+            record(stream, result, base, base + 1);
+            stream.insertSegment(segments[i]);
+        }
+        execute(stream, buffer);
+    }
+
+    EXPECT_EQ(expected, result);
+}
+
+TEST_F(CommandStreamTest, EmptySegment) {
+    if (!CommandStream::hasSegments()) {
+        GTEST_SKIP() << "segments are not available with FILAMENT_DEBUG_COMMANDS";
+    }
+
+    std::vector<int> result;
+    CircularBuffer buffer(65536);
+    CommandStream stream(*driver, buffer);
+    stream.queueCommand([&result]() { result.push_back(0); });
+    stream.insertSegment(stream.createSegment(1024));
+    stream.queueCommand([&result]() { result.push_back(1); });
+    execute(stream, buffer);
+
+    EXPECT_EQ(std::vector<int>({ 0, 1 }), result);
+}
+
+TEST_F(CommandStreamTest, OverflowWhileRecording) {
+    constexpr size_t REQUIRED_SIZE = 64 * 1024;
+    constexpr size_t BUFFER_SIZE = 256 * 1024;
+    constexpr size_t CHUNK_SIZE = 4096;
+
+    CommandBufferQueue queue(REQUIRED_SIZE, BUFFER_SIZE);
+    CommandStream stream(*driver, queue.getCircularBuffer());
+
+    // the driver thread is kept busy until the stream overflows, so that the space used by the
+    // commands recorded until then isn't freed
+    std::atomic<bool> gate{ false };
+    size_t overflowCount = 0;
+    stream.setOverflowHandler([&](size_t size) {
+        overflowCount++;
+        gate.store(true);
+        queue.reserve(size);
+    });
+
+    // the driver thread, see FEngine::execute()
+    std::thread consumer([&]() {
+        while (true) {
+            auto buffers = queue.waitForCommands();
+            if (buffers.empty()) {
+                break;
+            }
+            for (auto& item : buffers) {
+                stream.execute(item.begin);
+                queue.releaseBuffer(item);
+            }
+        }
+    });
+
+    std::atomic<size_t> checkedCount{ 0 };
+    std::atomic<size_t> errorCount{ 0 };
+
+    // the last slice's commands must not be handed off to the driver thread before it's flushed
+    std::atomic<bool> recording{ false };
+    std::atomic<size_t> earlyCount{ 0 };
+
+    // records a chunk of data, and a command checking it when executed
+    auto recordChunk = [&](uint8_t value, bool last) {
+        uint8_t* const data = stream.allocatePod<uint8_t>(CHUNK_SIZE);
+        std::fill_n(data, CHUNK_SIZE, value);
+        stream.queueCommand([&, data, value, last]() {
+            for (size_t i = 0; i < CHUNK_SIZE; i++) {
+                if (data[i] != value) {
+                    errorCount++;
+                    break;
+                }
+            }
+            checkedCount++;
+            if (last && recording.load()) {
+                earlyCount++;
+            }
+        });
+        return data;
+    };
+
+    stream.queueCommand([&gate]() {
+        while (!gate.load()) {
+            std::this_thread::yield();
+        }
+    });
+    queue.flush();
+
+    // fill the circular buffer, leaving a bit more than the required space...
+    size_t const firstCount = (BUFFER_SIZE - REQUIRED_SIZE * 3 / 2) / CHUNK_SIZE - 1;
+    for (size_t i = 0; i < firstCount; i++) {
+        recordChunk(uint8_t(i), false);
+    }
+    queue.flush();
+
+    // ...then record more than the space left without flushing. The stream overflows and must
+    // wait for the driver thread, while the data recorded first is still needed.
+    recording.store(true);
+    uint8_t const* const first = recordChunk(0xA5, true);
+    size_t const secondCount = REQUIRED_SIZE * 2 / CHUNK_SIZE;
+    for (size_t i = 0; i < secondCount; i++) {
+        recordChunk(uint8_t(i + 1), true);
+    }
+    bool firstIntact = true;
+    stream.queueCommand([&firstIntact, first]() {
+        for (size_t i = 0; i < CHUNK_SIZE; i++) {
+            firstIntact = firstIntact && first[i] == 0xA5;
+        }
+    });
+
+    // give the driver thread a chance to execute commands it shouldn't have received yet
+    while (checkedCount.load() < firstCount) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    recording.store(false);
+    queue.flush();
+
+    // wait for everything to be executed
+    std::atomic<bool> done{ false };
+    stream.queueCommand([&done]() { done.store(true); });
+    queue.flush();
+    while (!done.load()) {
+        std::this_thread::yield();
+    }
+    queue.requestExit();
+    consumer.join();
+
+    EXPECT_GE(overflowCount, 1u);
+    EXPECT_TRUE(firstIntact);
+    EXPECT_EQ(0u, errorCount.load());
+    EXPECT_EQ(0u, earlyCount.load());
+    EXPECT_EQ(firstCount + secondCount + 1, checkedCount.load());
+    EXPECT_GT(queue.getProducerBlockedTime(), 0u);
+}
+
+TEST_F(CommandStreamTest, OverflowBufferSize) {
+    constexpr size_t REQUIRED_SIZE = 64 * 1024;
+    constexpr size_t BUFFER_SIZE = 128 * 1024;
+    constexpr size_t MAX_BUFFER_SIZE = 1024 * 1024;
+    constexpr size_t CHUNK_SIZE = 4096;
+
+    CommandBufferQueue queue(REQUIRED_SIZE, BUFFER_SIZE, MAX_BUFFER_SIZE);
+    CommandStream stream(*driver, queue.getCircularBuffer());
+    stream.setOverflowHandler([&queue](size_t size) { queue.reserve(size); });
+
+    // the driver thread, see FEngine::execute()
+    std::thread consumer([&]() {
+        while (true) {
+            auto buffers = queue.waitForCommands();
+            if (buffers.empty()) {
+                break;
+            }
+            for (auto& item : buffers) {
+                stream.execute(item.begin);
+                queue.releaseBuffer(item);
+            }
+        }
+    });
+
+    // only accessed by the driver thread until it's joined
+    size_t checkedCount = 0;
+    size_t errorCount = 0;
+
+    // records a chunk of data, and a command checking it when executed
+    auto recordChunk = [&](uint8_t value) {
+        uint8_t* const data = stream.allocatePod<uint8_t>(CHUNK_SIZE);
+        std::fill_n(data, CHUNK_SIZE, value);
+        stream.queueCommand([&, data, value]() {
+            errorCount += std::any_of(data, data + CHUNK_SIZE,
+                    [value](uint8_t v) { return v != value; });
+            checkedCount++;
+        });
+    };
+
+    // a slice which may still be executing when the next one overflows the buffer
+    recordChunk(0);
+    queue.flush();
+
+    // more commands than the whole buffer between two flushes, e.g. many resources created at
+    // once. They continue in a larger buffer.
+    size_t const largeCount = BUFFER_SIZE * 3 / CHUNK_SIZE;
+    for (size_t i = 0; i < largeCount; i++) {
+        recordChunk(uint8_t(i + 1));
+    }
+    queue.flush();
+    EXPECT_GT(queue.getSize(), BUFFER_SIZE);
+    EXPECT_LE(queue.getSize(), MAX_BUFFER_SIZE);
+    EXPECT_GE(queue.getResizeCount(), 1u);
+
+    // and the commands recorded next use the larger buffer
+    for (size_t i = 0; i < 16; i++) {
+        recordChunk(uint8_t(i));
+        queue.flush();
+    }
+
+    queue.requestExit();
+    consumer.join();
+
+    EXPECT_EQ(0u, errorCount);
+    EXPECT_EQ(1 + largeCount + 16, checkedCount);
+}
+
+TEST_F(CommandStreamTest, ProducerConsumerStress) {
+    // a small buffer and many small slices, so that the two threads often wait for each other.
+    // A lost wake-up hangs this test.
+    constexpr size_t REQUIRED_SIZE = 16 * 1024;
+    constexpr size_t BUFFER_SIZE = 64 * 1024;
+    constexpr size_t SLICE_COUNT = 20000;
+
+    CommandBufferQueue queue(REQUIRED_SIZE, BUFFER_SIZE);
+    CommandStream stream(*driver, queue.getCircularBuffer());
+    stream.setOverflowHandler([&queue](size_t size) { queue.reserve(size); });
+
+    // the driver thread, see FEngine::execute()
+    std::thread consumer([&]() {
+        while (true) {
+            auto buffers = queue.waitForCommands();
+            if (buffers.empty()) {
+                break;
+            }
+            for (auto& item : buffers) {
+                stream.execute(item.begin);
+                queue.releaseBuffer(item);
+            }
+        }
+    });
+
+    // only accessed by the driver thread until it's joined
+    size_t executedCount = 0;
+    size_t errorCount = 0;
+
+    // each command checks its data and that it's executed in order, some of them are slow so
+    // that the producer runs out of space.
+    std::default_random_engine generator(82828); // NOLINT
+    size_t commandCount = 0;
+    for (size_t i = 0; i < SLICE_COUNT; i++) {
+        for (size_t k = 0, n = 1 + generator() % 8; k < n; k++) {
+            size_t const size = 1 + generator() % 256;
+            uint32_t const value = uint32_t(commandCount);
+            uint32_t* const data = stream.allocatePod<uint32_t>(size);
+            std::fill_n(data, size, value);
+            bool const slow = generator() % 64 == 0;
+            stream.queueCommand([&, data, size, value, slow]() {
+                errorCount += executedCount != value ||
+                        std::any_of(data, data + size, [value](uint32_t v) { return v != value; });
+                executedCount++;
+                if (slow) {
+                    std::this_thread::yield();
+                }
+            });
+            commandCount++;
+        }
+        queue.flush();
+        // and the driver thread sometimes runs out of commands
+        if (generator() % 64 == 0) {
+            std::this_thread::yield();
+        }
+    }
+
+    queue.requestExit();
+    consumer.join();
+
+    EXPECT_EQ(0u, errorCount);
+    EXPECT_EQ(commandCount, executedCount);
+}
+
+TEST_F(CommandStreamTest, CaptureReplay) {
+    std::string const path = testing::TempDir() + "filament_command_stream_test.capture";
+
+    // the handles created by the replay differ from the captured ones
+    RecordingDriver captureDriver(1);
+    RecordingDriver replayDriver(1000);
+
+    {
+        CircularBuffer buffer(65536);
+        CommandStream stream(captureDriver, buffer);
+        ASSERT_TRUE(stream.startCommandCapture(path.c_str()));
+
+        TextureHandle const texture = stream.createTexture(SamplerType::SAMPLER_2D, 1,
+                TextureFormat::RGBA8, 1, 4, 4, 1, TextureUsage::DEFAULT);
+        SamplerGroupHandle const samplerGroup = stream.createSamplerGroup(2,
+                utils::FixedSizeString<32>("test"));
+
+        // the second sampler is unused
+        auto* const samplers = stream.allocatePod<SamplerDescriptor>(2);
+        samplers[0] = { texture, {} };
+        samplers[1] = {};
+        stream.updateSamplerGroup(samplerGroup,
+                BufferDescriptor(samplers, 2 * sizeof(SamplerDescriptor)));
+        stream.insertEventMarker("marker", 6);
+
+        stream.stopCommandCapture();
+        execute(stream, buffer);
+    }
+
+    ASSERT_EQ(2u, captureDriver.createdHandles.size());
+    ASSERT_EQ(1u, captureDriver.samplerGroups.size());
+    EXPECT_EQ(captureDriver.createdHandles[0],
+            captureDriver.samplerGroups[0].second[0].t.getId());
+
+    CommandStreamReplay replay(replayDriver, 65536);
+    EXPECT_TRUE(replay.replay(path.c_str()));
+    remove(path.c_str());
+
+    auto const& statistics = replay.getStatistics();
+    EXPECT_EQ(1u, statistics.commands[size_t(CommandId::createTexture)].count);
+    EXPECT_EQ(1u, statistics.commands[size_t(CommandId::createSamplerGroup)].count);
+    EXPECT_EQ(1u, statistics.commands[size_t(CommandId::updateSamplerGroup)].count);
+    EXPECT_EQ(1u, statistics.commands[size_t(CommandId::insertEventMarker)].count);
+    EXPECT_EQ(0u, statistics.skippedCount);
+
+    // the sampler group and the texture it refers to are the ones created by the replay
+    ASSERT_EQ(2u, replayDriver.createdHandles.size());
+    ASSERT_EQ(1u, replayDriver.samplerGroups.size());
+    auto const& [samplerGroup, samplers] = replayDriver.samplerGroups[0];
+    EXPECT_EQ(replayDriver.createdHandles[1], samplerGroup.getId());
+    ASSERT_EQ(2u, samplers.size());
+    EXPECT_EQ(replayDriver.createdHandles[0], samplers[0].t.getId());
+    EXPECT_FALSE(samplers[1].t);
+}
+
+TEST_F(CommandStreamTest, CommandStatistics) {
+    // records a frame with as many markers as its id
+    auto recordFrame = [](CommandStream& stream, uint32_t frameId) {
+        stream.beginFrame(0, frameId);
+        for (uint32_t i = 0; i < frameId; i++) {
+            stream.insertEventMarker("marker", 6);
+        }
+        stream.endFrame(frameId);
+    };
+
+    // the statistics of a frame recorded with recordFrame()
+    auto checkFrame = [](CommandStreamProfiler::FrameStatistics const& statistics,
+            uint32_t frameId) {
+        EXPECT_EQ(frameId, statistics.frameId);
+        auto const& commands = statistics.commands;
+        EXPECT_EQ(1u, commands[size_t(CommandId::beginFrame)].count);
+        EXPECT_EQ(1u, commands[size_t(CommandId::endFrame)].count);
+        EXPECT_EQ(frameId, commands[size_t(CommandId::insertEventMarker)].count);
+        EXPECT_EQ(0u, commands[size_t(CommandId::createTexture)].count);
+        EXPECT_EQ(frameId * CommandBase::align(sizeof(COMMAND_TYPE(insertEventMarker))),
+                commands[size_t(CommandId::insertEventMarker)].size);
+    };
+
+    RecordingDriver recordingDriver(1);
+    CircularBuffer buffer(65536);
+    CommandStream stream(recordingDriver, buffer);
+    EXPECT_EQ(nullptr, stream.getCommandProfiler());
+
+    // nothing is accounted for before profiling starts
+    recordFrame(stream, 7);
+    execute(stream, buffer);
+
+    ASSERT_TRUE(stream.startCommandProfiling());
+    EXPECT_FALSE(stream.startCommandProfiling());
+    CommandStreamProfiler const* const profiler = stream.getCommandProfiler();
+    ASSERT_NE(nullptr, profiler);
+
+    // no frame ended yet
+    recordFrame(stream, 1);
+    stream.insertEventMarker("marker", 6);
+    EXPECT_EQ(0u, profiler->getFrameStatistics().frameId);
+    execute(stream, buffer);
+
+    // each frame's statistics replace the previous ones, the commands recorded after the last
+    // endFrame are accounted to the next frame
+    checkFrame(profiler->getFrameStatistics(), 1);
+    recordFrame(stream, 2);
+    execute(stream, buffer);
+    auto statistics = profiler->getFrameStatistics();
+    EXPECT_EQ(2u, statistics.frameId);
+    EXPECT_EQ(3u, statistics.commands[size_t(CommandId::insertEventMarker)].count);
+
+    for (uint32_t frameId = 3; frameId < 6; frameId++) {
+        recordFrame(stream, frameId);
+        execute(stream, buffer);
+        checkFrame(profiler->getFrameStatistics(), frameId);
+    }
+
+    // the profiler is deleted once the commands recorded before stopping have executed
+    recordFrame(stream, 6);
+    stream.stopCommandProfiling();
+    EXPECT_EQ(nullptr, stream.getCommandProfiler());
+    recordFrame(stream, 7);
+    execute(stream, buffer);
+
+    // profiling can be started again
+    ASSERT_TRUE(stream.startCommandProfiling());
+    recordFrame(stream, 8);
+    execute(stream, buffer);
+    checkFrame(stream.getCommandProfiler()->getFrameStatistics(), 8);
+    stream.stopCommandProfiling();
+    execute(stream, buffer);
+}
+
+TEST_F(CommandStreamTest, CommandStatisticsDuringCapture) {
+    std::string const path = testing::TempDir() + "filament_command_stream_statistics.capture";
+
+    RecordingDriver recordingDriver(1);
+    RecordingDriver replayDriver(1000);
+
+    {
+        CircularBuffer buffer(65536);
+        CommandStream stream(recordingDriver, buffer);
+
+        // profiling is nested in the capture, and must be stopped first
+        ASSERT_TRUE(stream.startCommandCapture(path.c_str()));
+        stream.createTexture(SamplerType::SAMPLER_2D, 1,
+                TextureFormat::RGBA8, 1, 4, 4, 1, TextureUsage::DEFAULT);
+        ASSERT_TRUE(stream.startCommandProfiling());
+        CommandStreamProfiler const* const profiler = stream.getCommandProfiler();
+        ASSERT_NE(nullptr, profiler);
+
+        for (uint32_t frameId = 1; frameId <= 3; frameId++) {
+            stream.beginFrame(0, frameId);
+            stream.createTexture(SamplerType::SAMPLER_2D, 1,
+                    TextureFormat::RGBA8, 1, 4, 4, 1, TextureUsage::DEFAULT);
+            stream.insertEventMarker("marker", 6);
+            stream.endFrame(frameId);
+            execute(stream, buffer);
+
+            // the commands recorded before profiling started aren't accounted for
+            auto const statistics = profiler->getFrameStatistics();
+            EXPECT_EQ(frameId, statistics.frameId);
+            EXPECT_EQ(1u, statistics.commands[size_t(CommandId::beginFrame)].count);
+            EXPECT_EQ(1u, statistics.commands[size_t(CommandId::createTexture)].count);
+            EXPECT_EQ(1u, statistics.commands[size_t(CommandId::insertEventMarker)].count);
+            EXPECT_EQ(1u, statistics.commands[size_t(CommandId::endFrame)].count);
+        }
+
+        stream.stopCommandProfiling();
+        stream.insertEventMarker("marker", 6);
+        stream.stopCommandCapture();
+        execute(stream, buffer);
+    }
+
+    // profiled or not, the commands executed by the driver are all captured
+    EXPECT_EQ(4u, recordingDriver.createdHandles.size());
+
+    CommandStreamReplay replay(replayDriver, 65536);
+    EXPECT_TRUE(replay.replay(path.c_str()));
+    remove(path.c_str());
+
+    auto const& statistics = replay.getStatistics();
+    EXPECT_EQ(4u, statistics.commands[size_t(CommandId::createTexture)].count);
+    EXPECT_EQ(3u, statistics.commands[size_t(CommandId::beginFrame)].count);
+    EXPECT_EQ(3u, statistics.commands[size_t(CommandId::endFrame)].count);
+    EXPECT_EQ(4u, statistics.commands[size_t(CommandId::insertEventMarker)].count);
+    EXPECT_EQ(0u, statistics.skippedCount);
+    EXPECT_EQ(4u, replayDriver.createdHandles.size());
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <private/backend/HandleAllocator.h>
+
+#include <backend/Handle.h>
+
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(FILAMENT_SUPPORTS_OPENGL)
+
+using namespace filament::backend;
+
+namespace {
+
+// one object type per pool of HandleAllocatorGL
+template<size_t SIZE>
+struct Object {
+    explicit Object(uint32_t value) noexcept : value(value) { }
+    uint32_t value;
+    uint8_t padding[SIZE - sizeof(uint32_t)] = {};
+};
+
+using SmallObject = Object<16>;
+using LargeObject = Object<200>;
+
+// index of the overflow arena a handle was allocated from, -1 for the HandleArena
+int getArenaIndex(HandleBase::HandleId id) {
+    return (id & 0x80000000u) ? int((id & 0x7FFFFFFFu) >> 27u) : -1;
+}
+
+} // anonymous namespace
+
+class HandleAllocatorTest : public testing::Test {
+protected:
+    // small enough that the HandleArena only holds ~150 large objects
+    static constexpr size_t ARENA_SIZE = 64 * 1024;
+
+    HandleAllocatorGL mAllocator{ "HandleAllocatorTest", ARENA_SIZE };
+
+    template<typename T>
+    std::vector<Handle<T>> allocate(size_t count, uint32_t firstValue) {
+        std::vector<Handle<T>> handles;
+        handles.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            handles.push_back(mAllocator.allocateAndConstruct<T>(uint32_t(firstValue + i)));
+        }
+        return handles;
+    }
+
+    template<typename T>
+    void check(std::vector<Handle<T>> const& handles, uint32_t firstValue) {
+        for (size_t i = 0; i < handles.size(); i++) {
+            if (handles[i]) {
+                T const* const p = mAllocator.handle_cast<T const*>(handles[i]);
+                ASSERT_NE(p, nullptr);
+                EXPECT_EQ(p->value, firstValue + i);
+            }
+        }
+    }
+};
+
+TEST_F(HandleAllocatorTest, FillArena) {
+    auto handles = allocate<LargeObject>(100, 0);
+    std::set<HandleBase::HandleId> ids;
+    for (auto const& h : handles) {
+        EXPECT_TRUE(h);
+        EXPECT_EQ(getArenaIndex(h.getId()), -1);
+        ids.insert(h.getId());
+    }
+    EXPECT_EQ(ids.size(), handles.size());
+    check(handles, 0);
+
+    for (auto& h : handles) {
+        mAllocator.deallocate(h);
+    }
+}
+
+TEST_F(HandleAllocatorTest, Overflow) {
+    // enough objects to overflow the HandleArena into several overflow arenas, each twice as
+    // large as the previous one.
+    constexpr size_t COUNT = 4000;
+    auto large = allocate<LargeObject>(COUNT, 0);
+    auto small = allocate<SmallObject>(COUNT, 1000000);
+
+    std::set<int> arenas;
+    std::set<uintptr_t> addresses;
+    for (auto const& h : large) {
+        arenas.insert(getArenaIndex(h.getId()));
+        addresses.insert(uintptr_t(mAllocator.handle_cast<LargeObject*>(h)));
+    }
+    EXPECT_GE(arenas.size(), 4);
+    EXPECT_EQ(addresses.size(), COUNT);
+    for (auto const& h : small) {
+        arenas.insert(getArenaIndex(h.getId()));
+    }
+
+    // handle_cast resolves handles of all arenas, and the objects don't overlap
+    check(large, 0);
+    check(small, 1000000);
+
+    for (auto& h : large) {
+        mAllocator.deallocate(h);
+    }
+    for (auto& h : small) {
+        mAllocator.deallocate(h);
+    }
+
+    // the freed handles are reused, no new arena is needed
+    auto again = allocate<LargeObject>(COUNT, 2000000);
+    for (auto const& h : again) {
+        EXPECT_TRUE(arenas.count(getArenaIndex(h.getId())));
+    }
+    check(again, 2000000);
+    for (auto& h : again) {
+        mAllocator.deallocate(h);
+    }
+}
+
+TEST_F(HandleAllocatorTest, FreeFromAnotherThread) {
+    constexpr size_t COUNT = 2000;
+    auto handles = allocate<LargeObject>(COUNT, 0);
+
+    // free every other handle from another thread, while this one keeps allocating
+    std::thread thread([this, &handles]() {
+        for (size_t i = 0; i < handles.size(); i += 2) {
+            mAllocator.deallocate(handles[i]);
+            handles[i].clear();
+        }
+    });
+    auto more = allocate<LargeObject>(COUNT, 1000000);
+    thread.join();
+
+    check(handles, 0);
+    check(more, 1000000);
+
+    // the handles freed by the other thread can be allocated again
+    auto again = allocate<LargeObject>(COUNT / 2, 2000000);
+    check(again, 2000000);
+
+    for (auto* list : { &handles, &more, &again }) {
+        for (auto& h : *list) {
+            if (h) {
+                mAllocator.deallocate(h);
+            }
+        }
+    }
+}
+
+#endif // FILAMENT_SUPPORTS_OPENGL
@@ -0,0 +1,444 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "RenderPass.h"
+#include "ShadowMap.h"
+
+#include "components/RenderableManager.h"
+
+#include "details/Camera.h"
+#include "details/Engine.h"
+#include "details/IndexBuffer.h"
+#include "details/Material.h"
+#include "details/MaterialInstance.h"
+#include "details/Scene.h"
+#include "details/VertexBuffer.h"
+
+#include <filament/Box.h>
+#include <filament/Engine.h>
+#include <filament/IndexBuffer.h>
+#include <filament/RenderableManager.h>
+#include <filament/TransformManager.h>
+#include <filament/VertexBuffer.h>
+
+#include <private/backend/CommandStreamProfiler.h>
+
+#include <private/filament/UibStructs.h>
+
+#include <utils/EntityManager.h>
+#include <utils/Range.h>
+
+#include <math/mat4.h>
+#include <math/vec3.h>
+
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+using namespace filament;
+using namespace filament::backend;
+using namespace filament::math;
+using namespace utils;
+
+class RenderPassTest : public testing::Test {
+protected:
+    static constexpr size_t RENDERABLE_COUNT = 32;
+
+    FEngine* mEngine = nullptr;
+    FScene* mScene = nullptr;
+    VertexBuffer* mVertexBuffer = nullptr;
+    IndexBuffer* mIndexBuffer = nullptr;
+    MaterialInstance* mMaterialInstance = nullptr;
+    std::vector<Entity> mEntities;
+
+    void SetUp() override {
+        Engine::Config config;
+        config.sceneChangeTracking = true;
+        config.renderPassCommandCache = true;
+        mEngine = downcast(Engine::Builder()
+                .backend(Engine::Backend::NOOP)
+                .config(&config)
+                .build());
+        ASSERT_NE(mEngine, nullptr);
+
+        Engine& engine = *mEngine;
+        Scene* const scene = engine.createScene();
+        mScene = downcast(scene);
+
+        mVertexBuffer = VertexBuffer::Builder()
+                .vertexCount(3)
+                .bufferCount(1)
+                .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3)
+                .build(engine);
+
+        mIndexBuffer = IndexBuffer::Builder()
+                .indexCount(3)
+                .bufferType(IndexBuffer::IndexType::USHORT)
+                .build(engine);
+
+        FMaterial const* const material = mEngine->getDefaultMaterial();
+        mMaterialInstance = material->createInstance("test");
+
+        // renderables with different materials, priorities and depths, so that sorting matters
+        mEntities.resize(RENDERABLE_COUNT);
+        EntityManager::get().create(mEntities.size(), mEntities.data());
+        for (size_t i = 0; i < mEntities.size(); i++) {
+            MaterialInstance const* const mi = (i % 3) ?
+                    material->getDefaultInstance() : mMaterialInstance;
+            RenderableManager::Builder(1)
+                    .boundingBox({{ -1, -1, -1 }, { 1, 1, 1 }})
+                    .geometry(0, RenderableManager::PrimitiveType::TRIANGLES,
+                            mVertexBuffer, mIndexBuffer)
+                    .material(0, mi)
+                    .priority(uint8_t(i % 7))
+                    .build(engine, mEntities[i]);
+            mEngine->getTransformManager().create(mEntities[i], {},
+                    mat4f::translation(float3{ 0, 0, -float((i * 13) % RENDERABLE_COUNT) }));
+            scene->addEntity(mEntities[i]);
+        }
+    }
+
+    void TearDown() override {
+        Engine* const engine = mEngine;
+        for (Entity const e : mEntities) {
+            engine->destroy(e);
+        }
+        EntityManager::get().destroy(mEntities.size(), mEntities.data());
+        engine->destroy(mMaterialInstance);
+        engine->destroy(mIndexBuffer);
+        engine->destroy(mVertexBuffer);
+        engine->destroy(mScene);
+        Engine::destroy((Engine**)&mEngine);
+    }
+
+    void prepareScene() {
+        LinearAllocatorArena arena("RenderPassTest", 1 * 1024 * 1024);
+        mScene->prepare(mEngine->getJobSystem(), arena, mat4{}, false);
+
+        // this is normally done by FView::prepare()
+        FRenderableManager const& rcm = mEngine->getRenderableManager();
+        FScene::RenderableSoa& soa = mScene->getRenderableData();
+        for (size_t i = 0; i < soa.size(); i++) {
+            soa.elementAt<FScene::PRIMITIVES>(i) =
+                    rcm.getRenderPrimitives(soa.elementAt<FScene::RENDERABLE_INSTANCE>(i), 0);
+        }
+    }
+
+    // The commands and PrimitiveInfo of a sorted pass, which outlive the pass and its Arenas
+    struct Commands {
+        std::vector<RenderPass::Command> commands;
+        std::vector<RenderPass::PrimitiveInfo> infos;
+    };
+
+    // generates the commands of all the renderables, except the hidden ones
+    Commands generateCommands(RenderPass::CommandCache* cache,
+            std::vector<uint32_t> const& hidden = {}) {
+        FScene::RenderableSoa const& soa = mScene->getRenderableData();
+        Range<uint32_t> const vr{ 0, uint32_t(soa.size()) };
+        std::vector<FScene::VisibleMaskType> masks(soa.size(), VISIBLE_RENDERABLE);
+        for (uint32_t const i : hidden) {
+            masks[i] = 0;
+        }
+
+        std::vector<uint8_t> storage(1024 * 1024);
+        size_t const commandArenaSize = RenderPass::getCommandArenaSize(storage.size());
+        RenderPass::Arena commandArena("Command Arena",
+                { storage.data(), storage.data() + commandArenaSize });
+        RenderPass::Arena primitiveInfoArena("PrimitiveInfo Arena",
+                { storage.data() + commandArenaSize, storage.data() + storage.size() });
+
+        RenderPass pass(*mEngine, commandArena, primitiveInfoArena);
+        pass.setGeometry(soa, vr, {});
+        pass.setCamera(CameraInfo{});
+        pass.setVisibleMasks(masks.data());
+        if (cache) {
+            pass.setCommandCache(cache, *mScene);
+        }
+        pass.appendCommands(*mEngine, RenderPass::CommandTypeFlags::COLOR);
+        pass.sortCommands(*mEngine);
+
+        Commands result;
+        for (RenderPass::Command const& command : pass) {
+            result.commands.push_back(command);
+            result.infos.push_back(pass.getPrimitiveInfo(command));
+        }
+        return result;
+    }
+
+    // RenderPass' radix sort is private, and TEST_F bodies aren't friends of RenderPass
+    static constexpr size_t RADIX_SORT_MIN_COMMANDS_COUNT =
+            RenderPass::RADIX_SORT_MIN_COMMANDS_COUNT;
+
+    static size_t radixSortCommands(JobSystem& js,
+            RenderPass::Command* commands, size_t count) noexcept {
+        return RenderPass::radixSortCommands(js, commands, count);
+    }
+
+    static void expectSameCommands(Commands const& lhs, Commands const& rhs) {
+        ASSERT_EQ(lhs.commands.size(), rhs.commands.size());
+        for (size_t i = 0; i < lhs.commands.size(); i++) {
+            EXPECT_EQ(lhs.commands[i].key, rhs.commands[i].key);
+            RenderPass::PrimitiveInfo const& l = lhs.infos[i];
+            RenderPass::PrimitiveInfo const& r = rhs.infos[i];
+            EXPECT_EQ(l.mi, r.mi);
+            EXPECT_EQ(l.primitiveHandle, r.primitiveHandle);
+            EXPECT_EQ(l.instanceBufferHandle, r.instanceBufferHandle);
+            EXPECT_EQ(l.index, r.index);
+            EXPECT_EQ(l.instanceCount, r.instanceCount);
+            EXPECT_EQ(l.materialVariant, r.materialVariant);
+        }
+    }
+};
+
+TEST_F(RenderPassTest, CommandCache) {
+    RenderPass::CommandCache cache;
+    TransformManager& tcm = mEngine->getTransformManager();
+
+    // the first pass fills the cache
+    prepareScene();
+    uint32_t const revision = mScene->getRevision();
+    Commands const stored = generateCommands(&cache);
+    EXPECT_EQ(stored.commands.size(), RENDERABLE_COUNT);
+    expectSameCommands(stored, generateCommands(nullptr));
+    EXPECT_EQ(cache.getHitCount(), 0);
+    EXPECT_EQ(cache.getPatchCount(), 0);
+
+    // nothing changed, the cached commands are used and must be the ones we'd generate
+    prepareScene();
+    EXPECT_EQ(mScene->getRevision(), revision);
+    expectSameCommands(generateCommands(&cache), generateCommands(nullptr));
+    EXPECT_EQ(cache.getHitCount(), 1);
+    EXPECT_EQ(cache.getPatchCount(), 0);
+
+    // moving a renderable changes the scene revision, only its commands are regenerated
+    tcm.setTransform(tcm.getInstance(mEntities[0]), mat4f::translation(float3{ 0, 0, -100 }));
+    prepareScene();
+    EXPECT_NE(mScene->getRevision(), revision);
+    expectSameCommands(generateCommands(&cache), generateCommands(nullptr));
+    EXPECT_EQ(cache.getHitCount(), 1);
+    EXPECT_EQ(cache.getPatchCount(), 1);
+
+    // and cached again
+    prepareScene();
+    expectSameCommands(generateCommands(&cache), generateCommands(nullptr));
+    EXPECT_EQ(cache.getHitCount(), 2);
+    EXPECT_EQ(cache.getPatchCount(), 1);
+
+    // moving two renderables far apart, the commands of the renderables between them are
+    // regenerated too
+    tcm.setTransform(tcm.getInstance(mEntities[1]), mat4f::translation(float3{ 0, 0, -50 }));
+    tcm.setTransform(tcm.getInstance(mEntities[RENDERABLE_COUNT - 1]),
+            mat4f::translation(float3{ 0, 0, -40 }));
+    prepareScene();
+    expectSameCommands(generateCommands(&cache), generateCommands(nullptr));
+    EXPECT_EQ(cache.getHitCount(), 2);
+    EXPECT_EQ(cache.getPatchCount(), 2);
+
+    // hiding renderables only regenerates their commands
+    Commands const hidden = generateCommands(&cache, { 3, 4, 9 });
+    EXPECT_EQ(hidden.commands.size(), RENDERABLE_COUNT - 3);
+    expectSameCommands(hidden, generateCommands(nullptr, { 3, 4, 9 }));
+    EXPECT_EQ(cache.getPatchCount(), 3);
+
+    // and showing them again too
+    expectSameCommands(generateCommands(&cache), generateCommands(nullptr));
+    EXPECT_EQ(cache.getHitCount(), 2);
+    EXPECT_EQ(cache.getPatchCount(), 4);
+    expectSameCommands(generateCommands(&cache), generateCommands(nullptr));
+    EXPECT_EQ(cache.getHitCount(), 3);
+
+    // a cleared cache is filled again
+    cache.clear();
+    expectSameCommands(generateCommands(&cache), generateCommands(nullptr));
+    EXPECT_EQ(cache.getHitCount(), 3);
+    EXPECT_EQ(cache.getPatchCount(), 4);
+    expectSameCommands(generateCommands(&cache), generateCommands(nullptr));
+    EXPECT_EQ(cache.getHitCount(), 4);
+}
+
+TEST_F(RenderPassTest, RedundantBindings) {
+    FEngine& engine = *mEngine;
+    DriverApi& driver = engine.getDriverApi();
+    TransformManager& tcm = engine.getTransformManager();
+    Scene* const scene = mScene;
+
+    // renderables with several primitives, which share their per-renderable uniforms
+    constexpr size_t PRIMITIVE_COUNT = 3;
+    MaterialInstance const* const mi = engine.getDefaultMaterial()->getDefaultInstance();
+    for (size_t i = 0; i < 4; i++) {
+        Entity const entity = EntityManager::get().create();
+        RenderableManager::Builder builder(PRIMITIVE_COUNT);
+        builder.boundingBox({{ -1, -1, -1 }, { 1, 1, 1 }});
+        for (size_t j = 0; j < PRIMITIVE_COUNT; j++) {
+            builder.geometry(j, RenderableManager::PrimitiveType::TRIANGLES,
+                    mVertexBuffer, mIndexBuffer);
+            builder.material(j, mi);
+        }
+        builder.build(engine, entity);
+        tcm.create(entity, {}, mat4f::translation(float3{ 0, 0, -0.5f - float(i) }));
+        scene->addEntity(entity);
+        mEntities.push_back(entity);
+    }
+    prepareScene();
+
+    // all renderables share the same skinning bindings
+    BufferObjectHandle const ubo = driver.createBufferObject(
+            sizeof(PerRenderableUib) * mEntities.size(),
+            BufferObjectBinding::UNIFORM, BufferUsage::DYNAMIC);
+    BufferObjectHandle const bones = driver.createBufferObject(sizeof(PerRenderableBoneUib),
+            BufferObjectBinding::UNIFORM, BufferUsage::DYNAMIC);
+    FScene::RenderableSoa& soa = mScene->getRenderableData();
+    for (size_t i = 0; i < soa.size(); i++) {
+        soa.elementAt<FScene::SKINNING_BUFFER>(i) = { bones, 0, {} };
+    }
+
+    Range<uint32_t> const vr{ 0, uint32_t(soa.size()) };
+    std::vector<FScene::VisibleMaskType> masks(soa.size(), VISIBLE_RENDERABLE);
+    std::vector<uint8_t> storage(1024 * 1024);
+    size_t const commandArenaSize = RenderPass::getCommandArenaSize(storage.size());
+    RenderPass::Arena commandArena("Command Arena",
+            { storage.data(), storage.data() + commandArenaSize });
+    RenderPass::Arena primitiveInfoArena("PrimitiveInfo Arena",
+            { storage.data() + commandArenaSize, storage.data() + storage.size() });
+
+    RenderPass pass(engine, commandArena, primitiveInfoArena);
+    pass.setGeometry(soa, vr, ubo);
+    pass.setCamera(CameraInfo{});
+    pass.setVisibleMasks(masks.data());
+    pass.appendCommands(engine, RenderPass::CommandTypeFlags::COLOR);
+    pass.sortCommands(engine);
+
+    // the per-renderable uniforms are bound each time the renderable changes, and the skinning
+    // bindings only once, every command is drawn
+    size_t drawCount = 0;
+    size_t uboBindingCount = 0;
+    uint32_t boundIndex = 0;
+    for (RenderPass::Command const& command : pass) {
+        RenderPass::PrimitiveInfo const& info = pass.getPrimitiveInfo(command);
+        ASSERT_TRUE(info.primitiveHandle);
+        ASSERT_EQ(info.instanceCount, 1);
+        ASSERT_TRUE(info.skinningHandle == bones);
+        if (!drawCount++ || info.index != boundIndex) {
+            boundIndex = info.index;
+            uboBindingCount++;
+        }
+    }
+    EXPECT_EQ(drawCount, RENDERABLE_COUNT + PRIMITIVE_COUNT * 4);
+    EXPECT_LT(uboBindingCount, drawCount);
+
+    ASSERT_TRUE(driver.startCommandProfiling());
+    driver.beginFrame(0, 1);
+    pass.getExecutor().execute(engine, "RedundantBindings");
+    driver.endFrame(1);
+    engine.flushAndWait();
+    CommandStreamProfiler::FrameStatistics const statistics =
+            driver.getCommandProfiler()->getFrameStatistics();
+    driver.stopCommandProfiling();
+
+    auto const& commands = statistics.commands;
+    EXPECT_EQ(commands[size_t(CommandId::draw)].count, drawCount);
+    EXPECT_EQ(commands[size_t(CommandId::bindBufferRange)].count, uboBindingCount + 1);
+    EXPECT_LT(commands[size_t(CommandId::bindBufferRange)].count, drawCount * 2);
+
+    driver.destroyBufferObject(bones);
+    driver.destroyBufferObject(ubo);
+}
+
+TEST_F(RenderPassTest, DisableDepthSorting) {
+    prepareScene();
+    FScene::RenderableSoa const& soa = mScene->getRenderableData();
+    Range<uint32_t> const vr{ 0, uint32_t(soa.size()) };
+    std::vector<FScene::VisibleMaskType> masks(soa.size(), VISIBLE_DYN_SHADOW_RENDERABLE);
+
+    std::vector<uint8_t> storage(1024 * 1024);
+    size_t const commandArenaSize = RenderPass::getCommandArenaSize(storage.size());
+    RenderPass::Arena commandArena("Command Arena",
+            { storage.data(), storage.data() + commandArenaSize });
+    RenderPass::Arena primitiveInfoArena("PrimitiveInfo Arena",
+            { storage.data() + commandArenaSize, storage.data() + storage.size() });
+
+    // the renderables are at different depths, but the commands don't depend on the camera
+    RenderPass pass(*mEngine, commandArena, primitiveInfoArena);
+    pass.setRenderFlags(RenderPass::DISABLE_DEPTH_SORTING);
+    pass.setVisibilityMask(VISIBLE_DYN_SHADOW_RENDERABLE);
+    pass.setGeometry(soa, vr, {});
+    pass.setCamera(CameraInfo{});
+    pass.setVisibleMasks(masks.data());
+    pass.appendCommands(*mEngine, RenderPass::CommandTypeFlags::SHADOW);
+    pass.sortCommands(*mEngine);
+
+    ASSERT_NE(pass.begin(), pass.end());
+    uint64_t const depth = pass.begin()->key & RenderPass::Z_BUCKET_MASK;
+    for (RenderPass::Command const& command : pass) {
+        EXPECT_EQ(command.key & RenderPass::Z_BUCKET_MASK, depth);
+    }
+}
+
+TEST_F(RenderPassTest, RadixSortCommands) {
+    using Command = RenderPass::Command;
+    JobSystem& js = mEngine->getJobSystem();
+    std::default_random_engine generator(82828); // NOLINT
+
+    // random keys, keys with many duplicates, and keys where only a few bytes vary
+    std::uniform_int_distribution<uint64_t> distribution;
+    std::vector<uint64_t> const pool{ 0, 1, 0x100, 0xFF00, 0x8000000000000000, 0x1234 };
+    std::function<uint64_t()> const keyGenerators[] = {
+            [&]() { return distribution(generator) >> 1; },
+            [&]() { return pool[generator() % pool.size()]; },
+            [&]() { return (distribution(generator) & 0xFF0000FF00) | 0x4200000000000000; },
+    };
+
+    constexpr size_t MIN = RADIX_SORT_MIN_COMMANDS_COUNT;
+    // the last count is large enough to be sorted by several jobs
+    for (size_t const count : { size_t(1), MIN - 1, MIN, MIN + 1, size_t(65536 + 7) }) {
+        for (auto const& keyGenerator : keyGenerators) {
+            std::vector<Command> commands(count);
+            for (size_t i = 0; i < count; i++) {
+                commands[i] = { .key = keyGenerator(), .infoIndex = uint32_t(i) };
+            }
+            // a few sentinels, anywhere
+            for (size_t i = 0; i < std::min<size_t>(count, 3); i++) {
+                commands[generator() % count].key = uint64_t(RenderPass::Pass::SENTINEL);
+            }
+
+            // the radix sort is stable, so the order of the commands with the same key
+            // must be the same as with std::stable_sort()
+            std::vector<Command> expected = commands;
+            std::stable_sort(expected.begin(), expected.end());
+            size_t const expectedCount = std::find_if(expected.begin(), expected.end(),
+                    [](Command const& c) {
+                        return c.key == uint64_t(RenderPass::Pass::SENTINEL);
+                    }) - expected.begin();
+
+            std::vector<Command> sorted = commands;
+            std::sort(sorted.begin(), sorted.end());
+
+            size_t const sortedCount =
+                    radixSortCommands(js, commands.data(), commands.size());
+            ASSERT_EQ(sortedCount, expectedCount);
+            for (size_t i = 0; i < sortedCount; i++) {
+                ASSERT_EQ(commands[i].key, sorted[i].key);
+                ASSERT_EQ(commands[i].infoIndex, expected[i].infoIndex);
+            }
+        }
+    }
+}
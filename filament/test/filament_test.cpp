@@ -14,8 +14,10 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <iostream>
 #include <random>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -29,6 +31,7 @@
 #include <filament/Camera.h>
 #include <filament/Color.h>
 #include <filament/Frustum.h>
+#include <filament/InstanceBuffer.h>
 #include <filament/Material.h>
 #include <filament/Engine.h>
 
@@ -37,14 +40,21 @@
 #include <private/backend/BackendUtils.h>
 
 #include "Allocators.h"
+#include "Culler.h"
+#include "CullingBvh.h"
 #include "details/Material.h"
 #include "details/Camera.h"
 #include "Froxelizer.h"
+#include "Intersections.h"
+#include "ShadowMapManager.h"
 #include "details/Engine.h"
+#include "details/InstanceBuffer.h"
 #include "components/RenderableManager.h"
 #include "components/TransformManager.h"
 #include "UniformBuffer.h"
 
+#include <utils/JobSystem.h>
+
 using namespace filament;
 using namespace filament::math;
 using namespace utils;
@@ -283,6 +293,204 @@ TEST(FilamentTest, TransformManager) {
     EXPECT_EQ(c, tcm.getChildCount(newParent));
 }
 
+TEST(FilamentTest, TransformManagerChangeTracking) {
+    filament::FTransformManager tcm;
+    EntityManager& em = EntityManager::get();
+    std::array<Entity, 3> entities;
+    em.create(entities.size(), entities.data());
+
+    // creating components changes the structure
+    uint32_t structureVersion = tcm.getStructureVersion();
+    tcm.create(entities[0]);
+    TransformManager::Instance parent = tcm.getInstance(entities[0]);
+    tcm.create(entities[1], parent, mat4f{});
+    TransformManager::Instance child = tcm.getInstance(entities[1]);
+    tcm.create(entities[2]);
+    TransformManager::Instance other = tcm.getInstance(entities[2]);
+    EXPECT_NE(structureVersion, tcm.getStructureVersion());
+    structureVersion = tcm.getStructureVersion();
+
+    auto isNewer = [](uint32_t version, uint32_t epoch) { return int32_t(version - epoch) > 0; };
+
+    // nothing changed since the last epoch
+    uint32_t epoch = tcm.advanceEpoch();
+    EXPECT_FALSE(isNewer(tcm.getVersion(parent), epoch));
+    EXPECT_FALSE(isNewer(tcm.getVersion(child), epoch));
+    EXPECT_FALSE(isNewer(tcm.getVersion(other), epoch));
+
+    // changing a parent dirties its children, but not unrelated transforms
+    tcm.setTransform(parent, mat4f{ float4{ 2 }});
+    EXPECT_TRUE(isNewer(tcm.getVersion(parent), epoch));
+    EXPECT_TRUE(isNewer(tcm.getVersion(child), epoch));
+    EXPECT_FALSE(isNewer(tcm.getVersion(other), epoch));
+
+    // committing a transaction only dirties transforms that actually changed
+    epoch = tcm.advanceEpoch();
+    tcm.openLocalTransformTransaction();
+    tcm.setTransform(other, mat4f{ float4{ 3 }});
+    tcm.commitLocalTransformTransaction();
+    EXPECT_FALSE(isNewer(tcm.getVersion(parent), epoch));
+    EXPECT_FALSE(isNewer(tcm.getVersion(child), epoch));
+    EXPECT_TRUE(isNewer(tcm.getVersion(other), epoch));
+    EXPECT_EQ(structureVersion, tcm.getStructureVersion());
+
+    // destroying components changes the structure
+    tcm.destroy(entities[1]);
+    EXPECT_NE(structureVersion, tcm.getStructureVersion());
+
+    tcm.destroy(entities[0]);
+    tcm.destroy(entities[2]);
+    em.destroy(entities.size(), entities.data());
+}
+
+TEST(FilamentTest, TransformManagerParallel) {
+    JobSystem js;
+    js.adopt();
+
+    // the same hierarchy is built in both managers, only one of them is computed by level
+    filament::FTransformManager serial;
+    filament::FTransformManager parallel;
+    parallel.setParallelTransforms(&js, 1);
+
+    EntityManager& em = EntityManager::get();
+    std::vector<Entity> entities(8192);
+    em.create(entities.size(), entities.data());
+
+    std::default_random_engine generator(82828); // NOLINT
+    std::uniform_real_distribution<float> distribution(-4, 4);
+    auto rand_gen = std::bind(distribution, generator);
+
+    auto forEach = [&](auto const& f) { f(serial); f(parallel); };
+
+    // wide and shallow, with some levels large enough to be split in jobs
+    for (size_t i = 0; i < entities.size(); i++) {
+        size_t const p = i ? generator() % std::min(i, size_t(256)) : 0;
+        mat4f const m = mat4f::translation(float3{ rand_gen(), rand_gen(), rand_gen() });
+        forEach([&](auto& tcm) {
+            tcm.create(entities[i],
+                    i ? tcm.getInstance(entities[p]) : TransformManager::Instance{}, m);
+        });
+    }
+
+    // move some nodes under nodes created after them, so that they're out of order
+    for (size_t i = 0; i < 64; i++) {
+        size_t const c = 256 + generator() % 1024;
+        size_t const p = 4096 + generator() % 4096;
+        forEach([&](auto& tcm) {
+            tcm.setParent(tcm.getInstance(entities[c]), tcm.getInstance(entities[p]));
+        });
+    }
+
+    for (size_t frame = 0; frame < 2; frame++) {
+        forEach([&](auto& tcm) { tcm.openLocalTransformTransaction(); });
+        for (size_t i = 0; i < 16; i++) {
+            size_t const e = generator() % entities.size();
+            mat4f const m = mat4f::translation(float3{ rand_gen(), rand_gen(), rand_gen() });
+            forEach([&](auto& tcm) { tcm.setTransform(tcm.getInstance(entities[e]), m); });
+        }
+        forEach([&](auto& tcm) { tcm.commitLocalTransformTransaction(); });
+
+        for (Entity const e : entities) {
+            ASSERT_EQ(parallel.getWorldTransform(parallel.getInstance(e)),
+                    serial.getWorldTransform(serial.getInstance(e)));
+        }
+
+        // the nodes are sorted by depth
+        size_t previousDepth = 0;
+        for (size_t i = 1; i <= entities.size(); i++) {
+            size_t depth = 0;
+            for (Entity p = parallel.getParent(TransformManager::Instance(i)); p;
+                    p = parallel.getParent(parallel.getInstance(p))) {
+                depth++;
+            }
+            EXPECT_LE(previousDepth, depth);
+            previousDepth = depth;
+        }
+    }
+
+    em.destroy(entities.size(), entities.data());
+    js.emancipate();
+}
+
+TEST(FilamentTest, TransformManagerBulk) {
+    filament::FTransformManager single;
+    filament::FTransformManager bulk;
+    single.setAccurateTranslationsEnabled(true);
+    bulk.setAccurateTranslationsEnabled(true);
+
+    EntityManager& em = EntityManager::get();
+    std::vector<Entity> entities(64);
+    em.create(entities.size(), entities.data());
+
+    // a hierarchy where some children are before their parent
+    std::default_random_engine generator(82828); // NOLINT
+    for (size_t i = 0; i < entities.size(); i++) {
+        single.create(entities[i]);
+        bulk.create(entities[i]);
+    }
+    for (size_t i = 0; i < entities.size() - 1; i++) {
+        Entity const parent = entities[i + 1 + generator() % (entities.size() - i - 1)];
+        single.setParent(single.getInstance(entities[i]), single.getInstance(parent));
+        bulk.setParent(bulk.getInstance(entities[i]), bulk.getInstance(parent));
+    }
+
+    auto setAll = [&](auto const& makeTransform, size_t stride = 3) {
+        using Transform = decltype(makeTransform(0));
+        std::vector<TransformManager::Instance> instances;
+        std::vector<Transform> transforms;
+        for (size_t i = 0; i < entities.size(); i += stride) {
+            single.setTransform(single.getInstance(entities[i]), makeTransform(i));
+            instances.push_back(bulk.getInstance(entities[i]));
+            transforms.push_back(makeTransform(i));
+        }
+        bulk.setTransforms(instances.data(), transforms.data(), instances.size());
+    };
+
+    auto check = [&]() {
+        for (Entity const e : entities) {
+            TransformManager::Instance const si = single.getInstance(e);
+            TransformManager::Instance const bi = bulk.getInstance(e);
+            EXPECT_EQ(single.getTransformAccurate(si), bulk.getTransformAccurate(bi));
+            EXPECT_EQ(single.getWorldTransformAccurate(si), bulk.getWorldTransformAccurate(bi));
+        }
+    };
+
+    // outside of a transaction, the world transforms are updated right away, and the instances
+    // don't change
+    std::vector<TransformManager::Instance> instances(entities.size());
+    for (size_t i = 0; i < entities.size(); i++) {
+        instances[i] = bulk.getInstance(entities[i]);
+    }
+    auto checkInstances = [&]() {
+        for (size_t i = 0; i < entities.size(); i++) {
+            EXPECT_EQ(bulk.getInstance(entities[i]), instances[i]);
+        }
+    };
+
+    setAll([](size_t i) { return mat4f::translation(float3{ float(i), 1, 2 }); });
+    check();
+    checkInstances();
+
+    setAll([](size_t i) { return mat4::translation(double3{ 1.0 / double(i + 3), 1, 2 }); });
+    check();
+    checkInstances();
+
+    // with only a few transforms set, their subtrees are updated instead of all the transforms
+    setAll([](size_t i) { return mat4f::translation(float3{ 1, float(i), 2 }); }, 17);
+    check();
+    checkInstances();
+
+    // within a transaction, they're updated when it's committed
+    single.openLocalTransformTransaction();
+    bulk.openLocalTransformTransaction();
+    setAll([](size_t i) { return mat4f::scaling(float(i + 1)); });
+    single.commitLocalTransformTransaction();
+    bulk.commitLocalTransformTransaction();
+    check();
+
+    em.destroy(entities.size(), entities.data());
+}
+
 TEST(FilamentTest, UniformInterfaceBlock) {
 
     BufferInterfaceBlock::Builder b;
@@ -558,6 +766,49 @@ TEST(FilamentTest, BoxCulling) {
     EXPECT_TRUE( frustum.intersects( { 0, 200 }) );
 }
 
+TEST(FilamentTest, BvhCulling) {
+    Frustum frustum(mat4f::frustum(-1, 1, -1, 1, 1, 100));
+
+    // random boxes around the frustum, some of them straddling its planes
+    constexpr size_t count = 1001;
+    std::default_random_engine generator(82828); // NOLINT
+    std::uniform_real_distribution<float> position(-120.0f, 20.0f);
+    std::uniform_real_distribution<float> size(0.1f, 4.0f);
+    std::vector<float3> centers(Culler::round(count));
+    std::vector<float3> extents(Culler::round(count));
+    std::vector<uint32_t> payloads(count);
+    for (size_t i = 0; i < count; i++) {
+        centers[i] = { position(generator), position(generator), position(generator) };
+        extents[i] = { size(generator), size(generator), size(generator) };
+        payloads[i] = uint32_t(i);
+    }
+
+    std::vector<Culler::result_type> results(Culler::round(count));
+    Culler::Test::intersects(results.data(), frustum, centers.data(), extents.data(), count);
+
+    CullingBvh bvh;
+    bvh.build(centers.data(), extents.data(), payloads.data(), count);
+    EXPECT_EQ(count, bvh.size());
+
+    std::vector<uint32_t> visible(count);
+    visible.resize(bvh.intersects(frustum, visible.data()));
+    std::sort(visible.begin(), visible.end());
+
+    std::vector<uint32_t> expected;
+    for (size_t i = 0; i < count; i++) {
+        if (results[i] & 1u) {
+            expected.push_back(uint32_t(i));
+        }
+    }
+    EXPECT_FALSE(expected.empty());
+    EXPECT_EQ(expected, visible);
+
+    // a frustum containing all the boxes
+    Frustum all(mat4f::ortho(-200, 200, -200, 200, -200, 200));
+    visible.resize(count);
+    EXPECT_EQ(count, bvh.intersects(all, visible.data()));
+}
+
 TEST(FilamentTest, SphereCulling) {
     Frustum frustum(mat4f::frustum(-1, 1, -1, 1, 1, 100));
 
@@ -595,6 +846,75 @@ TEST(FilamentTest, SphereCulling) {
     EXPECT_TRUE(frustum.intersects({ 0, 200 }));
 }
 
+TEST(FilamentTest, InstanceBufferCulling) {
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+
+    // a row of cubes of size 1 at z = -10, from x = -14 to x = 14
+    constexpr size_t INSTANCE_COUNT = 8;
+    mat4f localTransforms[INSTANCE_COUNT];
+    for (size_t i = 0; i < INSTANCE_COUNT; i++) {
+        localTransforms[i] = mat4f::translation(float3{ float(i) * 4.0f - 14.0f, 0, -10 });
+    }
+
+    InstanceBuffer* const culled = InstanceBuffer::Builder(INSTANCE_COUNT)
+            .localTransforms(localTransforms)
+            .culling({ 0, 0.5f })
+            .build(*engine);
+    InstanceBuffer* const unculled = InstanceBuffer::Builder(INSTANCE_COUNT)
+            .localTransforms(localTransforms)
+            .build(*engine);
+
+    // x = +/-10 straddles the frustum planes at z = -10, +/-14 is outside
+    Frustum const frustum(mat4f::frustum(-1, 1, -1, 1, 1, 100));
+
+    PerRenderableData ubo{};
+    ubo.objectId = 42;
+    PerRenderableData staging[INSTANCE_COUNT];
+
+    // the x translations of the first 'count' instances written
+    auto getPositions = [&staging](size_t count) {
+        std::vector<float> positions;
+        for (size_t i = 0; i < count; i++) {
+            EXPECT_EQ(staging[i].objectId, 42);
+            EXPECT_FLOAT_EQ(staging[i].worldFromModelMatrix[3][2], -10.0f);
+            positions.push_back(staging[i].worldFromModelMatrix[3][0]);
+        }
+        return positions;
+    };
+
+    // only the visible instances are written, in order
+    size_t count = downcast(culled)->prepare(staging, INSTANCE_COUNT, {}, ubo, &frustum);
+    EXPECT_EQ(getPositions(count), std::vector<float>({ -10, -6, -2, 2, 6, 10 }));
+
+    // culling is done after the root transform is applied
+    count = downcast(culled)->prepare(staging, INSTANCE_COUNT,
+            mat4f::translation(float3{ 8, 0, 0 }), ubo, &frustum);
+    EXPECT_EQ(getPositions(count), std::vector<float>({ -6, -2, 2, 6, 10 }));
+
+    // only the first instanceCount instances are considered
+    count = downcast(culled)->prepare(staging, 3, {}, ubo, &frustum);
+    EXPECT_EQ(getPositions(count), std::vector<float>({ -10, -6 }));
+
+    // when no instance is visible, the first one is kept
+    count = downcast(culled)->prepare(staging, INSTANCE_COUNT,
+            mat4f::translation(float3{ 1000, 0, 0 }), ubo, &frustum);
+    EXPECT_EQ(getPositions(count), std::vector<float>({ 986 }));
+
+    // without a frustum, or when culling isn't enabled, all instances are written
+    std::vector<float> all;
+    for (size_t i = 0; i < INSTANCE_COUNT; i++) {
+        all.push_back(float(i) * 4.0f - 14.0f);
+    }
+    count = downcast(culled)->prepare(staging, INSTANCE_COUNT, {}, ubo, nullptr);
+    EXPECT_EQ(getPositions(count), all);
+    count = downcast(unculled)->prepare(staging, INSTANCE_COUNT, {}, ubo, &frustum);
+    EXPECT_EQ(getPositions(count), all);
+
+    engine->destroy(culled);
+    engine->destroy(unculled);
+    Engine::destroy(&engine);
+}
+
 TEST(FilamentTest, ColorConversion) {
     // Linear to Gamma
     // 0.0 stays 0.0
@@ -655,7 +975,7 @@ TEST(FilamentTest, FroxelData) {
 
     Froxelizer froxelData(*engine);
     froxelData.setOptions(5, 100);
-    froxelData.prepare(engine->getDriverApi(), scope, vp, p, 0.1, 100);
+    froxelData.prepare(engine->getDriverApi(), scope, vp, p, 0.1, 100, 1);
 
     Froxel f = froxelData.getFroxelAt(0,0,0);
 
@@ -741,6 +1061,187 @@ TEST(FilamentTest, FroxelData) {
     Engine::destroy((Engine **)&engine);
 }
 
+TEST(FilamentTest, FroxelRecords) {
+    using namespace filament;
+
+    // with large light counts, light indices above 255 need 16-bits records
+    Engine::Config config;
+    config.largeLightCount = true;
+    FEngine* engine = downcast(Engine::Builder()
+            .backend(Engine::Backend::NOOP)
+            .config(&config)
+            .build());
+    ASSERT_NE(engine, nullptr);
+    ASSERT_TRUE(engine->hasLargeLightCount());
+
+    LinearAllocatorArena arena("FRenderer: per-frame allocator", 5 * 1024 * 1024);
+    utils::ArenaScope<LinearAllocatorArena> scope(arena);
+
+    // enough lights to use all the bits of several light groups, and indices above 255
+    constexpr size_t LIGHT_COUNT = 600;
+    constexpr float LIGHT_RADIUS = 0.25f;
+
+    Viewport vp(0, 0, 1280, 640);
+    mat4f p = mat4f::perspective(90, 1.0f, 0.1, 100, mat4f::Fov::HORIZONTAL);
+
+    Froxelizer froxelData(*engine);
+    froxelData.setOptions(5, 100);
+    froxelData.prepare(engine->getDriverApi(), scope, vp, p, 0.1, 100, LIGHT_COUNT);
+
+    Entity e = engine->getEntityManager().create();
+    LightManager::Builder(LightManager::Type::POINT).build(*engine, e);
+    LightManager::Instance instance = engine->getLightManager().getInstance(e);
+
+    // small lights scattered in the view frustum
+    std::default_random_engine generator(82828); // NOLINT
+    std::uniform_real_distribution<float> distribution(-0.4f, 0.4f);
+    FScene::LightSoa lights;
+    lights.push_back({}, {}, {}, {}, {}, {}, {}, {});   // first one is always skipped
+    for (size_t i = 0; i < LIGHT_COUNT; i++) {
+        float const z = -6.0f - float(i % 40);
+        float3 const position{ distribution(generator) * z, distribution(generator) * z, z };
+        lights.push_back(float4{ position, LIGHT_RADIUS }, {}, {}, {}, instance, 1, {}, {});
+    }
+
+    froxelData.froxelizeLights(*engine, {}, lights);
+    auto const& froxelBuffer = froxelData.getFroxelBufferUser();
+    auto const* const records =
+            reinterpret_cast<uint16_t const*>(froxelData.getRecordBufferUser().data());
+
+    // Each record is a light index, encoded from its group and bit in the group, it must
+    // designate a light that touches the froxel referencing the record.
+    std::vector<bool> found(LIGHT_COUNT);
+    size_t maxIndex = 0;
+    size_t const countX = froxelData.getFroxelCountX();
+    size_t const countY = froxelData.getFroxelCountY();
+    for (size_t i = 0; i < froxelData.getFroxelCount(); i++) {
+        Froxelizer::FroxelEntry const entry = froxelBuffer[i];
+        Froxel const froxel = froxelData.getFroxelAt(
+                i % countX, (i / countX) % countY, i / (countX * countY));
+        for (size_t k = 0; k < entry.count(); k++) {
+            size_t const l = records[entry.offset() + k];
+            ASSERT_LT(l, LIGHT_COUNT);
+            found[l] = true;
+            maxIndex = std::max(maxIndex, l);
+            float4 const sphere = lights.elementAt<FScene::POSITION_RADIUS>(
+                    l + FScene::DIRECTIONAL_LIGHTS_COUNT);
+            for (float4 const plane : froxel.planes) {
+                EXPECT_LE(dot(plane.xyz, sphere.xyz) + plane.w, sphere.w + 1e-3f);
+            }
+        }
+    }
+
+    // all lights are in the frustum, including those which don't fit in 8 bits
+    EXPECT_EQ(size_t(std::count(found.begin(), found.end(), true)), LIGHT_COUNT);
+    EXPECT_GT(maxIndex, 255);
+
+    froxelData.terminate(engine->getDriverApi());
+    engine->destroy(e);
+
+    Engine::destroy((Engine **)&engine);
+}
+
+TEST(FilamentTest, FroxelBoundingSpheres) {
+    using namespace filament;
+
+    FEngine* engine = downcast(Engine::Builder().backend(Engine::Backend::NOOP).build());
+    ASSERT_NE(engine, nullptr);
+
+    LinearAllocatorArena arena("FRenderer: per-frame allocator", 3 * 1024 * 1024);
+
+    // the bounding sphere of the 8 corners of a froxel, each the intersection of 3 of its planes
+    auto getBoundingSphere = [](Froxel const& froxel) -> float4 {
+        float4 const* const planes = froxel.planes;
+        float3 corners[8];
+        for (size_t i = 0; i < 8; i++) {
+            corners[i] = planeIntersection(
+                    planes[(i & 1) ? Froxel::RIGHT : Froxel::LEFT],
+                    planes[(i & 2) ? Froxel::TOP : Froxel::BOTTOM],
+                    planes[(i & 4) ? Froxel::FAR : Froxel::NEAR]);
+        }
+        float3 c{};
+        for (float3 const& corner : corners) {
+            c += corner * 0.125f;
+        }
+        float d = 0.0f;
+        for (float3 const& corner : corners) {
+            d = std::max(d, length2(corner - c));
+        }
+        return { c, std::sqrt(d) };
+    };
+
+    mat4f const projections[] = {
+            mat4f::perspective(90, 1.0f, 0.1, 100, mat4f::Fov::HORIZONTAL),
+            mat4f::perspective(45, 16.0f / 9.0f, 0.5, 1000, mat4f::Fov::VERTICAL),
+            mat4f::frustum(-0.3f, 0.1f, -0.05f, 0.2f, 0.1f, 100.0f),   // off-center
+    };
+
+    // the froxel counts are below and above the threshold to compute the slices in parallel,
+    // and not always a multiple of the vector width
+    Viewport const viewports[] = {
+            { 0, 0, 1280, 640 }, { 0, 0, 1920, 1080 }, { 0, 0, 1000, 777 },
+            { 0, 0, 333, 199 }, { 0, 0, 64, 48 },
+    };
+
+    bool hasPartialVector = false;
+    for (mat4f const& p : projections) {
+        for (Viewport const& vp : viewports) {
+            utils::ArenaScope<LinearAllocatorArena> scope(arena);
+            Froxelizer froxelData(*engine);
+            froxelData.setOptions(5, 100);
+            froxelData.prepare(engine->getDriverApi(), scope, vp, p, 0.1, 100, 1);
+
+            size_t const countX = froxelData.getFroxelCountX();
+            hasPartialVector = hasPartialVector || (countX % 8);
+            for (size_t z = 0; z < froxelData.getFroxelCountZ(); z++) {
+                for (size_t y = 0; y < froxelData.getFroxelCountY(); y++) {
+                    for (size_t x = 0; x < countX; x++) {
+                        float4 const expected = getBoundingSphere(froxelData.getFroxelAt(x, y, z));
+                        float4 const sphere = froxelData.getFroxelBoundingSphere(x, y, z);
+                        float const epsilon = 1e-4f * std::max(1.0f, length(expected.xyz));
+                        ASSERT_NEAR(sphere.x, expected.x, epsilon) << x << ", " << y << ", " << z;
+                        ASSERT_NEAR(sphere.y, expected.y, epsilon) << x << ", " << y << ", " << z;
+                        ASSERT_NEAR(sphere.z, expected.z, epsilon) << x << ", " << y << ", " << z;
+                        ASSERT_NEAR(sphere.w, expected.w, epsilon) << x << ", " << y << ", " << z;
+                    }
+                }
+            }
+            froxelData.terminate(engine->getDriverApi());
+        }
+    }
+    EXPECT_TRUE(hasPartialVector);
+
+    Engine::destroy((Engine **)&engine);
+}
+
+TEST(FilamentTest, ShadowMapManagerMergeVisibleMasks) {
+    using VisibleMaskType = FScene::VisibleMaskType;
+
+    // the masks of each shadow map are only valid in its range, and garbage elsewhere
+    std::vector<VisibleMaskType> a(16, 0xFF);
+    std::vector<VisibleMaskType> b(16, 0xFF);
+    std::vector<VisibleMaskType> c(16, 0xFF);
+    Range<uint32_t> const ranges[] = {{ 6, 8 }, { 2, 5 }, { 4, 7 }};
+    VisibleMaskType const* const masks[] = { a.data(), b.data(), c.data() };
+    a[6] = 0x1; a[7] = 0x0;
+    b[2] = 0x1; b[3] = 0x0; b[4] = 0x2;
+    c[4] = 0x4; c[5] = 0x0; c[6] = 0x2;
+
+    std::vector<VisibleMaskType> merged(16, 0xAA);
+    Range<uint32_t> const range = ShadowMapManager::mergeVisibleMasks(
+            merged.data(), ranges, masks, 3);
+
+    // the merged range spans all the ranges, not just the last or the first one
+    EXPECT_EQ(range.first, 2);
+    EXPECT_EQ(range.last, 8);
+    std::vector<VisibleMaskType> const expected{
+            0xAA, 0xAA, 0x1, 0x0, 0x6, 0x0, 0x3, 0x0,
+            0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA };
+    EXPECT_EQ(merged, expected);
+
+    EXPECT_TRUE(ShadowMapManager::mergeVisibleMasks(merged.data(), ranges, masks, 0).empty());
+}
+
 TEST(FilamentTest, GoogleLineDirective) {
     {
         char s[512] = "#line 10 \"foobar\"";
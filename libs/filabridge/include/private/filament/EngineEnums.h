@@ -69,6 +69,7 @@ enum class ReservedSpecializationConstants : uint8_t {
     CONFIG_DEBUG_DIRECTIONAL_SHADOWMAP = 6,
     CONFIG_DEBUG_FROXEL_VISUALIZATION = 7,
     CONFIG_STEREO_EYE_COUNT = 8,
+    CONFIG_LARGE_LIGHT_COUNT = 9,
 };
 
 // This value is limited by UBO size, ES3.0 only guarantees 16 KiB.
@@ -76,6 +77,10 @@ enum class ReservedSpecializationConstants : uint8_t {
 constexpr size_t CONFIG_MAX_LIGHT_COUNT = 256;
 constexpr size_t CONFIG_MAX_LIGHT_INDEX = CONFIG_MAX_LIGHT_COUNT - 1;
 
+// The maximum number of lights when Engine::Config::largeLightCount is set.
+// This requires 64 KiB UBOs, and the Froxelizer's record buffer uses 16-bits indices in that mode.
+constexpr size_t CONFIG_MAX_LIGHT_COUNT_LARGE = 1024;
+
 // The number of specialization constants that Filament reserves for its own use. These are always
 // the first constants (from 0 to CONFIG_MAX_RESERVED_SPEC_CONSTANTS - 1).
 // Updating this value necessitates a material version bump.
@@ -115,6 +120,16 @@ constexpr size_t CONFIG_MAX_INSTANCES = 8;
 constexpr size_t CONFIG_MAX_INSTANCES = 64;
 #endif
 
+// The maximum number of automatic instances when Engine::Config::largeInstanceBatches is set.
+// This requires 64 KiB UBOs, and is only possible when CONFIG_MAX_INSTANCES is a specialization
+// constant (i.e. not with Vulkan, see CodeGenerator). The PER_RENDERABLE block then always has
+// this many elements: a buffer bound to it can't be smaller, whatever the instance count.
+#if defined(__EMSCRIPTEN__)
+constexpr size_t CONFIG_MAX_INSTANCES_LARGE = CONFIG_MAX_INSTANCES;
+#else
+constexpr size_t CONFIG_MAX_INSTANCES_LARGE = 256;
+#endif
+
 // The maximum number of bones that can be associated with a single renderable.
 // We store 32 bytes per bone. Must be a power-of-two, and must fit within CONFIG_MINSPEC_UBO_SIZE.
 constexpr size_t CONFIG_MAX_BONE_COUNT = 256;
@@ -252,12 +252,19 @@ utils::io::sstream& CodeGenerator::generateProlog(utils::io::sstream& out, Shade
         // CONFIG_MAX_INSTANCES is only needed for WebGL, so we can replace it with a constant.
         // CONFIG_FROXEL_BUFFER_HEIGHT can be hardcoded to 2048 because only 3% of Android devices
         //                             only support 16KiB buffer or less (1024 lines).
+        // CONFIG_MAX_LIGHT_COUNT and CONFIG_FROXEL_RECORD_BUFFER_HEIGHT are hardcoded to their
+        //                             large light count values (64 KiB), the buffers actually
+        //                             bound are smaller unless CONFIG_LARGE_LIGHT_COUNT is set.
         //
         // We *could* leave these as a specialization constant, but this triggers a crashing bug with
         // some Adreno drivers on Android. see: https://github.com/google/filament/issues/6444
         //
         out << "const int CONFIG_MAX_INSTANCES = " << (int)CONFIG_MAX_INSTANCES << ";\n";
         out << "const int CONFIG_FROXEL_BUFFER_HEIGHT = 2048;\n";
+        generateSpecializationConstant(out, "CONFIG_LARGE_LIGHT_COUNT",
+                +ReservedSpecializationConstants::CONFIG_LARGE_LIGHT_COUNT, false);
+        out << "const int CONFIG_MAX_LIGHT_COUNT = " << (int)CONFIG_MAX_LIGHT_COUNT_LARGE << ";\n";
+        out << "const int CONFIG_FROXEL_RECORD_BUFFER_HEIGHT = 4096;\n";
     } else {
         generateSpecializationConstant(out, "CONFIG_MAX_INSTANCES",
                 +ReservedSpecializationConstants::CONFIG_MAX_INSTANCES, (int)CONFIG_MAX_INSTANCES);
@@ -265,6 +272,15 @@ utils::io::sstream& CodeGenerator::generateProlog(utils::io::sstream& out, Shade
         // the default of 1024 (16KiB) is needed for 32% of Android devices
         generateSpecializationConstant(out, "CONFIG_FROXEL_BUFFER_HEIGHT",
                 +ReservedSpecializationConstants::CONFIG_FROXEL_BUFFER_HEIGHT, 1024);
+
+        // the lights and froxel records buffers are 64 KiB with large light counts, 16 KiB
+        // otherwise.
+        generateSpecializationConstant(out, "CONFIG_LARGE_LIGHT_COUNT",
+                +ReservedSpecializationConstants::CONFIG_LARGE_LIGHT_COUNT, false);
+        out << "const int CONFIG_MAX_LIGHT_COUNT = CONFIG_LARGE_LIGHT_COUNT ? "
+            << (int)CONFIG_MAX_LIGHT_COUNT_LARGE << " : " << (int)CONFIG_MAX_LIGHT_COUNT << ";\n";
+        out << "const int CONFIG_FROXEL_RECORD_BUFFER_HEIGHT = "
+               "CONFIG_LARGE_LIGHT_COUNT ? 4096 : 1024;\n";
     }
 
     // directional shadowmap visualization
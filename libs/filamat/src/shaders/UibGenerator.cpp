@@ -174,7 +174,8 @@ BufferInterfaceBlock const& UibGenerator::getLightsUib() noexcept {
     static BufferInterfaceBlock const uib = BufferInterfaceBlock::Builder()
             .name(LightsUib::_name)
             .add({{ "lights", CONFIG_MAX_LIGHT_COUNT,
-                    BufferInterfaceBlock::Type::MAT4, Precision::HIGH }})
+                    BufferInterfaceBlock::Type::MAT4, Precision::HIGH,
+                    FeatureLevel::FEATURE_LEVEL_1, {}, {}, "CONFIG_MAX_LIGHT_COUNT" }})
             .build();
     return uib;
 }
@@ -211,7 +212,8 @@ BufferInterfaceBlock const& UibGenerator::getPerRenderableMorphingUib() noexcept
 BufferInterfaceBlock const& UibGenerator::getFroxelRecordUib() noexcept {
     static BufferInterfaceBlock const uib = BufferInterfaceBlock::Builder()
             .name(FroxelRecordUib::_name)
-            .add({{ "records", 1024, BufferInterfaceBlock::Type::UINT4, Precision::HIGH }})
+            .add({{ "records", 1024, BufferInterfaceBlock::Type::UINT4, Precision::HIGH,
+                    FeatureLevel::FEATURE_LEVEL_1, {}, {}, "CONFIG_FROXEL_RECORD_BUFFER_HEIGHT"}})
             .build();
     return uib;
 }
@@ -193,11 +193,16 @@ void Ktx2Provider::waitForCompletion() {
 }
 
 void Ktx2Provider::cancelDecoding() {
-    // TODO: Currently, Ktx2Provider runs jobs eagerly and JobSystem does not allow cancellation of
-    // in-flight jobs. We should consider throttling the number of simultaneous decoder jobs, which
-    // would allow for actual cancellation.
+    // Transcoder jobs that haven't started yet are skipped, so this only waits for the ones in
+    // flight.
+    JobSystem& js = mEngine->getJobSystem();
+    js.requestCancellation(mDecoderRootJob);
     waitForCompletion();
 
+    // textures pushed from now on are transcoded under a new root job
+    js.release(mDecoderRootJob);
+    mDecoderRootJob = js.createJob(nullptr, JobSystem::Lane::BACKGROUND);
+
     // For cancelled jobs, we need to set the QueueItemState to POPPED and free the decoded data
     // stored in item->async.
     for (auto& item : mQueueItems) {
@@ -231,7 +236,8 @@ void Ktx2Provider::transcodeSingleTexture() {
 }
 
 Ktx2Provider::Ktx2Provider(Engine* engine) : mEngine(engine) {
-    mDecoderRootJob = mEngine->getJobSystem().createJob();
+    // transcoding must not delay the engine's frame-critical jobs
+    mDecoderRootJob = mEngine->getJobSystem().createJob(nullptr, JobSystem::Lane::BACKGROUND);
 #ifdef NDEBUG
     const bool quiet = true;
 #else
@@ -215,11 +215,16 @@ void StbProvider::waitForCompletion() {
 }
 
 void StbProvider::cancelDecoding() {
-    // TODO: Currently, StbProvider runs jobs eagerly and JobSystem does not allow cancellation of
-    // in-flight jobs. We should consider throttling the number of simultaneous decoder jobs, which
-    // would allow for actual cancellation.
+    // Decoder jobs that haven't started yet are skipped, so this only waits for the ones in
+    // flight. The job system doesn't interrupt those, stb_image can't poll for cancellation.
+    JobSystem& js = mEngine->getJobSystem();
+    js.requestCancellation(mDecoderRootJob);
     waitForCompletion();
 
+    // textures pushed from now on are decoded under a new root job
+    js.release(mDecoderRootJob);
+    mDecoderRootJob = js.createJob(nullptr, JobSystem::Lane::BACKGROUND);
+
     // For cancelled jobs, we need to set the TextureInfo to the popped state and free the decoded
     // data.
     for (auto& info : mTextures) {
@@ -262,7 +267,8 @@ void StbProvider::decodeSingleTexture() {
 }
 
 StbProvider::StbProvider(Engine* engine) : mEngine(engine) {
-    mDecoderRootJob = mEngine->getJobSystem().createJob();
+    // decoding must not delay the engine's frame-critical jobs
+    mDecoderRootJob = mEngine->getJobSystem().createJob(nullptr, JobSystem::Lane::BACKGROUND);
 #ifndef NDEBUG
     slog.i << "Texture Decoder has "
             << mEngine->getJobSystem().getThreadCount()
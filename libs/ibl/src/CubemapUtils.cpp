@@ -263,7 +263,7 @@ void CubemapUtils::cubemapToEquirectangular(JobSystem& js, Image& dst, const Cub
     };
 
     auto job = jobs::parallel_for(js, nullptr, 0, uint32_t(h),
-            std::ref(parallelJobTask), jobs::CountSplitter<1, 8>());
+            std::ref(parallelJobTask), jobs::AdaptiveSplitter(js));
     js.runAndWait(job);
 }
 
@@ -297,7 +297,7 @@ void CubemapUtils::cubemapToOctahedron(JobSystem& js, Image& dst, const Cubemap&
     };
 
     auto job = jobs::parallel_for(js, nullptr, 0, uint32_t(h),
-            std::ref(parallelJobTask), jobs::CountSplitter<1, 8>());
+            std::ref(parallelJobTask), jobs::AdaptiveSplitter(js));
     js.runAndWait(job);
 }
 
@@ -31,6 +31,7 @@
 #include <tsl/robin_map.h>
 
 #include <atomic>
+#include <chrono>
 #include <functional>
 #include <mutex>
 #include <type_traits>
@@ -53,6 +54,24 @@ public:
 
     using JobFunc = void(*)(void*, JobSystem&, Job*);
 
+    /*
+     * Jobs are queued in one of two lanes. Worker threads always drain the CRITICAL lane, including
+     * by stealing from other threads, before picking up a BACKGROUND job. A job that has started
+     * is never preempted, so long background work should be split into several jobs (e.g. with
+     * parallel_for), between which workers go back to the critical lane.
+     *
+     * A job runs in the lane of its parent (or of the root job) unless created with an explicit
+     * lane, see createJob(Job*, Lane).
+     *
+     * A thread waiting for a critical job only helps with critical jobs, so that it isn't
+     * delayed by background work. Consequently, a background job can't be the child of a critical
+     * job, and doesn't take a critical root job as its parent.
+     */
+    enum class Lane : uint8_t {
+        CRITICAL,       // frame-critical work, e.g.: culling, froxelization, command generation
+        BACKGROUND      // latency-tolerant work, e.g.: texture decoding, LUT generation
+    };
+
     class alignas(CACHELINE_SIZE) Job {
     public:
         Job() noexcept {} /* = default; */ /* clang bug */ // NOLINT(modernize-use-equals-default,cppcoreguidelines-pro-type-member-init)
@@ -77,7 +96,9 @@ public:
         uint16_t parent;                                        //  2 |  2
         std::atomic<uint16_t> runningJobCount = { 1 };          //  2 |  2
         mutable std::atomic<uint16_t> refCount = { 1 };         //  2 |  2
-                                                                //  6 |  2 (padding)
+        Lane lane;                                              //  1 |  1
+        std::atomic<bool> cancelled = { false };                //  1 |  1
+                                                                //  4 |  0 (padding)
                                                                 // 64 | 64
     };
 
@@ -105,6 +126,7 @@ public:
 
 
     Job* create(Job* parent, JobFunc func) noexcept;
+    Job* create(Job* parent, JobFunc func, Lane lane) noexcept;
 
     // NOTE: All methods below must be called from the same thread and that thread must be
     // owned by JobSystem's thread pool.
@@ -170,13 +192,21 @@ public:
         return create(parent, nullptr);
     }
 
+    // creates an empty (no-op) job in the given lane, its children will inherit this lane.
+    // e.g.: a parent for background jobs.
+    Job* createJob(Job* parent, Lane lane) noexcept {
+        return create(parent, nullptr, lane);
+    }
+
     // creates a job from a KNOWN method pointer w/ object passed by pointer
     // the caller must ensure the object will outlive the Job
     template<typename T, void(T::*method)(JobSystem&, Job*)>
     Job* createJob(Job* parent, T* data) noexcept {
         Job* job = create(parent, +[](void* storage, JobSystem& js, Job* job) {
             T* const that = static_cast<T*>(reinterpret_cast<void**>(storage)[0]);
-            (that->*method)(js, job);
+            if (UTILS_LIKELY(!js.isCancelled(job))) {
+                (that->*method)(js, job);
+            }
         });
         if (job) {
             job->storage[0] = data;
@@ -190,7 +220,9 @@ public:
         static_assert(sizeof(data) <= sizeof(Job::storage), "user data too large");
         Job* job = create(parent, [](void* storage, JobSystem& js, Job* job) {
             T* const that = static_cast<T*>(storage);
-            (that->*method)(js, job);
+            if (UTILS_LIKELY(!js.isCancelled(job))) {
+                (that->*method)(js, job);
+            }
             that->~T();
         });
         if (job) {
@@ -205,7 +237,9 @@ public:
         static_assert(sizeof(functor) <= sizeof(Job::storage), "functor too large");
         Job* job = create(parent, [](void* storage, JobSystem& js, Job* job){
             T* const that = static_cast<T*>(storage);
-            that->operator()(js, job);
+            if (UTILS_LIKELY(!js.isCancelled(job))) {
+                that->operator()(js, job);
+            }
             that->~T();
         });
         if (job) {
@@ -222,6 +256,28 @@ public:
      */
     void cancel(Job*& job) noexcept;
 
+    /*
+     * Requests the cancellation of a job and of all its descendants, including the ones created
+     * after this call. This can be called from any thread, at any time before the job is released.
+     *
+     * Jobs created with a flavor of createJob() are skipped if they haven't started yet; they
+     * complete without running, so waiting on a cancelled subtree only waits for the jobs that
+     * are already running. Those can poll isCancelled() to return early. A JobFunc passed to
+     * create() directly must check isCancelled() itself.
+     *
+     * Cancellation can't be undone, use a new parent job for subsequent work.
+     */
+    void requestCancellation(Job* job) noexcept;
+
+    /*
+     * Returns whether the cancellation of this job or of one of its ancestors was requested.
+     * This is cheap when no cancellation is pending, it's intended to be polled by long jobs.
+     */
+    bool isCancelled(Job const* job) const noexcept {
+        return UTILS_UNLIKELY(mCancelledJobCount.load(std::memory_order_relaxed)) &&
+               isCancelledSlow(job);
+    }
+
     /*
      * Adds a reference to a Job.
      *
@@ -330,12 +386,19 @@ private:
         // make sure storage is cache-line aligned
         WorkQueue workQueue;
 
+        alignas(CACHELINE_SIZE)
+        WorkQueue backgroundWorkQueue;
+
         // these are not accessed by the worker threads
         alignas(CACHELINE_SIZE)     // this causes 56-bytes padding
         JobSystem* js;
         std::thread thread;
         default_random_engine rndGen;
         uint32_t id;
+
+        WorkQueue& getWorkQueue(Lane lane) noexcept {
+            return lane == Lane::CRITICAL ? workQueue : backgroundWorkQueue;
+        }
     };
 
     static_assert(sizeof(ThreadState) % CACHELINE_SIZE == 0,
@@ -353,15 +416,22 @@ private:
     void requestExit() noexcept;
     bool exitRequested() const noexcept;
     bool hasActiveJobs() const noexcept;
+    bool hasActiveJobs(Lane lane) const noexcept;
+
+    std::atomic<uint32_t>& getActiveJobs(Lane lane) noexcept {
+        return lane == Lane::CRITICAL ? mActiveJobs : mActiveBackgroundJobs;
+    }
 
     void loop(ThreadState* state) noexcept;
-    bool execute(JobSystem::ThreadState& state) noexcept;
-    Job* steal(JobSystem::ThreadState& state) noexcept;
+    // executes a job from 'lane' or from a more urgent lane, returns false if there was none
+    bool execute(JobSystem::ThreadState& state, Lane lane = Lane::BACKGROUND) noexcept;
+    Job* steal(JobSystem::ThreadState& state, Lane lane) noexcept;
     void finish(Job* job) noexcept;
+    bool isCancelledSlow(Job const* job) const noexcept;
 
-    void put(WorkQueue& workQueue, Job* job) noexcept;
-    Job* pop(WorkQueue& workQueue) noexcept;
-    Job* steal(WorkQueue& workQueue) noexcept;
+    void put(ThreadState& state, Job* job) noexcept;
+    Job* pop(WorkQueue& workQueue, Lane lane) noexcept;
+    Job* steal(WorkQueue& workQueue, Lane lane) noexcept;
 
     void wait(std::unique_lock<Mutex>& lock, Job* job = nullptr) noexcept;
     void wakeAll() noexcept;
@@ -371,7 +441,9 @@ private:
     utils::Mutex mWaiterLock;
     utils::Condition mWaiterCondition;
 
-    std::atomic<uint32_t> mActiveJobs = { 0 };
+    std::atomic<uint32_t> mActiveJobs = { 0 };              // in the CRITICAL lane
+    std::atomic<uint32_t> mActiveBackgroundJobs = { 0 };    // in the BACKGROUND lane
+    std::atomic<uint32_t> mCancelledJobCount = { 0 };       // # of live cancelled jobs
     utils::Arena<utils::ThreadSafeObjectPoolAllocator<Job>, LockingPolicy::NoLock> mJobPool;
 
     template <typename T>
@@ -435,6 +507,64 @@ JobSystem::Job* createJob(JobSystem& js, JobSystem::Job* parent,
 }
 
 
+/*
+ * AdaptiveSplitter sizes the jobs of a parallel_for() so that each takes about a target duration,
+ * instead of using a fixed item count like CountSplitter.
+ *
+ * The cost of an item is learned by timing the jobs, separately for each type of functor (i.e.
+ * for each call site, since each lambda has its own type), and kept across calls. A range is
+ * split only while each half would take at least the target duration, and the split depth is
+ * limited to about 4 jobs per thread of the JobSystem. Until a cost is known, each half must
+ * have at least UNKNOWN_COST_MIN_COUNT items instead.
+ *
+ * When split<F>(0, count) is false, the whole range runs in a single job, callers can then
+ * skip the job entirely and call execute() directly.
+ */
+class AdaptiveSplitter {
+public:
+    static constexpr size_t UNKNOWN_COST_MIN_COUNT = 256;
+
+    explicit AdaptiveSplitter(JobSystem const& js, uint16_t targetDurationUs = 50) noexcept
+            : mMaxSplits(uint8_t(js.getParallelSplitCount() + 2)),
+              mTargetDurationUs(targetDurationUs) {
+    }
+
+    template<typename F>
+    bool split(size_t splits, size_t count) const noexcept {
+        if (splits >= mMaxSplits || count < 2) {
+            return false;
+        }
+        float const cost = sNanosecondsPerItem<F>.load(std::memory_order_relaxed);
+        if (cost <= 0.0f) {
+            return count / 2 >= UNKNOWN_COST_MIN_COUNT;
+        }
+        return float(count / 2) * cost >= 1000.0f * float(mTargetDurationUs);
+    }
+
+    template<typename F>
+    void execute(F& functor, uint32_t start, uint32_t count) const noexcept {
+        auto const begin = std::chrono::steady_clock::now();
+        functor(start, count);
+        std::chrono::duration<float, std::nano> const duration =
+                std::chrono::steady_clock::now() - begin;
+        if (UTILS_LIKELY(count)) {
+            // moving average of the cost of an item, it's fine to lose concurrent updates.
+            float const sample = duration.count() / float(count);
+            std::atomic<float>& cost = sNanosecondsPerItem<F>;
+            float const estimate = cost.load(std::memory_order_relaxed);
+            cost.store(estimate > 0.0f ? estimate + (sample - estimate) * 0.25f : sample,
+                    std::memory_order_relaxed);
+        }
+    }
+
+private:
+    template<typename F>
+    static inline std::atomic<float> sNanosecondsPerItem{ 0.0f };
+
+    uint8_t mMaxSplits;
+    uint16_t mTargetDurationUs;
+};
+
 namespace details {
 
 template<typename S, typename F>
@@ -458,7 +588,7 @@ struct ParallelForJobData {
 
         // this branch is often miss-predicted (it both sides happen 50% of the calls)
 right_side:
-        if (splitter.split(splits, count)) {
+        if (split()) {
             const size_type lc = count / 2;
             JobData ld(start, lc, splits + uint8_t(1), functor, splitter);
             JobSystem::Job* l = js.createJob<JobData, &JobData::parallelWithJobs>(parent, std::move(ld));
@@ -481,11 +611,23 @@ right_side:
         } else {
 execute:
             // we're done splitting, do the real work here!
-            functor(start, count);
+            if constexpr (std::is_same_v<SplitterType, AdaptiveSplitter>) {
+                splitter.execute(functor, start, count);
+            } else {
+                functor(start, count);
+            }
         }
     }
 
 private:
+    bool split() const noexcept {
+        if constexpr (std::is_same_v<SplitterType, AdaptiveSplitter>) {
+            return splitter.template split<Functor>(splits, count);
+        } else {
+            return splitter.split(splits, count);
+        }
+    }
+
     size_type start;            // 4
     size_type count;            // 4
     Functor functor;            // ?
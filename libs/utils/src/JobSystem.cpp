@@ -221,6 +221,9 @@ void JobSystem::decRef(Job const* job) noexcept {
     assert(c > 0);
     if (c == 1) {
         // This was the last reference, it's safe to destroy the job.
+        if (UTILS_UNLIKELY(job->cancelled.load(std::memory_order_relaxed))) {
+            mCancelledJobCount.fetch_sub(1, std::memory_order_relaxed);
+        }
         mJobPool.destroy(job);
     }
 }
@@ -240,7 +243,14 @@ inline bool JobSystem::exitRequested() const noexcept {
 
 inline bool JobSystem::hasActiveJobs() const noexcept {
     HEAVY_SYSTRACE_CALL();
-    return mActiveJobs.load(std::memory_order_relaxed) > 0;
+    return hasActiveJobs(Lane::CRITICAL) || hasActiveJobs(Lane::BACKGROUND);
+}
+
+inline bool JobSystem::hasActiveJobs(Lane lane) const noexcept {
+    HEAVY_SYSTRACE_CALL();
+    std::atomic<uint32_t> const& activeJobs =
+            lane == Lane::CRITICAL ? mActiveJobs : mActiveBackgroundJobs;
+    return activeJobs.load(std::memory_order_relaxed) > 0;
 }
 
 inline bool JobSystem::hasJobCompleted(JobSystem::Job const* job) noexcept {
@@ -268,7 +278,7 @@ void JobSystem::wait(std::unique_lock<Mutex>& lock, Job* job) noexcept {
             // confidence that we're in an incorrect state.
 
             auto id = getState().id;
-            auto activeJobs = mActiveJobs.load();
+            auto activeJobs = mActiveJobs.load() + mActiveBackgroundJobs.load();
 
             if (job) {
                 auto runningJobCount = job->runningJobCount.load();
@@ -312,16 +322,16 @@ JobSystem::Job* JobSystem::allocateJob() noexcept {
     return mJobPool.make<Job>();
 }
 
-void JobSystem::put(WorkQueue& workQueue, Job* job) noexcept {
+void JobSystem::put(ThreadState& state, Job* job) noexcept {
     HEAVY_SYSTRACE_CALL();
     assert(job);
     size_t index = job - mJobStorageBase;
     assert(index >= 0 && index < MAX_JOB_COUNT);
 
-    // put the job into the queue first
-    workQueue.push(uint16_t(index + 1));
+    // put the job into the queue of its lane first
+    state.getWorkQueue(job->lane).push(uint16_t(index + 1));
     // then increase our active job count
-    uint32_t oldActiveJobs = mActiveJobs.fetch_add(1, std::memory_order_relaxed);
+    uint32_t oldActiveJobs = getActiveJobs(job->lane).fetch_add(1, std::memory_order_relaxed);
     // but it's possible that the job has already been picked-up, so oldActiveJobs could be
     // negative for instance. We signal only if that's not the case.
     if (oldActiveJobs >= 0) {
@@ -329,20 +339,22 @@ void JobSystem::put(WorkQueue& workQueue, Job* job) noexcept {
     }
 }
 
-JobSystem::Job* JobSystem::pop(WorkQueue& workQueue) noexcept {
+JobSystem::Job* JobSystem::pop(WorkQueue& workQueue, Lane lane) noexcept {
     HEAVY_SYSTRACE_CALL();
-    // decrement mActiveJobs first, this is to ensure that if there is only a single job left
+    std::atomic<uint32_t>& activeJobs = getActiveJobs(lane);
+
+    // decrement activeJobs first, this is to ensure that if there is only a single job left
     // (and we're about to pick it up), other threads don't loop trying to do the same.
-    mActiveJobs.fetch_sub(1, std::memory_order_relaxed);
+    activeJobs.fetch_sub(1, std::memory_order_relaxed);
 
     size_t index = workQueue.pop();
     assert(index <= MAX_JOB_COUNT);
     Job* job = !index ? nullptr : &mJobStorageBase[index - 1];
 
     // if our guess was wrong, i.e. we couldn't pick-up a job (b/c our queue was empty), we
-    // need to correct mActiveJobs.
+    // need to correct activeJobs.
     if (!job) {
-        if (mActiveJobs.fetch_add(1, std::memory_order_relaxed) >= 0) {
+        if (activeJobs.fetch_add(1, std::memory_order_relaxed) >= 0) {
             // and if there are some active jobs, then we need to wake someone up. We know it
             // can't be us, because we failed taking a job and we know another thread can't
             // have added one in our queue.
@@ -352,19 +364,21 @@ JobSystem::Job* JobSystem::pop(WorkQueue& workQueue) noexcept {
     return job;
 }
 
-JobSystem::Job* JobSystem::steal(WorkQueue& workQueue) noexcept {
+JobSystem::Job* JobSystem::steal(WorkQueue& workQueue, Lane lane) noexcept {
     HEAVY_SYSTRACE_CALL();
-    // decrement mActiveJobs first, this is to ensure that if there is only a single job left
+    std::atomic<uint32_t>& activeJobs = getActiveJobs(lane);
+
+    // decrement activeJobs first, this is to ensure that if there is only a single job left
     // (and we're about to pick it up), other threads don't loop trying to do the same.
-    mActiveJobs.fetch_sub(1, std::memory_order_relaxed);
+    activeJobs.fetch_sub(1, std::memory_order_relaxed);
 
     size_t index = workQueue.steal();
     assert(index <= MAX_JOB_COUNT);
     Job* job = !index ? nullptr : &mJobStorageBase[index - 1];
 
-    // if we failed taking a job, we need to correct mActiveJobs
+    // if we failed taking a job, we need to correct activeJobs
     if (!job) {
-        if (mActiveJobs.fetch_add(1, std::memory_order_relaxed) >= 0) {
+        if (activeJobs.fetch_add(1, std::memory_order_relaxed) >= 0) {
             // and if there are some active jobs, then we need to wake someone up. We know it
             // can't be us, because we failed taking a job and we know another thread can't
             // have added one in our queue.
@@ -397,27 +411,37 @@ inline JobSystem::ThreadState* JobSystem::getStateToStealFrom(JobSystem::ThreadS
     return stateToStealFrom;
 }
 
-JobSystem::Job* JobSystem::steal(JobSystem::ThreadState& state) noexcept {
+JobSystem::Job* JobSystem::steal(JobSystem::ThreadState& state, Lane lane) noexcept {
     HEAVY_SYSTRACE_CALL();
     Job* job = nullptr;
     do {
         ThreadState* const stateToStealFrom = getStateToStealFrom(state);
         if (UTILS_LIKELY(stateToStealFrom)) {
-            job = steal(stateToStealFrom->workQueue);
+            job = steal(stateToStealFrom->getWorkQueue(lane), lane);
         }
-        // nullptr -> nothing to steal in that queue either, if there are active jobs,
-        // continue to try stealing one.
-    } while (!job && hasActiveJobs());
+        // nullptr -> nothing to steal in that queue either, if there are active jobs in this
+        // lane, continue to try stealing one -- unless critical jobs showed up while we were
+        // looking for a background one, in which case our caller must go back to them.
+    } while (!job && hasActiveJobs(lane) &&
+            (lane == Lane::CRITICAL || !hasActiveJobs(Lane::CRITICAL)));
     return job;
 }
 
-bool JobSystem::execute(JobSystem::ThreadState& state) noexcept {
+bool JobSystem::execute(JobSystem::ThreadState& state, Lane lane) noexcept {
     HEAVY_SYSTRACE_CALL();
 
-    Job* job = pop(state.workQueue);
+    Job* job = pop(state.workQueue, Lane::CRITICAL);
     if (UTILS_UNLIKELY(job == nullptr)) {
         // our queue is empty, try to steal a job
-        job = steal(state);
+        job = steal(state, Lane::CRITICAL);
+    }
+    if (UTILS_UNLIKELY(job == nullptr) && lane == Lane::BACKGROUND &&
+            hasActiveJobs(Lane::BACKGROUND)) {
+        // there is no critical job left anywhere, pick-up a background job
+        job = pop(state.backgroundWorkQueue, Lane::BACKGROUND);
+        if (job == nullptr) {
+            job = steal(state, Lane::BACKGROUND);
+        }
     }
 
     if (job) {
@@ -495,8 +519,19 @@ void JobSystem::finish(Job* job) noexcept {
 
 
 JobSystem::Job* JobSystem::create(JobSystem::Job* parent, JobFunc func) noexcept {
-    HEAVY_SYSTRACE_CALL();
     parent = (parent == nullptr) ? mRootJob : parent;
+    return create(parent, func, parent ? parent->lane : Lane::CRITICAL);
+}
+
+JobSystem::Job* JobSystem::create(JobSystem::Job* parent, JobFunc func, Lane lane) noexcept {
+    HEAVY_SYSTRACE_CALL();
+    // waiting for a critical job doesn't execute background jobs, see waitAndRelease()
+    if (parent == nullptr && mRootJob &&
+            (lane == Lane::CRITICAL || mRootJob->lane == Lane::BACKGROUND)) {
+        parent = mRootJob;
+    }
+    ASSERT_PRECONDITION(!parent || lane == Lane::CRITICAL || parent->lane == Lane::BACKGROUND,
+            "A background job can't be the child of a critical job");
     Job* const job = allocateJob();
     if (UTILS_LIKELY(job)) {
         size_t index = 0x7FFF;
@@ -514,6 +549,7 @@ JobSystem::Job* JobSystem::create(JobSystem::Job* parent, JobFunc func) noexcept
         }
         job->function = func;
         job->parent = uint16_t(index);
+        job->lane = lane;
     }
     return job;
 }
@@ -524,6 +560,29 @@ void JobSystem::cancel(Job*& job) noexcept {
     job = nullptr;
 }
 
+void JobSystem::requestCancellation(Job* job) noexcept {
+    HEAVY_SYSTRACE_CALL();
+    assert(job);
+    // memory_order_relaxed is enough, cancellation is only a hint: a job which doesn't see it
+    // yet simply runs.
+    if (!job->cancelled.exchange(true, std::memory_order_relaxed)) {
+        mCancelledJobCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+UTILS_NOINLINE
+bool JobSystem::isCancelledSlow(Job const* job) const noexcept {
+    // a job's ancestors can't be destroyed before it terminates, so it's safe to walk up the tree.
+    Job* const storage = mJobStorageBase;
+    while (job) {
+        if (job->cancelled.load(std::memory_order_relaxed)) {
+            return true;
+        }
+        job = job->parent == 0x7FFF ? nullptr : &storage[job->parent];
+    }
+    return false;
+}
+
 JobSystem::Job* JobSystem::retain(JobSystem::Job* job) noexcept {
     HEAVY_SYSTRACE_CALL();
     JobSystem::Job* retained = job;
@@ -547,7 +606,7 @@ void JobSystem::run(Job*& job) noexcept {
 
     ThreadState& state(getState());
 
-    put(state.workQueue, job);
+    put(state, job);
 
     // after run() returns, the job is virtually invalid (it'll die on its own)
     job = nullptr;
@@ -566,9 +625,16 @@ void JobSystem::waitAndRelease(Job*& job) noexcept {
     assert(job);
     assert(job->refCount.load(std::memory_order_relaxed) >= 1);
 
+    // While waiting for a critical job, we only help with critical jobs: a background job could
+    // take much longer than the job we're waiting for.
+    Lane const lane = job->lane;
+    auto hasJobsToExecute = [this, lane]() {
+        return lane == Lane::CRITICAL ? hasActiveJobs(Lane::CRITICAL) : hasActiveJobs();
+    };
+
     ThreadState& state(getState());
     do {
-        if (!execute(state)) {
+        if (!execute(state, lane)) {
             // test if job has completed first, to possibly avoid taking the lock
             if (hasJobCompleted(job)) {
                 break;
@@ -584,7 +650,12 @@ void JobSystem::waitAndRelease(Job*& job) noexcept {
             // continue to handle more jobs, as they get added.
 
             std::unique_lock<Mutex> lock(mWaiterLock);
-            if (!hasJobCompleted(job) && !hasActiveJobs() && !exitRequested()) {
+            if (!hasJobCompleted(job) && !hasJobsToExecute() && !exitRequested()) {
+                if (hasActiveJobs()) {
+                    // we may have been woken up for background jobs we won't execute, make sure
+                    // another thread picks them up.
+                    mWaiterCondition.notify_one();
+                }
                 wait(lock, job);
             }
         }
@@ -651,7 +722,8 @@ void JobSystem::emancipate() {
 
 io::ostream& operator<<(io::ostream& out, JobSystem const& js) {
     for (auto const& item : js.mThreadStates) {
-        out << size_t(item.id) << ": " << item.workQueue.getCount() << io::endl;
+        out << size_t(item.id) << ": " << item.workQueue.getCount()
+            << " (background: " << item.backgroundWorkQueue.getCount() << ")" << io::endl;
     }
     return out;
 }
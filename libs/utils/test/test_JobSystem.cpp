@@ -23,7 +23,9 @@
 #include <math/mat3.h>
 
 #include <array>
+#include <chrono>
 #include <thread>
+#include <vector>
 #include <utils/Allocator.h>
 
 using namespace utils;
@@ -342,5 +344,264 @@ TEST(JobSystem, JobSystemDelegates) {
     EXPECT_EQ(4, functor.result);
 
 
+    js.emancipate();
+}
+
+TEST(JobSystem, JobSystemLanes) {
+    JobSystem js(1);
+    js.adopt();
+
+    // keep the only worker thread busy, so that this thread runs all the jobs below in order
+    std::atomic_bool started = { false };
+    std::atomic_bool done = { false };
+    JobSystem::Job* gate = js.createJob(nullptr, [&](JobSystem&, JobSystem::Job*) {
+        started = true;
+        while (!done) {
+            std::this_thread::yield();
+        }
+    });
+    gate = js.runAndRetain(gate);
+    while (!started) {
+        std::this_thread::yield();
+    }
+
+    std::vector<JobSystem::Lane> lanes;
+
+    // waiting for a background job executes the jobs of both lanes
+    JobSystem::Job* root = js.createJob(nullptr, JobSystem::Lane::BACKGROUND);
+    JobSystem::Job* background = js.createJob(root, JobSystem::Lane::BACKGROUND);
+    JobSystem::Job* critical = js.createJob(root, JobSystem::Lane::CRITICAL);
+
+    // background jobs are queued first, yet must run last
+    for (int i = 0; i < 16; i++) {
+        js.run(js.createJob(background, [&lanes](JobSystem&, JobSystem::Job*) {
+            lanes.push_back(JobSystem::Lane::BACKGROUND);
+        }));
+    }
+    for (int i = 0; i < 16; i++) {
+        js.run(js.createJob(critical, [&lanes](JobSystem&, JobSystem::Job*) {
+            lanes.push_back(JobSystem::Lane::CRITICAL);
+        }));
+    }
+    js.run(background);
+    js.run(critical);
+    js.runAndWait(root);
+
+    done = true;
+    js.waitAndRelease(gate);
+
+    ASSERT_EQ(32u, lanes.size());
+    for (size_t i = 0; i < lanes.size(); i++) {
+        EXPECT_EQ(i < 16 ? JobSystem::Lane::CRITICAL : JobSystem::Lane::BACKGROUND, lanes[i]);
+    }
+
+    js.emancipate();
+}
+
+TEST(JobSystem, JobSystemWaitForCriticalJob) {
+    JobSystem js(1);
+    js.adopt();
+
+    // keep the only worker thread busy, so that only this thread can run the jobs below
+    std::atomic_bool started = { false };
+    std::atomic_bool done = { false };
+    JobSystem::Job* gate = js.createJob(nullptr, [&](JobSystem&, JobSystem::Job*) {
+        started = true;
+        while (!done) {
+            std::this_thread::yield();
+        }
+    });
+    gate = js.runAndRetain(gate);
+    while (!started) {
+        std::this_thread::yield();
+    }
+
+    std::atomic<uint32_t> backgroundCount = { 0 };
+    std::atomic<uint32_t> criticalCount = { 0 };
+
+    JobSystem::Job* background = js.createJob(nullptr, JobSystem::Lane::BACKGROUND);
+    for (int i = 0; i < 16; i++) {
+        js.run(js.createJob(background, [&backgroundCount](JobSystem&, JobSystem::Job*) {
+            backgroundCount++;
+        }));
+    }
+    background = js.runAndRetain(background);
+
+    // waiting for a critical job doesn't execute the background jobs
+    JobSystem::Job* critical = js.createJob();
+    for (int i = 0; i < 16; i++) {
+        js.run(js.createJob(critical, [&criticalCount](JobSystem&, JobSystem::Job*) {
+            criticalCount++;
+        }));
+    }
+    js.runAndWait(critical);
+    EXPECT_EQ(16u, criticalCount.load());
+    EXPECT_EQ(0u, backgroundCount.load());
+
+    // a critical root job doesn't become the parent of background jobs
+    JobSystem::Job* root = js.setRootJob(js.createJob());
+    JobSystem::Job* orphan = js.createJob(nullptr, JobSystem::Lane::BACKGROUND);
+    js.run(js.createJob(orphan, [&backgroundCount](JobSystem&, JobSystem::Job*) {
+        backgroundCount++;
+    }));
+    orphan = js.runAndRetain(orphan);
+    js.runAndWait(root);
+    EXPECT_EQ(0u, backgroundCount.load());
+
+    js.waitAndRelease(background);
+    js.waitAndRelease(orphan);
+    EXPECT_EQ(17u, backgroundCount.load());
+
+    done = true;
+    js.waitAndRelease(gate);
+
+    js.emancipate();
+}
+
+TEST(JobSystem, JobSystemBackgroundParallelFor) {
+    JobSystem js;
+    js.adopt();
+
+    // the jobs parallel_for() spawns inherit the background lane from their parent
+    std::array<uint32_t, 4096 * 16> values{};
+    JobSystem::Job* parent = js.createJob(nullptr, JobSystem::Lane::BACKGROUND);
+    js.run(jobs::parallel_for(js, parent, values.data(), uint32_t(values.size()),
+            [](uint32_t* v, uint32_t c) {
+                for (uint32_t i = 0; i < c; i++) {
+                    v[i] = 1;
+                }
+            }, jobs::CountSplitter<64>()));
+    js.runAndWait(parent);
+
+    for (uint32_t value : values) {
+        EXPECT_EQ(1, value);
+    }
+
+    js.emancipate();
+}
+
+TEST(JobSystem, JobSystemCancellation) {
+    JobSystem js(1);
+    js.adopt();
+
+    // a running job polls for the cancellation of its parent
+    std::atomic_bool started = { false };
+    std::atomic_bool cancelled = { false };
+    JobSystem::Job* parent = js.createJob();
+    js.run(js.createJob(parent, [&](JobSystem& js, JobSystem::Job* job) {
+        started = true;
+        while (!js.isCancelled(job)) {
+            std::this_thread::yield();
+        }
+        cancelled = true;
+    }));
+    while (!started) {
+        std::this_thread::yield();
+    }
+    js.requestCancellation(parent);
+    js.runAndWait(parent);
+    EXPECT_TRUE(cancelled);
+
+    // keep the only worker thread busy, so none of the jobs below start before the cancellation
+    std::atomic_bool done = { false };
+    started = false;
+    JobSystem::Job* gate = js.runAndRetain(js.createJob(nullptr,
+            [&](JobSystem&, JobSystem::Job*) {
+        started = true;
+        while (!done) {
+            std::this_thread::yield();
+        }
+    }));
+    while (!started) {
+        std::this_thread::yield();
+    }
+
+    // jobs that haven't started are skipped, including the ones created after the cancellation
+    std::atomic_int calls = { 0 };
+    JobSystem::Job* root = js.createJob();
+    for (int i = 0; i < 16; i++) {
+        js.run(jobs::createJob(js, root, [&calls] { calls++; }));
+    }
+    js.requestCancellation(root);
+    JobSystem::Job* child = js.createJob(root, [&calls](JobSystem&, JobSystem::Job*) { calls++; });
+    EXPECT_TRUE(js.isCancelled(child));
+    js.run(child);
+    js.runAndWait(root);
+    EXPECT_EQ(0, calls);
+
+    done = true;
+    js.waitAndRelease(gate);
+
+    // other jobs are unaffected
+    JobSystem::Job* job = js.createJob(nullptr, [&calls](JobSystem& js, JobSystem::Job* job) {
+        EXPECT_FALSE(js.isCancelled(job));
+        calls++;
+    });
+    js.runAndWait(job);
+    EXPECT_EQ(1, calls);
+
+    js.emancipate();
+}
+
+TEST(JobSystem, JobSystemAdaptiveSplitter) {
+    JobSystem js;
+    js.adopt();
+
+    std::atomic_int leaves = { 0 };
+    std::array<uint32_t, 4096> values{};
+
+    // until their cost is known, small ranges aren't split
+    auto unknown = [&](uint32_t, uint32_t) { leaves++; };
+    js.runAndWait(jobs::parallel_for(js, nullptr, 0, 64,
+            std::cref(unknown), jobs::AdaptiveSplitter(js)));
+    EXPECT_EQ(1, leaves);
+    leaves = 0;
+
+    // cheap items: once their cost is known, a small range runs in a single job
+    auto cheap = [&](uint32_t start, uint32_t count) {
+        leaves++;
+        for (uint32_t i = start; i < start + count; i++) {
+            values[i]++;
+        }
+    };
+    for (int i = 0; i < 4; i++) {
+        js.runAndWait(jobs::parallel_for(js, nullptr, 0, uint32_t(values.size()),
+                std::cref(cheap), jobs::AdaptiveSplitter(js)));
+    }
+    for (uint32_t value : values) {
+        EXPECT_EQ(4, value);
+    }
+    leaves = 0;
+    js.runAndWait(jobs::parallel_for(js, nullptr, 0, 64,
+            std::cref(cheap), jobs::AdaptiveSplitter(js)));
+    EXPECT_EQ(1, leaves);
+
+    // expensive items (100us each): the same range is split
+    auto expensive = [&](uint32_t start, uint32_t count) {
+        leaves++;
+        auto const end = std::chrono::steady_clock::now() + std::chrono::microseconds(100 * count);
+        while (std::chrono::steady_clock::now() < end) {
+        }
+    };
+    js.runAndWait(jobs::parallel_for(js, nullptr, 0, 64,
+            std::cref(expensive), jobs::AdaptiveSplitter(js)));
+    leaves = 0;
+    js.runAndWait(jobs::parallel_for(js, nullptr, 0, 64,
+            std::cref(expensive), jobs::AdaptiveSplitter(js)));
+    EXPECT_LT(1, leaves);
+
+    // but a single item never is
+    leaves = 0;
+    js.runAndWait(jobs::parallel_for(js, nullptr, 0, 1,
+            std::cref(expensive), jobs::AdaptiveSplitter(js)));
+    EXPECT_EQ(1, leaves);
+
+    // the splitter tells when a range is better processed without any job
+    jobs::AdaptiveSplitter const splitter(js);
+    using Expensive = decltype(std::cref(expensive));
+    EXPECT_FALSE(splitter.split<Expensive>(0, 0));
+    EXPECT_FALSE(splitter.split<Expensive>(0, 1));
+    EXPECT_TRUE(splitter.split<Expensive>(0, 64));
+
     js.emancipate();
 }
@@ -80,8 +80,16 @@ FroxelParams getFroxelParams(const uint froxelIndex) {
 /**
  * Return the light index from the record index
  * A light record is a single uint index into the lights data buffer (lightsUniforms UBO).
+ * Records are 8-bits, or 16-bits when CONFIG_LARGE_LIGHT_COUNT is set.
  */
 uint getLightIndex(const uint index) {
+    if (CONFIG_LARGE_LIGHT_COUNT) {
+        uint v = index >> 3u;
+        uint c = (index >> 1u) & 0x3u;
+        uint s = (index & 0x1u) * 16u;
+        highp uvec4 d = froxelRecordUniforms.records[v];
+        return (d[c] >> s) & 0xFFFFu;
+    }
     uint v = index >> 4u;
     uint c = (index >> 2u) & 0x3u;
     uint s = (index & 0x3u) * 8u;
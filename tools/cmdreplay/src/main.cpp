@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <backend/DriverEnums.h>
+#include <backend/Platform.h>
+
+#include <private/backend/CommandStreamCapture.h>
+#include <private/backend/Driver.h>
+#include <private/backend/PlatformFactory.h>
+
+#include <utils/Path.h>
+
+#include <getopt/getopt.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace filament::backend;
+using namespace utils;
+
+static Backend g_backend = Backend::NOOP;
+static size_t g_bufferSizeMB = 32;
+static bool g_printStatistics = false;
+
+static void printUsage(const char* name) {
+    std::string execName(Path(name).getName());
+    std::string usage(
+            "CMDREPLAY executes the backend commands captured from a Filament application.\n"
+            "Usage:\n"
+            "    CMDREPLAY [options] <capture file>\n"
+            "\n"
+            "Captures are created with Engine::Config::commandStreamCapturePath.\n"
+            "\n"
+            "Options:\n"
+            "   --help, -h\n"
+            "       Print this message\n\n"
+            "   --license\n"
+            "       Print copyright and license information\n\n"
+            "   --api=[noop|opengl|vulkan|metal], -a [noop|opengl|vulkan|metal]\n"
+            "       Backend executing the commands, noop by default\n\n"
+            "   --buffer-size=MB, -b MB\n"
+            "       Size of the command buffer, it must hold the commands of a frame (32 MiB)\n\n"
+            "   --stats, -s\n"
+            "       Print the number and size of the commands of each type\n\n"
+    );
+
+    const std::string from("CMDREPLAY");
+    for (size_t pos = usage.find(from); pos != std::string::npos; pos = usage.find(from, pos)) {
+        usage.replace(pos, from.length(), execName);
+    }
+    printf("%s", usage.c_str());
+}
+
+static void license() {
+    static const char *license[] = {
+        #include "licenses/licenses.inc"
+        nullptr
+    };
+
+    const char **p = &license[0];
+    while (*p)
+        std::cout << *p++ << std::endl;
+}
+
+static int handleArguments(int argc, char* argv[]) {
+    static constexpr const char* OPTSTR = "ha:b:s";
+    static const struct option OPTIONS[] = {
+            { "help",                 no_argument, nullptr, 'h' },
+            { "license",              no_argument, nullptr, 'l' },
+            { "api",            required_argument, nullptr, 'a' },
+            { "buffer-size",    required_argument, nullptr, 'b' },
+            { "stats",                no_argument, nullptr, 's' },
+            { nullptr, 0, nullptr, 0 }  // termination of the option list
+    };
+
+    int opt;
+    int optionIndex = 0;
+
+    while ((opt = getopt_long(argc, argv, OPTSTR, OPTIONS, &optionIndex)) >= 0) {
+        std::string arg(optarg ? optarg : "");
+        switch (opt) {
+            default:
+            case 'h':
+                printUsage(argv[0]);
+                exit(0);
+                // break;
+            case 'l':
+                license();
+                exit(0);
+                // break;
+            case 'a':
+                if (arg == "noop") {
+                    g_backend = Backend::NOOP;
+                } else if (arg == "opengl") {
+                    g_backend = Backend::OPENGL;
+                } else if (arg == "vulkan") {
+                    g_backend = Backend::VULKAN;
+                } else if (arg == "metal") {
+                    g_backend = Backend::METAL;
+                } else {
+                    std::cerr << "Unrecognized backend. Must be 'noop'|'opengl'|'vulkan'|'metal'."
+                              << std::endl;
+                    exit(1);
+                }
+                break;
+            case 'b':
+                g_bufferSizeMB = std::max(1, std::stoi(arg));
+                break;
+            case 's':
+                g_printStatistics = true;
+                break;
+        }
+    }
+
+    return optind;
+}
+
+static void printStatistics(CommandStreamReplay::Statistics const& statistics) {
+    CommandStreamReplay::CommandStatistics total;
+    std::cout << std::left << std::setw(36) << "command"
+              << std::right << std::setw(12) << "count"
+              << std::setw(16) << "capture bytes"
+              << std::setw(16) << "stream bytes" << std::endl;
+    for (size_t i = 0; i < size_t(CommandId::COUNT); i++) {
+        CommandStreamReplay::CommandStatistics const& command = statistics.commands[i];
+        if (command.count) {
+            std::cout << std::left << std::setw(36) << getCommandName(CommandId(i))
+                      << std::right << std::setw(12) << command.count
+                      << std::setw(16) << command.captureSize
+                      << std::setw(16) << command.streamSize << std::endl;
+            total.count += command.count;
+            total.captureSize += command.captureSize;
+            total.streamSize += command.streamSize;
+        }
+    }
+    std::cout << std::left << std::setw(36) << "total"
+              << std::right << std::setw(12) << total.count
+              << std::setw(16) << total.captureSize
+              << std::setw(16) << total.streamSize << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    int const optionIndex = handleArguments(argc, argv);
+    if (optionIndex >= argc) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    Backend backend = g_backend;
+    Platform* platform = PlatformFactory::create(&backend);
+    if (!platform || backend != g_backend) {
+        std::cerr << "The requested backend is not supported in this build." << std::endl;
+        PlatformFactory::destroy(&platform);
+        return 1;
+    }
+
+    Driver* const driver = platform->createDriver(nullptr, {});
+    if (!driver) {
+        std::cerr << "Couldn't create the driver." << std::endl;
+        PlatformFactory::destroy(&platform);
+        return 1;
+    }
+
+    bool success;
+    {
+        CommandStreamReplay replay(*driver, g_bufferSizeMB * 1024 * 1024);
+        success = replay.replay(argv[optionIndex]);
+
+        CommandStreamReplay::Statistics const& statistics = replay.getStatistics();
+        if (g_printStatistics) {
+            printStatistics(statistics);
+        }
+        std::cout << statistics.frameCount << " frames replayed in "
+                  << double(statistics.executionTime) / 1e6 << " ms";
+        if (statistics.frameCount) {
+            std::cout << " (" << double(statistics.executionTime) / 1e6 / double(statistics.frameCount)
+                      << " ms per frame)";
+        }
+        std::cout << std::endl;
+        if (statistics.skippedCount) {
+            std::cout << statistics.skippedCount << " unknown commands skipped" << std::endl;
+        }
+    }
+
+    driver->terminate();
+    driver->purge();
+    delete driver;
+    PlatformFactory::destroy(&platform);
+
+    return success ? 0 : 1;
+}